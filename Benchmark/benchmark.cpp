@@ -0,0 +1,294 @@
+// Planet generation benchmark
+// Runs each generator over a range of subdivision levels, radii and noise settings, and reports
+// time per vertex, allocations, peak memory and a checksum of the output.
+//
+//   benchmark [--levels min-max] [--radius r[,r...]] [--seed n] [--frequency f] [--amplitude a]
+//             [--repeat n] [--threads n] [--no-noise]
+
+#include "planet.h"
+#include "planet_kernel.h"
+#include "mesh.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace planet_generator;
+
+// Allocation tracking, every allocation carries its size in front of it
+namespace
+{
+	std::atomic<uint64_t> allocation_count{ 0 };
+	std::atomic<uint64_t> allocated_bytes{ 0 };
+	std::atomic<int64_t> live_bytes{ 0 };
+	std::atomic<int64_t> peak_live_bytes{ 0 };
+
+	constexpr size_t header_size = alignof(std::max_align_t);
+
+	void *tracked_alloc(size_t size)
+	{
+		auto *block = static_cast<char *>(std::malloc(size + header_size));
+		if (not block)
+			throw std::bad_alloc();
+
+		std::memcpy(block, &size, sizeof(size));
+
+		allocation_count.fetch_add(1, std::memory_order_relaxed);
+		allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+		auto live = live_bytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + static_cast<int64_t>(size);
+
+		auto peak = peak_live_bytes.load(std::memory_order_relaxed);
+		while (live > peak and not peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		{}
+
+		return block + header_size;
+	}
+
+	void tracked_free(void *ptr)
+	{
+		if (not ptr)
+			return;
+
+		auto *block = static_cast<char *>(ptr) - header_size;
+		size_t size{};
+		std::memcpy(&size, block, sizeof(size));
+		live_bytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+
+		std::free(block);
+	}
+}
+
+void *operator new(size_t size) { return tracked_alloc(size); }
+void *operator new[](size_t size) { return tracked_alloc(size); }
+void operator delete(void *ptr) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr) noexcept { tracked_free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { tracked_free(ptr); }
+
+namespace
+{
+	struct options
+	{
+		uint32_t min_level = 0;
+		uint32_t max_level = 8;
+		std::vector<float> radii{ 1.0f };
+		noise_settings noise{};
+		bool with_noise = true;
+		uint32_t repeat = 3;
+		uint32_t threads = 0;   // 0 for hardware concurrency
+	};
+
+	struct generator
+	{
+		const char *name;
+		std::function<mesh(float radius, uint32_t level)> run;
+	};
+
+	struct result
+	{
+		double seconds;
+		uint64_t allocations;
+		uint64_t allocated;
+		int64_t peak_heap;
+		uint64_t checksum;
+		size_t vertex_count;
+		size_t triangle_count;
+	};
+
+	uint64_t peak_rss_bytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+		return static_cast<uint64_t>(usage.ru_maxrss) * 1024u;
+#endif
+	}
+
+	// FNV-1a over the raw vertex and index data
+	uint64_t checksum(const mesh &mesh_obj)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		auto add_bytes = [&](const void *data, size_t size)
+		{
+			auto *bytes = static_cast<const uint8_t *>(data);
+			for (size_t i{ 0 }; i < size; i++)
+			{
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+		};
+
+		add_bytes(mesh_obj.verticies.data(), mesh_obj.verticies.size() * sizeof(vertex));
+		add_bytes(mesh_obj.indicies.data(), mesh_obj.indicies.size() * sizeof(uint32_t));
+		return hash;
+	}
+
+	result measure(const generator &gen, float radius, uint32_t level, uint32_t repeat)
+	{
+		result best{};
+		best.seconds = 1e30;
+
+		for (uint32_t r{ 0 }; r < repeat; r++)
+		{
+			auto allocations_before = allocation_count.load();
+			auto allocated_before = allocated_bytes.load();
+			auto live_before = live_bytes.load();
+			peak_live_bytes = live_before;
+
+			auto start = std::chrono::steady_clock::now();
+			auto obj = gen.run(radius, level);
+			auto stop = std::chrono::steady_clock::now();
+
+			double seconds = std::chrono::duration<double>(stop - start).count();
+			if (seconds < best.seconds)
+			{
+				best.seconds = seconds;
+				best.allocations = allocation_count.load() - allocations_before;
+				best.allocated = allocated_bytes.load() - allocated_before;
+				best.peak_heap = peak_live_bytes.load() - live_before;
+			}
+
+			best.checksum = checksum(obj);
+			best.vertex_count = obj.verticies.size();
+			best.triangle_count = obj.indicies.size() / 3;
+		}
+
+		return best;
+	}
+
+	std::vector<float> parse_list(std::string_view text)
+	{
+		std::vector<float> values;
+		while (not text.empty())
+		{
+			auto comma = text.find(',');
+			values.push_back(std::stof(std::string(text.substr(0, comma))));
+			text = (comma == text.npos) ? std::string_view{} : text.substr(comma + 1);
+		}
+		return values;
+	}
+
+	options parse_options(int argc, char *argv[])
+	{
+		options opt{};
+		for (int i{ 1 }; i < argc; i++)
+		{
+			std::string_view arg = argv[i];
+			auto next = [&]() -> std::string
+			{
+				if (i + 1 >= argc)
+				{
+					std::fprintf(stderr, "missing value for %s\n", argv[i]);
+					std::exit(1);
+				}
+				return argv[++i];
+			};
+
+			if (arg == "--levels")
+			{
+				auto range = next();
+				auto dash = range.find('-');
+				opt.min_level = std::stoul(range.substr(0, dash));
+				opt.max_level = (dash == range.npos) ? opt.min_level : std::stoul(range.substr(dash + 1));
+			}
+			else if (arg == "--radius")     opt.radii = parse_list(next());
+			else if (arg == "--seed")       opt.noise.seed = std::stoi(next());
+			else if (arg == "--frequency")  opt.noise.frequency = std::stof(next());
+			else if (arg == "--amplitude")  opt.noise.amplitude = std::stof(next());
+			else if (arg == "--repeat")     opt.repeat = std::max(1ul, std::stoul(next()));
+			else if (arg == "--threads")    opt.threads = std::stoul(next());
+			else if (arg == "--no-noise")   opt.with_noise = false;
+			else
+			{
+				std::fprintf(stderr, "unknown option %s\n", argv[i]);
+				std::exit(1);
+			}
+		}
+		return opt;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	auto opt = parse_options(argc, argv);
+
+	thread_pool pool = opt.threads ? thread_pool(opt.threads - 1) : thread_pool();
+	auto heights = make_height_sampler(opt.noise);
+
+	// Subdivision level n is compared against a grid of 2^n quads per face edge, which has the same density
+	auto with_noise = [&](mesh obj) -> mesh
+	{
+		if (opt.with_noise)
+			layer_noise(opt.noise.type, obj);
+		return obj;
+	};
+
+	std::vector<generator> generators{
+		{ "subdivide_split",  [&](float r, uint32_t l) { return with_noise(generate_sphere(r, static_cast<uint8_t>(l), subdivision_mode::split_triangles)); } },
+		{ "subdivide_shared", [&](float r, uint32_t l) { return with_noise(generate_sphere(r, static_cast<uint8_t>(l), subdivision_mode::shared_vertices)); } },
+		{ "grid",             [&](float r, uint32_t l) { return with_noise(generate_grid_sphere(r, 1u << l)); } },
+		{ "grid_fused",       [&](float r, uint32_t l) { return opt.with_noise ? generate_planet(r, 1u << l, *heights) : generate_grid_sphere(r, 1u << l); } },
+		{ "grid_fused_mt",    [&](float r, uint32_t l) { return opt.with_noise ? generate_planet(r, 1u << l, *heights, &pool) : generate_grid_sphere(r, 1u << l, &pool); } },
+		{ "grid_normals_mt",  [&](float r, uint32_t l) { return opt.with_noise ? generate_planet(r, 1u << l, *heights, &pool, true) : generate_grid_sphere(r, 1u << l, &pool); } },
+	};
+
+	std::printf("kernel: %s, threads: %u, noise: %s (seed %d, frequency %g, amplitude %g)\n",
+	            kernel_instruction_set(),
+	            pool.size(),
+	            opt.with_noise ? "on" : "off",
+	            opt.noise.seed,
+	            opt.noise.frequency,
+	            opt.noise.amplitude);
+	std::printf("%-18s %5s %8s %12s %12s %10s %10s %10s %12s %12s %12s  %s\n",
+	            "generator", "level", "radius", "verticies", "triangles", "ms", "ns/vertex",
+	            "allocs", "alloc MiB", "peak heap MiB", "peak RSS MiB", "checksum");
+
+	constexpr double mib = 1024.0 * 1024.0;
+	for (auto radius : opt.radii)
+	{
+		for (uint32_t level{ opt.min_level }; level <= opt.max_level; level++)
+		{
+			for (auto &gen : generators)
+			{
+				auto res = measure(gen, radius, level, opt.repeat);
+
+				std::printf("%-18s %5u %8g %12zu %12zu %10.3f %10.2f %10llu %10.2f %12.2f %12.2f  %016llx\n",
+				            gen.name,
+				            level,
+				            radius,
+				            res.vertex_count,
+				            res.triangle_count,
+				            res.seconds * 1e3,
+				            res.seconds * 1e9 / std::max<size_t>(1, res.vertex_count),
+				            static_cast<unsigned long long>(res.allocations),
+				            res.allocated / mib,
+				            res.peak_heap / mib,
+				            peak_rss_bytes() / mib,
+				            static_cast<unsigned long long>(res.checksum));
+				std::fflush(stdout);
+			}
+		}
+	}
+
+	return 0;
+}
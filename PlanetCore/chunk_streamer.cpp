@@ -0,0 +1,234 @@
+#include "chunk_streamer.h"
+#include "height_cache.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+#include "planet_kernel.h"
+
+#include <algorithm>
+
+using namespace planet_generator;
+
+namespace
+{
+	uint64_t make_key(const patch_id &patch)
+	{
+		return (uint64_t{ patch.face } << 61)
+		     | (uint64_t{ patch.depth } << 56)
+		     | (uint64_t{ patch.x } << 28)
+		     | uint64_t{ patch.y };
+	}
+
+	size_t mesh_bytes(const mesh &patch_mesh)
+	{
+		return patch_mesh.verticies.capacity() * sizeof(vertex)
+		     + patch_mesh.indicies.capacity() * sizeof(uint32_t)
+		     + patch_mesh.normals.capacity() * sizeof(DirectX::XMFLOAT3)
+		     + patch_mesh.meshlets.capacity() * sizeof(meshlet);
+	}
+}
+
+chunk_streamer::chunk_streamer(const settings &stream_settings_) :
+	stream_settings(stream_settings_),
+	noise_heights(make_height_sampler(noise_settings{ stream_settings_.noise }))
+{
+	uint32_t worker_count = stream_settings.worker_count;
+	if (worker_count == 0)
+	{
+		worker_count = std::max(2u, std::thread::hardware_concurrency()) - 1u;
+	}
+
+	workers.reserve(worker_count);
+	for (uint32_t i{ 0 }; i < worker_count; i++)
+	{
+		workers.emplace_back([&]() { worker_loop(); });
+	}
+}
+
+chunk_streamer::~chunk_streamer()
+{
+	{
+		std::lock_guard lock(queue_mutex);
+		stop_workers = true;
+	}
+	queue_signal.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void chunk_streamer::begin_frame()
+{
+	frame_number++;
+	frame_stats.requested = 0;
+	frame_stats.completed = 0;
+	frame_stats.cancelled = 0;
+	frame_stats.evicted = 0;
+
+	// Take the whole list in one exchange; order does not matter
+	auto *job = completed_head.exchange(nullptr, std::memory_order_acquire);
+	while (job)
+	{
+		auto *next = job->next_completed;
+
+		auto owned = std::move(owned_jobs.at(job));
+		owned_jobs.erase(job);
+
+		if (not owned->cancelled.load(std::memory_order_relaxed))
+		{
+			pending.erase(owned->key);
+			add_to_cache(owned->key, std::move(owned->result));
+			frame_stats.completed++;
+		}
+
+		job = next;
+	}
+
+	frame_stats.queued = static_cast<uint32_t>(pending.size());
+}
+
+void chunk_streamer::request(const patch_id &patch, float skirt_depth, float priority)
+{
+	auto key = make_key(patch);
+	if (cache.count(key))
+		return;
+
+	if (auto it = pending.find(key); it != pending.end())
+	{
+		it->second->last_requested = frame_number;
+		return;
+	}
+
+	auto job = std::make_unique<chunk_job>();
+	job->key = key;
+	job->patch = patch;
+	job->skirt_depth = skirt_depth;
+	job->priority = priority;
+	job->last_requested = frame_number;
+
+	auto *job_ptr = job.get();
+	owned_jobs.emplace(job_ptr, std::move(job));
+	pending.emplace(key, job_ptr);
+
+	{
+		std::lock_guard lock(queue_mutex);
+		job_queue.push(job_ptr);
+	}
+	queue_signal.notify_one();
+
+	frame_stats.requested++;
+	frame_stats.queued = static_cast<uint32_t>(pending.size());
+}
+
+const mesh *chunk_streamer::find(const patch_id &patch)
+{
+	auto it = cache.find(make_key(patch));
+	if (it == cache.end())
+		return nullptr;
+
+	lru_order.splice(lru_order.begin(), lru_order, it->second.lru_position);
+	return &it->second.patch_mesh;
+}
+
+void chunk_streamer::end_frame()
+{
+	for (auto it = pending.begin(); it != pending.end();)
+	{
+		auto *job = it->second;
+		if (job->last_requested == frame_number)
+		{
+			++it;
+			continue;
+		}
+
+		// Job stays owned until a worker hands it back, whether or not it was started
+		job->cancelled.store(true, std::memory_order_relaxed);
+		it = pending.erase(it);
+		frame_stats.cancelled++;
+	}
+
+	frame_stats.queued = static_cast<uint32_t>(pending.size());
+}
+
+const chunk_streamer::statistics &chunk_streamer::stats() const
+{
+	return frame_stats;
+}
+
+void chunk_streamer::worker_loop()
+{
+	while (true)
+	{
+		chunk_job *job = nullptr;
+		{
+			std::unique_lock lock(queue_mutex);
+			queue_signal.wait(lock, [&]() { return stop_workers or not job_queue.empty(); });
+
+			if (stop_workers)
+				return;
+
+			job = job_queue.top();
+			job_queue.pop();
+		}
+
+		if (not job->cancelled.load(std::memory_order_relaxed))
+		{
+			// Heights are a function of direction only, so patches from the cache stay valid across radius changes
+			auto face_resolution = uint64_t{ stream_settings.patch_resolution } << job->patch.depth;
+			std::unique_ptr<height_sampler> cached{};
+			if (stream_settings.cached_heights and face_resolution <= stream_settings.cached_heights->finest_resolution())
+			{
+				cached = stream_settings.cached_heights->make_sampler(noise_settings{ stream_settings.noise },
+				                                                      *noise_heights,
+				                                                      static_cast<uint32_t>(face_resolution));
+			}
+
+			job->result = generate_patch(stream_settings.radius,
+			                             job->patch,
+			                             stream_settings.patch_resolution,
+			                             job->skirt_depth,
+			                             cached ? *cached : *noise_heights);
+			// Meshlets decide triangle order; within one they are already in neighbour order, which the
+			// vertex cache handles well enough, so only vertex fetch order is optimized after
+			auto surface_index_count = size_t{ stream_settings.patch_resolution } * stream_settings.patch_resolution * 6u;
+			build_meshlets(job->result, surface_index_count);
+			optimize_vertex_fetch(job->result);
+		}
+
+		push_completed(job);
+	}
+}
+
+void chunk_streamer::push_completed(chunk_job *job)
+{
+	job->next_completed = completed_head.load(std::memory_order_relaxed);
+	while (not completed_head.compare_exchange_weak(job->next_completed,
+	                                                job,
+	                                                std::memory_order_release,
+	                                                std::memory_order_relaxed))
+	{}
+}
+
+void chunk_streamer::add_to_cache(chunk_key key, mesh &&patch_mesh)
+{
+	size_t bytes = mesh_bytes(patch_mesh);
+
+	lru_order.push_front(key);
+	cache.insert_or_assign(key, cache_entry{ std::move(patch_mesh), bytes, lru_order.begin() });
+	cache_bytes += bytes;
+
+	// Never evict the entry just added, even when it alone is over budget
+	while (cache_bytes > stream_settings.cache_budget and lru_order.size() > 1)
+	{
+		auto oldest = lru_order.back();
+		lru_order.pop_back();
+
+		cache_bytes -= cache.at(oldest).bytes;
+		cache.erase(oldest);
+		frame_stats.evicted++;
+	}
+
+	frame_stats.cache_bytes = cache_bytes;
+	frame_stats.cache_entries = cache.size();
+}
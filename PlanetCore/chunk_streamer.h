@@ -0,0 +1,133 @@
+#pragma once
+
+#include "planet.h"
+#include "mesh.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace planet_generator
+{
+	class height_cache;
+	class height_sampler;
+
+	// Generates terrain patches on worker threads.
+	// Main thread requests patches every frame with a priority; requests that are not repeated
+	// by the end of the frame are cancelled. Finished patches come back through a lock-free list
+	// and are held in an LRU cache, capped at a memory budget.
+	class chunk_streamer
+	{
+	public:
+		struct settings
+		{
+			float radius;
+			noise_type noise;
+			uint32_t patch_resolution;
+			size_t cache_budget = 256ull * 1024 * 1024;   // bytes of cached mesh data
+			uint32_t worker_count = 0;                     // 0 to use all but one hardware thread
+			// Patches whose face resolution the cache holds are resampled from it instead of evaluating noise.
+			// Shared, and must outlive the streamer.
+			height_cache *cached_heights = nullptr;
+		};
+
+		struct statistics
+		{
+			uint32_t queued;            // waiting or being generated
+			uint32_t requested;         // new requests this frame
+			uint32_t completed;         // finished this frame
+			uint32_t cancelled;         // dropped this frame
+			uint32_t evicted;           // pushed out of the cache this frame
+			size_t cache_bytes;
+			size_t cache_entries;
+		};
+
+	public:
+		chunk_streamer() = delete;
+		chunk_streamer(const settings &stream_settings);
+		~chunk_streamer();
+
+		chunk_streamer(const chunk_streamer &) = delete;
+		chunk_streamer &operator=(const chunk_streamer &) = delete;
+
+		// Moves finished patches into the cache. Call once at start of frame.
+		void begin_frame();
+
+		// Asks for a patch, higher priority is generated first. Priority is fixed by the first request.
+		void request(const patch_id &patch, float skirt_depth, float priority);
+
+		// Cached patch, or nullptr if it is not generated yet. Marks the patch as recently used.
+		const mesh *find(const patch_id &patch);
+
+		// Cancels every outstanding request that was not repeated since begin_frame.
+		void end_frame();
+
+		const statistics &stats() const;
+
+	private:
+		using chunk_key = uint64_t;
+
+		struct chunk_job
+		{
+			chunk_key key;
+			patch_id patch;
+			float skirt_depth;
+			float priority;
+			uint64_t last_requested;
+
+			std::atomic<bool> cancelled{ false };
+			mesh result{};
+
+			chunk_job *next_completed = nullptr;
+		};
+
+		struct job_order
+		{
+			bool operator()(const chunk_job *a, const chunk_job *b) const
+			{
+				return a->priority < b->priority;
+			}
+		};
+
+		struct cache_entry
+		{
+			mesh patch_mesh;
+			size_t bytes;
+			std::list<chunk_key>::iterator lru_position;
+		};
+
+		void worker_loop();
+		void push_completed(chunk_job *job);
+		void add_to_cache(chunk_key key, mesh &&patch_mesh);
+
+	private:
+		settings stream_settings;
+		std::unique_ptr<height_sampler> noise_heights;
+		uint64_t frame_number{ 0 };
+		statistics frame_stats{};
+
+		// Main thread only
+		std::unordered_map<chunk_job *, std::unique_ptr<chunk_job>> owned_jobs;
+		std::unordered_map<chunk_key, chunk_job *> pending;
+
+		std::list<chunk_key> lru_order;     // most recently used at front
+		std::unordered_map<chunk_key, cache_entry> cache;
+		size_t cache_bytes{ 0 };
+
+		// Shared with workers
+		std::mutex queue_mutex;
+		std::condition_variable queue_signal;
+		std::priority_queue<chunk_job *, std::vector<chunk_job *>, job_order> job_queue;
+		bool stop_workers = false;
+
+		std::atomic<chunk_job *> completed_head{ nullptr };
+
+		std::vector<std::thread> workers;
+	};
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace planet_generator
+{
+	// Cube face as a unit square, position = normal + u * u_axis + v * v_axis.
+	// u_axis x v_axis == normal, which keeps the same winding as make_cube.
+	struct cube_face
+	{
+		DirectX::XMFLOAT3 normal;
+		DirectX::XMFLOAT3 u_axis;
+		DirectX::XMFLOAT3 v_axis;
+	};
+
+	constexpr std::array<cube_face, 6> cube_faces{ {
+		{ {  0.0f,  0.0f, +1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } }, // Front
+		{ {  0.0f, -1.0f,  0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }, // Bottom
+		{ { +1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }, // Right
+		{ { -1.0f,  0.0f,  0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } }, // Left
+		{ {  0.0f,  0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } }, // Back
+		{ {  0.0f, +1.0f,  0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f } }, // Top
+	} };
+
+	// Grid coordinate in [-1, 1]. Computed from integers so that the edge
+	// vertices of neighbouring faces come out bitwise identical.
+	inline float grid_coordinate(uint64_t i, uint64_t resolution)
+	{
+		return static_cast<float>(2 * static_cast<int64_t>(i) - static_cast<int64_t>(resolution)) / static_cast<float>(resolution);
+	}
+
+	inline DirectX::XMFLOAT3 face_point(const cube_face &face, float u, float v, float half_length)
+	{
+		return {
+			half_length * (face.normal.x + u * face.u_axis.x + v * face.v_axis.x),
+			half_length * (face.normal.y + u * face.u_axis.y + v * face.v_axis.y),
+			half_length * (face.normal.z + u * face.u_axis.z + v * face.v_axis.z)
+		};
+	}
+
+	struct face_coordinate
+	{
+		uint32_t face;
+		float u;
+		float v;
+	};
+
+	// Inverse of face_point: which face a direction goes through, and where on it.
+	inline face_coordinate direction_to_face(float x, float y, float z)
+	{
+		float ax = std::fabs(x), ay = std::fabs(y), az = std::fabs(z);
+
+		uint32_t face{};
+		float major{};
+		if (ax >= ay and ax >= az)
+		{
+			face = (x > 0.0f) ? 2 : 3;
+			major = ax;
+		}
+		else if (ay >= az)
+		{
+			face = (y > 0.0f) ? 5 : 1;
+			major = ay;
+		}
+		else
+		{
+			face = (z > 0.0f) ? 0 : 4;
+			major = az;
+		}
+
+		const auto &f = cube_faces[face];
+		float px = x / major, py = y / major, pz = z / major;
+		return {
+			face,
+			px * f.u_axis.x + py * f.u_axis.y + pz * f.u_axis.z,
+			px * f.v_axis.x + py * f.v_axis.y + pz * f.v_axis.z
+		};
+	}
+}
@@ -0,0 +1,316 @@
+#include "culling.h"
+#include "planet.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	using namespace planet_generator::simd;
+
+	// Grid intervals sampled along each side of a patch for its bounds
+	constexpr uint32_t bounds_intervals = 8;
+
+	// Arrays make_batch_test reads, one entry per patch
+	struct bounds_arrays
+	{
+		const float *center_x, *center_y, *center_z, *radius;
+		const float *min_x, *min_y, *min_z;
+		const float *max_x, *max_y, *max_z;
+		const float *max_radius;
+	};
+
+	// Per frame values of the horizon test, see patch_culler
+	struct horizon
+	{
+		bool enabled;                   // false with the camera inside the occluder
+		float normal[3];                // planet centre to camera, unit length
+		float plane_distance;           // of the plane through the horizon circle, from the centre
+		float sin_cone, cos_cone;       // half angle of the cone the occluder hides
+		float occluder_radius_sq;
+		float camera_reach;             // distance to the horizon
+	};
+
+	horizon make_horizon(const cull_view &view, float occluder_radius)
+	{
+		const auto &c = view.camera_position;
+		float distance = std::sqrt(c.x * c.x + c.y * c.y + c.z * c.z);
+
+		horizon h{};
+		h.enabled = distance > occluder_radius;
+		if (not h.enabled)
+			return h;
+
+		h.normal[0] = c.x / distance;
+		h.normal[1] = c.y / distance;
+		h.normal[2] = c.z / distance;
+		h.plane_distance = occluder_radius * occluder_radius / distance;
+		h.sin_cone = occluder_radius / distance;
+		h.cos_cone = std::sqrt(std::max(1.0f - h.sin_cone * h.sin_cone, 0.0f));
+		h.occluder_radius_sq = occluder_radius * occluder_radius;
+		h.camera_reach = std::sqrt(distance * distance - h.occluder_radius_sq);
+		return h;
+	}
+
+	inline float_v dot(float_v x, float_v y, float_v z, const float *n)
+	{
+		return add(add(mul(x, splat(n[0])), mul(y, splat(n[1]))), mul(z, splat(n[2])));
+	}
+
+	// Tests lanes patches starting at i; bit k of outside/below is set when patch i + k is culled that way.
+	// below is only meaningful where outside is clear.
+	void test_batch(const bounds_arrays &b, size_t i, const cull_view &view, const horizon &h, uint32_t &outside, uint32_t &below)
+	{
+		// Frustum: the box corner furthest along each plane's normal has to be inside it
+		mask_v out{};
+		for (size_t p{ 0 }; p < 6; p++)
+		{
+			const auto &plane = view.planes[p];
+			float_v x = load_unaligned((plane.x >= 0.0f ? b.max_x : b.min_x) + i),
+			        y = load_unaligned((plane.y >= 0.0f ? b.max_y : b.min_y) + i),
+			        z = load_unaligned((plane.z >= 0.0f ? b.max_z : b.min_z) + i);
+			const float n[3]{ plane.x, plane.y, plane.z };
+			mask_v outside_plane = less(add(dot(x, y, z, n), splat(plane.w)), splat(0.0f));
+			out = (p == 0) ? outside_plane : mask_or(out, outside_plane);
+		}
+		outside = mask_bits(out);
+		below = 0;
+
+		if (not h.enabled or outside == (1u << lanes) - 1)
+			return;
+
+		float_v cx = load_unaligned(b.center_x + i),
+		        cy = load_unaligned(b.center_y + i),
+		        cz = load_unaligned(b.center_z + i),
+		        r = load_unaligned(b.radius + i);
+		const auto &camera = view.camera_position;
+		float_v ux = sub(cx, splat(camera.x)),
+		        uy = sub(cy, splat(camera.y)),
+		        uz = sub(cz, splat(camera.z));
+		float_v length_sq = add(add(mul(ux, ux), mul(uy, uy)), mul(uz, uz));
+		float_v r_sq = mul(r, r);
+
+		// Hidden by the sphere: beyond the plane of the horizon circle, and inside the cone from the camera
+		// to that circle. angle(u, -normal) + asin(r / |u|) <= cone angle, multiplied through by |u|.
+		mask_v beyond = less(add(dot(cx, cy, cz, h.normal), r), splat(h.plane_distance));
+		float_v toward = sub(splat(0.0f), dot(ux, uy, uz, h.normal));
+		float_v tangent = sqrt(max(sub(length_sq, r_sq), splat(0.0f)));
+		mask_v in_cone = mask_and(less_equal(add(mul(splat(h.cos_cone), tangent), mul(splat(h.sin_cone), r)), toward),
+		                          less_equal(r_sq, mul(splat(h.sin_cone * h.sin_cone), length_sq)));
+
+		// Too far: nothing at max_radius can be seen over the sphere from further than the two horizon distances
+		float_v top = load_unaligned(b.max_radius + i);
+		float_v patch_reach = sqrt(max(sub(mul(top, top), splat(h.occluder_radius_sq)), splat(0.0f)));
+		mask_v too_far = less(add(add(splat(h.camera_reach), patch_reach), r), sqrt(length_sq));
+
+		below = mask_bits(mask_or(mask_and(beyond, in_cone), too_far));
+	}
+}
+
+cull_view planet_generator::make_cull_view(FXMMATRIX object_to_clip, FXMVECTOR camera_position)
+{
+	// Planes from the columns of the matrix (Gribb, Hartmann); clip space z is [0, w]
+	XMMATRIX columns = XMMatrixTranspose(object_to_clip);
+	const XMVECTOR planes[6] = {
+		columns.r[3] + columns.r[0],    // left
+		columns.r[3] - columns.r[0],    // right
+		columns.r[3] + columns.r[1],    // bottom
+		columns.r[3] - columns.r[1],    // top
+		columns.r[2],                   // near
+		columns.r[3] - columns.r[2]     // far
+	};
+
+	cull_view view{};
+	for (size_t p{ 0 }; p < 6; p++)
+	{
+		XMStoreFloat4(&view.planes[p], XMPlaneNormalize(planes[p]));
+	}
+	XMStoreFloat3(&view.camera_position, camera_position);
+	return view;
+}
+
+patch_bounds planet_generator::make_patch_bounds(float planet_radius, const patch_id &patch, float min_height, float max_height)
+{
+	assert(min_height <= max_height);
+	float low = planet_radius + min_height,
+	      high = planet_radius + max_height;
+
+	// Surface lies between samples on the sphere, and bulges out past the straight lines between them
+	// by at most the sagitta of the angle they span. Grid spacing on the cube face bounds that angle.
+	float spacing = 2.0f / static_cast<float>(uint64_t{ bounds_intervals } << patch.depth);
+	float sagitta = high * (1.0f - std::cos(spacing));
+
+	XMVECTOR box_min = XMVectorReplicate(std::numeric_limits<float>::max()),
+	         box_max = -box_min;
+	std::vector<XMVECTOR> samples;
+	samples.reserve((bounds_intervals + 1) * (bounds_intervals + 1));
+	for (uint32_t j{ 0 }; j <= bounds_intervals; j++)
+	{
+		for (uint32_t i{ 0 }; i <= bounds_intervals; i++)
+		{
+			auto point = patch_point(1.0f, patch, static_cast<float>(i) / bounds_intervals, static_cast<float>(j) / bounds_intervals);
+			XMVECTOR direction = XMLoadFloat3(&point);
+			samples.push_back(direction);
+			box_min = XMVectorMin(box_min, XMVectorMin(direction * low, direction * high));
+			box_max = XMVectorMax(box_max, XMVectorMax(direction * low, direction * high));
+		}
+	}
+	box_min = box_min - XMVectorReplicate(sagitta);
+	box_max = box_max + XMVectorReplicate(sagitta);
+
+	XMVECTOR center = (box_min + box_max) * 0.5f;
+	float radius{ 0.0f };
+	for (auto direction : samples)
+	{
+		radius = std::max(radius, XMVectorGetX(XMVector3Length(direction * low - center)));
+		radius = std::max(radius, XMVectorGetX(XMVector3Length(direction * high - center)));
+	}
+
+	patch_bounds bounds{};
+	XMStoreFloat3(&bounds.center, center);
+	bounds.radius = radius + sagitta;
+	XMStoreFloat3(&bounds.box_min, box_min);
+	XMStoreFloat3(&bounds.box_max, box_max);
+	bounds.max_radius = high;
+	return bounds;
+}
+
+uint32_t patch_culler::add(const patch_bounds &bounds)
+{
+	center_x.push_back(bounds.center.x);
+	center_y.push_back(bounds.center.y);
+	center_z.push_back(bounds.center.z);
+	radius.push_back(bounds.radius);
+	min_x.push_back(bounds.box_min.x);
+	min_y.push_back(bounds.box_min.y);
+	min_z.push_back(bounds.box_min.z);
+	max_x.push_back(bounds.box_max.x);
+	max_y.push_back(bounds.box_max.y);
+	max_z.push_back(bounds.box_max.z);
+	max_radius.push_back(bounds.max_radius);
+	visibility.push_back(1);
+	in_use.push_back(1);
+	return static_cast<uint32_t>(visibility.size() - 1);
+}
+
+void patch_culler::replace(uint32_t index, const patch_bounds &bounds)
+{
+	assert(index < size());
+	center_x[index] = bounds.center.x;
+	center_y[index] = bounds.center.y;
+	center_z[index] = bounds.center.z;
+	radius[index] = bounds.radius;
+	min_x[index] = bounds.box_min.x;
+	min_y[index] = bounds.box_min.y;
+	min_z[index] = bounds.box_min.z;
+	max_x[index] = bounds.box_max.x;
+	max_y[index] = bounds.box_max.y;
+	max_z[index] = bounds.box_max.z;
+	max_radius[index] = bounds.max_radius;
+	visibility[index] = 1;
+	in_use[index] = 1;
+}
+
+void patch_culler::remove(uint32_t index)
+{
+	assert(index < size());
+	visibility[index] = 0;
+	in_use[index] = 0;
+}
+
+void patch_culler::clear()
+{
+	for (auto *list : { &center_x, &center_y, &center_z, &radius, &min_x, &min_y, &min_z, &max_x, &max_y, &max_z, &max_radius })
+	{
+		list->clear();
+	}
+	visibility.clear();
+	in_use.clear();
+}
+
+size_t patch_culler::size() const
+{
+	return visibility.size();
+}
+
+void patch_culler::cull(const cull_view &view, float occluder_radius, size_t first, size_t last)
+{
+	last = std::min(last, size());
+	if (first >= last)
+		return;
+
+	auto h = make_horizon(view, occluder_radius);
+
+	auto record = [&](size_t i, size_t count, uint32_t outside, uint32_t below)
+	{
+		for (size_t k{ 0 }; k < count; k++)
+		{
+			// Removed patches go through the batch with the rest, but are left out of the results
+			if (not in_use[i + k])
+				continue;
+
+			bool is_outside = (outside >> k) & 1,
+			     is_below = not is_outside and ((below >> k) & 1);
+			visibility[i + k] = (is_outside or is_below) ? 0 : 1;
+			cull_stats.outside_frustum += is_outside ? 1 : 0;
+			cull_stats.below_horizon += is_below ? 1 : 0;
+			cull_stats.tested++;
+		}
+	};
+
+	bounds_arrays arrays{ center_x.data(), center_y.data(), center_z.data(), radius.data(),
+	                      min_x.data(), min_y.data(), min_z.data(),
+	                      max_x.data(), max_y.data(), max_z.data(), max_radius.data() };
+
+	size_t i = first;
+	for (; i + lanes <= last; i += lanes)
+	{
+		uint32_t outside{}, below{};
+		test_batch(arrays, i, view, h, outside, below);
+		record(i, lanes, outside, below);
+	}
+
+	if (i < last)
+	{
+		// Last partial batch goes through a copy, padded with its final patch
+		float tail[11][lanes];
+		const float *source[11]{ arrays.center_x, arrays.center_y, arrays.center_z, arrays.radius,
+		                         arrays.min_x, arrays.min_y, arrays.min_z,
+		                         arrays.max_x, arrays.max_y, arrays.max_z, arrays.max_radius };
+		for (size_t a{ 0 }; a < 11; a++)
+		{
+			for (size_t k{ 0 }; k < lanes; k++)
+			{
+				tail[a][k] = source[a][std::min(i + k, last - 1)];
+			}
+		}
+
+		bounds_arrays padded{ tail[0], tail[1], tail[2], tail[3], tail[4], tail[5], tail[6], tail[7], tail[8], tail[9], tail[10] };
+		uint32_t outside{}, below{};
+		test_batch(padded, 0, view, h, outside, below);
+		record(i, last - i, outside, below);
+	}
+
+	cull_stats.visible = cull_stats.tested - cull_stats.outside_frustum - cull_stats.below_horizon;
+}
+
+bool patch_culler::visible(uint32_t index) const
+{
+	return visibility[index] != 0;
+}
+
+void patch_culler::reset_stats()
+{
+	cull_stats = {};
+}
+
+const patch_culler::statistics &patch_culler::stats() const
+{
+	return cull_stats;
+}
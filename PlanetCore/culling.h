@@ -0,0 +1,82 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace planet_generator
+{
+	struct patch_id;
+
+	// Frustum planes and eye position, in the space the culled objects are in
+	struct cull_view
+	{
+		DirectX::XMFLOAT4 planes[6];    // inside where dot(plane.xyz, p) + plane.w >= 0
+		DirectX::XMFLOAT3 camera_position;
+	};
+
+	// object_to_clip is world * view * projection for the object; camera_position is in object space
+	[[nodiscard]]
+	cull_view make_cull_view(DirectX::FXMMATRIX object_to_clip, DirectX::FXMVECTOR camera_position);
+
+	// Bounds of a terrain patch in planet space, centred on the planet
+	struct patch_bounds
+	{
+		DirectX::XMFLOAT3 center;       // sphere
+		float radius;
+		DirectX::XMFLOAT3 box_min;      // axis aligned box
+		DirectX::XMFLOAT3 box_max;
+		float max_radius;               // distance of the highest point from the planet's centre
+	};
+
+	// Bounds of a cube sphere patch whose surface stays between min_height and max_height
+	[[nodiscard]]
+	patch_bounds make_patch_bounds(float planet_radius, const patch_id &patch, float min_height, float max_height);
+
+	// Tests many patches at once against the frustum and the planet's horizon.
+	// Bounds are kept as structure of arrays, so each SIMD batch tests several patches with no gathering.
+	// The planet is taken as a sphere of occluder_radius, which must not be above any terrain.
+	// A patch is below the horizon when that sphere hides all of its bounding sphere, or when it is
+	// further away than the furthest point at max_radius that can be seen over the sphere.
+	class patch_culler
+	{
+	public:
+		struct statistics
+		{
+			uint32_t tested;
+			uint32_t outside_frustum;
+			uint32_t below_horizon;
+			uint32_t visible;
+		};
+
+	public:
+		// Returns the index the patch is tested under, indicies count up from 0
+		uint32_t add(const patch_bounds &bounds);
+		// Puts a patch under an index that was added before, removed or not
+		void replace(uint32_t index, const patch_bounds &bounds);
+		// Patch is no longer tested and stays invisible until its index is replaced
+		void remove(uint32_t index);
+		void clear();
+		// Indicies handed out, removed ones included
+		size_t size() const;
+
+		// Tests patches [first, last) and adds to stats(); last is clamped to size()
+		void cull(const cull_view &view, float occluder_radius, size_t first = 0, size_t last = SIZE_MAX);
+
+		// Result of the last test that covered the patch; patches never tested are visible
+		bool visible(uint32_t index) const;
+
+		void reset_stats();
+		const statistics &stats() const;
+
+	private:
+		std::vector<float> center_x, center_y, center_z, radius;
+		std::vector<float> min_x, min_y, min_z;
+		std::vector<float> max_x, max_y, max_z;
+		std::vector<float> max_radius;
+		std::vector<uint8_t> visibility;
+		std::vector<uint8_t> in_use;
+		statistics cull_stats{};
+	};
+}
@@ -0,0 +1,329 @@
+#include "height_cache.h"
+#include "cube_sphere.h"
+#include "planet_kernel.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+using namespace planet_generator;
+
+namespace
+{
+	constexpr uint32_t build_tile_rows = 16;
+
+	// Bilinear in the face grid, for heights and, when stored, their gradients
+	class heightfield_sampler : public height_sampler
+	{
+	public:
+		heightfield_sampler(std::shared_ptr<const void> owner_, const float *heights_, const float *gradients_, uint32_t resolution_) :
+			owner(std::move(owner_)),
+			heights(heights_),
+			gradients(gradients_),
+			resolution(resolution_)
+		{}
+
+		void sample(const float *x, const float *y, const float *z, float *height, size_t count) const override
+		{
+			for (size_t i{ 0 }; i < count; i++)
+			{
+				auto cell = find_cell(x[i], y[i], z[i]);
+				height[i] = interpolate(heights, cell, 1);
+			}
+		}
+
+		bool sample_gradient(const float *x, const float *y, const float *z, float *height,
+		                     float *gradient_x, float *gradient_y, float *gradient_z, size_t count) const override
+		{
+			if (not gradients)
+				return false;
+
+			for (size_t i{ 0 }; i < count; i++)
+			{
+				auto cell = find_cell(x[i], y[i], z[i]);
+				height[i] = interpolate(heights, cell, 1);
+				gradient_x[i] = interpolate(gradients, cell, 3);
+				gradient_y[i] = interpolate(gradients + 1, cell, 3);
+				gradient_z[i] = interpolate(gradients + 2, cell, 3);
+			}
+			return true;
+		}
+
+	private:
+		struct cell
+		{
+			size_t corner;      // grid index of the lower left corner
+			float fx;
+			float fy;
+		};
+
+		cell find_cell(float x, float y, float z) const
+		{
+			size_t row_length = size_t{ resolution } + 1;
+			float scale = 0.5f * static_cast<float>(resolution);
+
+			auto [face, u, v] = direction_to_face(x, y, z);
+
+			float gx = std::clamp((u + 1.0f) * scale, 0.0f, static_cast<float>(resolution)),
+			      gy = std::clamp((v + 1.0f) * scale, 0.0f, static_cast<float>(resolution));
+
+			uint32_t x0 = std::min(static_cast<uint32_t>(gx), resolution - 1),
+			         y0 = std::min(static_cast<uint32_t>(gy), resolution - 1);
+
+			return { face * row_length * row_length + y0 * row_length + x0,
+			         gx - static_cast<float>(x0),
+			         gy - static_cast<float>(y0) };
+		}
+
+		// Values are 'stride' floats apart
+		float interpolate(const float *values, const cell &c, size_t stride) const
+		{
+			size_t row_length = size_t{ resolution } + 1;
+			const float *row0 = values + c.corner * stride;
+			const float *row1 = row0 + row_length * stride;
+
+			float h0 = row0[0] + (row0[stride] - row0[0]) * c.fx,
+			      h1 = row1[0] + (row1[stride] - row1[0]) * c.fx;
+			return h0 + (h1 - h0) * c.fy;
+		}
+
+	private:
+		std::shared_ptr<const void> owner;
+		const float *heights;
+		const float *gradients;
+		uint32_t resolution;
+	};
+}
+
+height_cache::height_cache(uint32_t base_resolution_, uint8_t level_count_) :
+	base_resolution(base_resolution_),
+	level_count(level_count_)
+{
+	assert(base_resolution > 0 and level_count > 0);
+}
+
+height_cache::~height_cache() = default;
+
+std::unique_ptr<height_sampler> height_cache::make_sampler(const noise_settings &noise, uint32_t resolution, thread_pool *pool)
+{
+	auto field = get_level(noise, nullptr, level_for(resolution), pool);
+	return std::make_unique<heightfield_sampler>(field, field->heights.data(),
+	                                             field->gradients.empty() ? nullptr : field->gradients.data(),
+	                                             field->resolution);
+}
+
+std::unique_ptr<height_sampler> height_cache::make_sampler(const noise_settings &key, const height_sampler &source, uint32_t resolution, thread_pool *pool)
+{
+	auto field = get_level(key, &source, level_for(resolution), pool);
+	return std::make_unique<heightfield_sampler>(field, field->heights.data(),
+	                                             field->gradients.empty() ? nullptr : field->gradients.data(),
+	                                             field->resolution);
+}
+
+uint32_t height_cache::finest_resolution() const
+{
+	return base_resolution << (level_count - 1);
+}
+
+size_t height_cache::memory_used() const
+{
+	std::lock_guard lock(cache_mutex);
+
+	size_t bytes{ 0 };
+	for (auto &[key, levels] : fields)
+	{
+		for (auto &level : levels)
+		{
+			// Levels still being built aren't counted
+			if (level.valid() and level.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			{
+				auto &field = level.get();
+				bytes += (field->heights.capacity() + field->gradients.capacity()) * sizeof(float);
+			}
+		}
+	}
+	return bytes;
+}
+
+void height_cache::clear()
+{
+	std::lock_guard lock(cache_mutex);
+	fields.clear();
+}
+
+uint8_t height_cache::level_for(uint32_t resolution) const
+{
+	uint8_t level{ 0 };
+	while (level + 1 < level_count and (base_resolution << level) < resolution)
+	{
+		level++;
+	}
+	return level;
+}
+
+height_cache::heightfield_ptr height_cache::get_level(const noise_settings &key, const height_sampler *source, uint8_t level, thread_pool *pool)
+{
+	std::shared_future<heightfield_ptr> existing{};
+	std::shared_future<heightfield_ptr> finer{};
+	std::promise<heightfield_ptr> built{};
+	{
+		std::lock_guard lock(cache_mutex);
+
+		auto &levels = fields[key];
+		levels.resize(level_count);
+		if (levels[level].valid())
+		{
+			existing = levels[level];
+		}
+		else
+		{
+			// Anyone else asking for this level waits for this build, instead of starting their own
+			levels[level] = built.get_future().share();
+
+			// Every point of a coarser level is also a point of any finer one,
+			// so when a finer level exists this is a copy, with no noise evaluated.
+			auto found = std::find_if(levels.begin() + level + 1, levels.end(), [](auto &l) { return l.valid(); });
+			if (found != levels.end())
+				finer = *found;
+		}
+	}
+
+	if (existing.valid())
+		return existing.get();
+
+	auto field = std::make_shared<heightfield>();
+	field->resolution = base_resolution << level;
+
+	uint32_t row_length = field->resolution + 1;
+	size_t face_size = size_t{ row_length } * row_length;
+	field->heights.resize(face_size * cube_faces.size());
+
+	heightfield_ptr src = finer.valid() ? finer.get() : nullptr;
+	std::unique_ptr<height_sampler> own_source{};
+	bool with_gradient{ false };
+	if (src)
+	{
+		with_gradient = not src->gradients.empty();
+	}
+	else
+	{
+		if (not source)
+		{
+			own_source = make_height_sampler(key);
+			source = own_source.get();
+		}
+
+		// Ask once whether the source has a gradient at all
+		float d[3] = { 0.0f, 0.0f, 1.0f }, h{}, g[3]{};
+		with_gradient = source->sample_gradient(&d[0], &d[1], &d[2], &h, &g[0], &g[1], &g[2], 1);
+	}
+	if (with_gradient)
+	{
+		field->gradients.resize(field->heights.size() * 3);
+	}
+
+	size_t tiles_per_face = (row_length + build_tile_rows - 1) / build_tile_rows;
+	auto build_tile = [&](size_t tile)
+	{
+		uint32_t face = static_cast<uint32_t>(tile / tiles_per_face);
+		uint32_t first_row = static_cast<uint32_t>((tile % tiles_per_face) * build_tile_rows);
+		uint32_t last_row = std::min(first_row + build_tile_rows, row_length);
+
+		size_t first = face * face_size + size_t{ first_row } * row_length;
+		float *out = field->heights.data() + first;
+		float *g_out = with_gradient ? field->gradients.data() + first * 3 : nullptr;
+
+		if (src)
+		{
+			uint32_t step = src->resolution / field->resolution;
+			size_t src_row_length = size_t{ src->resolution } + 1;
+			size_t src_face = face * src_row_length * src_row_length;
+
+			for (uint32_t y{ first_row }; y < last_row; y++)
+			{
+				for (uint32_t x{ 0 }; x < row_length; x++)
+				{
+					size_t from = src_face + size_t{ y } * step * src_row_length + size_t{ x } * step;
+					*out++ = src->heights[from];
+					if (with_gradient)
+					{
+						g_out = std::copy_n(src->gradients.data() + from * 3, 3, g_out);
+					}
+				}
+			}
+			return;
+		}
+
+		// Directions for one row at a time, heights evaluated straight into the grid
+		std::vector<float> dx(row_length), dy(row_length), dz(row_length);
+		float gx[max_kernel_block], gy[max_kernel_block], gz[max_kernel_block];
+		for (uint32_t y{ first_row }; y < last_row; y++)
+		{
+			float v = grid_coordinate(y, field->resolution);
+			for (uint32_t x{ 0 }; x < row_length; x++)
+			{
+				auto p = face_point(cube_faces[face], grid_coordinate(x, field->resolution), v, 1.0f);
+				float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+				dx[x] = p.x / length;
+				dy[x] = p.y / length;
+				dz[x] = p.z / length;
+			}
+
+			for (uint32_t x{ 0 }; x < row_length; x += max_kernel_block)
+			{
+				size_t count = std::min<size_t>(max_kernel_block, row_length - x);
+				if (not with_gradient)
+				{
+					source->sample(&dx[x], &dy[x], &dz[x], out + x, count);
+					continue;
+				}
+
+				source->sample_gradient(&dx[x], &dy[x], &dz[x], out + x, gx, gy, gz, count);
+				for (size_t i{ 0 }; i < count; i++)
+				{
+					*g_out++ = gx[i];
+					*g_out++ = gy[i];
+					*g_out++ = gz[i];
+				}
+			}
+			out += row_length;
+		}
+	};
+
+	size_t num_tiles = tiles_per_face * cube_faces.size();
+	if (pool)
+	{
+		pool->parallel_for(num_tiles, build_tile);
+	}
+	else
+	{
+		for (size_t tile{ 0 }; tile < num_tiles; tile++)
+			build_tile(tile);
+	}
+
+	built.set_value(field);
+	return field;
+}
+
+size_t height_cache::noise_key_hash::operator()(const noise_settings &noise) const
+{
+	size_t h = std::hash<int>{}(static_cast<int>(noise.type));
+	for (size_t value : { std::hash<int32_t>{}(noise.seed),
+	                      std::hash<float>{}(noise.frequency),
+	                      std::hash<float>{}(noise.amplitude) })
+	{
+		h ^= value + 0x9e3779b9 + (h << 6) + (h >> 2);
+	}
+	return h;
+}
+
+bool height_cache::noise_key_equal::operator()(const noise_settings &a, const noise_settings &b) const
+{
+	return a.type == b.type
+	   and a.seed == b.seed
+	   and a.frequency == b.frequency
+	   and a.amplitude == b.amplitude;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "planet.h"
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace planet_generator
+{
+	class thread_pool;
+	class height_sampler;
+
+	// Noise heights stored as six cube face grids, with several resolution levels per noise setting.
+	// Level n has base_resolution * 2^n quads along a face edge. Regenerating a planet at a new
+	// resolution or radius then bilinearly samples the stored heights instead of evaluating noise again.
+	// Levels are built outside the lock, so sampling built levels never waits for a level being built;
+	// only threads asking for that same level wait for it.
+	class height_cache
+	{
+	public:
+		height_cache(uint32_t base_resolution = 64, uint8_t level_count = 5);
+		~height_cache();
+
+		// Sampler that reads the coarsest level with at least 'resolution' quads per face edge,
+		// or the finest level if none is fine enough. Level is built on first use, with the pool if given.
+		[[nodiscard]]
+		std::unique_ptr<height_sampler> make_sampler(const noise_settings &noise, uint32_t resolution, thread_pool *pool = nullptr);
+
+		// Same, for heights from any sampler, stored under 'key'. Source is only called when a level
+		// has to be built, and must give the same heights for the same key every time.
+		[[nodiscard]]
+		std::unique_ptr<height_sampler> make_sampler(const noise_settings &key, const height_sampler &source, uint32_t resolution, thread_pool *pool = nullptr);
+
+		// Quads per face edge of the finest level
+		uint32_t finest_resolution() const;
+
+		size_t memory_used() const;
+		void clear();
+
+	private:
+		struct heightfield
+		{
+			uint32_t resolution;
+			std::vector<float> heights;     // 6 faces of (resolution + 1)^2, row major
+			std::vector<float> gradients;   // x, y, z for each height, empty if the source has no gradient
+		};
+		using heightfield_ptr = std::shared_ptr<const heightfield>;
+
+		struct noise_key_hash
+		{
+			size_t operator()(const noise_settings &noise) const;
+		};
+
+		struct noise_key_equal
+		{
+			bool operator()(const noise_settings &a, const noise_settings &b) const;
+		};
+
+		uint8_t level_for(uint32_t resolution) const;
+		heightfield_ptr get_level(const noise_settings &key, const height_sampler *source, uint8_t level, thread_pool *pool);
+
+	private:
+		uint32_t base_resolution;
+		uint8_t level_count;
+
+		// Guards the map only; a level's future is stored as soon as its build starts
+		mutable std::mutex cache_mutex;
+		std::unordered_map<noise_settings, std::vector<std::shared_future<heightfield_ptr>>, noise_key_hash, noise_key_equal> fields;
+	};
+}
@@ -0,0 +1,130 @@
+#include "instancing.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	using namespace planet_generator::simd;
+
+	// Bits k set for spheres i + k that are at least partly inside every plane
+	uint32_t test_batch(const float *x, const float *y, const float *z, const float *radius, size_t i, const cull_view &view)
+	{
+		float_v cx = load_unaligned(x + i),
+		        cy = load_unaligned(y + i),
+		        cz = load_unaligned(z + i),
+		        r = load_unaligned(radius + i);
+
+		mask_v out{};
+		for (size_t p{ 0 }; p < 6; p++)
+		{
+			const auto &plane = view.planes[p];
+			float_v distance = add(add(add(mul(cx, splat(plane.x)), mul(cy, splat(plane.y))), mul(cz, splat(plane.z))), splat(plane.w));
+			mask_v outside_plane = less(add(distance, r), splat(0.0f));
+			out = (p == 0) ? outside_plane : mask_or(out, outside_plane);
+		}
+		return ~mask_bits(out) & ((1u << lanes) - 1);
+	}
+}
+
+uint32_t instance_builder::add(const body &b)
+{
+	x.push_back(b.position.x);
+	y.push_back(b.position.y);
+	z.push_back(b.position.z);
+	radius.push_back(b.radius);
+	cos_spin.push_back(std::cos(b.spin));
+	sin_spin.push_back(std::sin(b.spin));
+	seed.push_back(b.seed);
+	return static_cast<uint32_t>(seed.size() - 1);
+}
+
+void instance_builder::set_position(uint32_t index, const XMFLOAT3 &position)
+{
+	assert(index < size());
+	x[index] = position.x;
+	y[index] = position.y;
+	z[index] = position.z;
+}
+
+void instance_builder::set_spin(uint32_t index, float spin)
+{
+	assert(index < size());
+	cos_spin[index] = std::cos(spin);
+	sin_spin[index] = std::sin(spin);
+}
+
+void instance_builder::clear()
+{
+	for (auto *list : { &x, &y, &z, &radius, &cos_spin, &sin_spin, &seed })
+	{
+		list->clear();
+	}
+}
+
+size_t instance_builder::size() const
+{
+	return seed.size();
+}
+
+uint32_t instance_builder::build(const cull_view &view, instance_data *out)
+{
+	uint32_t written{ 0 };
+	auto write = [&](size_t i, uint32_t inside, size_t count)
+	{
+		for (size_t k{ 0 }; k < count; k++)
+		{
+			if (not ((inside >> k) & 1))
+				continue;
+
+			// XMMatrixRotationY(spin) * XMMatrixTranslation(x, y, z)
+			auto b = i + k;
+			float c = cos_spin[b], s = sin_spin[b];
+			auto &instance = out[written++];
+			instance.transform = XMFLOAT4X4{ c,     0.0f,  -s,    0.0f,
+			                                 0.0f,  1.0f,  0.0f,  0.0f,
+			                                 s,     0.0f,  c,     0.0f,
+			                                 x[b],  y[b],  z[b],  1.0f };
+			instance.radius = radius[b];
+			instance.seed = seed[b];
+			instance.unused[0] = 0.0f;
+			instance.unused[1] = 0.0f;
+		}
+	};
+
+	const size_t count = size();
+	size_t i{ 0 };
+	for (; i + lanes <= count; i += lanes)
+	{
+		write(i, test_batch(x.data(), y.data(), z.data(), radius.data(), i, view), lanes);
+	}
+
+	if (i < count)
+	{
+		// Last partial batch goes through a copy, padded with its final body
+		float tail[4][lanes];
+		const float *source[4]{ x.data(), y.data(), z.data(), radius.data() };
+		for (size_t a{ 0 }; a < 4; a++)
+		{
+			for (size_t k{ 0 }; k < lanes; k++)
+			{
+				tail[a][k] = source[a][std::min(i + k, count - 1)];
+			}
+		}
+		write(i, test_batch(tail[0], tail[1], tail[2], tail[3], 0, view), count - i);
+	}
+
+	build_stats.tested = static_cast<uint32_t>(count);
+	build_stats.visible = written;
+	return written;
+}
+
+const instance_builder::statistics &instance_builder::stats() const
+{
+	return build_stats;
+}
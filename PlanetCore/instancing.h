@@ -0,0 +1,60 @@
+#pragma once
+
+#include "culling.h"
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace planet_generator
+{
+	// What an instanced draw reads per instance, from the instance stream of the _instanced vertex shaders
+	struct instance_data
+	{
+		DirectX::XMFLOAT4X4 transform;  // base mesh to world, rotation and translation only; as XMMATRIX, not transposed
+		float radius;                   // base mesh is scaled by it before transform
+		float seed;                     // varies how the instance is shaded
+		float unused[2];
+	};
+
+	// Many bodies drawn from one base mesh, e.g. moons from a unit sphere, kept as structure of arrays.
+	// build tests them against the frustum as spheres, a SIMD batch at a time, and writes instance data for
+	// the ones in view, in the order they were added; what is out of view costs only its test.
+	class instance_builder
+	{
+	public:
+		struct body
+		{
+			DirectX::XMFLOAT3 position;
+			float radius;
+			float spin;                 // about the y axis, radians
+			float seed;
+		};
+
+		struct statistics
+		{
+			uint32_t tested;
+			uint32_t visible;
+		};
+
+	public:
+		// Returns the index the body is kept under, indicies count up from 0
+		uint32_t add(const body &b);
+		void set_position(uint32_t index, const DirectX::XMFLOAT3 &position);
+		void set_spin(uint32_t index, float spin);
+		void clear();
+		size_t size() const;
+
+		// view has to be in world space; out needs room for size() instances. Returns how many were written.
+		uint32_t build(const cull_view &view, instance_data *out);
+
+		// Of the last build
+		const statistics &stats() const;
+
+	private:
+		std::vector<float> x, y, z, radius;
+		std::vector<float> cos_spin, sin_spin;
+		std::vector<float> seed;
+		statistics build_stats{};
+	};
+}
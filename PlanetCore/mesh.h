@@ -0,0 +1,37 @@
+#pragma once
+
+#include "meshlet.h"
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace planet_generator
+{
+	struct vertex
+	{
+		DirectX::XMFLOAT3 position;
+	};
+
+	struct mesh
+	{
+		std::vector<vertex> verticies;
+		std::vector<uint32_t> indicies;
+		std::vector<DirectX::XMFLOAT3> normals;    // empty, or one per vertex
+		std::vector<meshlet> meshlets;             // empty unless built, see build_meshlets
+	};
+
+	// Non-owning mesh data, for verticies and indicies that live somewhere other than a mesh
+	struct mesh_view
+	{
+		const vertex *verticies = nullptr;
+		size_t vertex_count = 0;
+		const uint32_t *indicies = nullptr;
+		size_t index_count = 0;
+	};
+
+	inline mesh_view make_view(const mesh &mesh_obj)
+	{
+		return { mesh_obj.verticies.data(), mesh_obj.verticies.size(), mesh_obj.indicies.data(), mesh_obj.indicies.size() };
+	}
+}
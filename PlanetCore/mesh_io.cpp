@@ -0,0 +1,123 @@
+#include "mesh_io.h"
+#include "mesh.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace planet_generator;
+
+namespace
+{
+	// Text is formatted in chunks of this size before being written out
+	constexpr size_t text_chunk_size = 1 << 20;
+}
+
+bool planet_generator::write_obj(const mesh &mesh_obj, const std::string &file_path)
+{
+	std::ofstream file(file_path, std::ios::out | std::ios::binary);
+	if (not file)
+		return false;
+
+	std::vector<char> text;
+	text.reserve(text_chunk_size + 128);
+	auto flush = [&]()
+	{
+		file.write(text.data(), text.size());
+		text.clear();
+	};
+
+	char line[128]{};
+	for (auto &v : mesh_obj.verticies)
+	{
+		auto length = std::snprintf(line, sizeof(line), "v %.9g %.9g %.9g\n", v.position.x, v.position.y, v.position.z);
+		text.insert(text.end(), line, line + length);
+		if (text.size() >= text_chunk_size)
+			flush();
+	}
+
+	for (auto &n : mesh_obj.normals)
+	{
+		auto length = std::snprintf(line, sizeof(line), "vn %.6g %.6g %.6g\n", n.x, n.y, n.z);
+		text.insert(text.end(), line, line + length);
+		if (text.size() >= text_chunk_size)
+			flush();
+	}
+
+	// OBJ indicies start at 1; normals share the vertex index
+	bool has_normals = not mesh_obj.normals.empty();
+	for (size_t i{ 0 }; i + 2 < mesh_obj.indicies.size(); i += 3)
+	{
+		uint32_t a = mesh_obj.indicies[i] + 1,
+		         b = mesh_obj.indicies[i + 1] + 1,
+		         c = mesh_obj.indicies[i + 2] + 1;
+		auto length = has_normals ? std::snprintf(line, sizeof(line), "f %u//%u %u//%u %u//%u\n", a, a, b, b, c, c)
+		                          : std::snprintf(line, sizeof(line), "f %u %u %u\n", a, b, c);
+		text.insert(text.end(), line, line + length);
+		if (text.size() >= text_chunk_size)
+			flush();
+	}
+	flush();
+
+	return static_cast<bool>(file);
+}
+
+bool planet_generator::write_ply(const mesh &mesh_obj, const std::string &file_path)
+{
+	std::ofstream file(file_path, std::ios::out | std::ios::binary);
+	if (not file)
+		return false;
+
+	auto triangle_count = mesh_obj.indicies.size() / 3;
+	bool has_normals = not mesh_obj.normals.empty();
+
+	file << "ply\n"
+	     << "format binary_little_endian 1.0\n"
+	     << "element vertex " << mesh_obj.verticies.size() << "\n"
+	     << "property float x\n"
+	     << "property float y\n"
+	     << "property float z\n";
+	if (has_normals)
+	{
+		file << "property float nx\n"
+		     << "property float ny\n"
+		     << "property float nz\n";
+	}
+	file << "element face " << triangle_count << "\n"
+	     << "property list uchar uint vertex_indices\n"
+	     << "end_header\n";
+
+	// vertex is exactly x, y, z floats, so verticies go out as one block
+	static_assert(sizeof(vertex) == 3 * sizeof(float));
+	if (not has_normals)
+	{
+		file.write(reinterpret_cast<const char *>(mesh_obj.verticies.data()),
+		           mesh_obj.verticies.size() * sizeof(vertex));
+	}
+	else
+	{
+		// PLY properties are per vertex, so positions and normals are interleaved
+		std::vector<float> interleaved(mesh_obj.verticies.size() * 6);
+		for (size_t v{ 0 }; v < mesh_obj.verticies.size(); v++)
+		{
+			std::memcpy(&interleaved[v * 6], &mesh_obj.verticies[v], sizeof(vertex));
+			std::memcpy(&interleaved[v * 6 + 3], &mesh_obj.normals[v], sizeof(DirectX::XMFLOAT3));
+		}
+		file.write(reinterpret_cast<const char *>(interleaved.data()), interleaved.size() * sizeof(float));
+	}
+
+	// Each face is a 1 byte count followed by 3 indicies; packed into a buffer so it's not 2 writes per face
+	constexpr size_t face_size = 1 + 3 * sizeof(uint32_t);
+	std::vector<char> faces(triangle_count * face_size);
+	for (size_t t{ 0 }; t < triangle_count; t++)
+	{
+		auto *face = faces.data() + t * face_size;
+		face[0] = 3;
+		std::memcpy(face + 1, &mesh_obj.indicies[t * 3], 3 * sizeof(uint32_t));
+	}
+	file.write(faces.data(), faces.size());
+
+	return static_cast<bool>(file);
+}
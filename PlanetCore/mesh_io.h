@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+namespace planet_generator
+{
+	struct mesh;
+
+	// Wavefront OBJ, plain text. Readable by nearly every tool, but slow and large for big meshes.
+	[[nodiscard]]
+	bool write_obj(const mesh &mesh_obj, const std::string &file_path);
+
+	// Binary little endian PLY. float x, y, z per vertex and uint32 indicies per triangle.
+	[[nodiscard]]
+	bool write_ply(const mesh &mesh_obj, const std::string &file_path);
+}
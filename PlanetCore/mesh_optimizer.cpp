@@ -0,0 +1,214 @@
+#include "mesh_optimizer.h"
+#include "mesh.h"
+
+#include <cassert>
+#include <limits>
+#include <vector>
+
+using namespace planet_generator;
+
+namespace
+{
+	constexpr uint32_t no_vertex = std::numeric_limits<uint32_t>::max();
+
+	// Triangles using each vertex, as one flat list with per vertex offsets
+	struct vertex_triangles
+	{
+		std::vector<uint32_t> offsets;      // vertex_count + 1 entries
+		std::vector<uint32_t> triangles;
+	};
+
+	vertex_triangles make_adjacency(const std::vector<uint32_t> &indicies, size_t vertex_count)
+	{
+		vertex_triangles adjacency{};
+		adjacency.offsets.assign(vertex_count + 1, 0);
+		adjacency.triangles.resize(indicies.size());
+
+		for (auto index : indicies)
+		{
+			adjacency.offsets[index + 1]++;
+		}
+		for (size_t v{ 0 }; v < vertex_count; v++)
+		{
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+		}
+
+		auto fill = adjacency.offsets;
+		for (size_t i{ 0 }; i < indicies.size(); i++)
+		{
+			adjacency.triangles[fill[indicies[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		return adjacency;
+	}
+}
+
+float planet_generator::average_cache_miss_ratio(const mesh &mesh_obj, uint32_t cache_size)
+{
+	assert(cache_size > 0);
+
+	auto triangle_count = mesh_obj.indicies.size() / 3;
+	if (triangle_count == 0)
+		return 0.0f;
+
+	// FIFO cache; a vertex is in the cache if it was loaded within the last cache_size misses
+	std::vector<uint64_t> loaded_at(mesh_obj.verticies.size(), 0);
+	uint64_t misses{ 0 };
+	for (auto index : mesh_obj.indicies)
+	{
+		if (loaded_at[index] == 0 or misses - loaded_at[index] + 1 > cache_size)
+		{
+			misses++;
+			loaded_at[index] = misses;
+		}
+	}
+
+	return static_cast<float>(misses) / static_cast<float>(triangle_count);
+}
+
+void planet_generator::optimize_vertex_cache(mesh &mesh_obj, uint32_t cache_size)
+{
+	assert(cache_size > 0);
+	mesh_obj.meshlets.clear();
+
+	auto &indicies = mesh_obj.indicies;
+	auto vertex_count = mesh_obj.verticies.size();
+	auto triangle_count = indicies.size() / 3;
+	if (triangle_count == 0)
+		return;
+
+	auto adjacency = make_adjacency(indicies, vertex_count);
+
+	std::vector<uint32_t> live_triangles(vertex_count);
+	for (size_t v{ 0 }; v < vertex_count; v++)
+	{
+		live_triangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+	}
+
+	std::vector<uint32_t> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<uint32_t> dead_end;                     // recently used verticies, to restart from
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(indicies.size());
+
+	uint32_t time = cache_size + 1;
+	uint32_t cursor = 0;                                // scan position for restarting when dead_end runs dry
+	uint32_t fan_vertex = 0;
+
+	while (fan_vertex != no_vertex)
+	{
+		candidates.clear();
+
+		// Emit every remaining triangle around fan_vertex
+		for (auto i = adjacency.offsets[fan_vertex]; i < adjacency.offsets[fan_vertex + 1]; i++)
+		{
+			auto triangle = adjacency.triangles[i];
+			if (emitted[triangle])
+				continue;
+
+			for (uint32_t corner{ 0 }; corner < 3; corner++)
+			{
+				auto v = indicies[triangle * 3 + corner];
+				output.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				live_triangles[v]--;
+
+				if (time - cache_time[v] > cache_size)
+				{
+					cache_time[v] = time;
+					time++;
+				}
+			}
+			emitted[triangle] = true;
+		}
+
+		// Next fan is the candidate that is still in cache and oldest in it;
+		// candidates whose remaining triangles would push them out of cache don't qualify
+		fan_vertex = no_vertex;
+		int64_t best_priority = -1;
+		for (auto v : candidates)
+		{
+			if (live_triangles[v] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (time - cache_time[v] + 2 * live_triangles[v] <= cache_size)
+				priority = time - cache_time[v];
+
+			if (priority > best_priority)
+			{
+				best_priority = priority;
+				fan_vertex = v;
+			}
+		}
+
+		if (fan_vertex != no_vertex)
+			continue;
+
+		// Dead end, fall back to the most recently used vertex that still has triangles
+		while (not dead_end.empty())
+		{
+			auto v = dead_end.back();
+			dead_end.pop_back();
+			if (live_triangles[v] > 0)
+			{
+				fan_vertex = v;
+				break;
+			}
+		}
+
+		// Then to the next vertex in input order that still has triangles
+		while (fan_vertex == no_vertex and cursor < vertex_count)
+		{
+			if (live_triangles[cursor] > 0)
+				fan_vertex = cursor;
+			cursor++;
+		}
+	}
+
+	assert(output.size() == triangle_count * 3);
+	output.insert(output.end(), indicies.begin() + triangle_count * 3, indicies.end());
+	indicies = std::move(output);
+}
+
+void planet_generator::optimize_vertex_fetch(mesh &mesh_obj)
+{
+	auto vertex_count = mesh_obj.verticies.size();
+	std::vector<uint32_t> remap(vertex_count, no_vertex);
+	uint32_t next{ 0 };
+
+	for (auto &index : mesh_obj.indicies)
+	{
+		if (remap[index] == no_vertex)
+			remap[index] = next++;
+		index = remap[index];
+	}
+
+	for (size_t v{ 0 }; v < vertex_count; v++)
+	{
+		if (remap[v] == no_vertex)
+			remap[v] = next++;
+	}
+
+	// Normals, when present, follow their verticies
+	std::vector<vertex> verticies(vertex_count);
+	for (size_t v{ 0 }; v < vertex_count; v++)
+		verticies[remap[v]] = mesh_obj.verticies[v];
+	mesh_obj.verticies = std::move(verticies);
+
+	if (not mesh_obj.normals.empty())
+	{
+		std::vector<DirectX::XMFLOAT3> normals(vertex_count);
+		for (size_t v{ 0 }; v < vertex_count; v++)
+			normals[remap[v]] = mesh_obj.normals[v];
+		mesh_obj.normals = std::move(normals);
+	}
+}
+
+void planet_generator::optimize_mesh(mesh &mesh_obj, uint32_t cache_size)
+{
+	optimize_vertex_cache(mesh_obj, cache_size);
+	optimize_vertex_fetch(mesh_obj);
+}
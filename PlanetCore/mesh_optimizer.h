@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+namespace planet_generator
+{
+	struct mesh;
+
+	// Post-transform vertex cache modelled as a FIFO of this many verticies
+	constexpr uint32_t default_vertex_cache_size = 16;
+
+	// Average cache miss ratio: transformed verticies per triangle, for a FIFO cache of cache_size.
+	// 3.0 is no reuse at all, about 0.5 is the best a regular grid can reach.
+	[[nodiscard]]
+	float average_cache_miss_ratio(const mesh &mesh_obj, uint32_t cache_size = default_vertex_cache_size);
+
+	// Reorders triangles for post-transform cache reuse, using Tipsify (Sander, Nehab, Barczak 2007).
+	// Winding of each triangle is kept. Verticies are not touched. Meshlets no longer match and are dropped.
+	void optimize_vertex_cache(mesh &mesh_obj, uint32_t cache_size = default_vertex_cache_size);
+
+	// Renumbers verticies in order of first use in the index list, so vertex fetch walks memory forwards.
+	// Verticies not used by any triangle move to the end. Index order is not touched.
+	void optimize_vertex_fetch(mesh &mesh_obj);
+
+	// Both of the above, cache order first since fetch order follows from it
+	void optimize_mesh(mesh &mesh_obj, uint32_t cache_size = default_vertex_cache_size);
+}
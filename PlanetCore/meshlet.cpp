@@ -0,0 +1,317 @@
+#include "meshlet.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	constexpr uint32_t no_triangle = std::numeric_limits<uint32_t>::max();
+
+	// Normals that add up to less than this are treated as pointing every way
+	constexpr float min_cone_length = 1e-6f;
+
+	// Triangles using each vertex, as one flat list with per vertex offsets
+	struct vertex_triangles
+	{
+		std::vector<uint32_t> offsets;      // vertex_count + 1 entries
+		std::vector<uint32_t> triangles;
+	};
+
+	vertex_triangles make_adjacency(const std::vector<uint32_t> &indicies, size_t vertex_count)
+	{
+		vertex_triangles adjacency{};
+		adjacency.offsets.assign(vertex_count + 1, 0);
+		adjacency.triangles.resize(indicies.size());
+
+		for (auto index : indicies)
+		{
+			adjacency.offsets[index + 1]++;
+		}
+		for (size_t v{ 0 }; v < vertex_count; v++)
+		{
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+		}
+
+		auto fill = adjacency.offsets;
+		for (size_t i{ 0 }; i < indicies.size(); i++)
+		{
+			adjacency.triangles[fill[indicies[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		return adjacency;
+	}
+
+	XMVECTOR load_position(const mesh &mesh_obj, uint32_t index)
+	{
+		return XMLoadFloat3(&mesh_obj.verticies[index].position);
+	}
+
+	// Sphere around the centre of the bounding box, and the cone of the surface triangles' normals
+	meshlet make_bounds(const mesh &mesh_obj, const std::vector<uint32_t> &index_list, uint32_t first_index, uint32_t index_count,
+	                    const std::vector<bool> &surface)
+	{
+		meshlet cluster{};
+		cluster.first_index = first_index;
+		cluster.index_count = index_count;
+		const auto *indicies = index_list.data() + first_index;
+
+		XMVECTOR low = load_position(mesh_obj, indicies[0]),
+		         high = low;
+		for (uint32_t i{ 1 }; i < index_count; i++)
+		{
+			XMVECTOR p = load_position(mesh_obj, indicies[i]);
+			low = XMVectorMin(low, p);
+			high = XMVectorMax(high, p);
+		}
+
+		XMVECTOR center = (low + high) * 0.5f;
+		XMVECTOR radius = XMVectorZero();
+		for (uint32_t i{ 0 }; i < index_count; i++)
+		{
+			radius = XMVectorMax(radius, XMVector3LengthSq(load_position(mesh_obj, indicies[i]) - center));
+		}
+		XMStoreFloat3(&cluster.center, center);
+		cluster.radius = std::sqrt(XMVectorGetX(radius));
+
+		// Unit face normals, winding is counter clockwise seen from the front
+		std::vector<XMVECTOR> normals;
+		normals.reserve(index_count / 3);
+		XMVECTOR axis = XMVectorZero();
+		for (uint32_t i{ 0 }; i + 2 < index_count; i += 3)
+		{
+			if (not surface[(first_index + i) / 3])
+				continue;
+
+			XMVECTOR a = load_position(mesh_obj, indicies[i]),
+			         b = load_position(mesh_obj, indicies[i + 1]),
+			         c = load_position(mesh_obj, indicies[i + 2]);
+			XMVECTOR n = XMVector3Cross(b - a, c - a);
+			if (XMVectorGetX(XMVector3LengthSq(n)) == 0.0f)
+				continue;
+
+			n = XMVector3Normalize(n);
+			normals.push_back(n);
+			axis += n;
+		}
+
+		cluster.cone_axis = { 0.0f, 0.0f, 0.0f };
+		cluster.cone_cutoff = 1.0f;
+		if (XMVectorGetX(XMVector3Length(axis)) < min_cone_length)
+			return cluster;
+
+		axis = XMVector3Normalize(axis);
+		float min_dot{ 1.0f };
+		for (auto n : normals)
+		{
+			min_dot = std::min(min_dot, XMVectorGetX(XMVector3Dot(axis, n)));
+		}
+
+		XMStoreFloat3(&cluster.cone_axis, axis);
+		// Sine of the cone's half angle; past 90 degrees some triangle always faces the camera
+		if (min_dot > 0.0f)
+		{
+			cluster.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+		}
+
+		return cluster;
+	}
+}
+
+void planet_generator::build_meshlets(mesh &mesh_obj, size_t surface_index_count, uint32_t max_verticies, uint32_t max_triangles)
+{
+	assert(max_verticies >= 3 and max_triangles > 0);
+
+	auto triangle_count = mesh_obj.indicies.size() / 3;
+	auto vertex_count = mesh_obj.verticies.size();
+	const auto &indicies = mesh_obj.indicies;
+	auto adjacency = make_adjacency(indicies, vertex_count);
+
+	mesh_obj.meshlets.clear();
+	if (triangle_count == 0)
+		return;
+
+	std::vector<uint32_t> new_indicies;
+	new_indicies.reserve(triangle_count * 3);
+	std::vector<bool> surface;          // by new triangle position
+	surface.reserve(triangle_count);
+
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<uint32_t> vertex_meshlet(vertex_count, no_triangle);   // last meshlet each vertex went into
+	std::vector<uint32_t> meshlet_verticies;
+	meshlet_verticies.reserve(max_verticies);
+
+	uint32_t current{ 0 };
+	uint32_t meshlet_first_index{ 0 };
+	uint32_t meshlet_triangles{ 0 };
+	XMVECTOR position_sum = XMVectorZero();
+	size_t next_seed{ 0 };
+
+	auto new_verticies = [&](uint32_t triangle)
+	{
+		uint32_t count{ 0 };
+		for (uint32_t k{ 0 }; k < 3; k++)
+		{
+			count += (vertex_meshlet[indicies[triangle * 3 + k]] != current) ? 1 : 0;
+		}
+		return count;
+	};
+
+	auto finish_meshlet = [&]()
+	{
+		auto index_count = static_cast<uint32_t>(new_indicies.size()) - meshlet_first_index;
+		mesh_obj.meshlets.push_back(make_bounds(mesh_obj, new_indicies, meshlet_first_index, index_count, surface));
+
+		current++;
+		meshlet_first_index = static_cast<uint32_t>(new_indicies.size());
+		meshlet_triangles = 0;
+		meshlet_verticies.clear();
+		position_sum = XMVectorZero();
+	};
+
+	// Triangle centres, for keeping meshlets round
+	std::vector<XMFLOAT3> centroids(triangle_count);
+	for (size_t t{ 0 }; t < triangle_count; t++)
+	{
+		XMStoreFloat3(&centroids[t], (load_position(mesh_obj, indicies[t * 3]) +
+		                              load_position(mesh_obj, indicies[t * 3 + 1]) +
+		                              load_position(mesh_obj, indicies[t * 3 + 2])) / 3.0f);
+	}
+
+	// Meshlets grow one triangle at a time: whichever neighbour adds the fewest new verticies,
+	// then the one nearest the meshlet's centre so it stays round and its bounds stay tight.
+	// Neighbours of the last triangle are tried first; the whole meshlet border only when none of those fit.
+	uint32_t last = no_triangle;
+	for (size_t emitted_count{ 0 }; emitted_count < triangle_count;)
+	{
+		uint32_t best = no_triangle;
+		uint32_t best_new{ 4 };
+		float best_distance{ 0.0f };
+
+		XMFLOAT3 center{};
+		XMStoreFloat3(&center, position_sum / static_cast<float>(std::max<size_t>(meshlet_verticies.size(), 1)));
+		auto consider_neighbours = [&](uint32_t v)
+		{
+			for (uint32_t a = adjacency.offsets[v]; a < adjacency.offsets[v + 1]; a++)
+			{
+				auto triangle = adjacency.triangles[a];
+				if (emitted[triangle])
+					continue;
+
+				auto added = new_verticies(triangle);
+				if (meshlet_verticies.size() + added > max_verticies or added > best_new)
+					continue;
+
+				const auto &c = centroids[triangle];
+				float dx = c.x - center.x,
+				      dy = c.y - center.y,
+				      dz = c.z - center.z;
+				float distance = dx * dx + dy * dy + dz * dz;
+				if (added < best_new or distance < best_distance)
+				{
+					best = triangle;
+					best_new = added;
+					best_distance = distance;
+				}
+			}
+		};
+
+		if (meshlet_triangles > 0)
+		{
+			for (uint32_t k{ 0 }; k < 3; k++)
+			{
+				consider_neighbours(indicies[last * 3 + k]);
+			}
+			if (best == no_triangle or best_new > 1)
+			{
+				for (auto v : meshlet_verticies)
+				{
+					consider_neighbours(v);
+				}
+			}
+
+			// Nothing connected fits; start a new meshlet rather than jump somewhere else
+			if (best == no_triangle)
+			{
+				finish_meshlet();
+				continue;
+			}
+		}
+		else
+		{
+			while (emitted[next_seed])
+				next_seed++;
+			best = static_cast<uint32_t>(next_seed);
+		}
+
+		emitted[best] = true;
+		emitted_count++;
+		last = best;
+		surface.push_back(size_t{ best } * 3 < surface_index_count);
+		for (uint32_t k{ 0 }; k < 3; k++)
+		{
+			auto index = indicies[best * 3 + k];
+			new_indicies.push_back(index);
+			if (vertex_meshlet[index] != current)
+			{
+				vertex_meshlet[index] = current;
+				meshlet_verticies.push_back(index);
+				position_sum += load_position(mesh_obj, index);
+			}
+		}
+
+		if (++meshlet_triangles == max_triangles)
+		{
+			finish_meshlet();
+		}
+	}
+
+	if (meshlet_triangles > 0)
+	{
+		finish_meshlet();
+	}
+
+	assert(new_indicies.size() == indicies.size());
+	mesh_obj.indicies = std::move(new_indicies);
+}
+
+bool planet_generator::meshlet_visible(const meshlet &cluster, const cull_view &view)
+{
+	XMVECTOR center = XMLoadFloat3(&cluster.center);
+	for (const auto &plane : view.planes)
+	{
+		if (XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&plane), center)) < -cluster.radius)
+			return false;
+	}
+
+	XMVECTOR to_center = center - XMLoadFloat3(&view.camera_position);
+	float along_axis = XMVectorGetX(XMVector3Dot(to_center, XMLoadFloat3(&cluster.cone_axis)));
+	float distance = XMVectorGetX(XMVector3Length(to_center));
+	return along_axis < cluster.cone_cutoff * distance + cluster.radius;
+}
+
+size_t planet_generator::cull_meshlets(const meshlet *first, size_t count, const cull_view &view, std::vector<index_range> &visible)
+{
+	size_t visible_count{ 0 };
+	for (size_t m{ 0 }; m < count; m++)
+	{
+		const auto &cluster = first[m];
+		if (not meshlet_visible(cluster, view))
+			continue;
+
+		visible_count++;
+		if (not visible.empty() and visible.back().first_index + visible.back().index_count == cluster.first_index)
+		{
+			visible.back().index_count += cluster.index_count;
+		}
+		else
+		{
+			visible.push_back({ cluster.first_index, cluster.index_count });
+		}
+	}
+	return visible_count;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "culling.h"
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace planet_generator
+{
+	struct mesh;
+
+	// Sizes that fit a mesh shader thread group, and keep each cluster small enough to cull on its own
+	constexpr uint32_t max_meshlet_verticies = 64;
+	constexpr uint32_t max_meshlet_triangles = 124;
+
+	// Small cluster of neighbouring triangles, stored as a contiguous run of the mesh's indicies.
+	// Bounding sphere and normal cone are in the same space as the verticies.
+	struct meshlet
+	{
+		uint32_t first_index;
+		uint32_t index_count;
+
+		DirectX::XMFLOAT3 center;
+		float radius;
+
+		// The cluster faces away from every point p where dot(center - p, cone_axis) >= cone_cutoff * |center - p| + radius.
+		// cone_cutoff is 1 when the normals spread too far for that to ever hold.
+		DirectX::XMFLOAT3 cone_axis;
+		float cone_cutoff;
+	};
+
+	struct index_range
+	{
+		uint32_t first_index;
+		uint32_t index_count;
+	};
+
+	// Splits the mesh into meshlets, reordering its triangles so each meshlet's are contiguous.
+	// Triangles at or after surface_index_count in the current index list are clustered and bounded, but
+	// do not widen normal cones; meant for skirts, which hang under a surface and are hidden whenever it is.
+	// Result goes in mesh::meshlets.
+	void build_meshlets(mesh &mesh_obj,
+	                    size_t surface_index_count = std::numeric_limits<size_t>::max(),
+	                    uint32_t max_verticies = max_meshlet_verticies,
+	                    uint32_t max_triangles = max_meshlet_triangles);
+
+	// False when the meshlet is outside the frustum or faces away from the camera
+	[[nodiscard]]
+	bool meshlet_visible(const meshlet &cluster, const cull_view &view);
+
+	// Appends the index ranges of the visible meshlets to visible, merging ranges that touch.
+	// Returns how many meshlets were visible.
+	size_t cull_meshlets(const meshlet *first, size_t count, const cull_view &view, std::vector<index_range> &visible);
+}
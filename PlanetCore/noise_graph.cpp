@@ -0,0 +1,408 @@
+#include "noise_graph.h"
+#include "simplex_noise.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace planet_generator;
+
+namespace
+{
+	uint32_t input_count(noise_graph::operation op)
+	{
+		using operation = noise_graph::operation;
+		switch (op)
+		{
+		case operation::noise:
+		case operation::constant:
+			return 0;
+		case operation::clamp:
+		case operation::scale_bias:
+			return 1;
+		case operation::blend:
+			return 3;
+		default:
+			return 2;
+		}
+	}
+}
+
+noise_graph::node_id noise_graph::noise(const noise_settings &settings, float warp_amplitude)
+{
+	return add_node({ operation::noise, {}, settings, warp_amplitude, 0.0f, 0.0f });
+}
+
+noise_graph::node_id noise_graph::constant(float value)
+{
+	return add_node({ operation::constant, {}, {}, 0.0f, value, 0.0f });
+}
+
+noise_graph::node_id noise_graph::add(node_id a, node_id b)
+{
+	return add_node({ operation::add, { a, b }, {}, 0.0f, 0.0f, 0.0f });
+}
+
+noise_graph::node_id noise_graph::multiply(node_id a, node_id b)
+{
+	return add_node({ operation::multiply, { a, b }, {}, 0.0f, 0.0f, 0.0f });
+}
+
+noise_graph::node_id noise_graph::minimum(node_id a, node_id b)
+{
+	return add_node({ operation::minimum, { a, b }, {}, 0.0f, 0.0f, 0.0f });
+}
+
+noise_graph::node_id noise_graph::maximum(node_id a, node_id b)
+{
+	return add_node({ operation::maximum, { a, b }, {}, 0.0f, 0.0f, 0.0f });
+}
+
+noise_graph::node_id noise_graph::blend(node_id a, node_id b, node_id mask)
+{
+	return add_node({ operation::blend, { a, b, mask }, {}, 0.0f, 0.0f, 0.0f });
+}
+
+noise_graph::node_id noise_graph::clamp(node_id a, float low, float high)
+{
+	return add_node({ operation::clamp, { a }, {}, 0.0f, low, high });
+}
+
+noise_graph::node_id noise_graph::scale_bias(node_id a, float scale, float bias)
+{
+	return add_node({ operation::scale_bias, { a }, {}, 0.0f, scale, bias });
+}
+
+void noise_graph::set_output(node_id output_)
+{
+	assert(output_ < nodes.size());
+	output = output_;
+	has_output = true;
+}
+
+std::unique_ptr<noise_program> noise_graph::compile() const
+{
+	assert(not nodes.empty());
+
+	node_id result = has_output ? output : static_cast<node_id>(nodes.size() - 1);
+
+	// Keep only what the output depends on, and note where each value is last read
+	std::vector<bool> live(nodes.size(), false);
+	std::vector<node_id> last_use(nodes.size(), 0);
+	live[result] = true;
+	last_use[result] = static_cast<node_id>(nodes.size());
+	for (node_id i = result + 1; i-- > 0;)
+	{
+		if (not live[i])
+			continue;
+
+		for (uint32_t k{ 0 }; k < input_count(nodes[i].op); k++)
+		{
+			auto input = nodes[i].inputs[k];
+			live[input] = true;
+			last_use[input] = std::max(last_use[input], i);
+		}
+	}
+
+	auto program = std::unique_ptr<noise_program>(new noise_program());
+
+	// Registers are handed back once their value has been read for the last time
+	std::vector<uint16_t> node_register(nodes.size(), 0);
+	std::vector<uint16_t> free_registers;
+	std::vector<std::vector<uint16_t>> release_after(nodes.size());
+
+	for (node_id i{ 0 }; i <= result; i++)
+	{
+		if (not live[i])
+			continue;
+
+		const auto &n = nodes[i];
+		noise_program::instruction ins{};
+		ins.op = n.op;
+		ins.param0 = n.param0;
+		ins.param1 = n.param1;
+
+		for (uint32_t k{ 0 }; k < input_count(n.op); k++)
+		{
+			ins.inputs[k] = node_register[n.inputs[k]];
+		}
+
+		if (n.op == operation::noise)
+		{
+			ins.source = static_cast<uint16_t>(program->sources.size());
+			program->sources.push_back({ std::make_unique<simplex_noise>(n.noise.seed), n.noise.frequency, n.noise.amplitude, n.warp_amplitude });
+		}
+
+		// Inputs read for the last time here can be reused as this node's target
+		for (uint32_t k{ 0 }; k < input_count(n.op); k++)
+		{
+			auto input = n.inputs[k];
+			if (last_use[input] == i and std::find(free_registers.begin(), free_registers.end(), node_register[input]) == free_registers.end())
+			{
+				free_registers.push_back(node_register[input]);
+			}
+		}
+
+		if (free_registers.empty())
+		{
+			// Register file for a block lives on the stack, so it can't grow past this
+			if (program->registers == noise_program::max_registers)
+				return nullptr;
+
+			ins.target = program->registers++;
+		}
+		else
+		{
+			ins.target = free_registers.back();
+			free_registers.pop_back();
+		}
+
+		node_register[i] = ins.target;
+		program->program.push_back(ins);
+	}
+
+	program->output_register = node_register[result];
+	return program;
+}
+
+noise_graph::node_id noise_graph::add_node(const node &n)
+{
+	for (uint32_t k{ 0 }; k < input_count(n.op); k++)
+	{
+		assert(n.inputs[k] < nodes.size());
+	}
+
+	nodes.push_back(n);
+	return static_cast<node_id>(nodes.size() - 1);
+}
+
+noise_program::noise_program() = default;
+noise_program::~noise_program() = default;
+
+void noise_program::sample(const float *x, const float *y, const float *z, float *height, size_t count) const
+{
+	evaluate(x, y, z, height, nullptr, nullptr, nullptr, count);
+}
+
+bool noise_program::sample_gradient(const float *x, const float *y, const float *z, float *height,
+                                    float *gradient_x, float *gradient_y, float *gradient_z, size_t count) const
+{
+	evaluate(x, y, z, height, gradient_x, gradient_y, gradient_z, count);
+	return true;
+}
+
+void noise_program::evaluate(const float *x, const float *y, const float *z, float *height,
+                             float *gradient_x, float *gradient_y, float *gradient_z, size_t count) const
+{
+	bool with_gradient = gradient_x != nullptr;
+	for (size_t first{ 0 }; first < count; first += max_kernel_block)
+	{
+		size_t block_count = std::min(max_kernel_block, count - first);
+		evaluate_block(x + first, y + first, z + first, height + first,
+		               with_gradient ? gradient_x + first : nullptr,
+		               with_gradient ? gradient_y + first : nullptr,
+		               with_gradient ? gradient_z + first : nullptr,
+		               block_count);
+	}
+}
+
+void noise_program::evaluate_block(const float *x, const float *y, const float *z, float *height,
+                                   float *gradient_x, float *gradient_y, float *gradient_z, size_t count) const
+{
+	assert(count <= max_kernel_block);
+
+	float reg[max_registers][max_kernel_block];
+	// d reg / d x, y, z; only touched when a gradient is asked for
+	float grad[max_registers][3][max_kernel_block];
+	bool with_gradient = gradient_x != nullptr;
+
+	for (const auto &ins : program)
+	{
+		float *out = reg[ins.target];
+		const float *a = reg[ins.inputs[0]],
+		            *b = reg[ins.inputs[1]],
+		            *c = reg[ins.inputs[2]];
+
+		auto &g_out = grad[ins.target];
+		const auto &g_a = grad[ins.inputs[0]],
+		           &g_b = grad[ins.inputs[1]],
+		           &g_c = grad[ins.inputs[2]];
+
+		switch (ins.op)
+		{
+		case noise_graph::operation::noise:
+		{
+			const auto &src = sources[ins.source];
+			if (not with_gradient and src.warp_amplitude == 0.0f)
+			{
+				// Plain noise goes through simplex_noise's SIMD path
+				float scaled[3][max_kernel_block];
+				for (size_t i{ 0 }; i < count; i++)
+				{
+					scaled[0][i] = x[i] * src.frequency;
+					scaled[1][i] = y[i] * src.frequency;
+					scaled[2][i] = z[i] * src.frequency;
+				}
+				src.noise->sample(scaled[0], scaled[1], scaled[2], out, count);
+				for (size_t i{ 0 }; i < count; i++) out[i] *= src.amplitude;
+				break;
+			}
+
+			for (size_t i{ 0 }; i < count; i++)
+			{
+				float px = x[i] * src.frequency,
+				      py = y[i] * src.frequency,
+				      pz = z[i] * src.frequency;
+
+				if (not with_gradient)
+				{
+					src.noise->warp(src.warp_amplitude, px, py, pz);
+					out[i] = src.noise->value(px, py, pz) * src.amplitude;
+					continue;
+				}
+
+				float jacobian[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+				if (src.warp_amplitude != 0.0f)
+				{
+					src.noise->warp(src.warp_amplitude, px, py, pz, jacobian);
+				}
+
+				float g[3]{};
+				out[i] = src.noise->value(px, py, pz, g) * src.amplitude;
+
+				// Chain rule through the warp and the frequency scale: g . J * frequency
+				float slope = src.amplitude * src.frequency;
+				for (int axis{ 0 }; axis < 3; axis++)
+				{
+					g_out[axis][i] = (g[0] * jacobian[axis] + g[1] * jacobian[3 + axis] + g[2] * jacobian[6 + axis]) * slope;
+				}
+			}
+			break;
+		}
+		case noise_graph::operation::constant:
+			std::fill(out, out + count, ins.param0);
+			if (with_gradient)
+			{
+				for (auto &axis : g_out) std::fill(axis, axis + count, 0.0f);
+			}
+			break;
+		case noise_graph::operation::add:
+			if (with_gradient)
+			{
+				for (int axis{ 0 }; axis < 3; axis++)
+					for (size_t i{ 0 }; i < count; i++) g_out[axis][i] = g_a[axis][i] + g_b[axis][i];
+			}
+			for (size_t i{ 0 }; i < count; i++) out[i] = a[i] + b[i];
+			break;
+		case noise_graph::operation::multiply:
+			if (with_gradient)
+			{
+				for (int axis{ 0 }; axis < 3; axis++)
+					for (size_t i{ 0 }; i < count; i++) g_out[axis][i] = g_a[axis][i] * b[i] + a[i] * g_b[axis][i];
+			}
+			for (size_t i{ 0 }; i < count; i++) out[i] = a[i] * b[i];
+			break;
+		case noise_graph::operation::minimum:
+			if (with_gradient)
+			{
+				for (int axis{ 0 }; axis < 3; axis++)
+					for (size_t i{ 0 }; i < count; i++) g_out[axis][i] = (a[i] <= b[i]) ? g_a[axis][i] : g_b[axis][i];
+			}
+			for (size_t i{ 0 }; i < count; i++) out[i] = std::min(a[i], b[i]);
+			break;
+		case noise_graph::operation::maximum:
+			if (with_gradient)
+			{
+				for (int axis{ 0 }; axis < 3; axis++)
+					for (size_t i{ 0 }; i < count; i++) g_out[axis][i] = (a[i] >= b[i]) ? g_a[axis][i] : g_b[axis][i];
+			}
+			for (size_t i{ 0 }; i < count; i++) out[i] = std::max(a[i], b[i]);
+			break;
+		case noise_graph::operation::blend:
+			if (with_gradient)
+			{
+				// Mask only contributes where it is not saturated
+				for (int axis{ 0 }; axis < 3; axis++)
+					for (size_t i{ 0 }; i < count; i++)
+					{
+						float t = std::clamp(c[i], 0.0f, 1.0f);
+						float g_t = (c[i] > 0.0f and c[i] < 1.0f) ? g_c[axis][i] : 0.0f;
+						g_out[axis][i] = g_a[axis][i] + (g_b[axis][i] - g_a[axis][i]) * t + (b[i] - a[i]) * g_t;
+					}
+			}
+			for (size_t i{ 0 }; i < count; i++) out[i] = a[i] + (b[i] - a[i]) * std::clamp(c[i], 0.0f, 1.0f);
+			break;
+		case noise_graph::operation::clamp:
+			if (with_gradient)
+			{
+				for (int axis{ 0 }; axis < 3; axis++)
+					for (size_t i{ 0 }; i < count; i++) g_out[axis][i] = (a[i] > ins.param0 and a[i] < ins.param1) ? g_a[axis][i] : 0.0f;
+			}
+			for (size_t i{ 0 }; i < count; i++) out[i] = std::clamp(a[i], ins.param0, ins.param1);
+			break;
+		case noise_graph::operation::scale_bias:
+			if (with_gradient)
+			{
+				for (int axis{ 0 }; axis < 3; axis++)
+					for (size_t i{ 0 }; i < count; i++) g_out[axis][i] = g_a[axis][i] * ins.param0;
+			}
+			for (size_t i{ 0 }; i < count; i++) out[i] = a[i] * ins.param0 + ins.param1;
+			break;
+		}
+	}
+
+	std::copy(reg[output_register], reg[output_register] + count, height);
+	if (with_gradient)
+	{
+		const auto &g = grad[output_register];
+		std::copy(g[0], g[0] + count, gradient_x);
+		std::copy(g[1], g[1] + count, gradient_y);
+		std::copy(g[2], g[2] + count, gradient_z);
+	}
+}
+
+size_t noise_program::instruction_count() const
+{
+	return program.size();
+}
+
+size_t noise_program::register_count() const
+{
+	return registers;
+}
+
+noise_graph planet_generator::make_noise_graph(const noise_settings &noise)
+{
+	noise_graph graph{};
+	switch (noise.type)
+	{
+	case noise_type::simplex:
+	{
+		// max(0, value) * amplitude
+		auto zero = graph.constant(0.0f);
+		auto layer = graph.noise(noise);
+		if (noise.amplitude >= 0.0f)
+			graph.maximum(zero, layer);
+		else
+			graph.minimum(zero, layer);
+		return graph;
+	}
+	case noise_type::continents:
+	{
+		float amplitude = noise.amplitude;
+
+		// Land where the slow layer is above 0, with a short coastal slope into it
+		auto continent = graph.noise(noise_settings{ noise.type, noise.seed, noise.frequency * 0.25f, 1.0f });
+		auto land = graph.clamp(graph.scale_bias(continent, 4.0f, 0.0f), 0.0f, 1.0f);
+
+		auto mountains = graph.noise(noise_settings{ noise.type, noise.seed + 1, noise.frequency, amplitude }, noise.frequency * 0.1f);
+		auto hills = graph.noise(noise_settings{ noise.type, noise.seed + 2, noise.frequency * 4.0f, amplitude * 0.1f });
+
+		auto inland = graph.add(graph.scale_bias(land, amplitude * 0.25f, 0.0f), graph.maximum(graph.constant(0.0f), mountains));
+		graph.clamp(graph.add(graph.blend(graph.constant(0.0f), inland, land), hills), 0.0f);
+		return graph;
+	}
+	}
+
+	assert(false); // Unimplemented Enum value
+	return graph;
+}
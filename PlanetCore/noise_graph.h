@@ -0,0 +1,132 @@
+#pragma once
+
+#include "planet.h"
+#include "planet_kernel.h"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace planet_generator
+{
+	class noise_program;
+	class simplex_noise;
+
+	// Declarative description of a height function, built from noise sources and operations on them.
+	// Nodes can only refer to nodes made before them, so the graph is always in evaluation order.
+	class noise_graph
+	{
+	public:
+		using node_id = uint32_t;
+
+		enum class operation
+		{
+			noise,          // simplex_noise source, value * amplitude
+			constant,
+			add,
+			multiply,
+			minimum,
+			maximum,
+			blend,          // a + (b - a) * saturate(mask)
+			clamp,
+			scale_bias      // a * scale + bias
+		};
+
+		struct node
+		{
+			operation op;
+			node_id inputs[3];
+			noise_settings noise;
+			float warp_amplitude;   // domain warp applied before sampling a noise source, 0 for none
+			float param0;
+			float param1;
+		};
+
+	public:
+		node_id noise(const noise_settings &settings, float warp_amplitude = 0.0f);
+		node_id constant(float value);
+		node_id add(node_id a, node_id b);
+		node_id multiply(node_id a, node_id b);
+		node_id minimum(node_id a, node_id b);
+		node_id maximum(node_id a, node_id b);
+		node_id blend(node_id a, node_id b, node_id mask);
+		node_id clamp(node_id a, float low, float high = std::numeric_limits<float>::max());
+		node_id scale_bias(node_id a, float scale, float bias);
+
+		// Output is the last node added, unless set here
+		void set_output(node_id output);
+
+		// Flattens the graph reachable from the output into a register program.
+		// Returns null if it needs more than noise_program::max_registers values alive at once.
+		[[nodiscard]]
+		std::unique_ptr<noise_program> compile() const;
+
+	private:
+		node_id add_node(const node &n);
+
+	private:
+		std::vector<node> nodes;
+		node_id output{ 0 };
+		bool has_output = false;
+	};
+
+	// Flat program compiled from a noise_graph. Each block of directions runs through the
+	// whole instruction list once, so all layers are done in the same pass over the verticies.
+	class noise_program : public height_sampler
+	{
+	public:
+		// Register file for one block is kept on the stack while sampling
+		static constexpr size_t max_registers = 64;
+
+		~noise_program();
+
+		void sample(const float *x, const float *y, const float *z, float *height, size_t count) const override;
+
+		// Gradient is carried through every instruction alongside the value (forward mode)
+		bool sample_gradient(const float *x, const float *y, const float *z, float *height,
+		                     float *gradient_x, float *gradient_y, float *gradient_z, size_t count) const override;
+
+		size_t instruction_count() const;
+		size_t register_count() const;
+
+	private:
+		friend class noise_graph;
+
+		struct instruction
+		{
+			noise_graph::operation op;
+			uint16_t target;
+			uint16_t inputs[3];
+			uint16_t source;        // index into sources, for noise
+			float param0;
+			float param1;
+		};
+
+		struct noise_source
+		{
+			std::unique_ptr<simplex_noise> noise;
+			float frequency;
+			float amplitude;
+			float warp_amplitude;
+		};
+
+		noise_program();
+
+		// Gradient pointers are either all null or all set.
+		// Runs the program over count directions, max_kernel_block at a time.
+		void evaluate(const float *x, const float *y, const float *z, float *height,
+		              float *gradient_x, float *gradient_y, float *gradient_z, size_t count) const;
+		void evaluate_block(const float *x, const float *y, const float *z, float *height,
+		                    float *gradient_x, float *gradient_y, float *gradient_z, size_t count) const;
+
+	private:
+		std::vector<instruction> program;
+		std::vector<noise_source> sources;
+		uint16_t registers{ 0 };
+		uint16_t output_register{ 0 };
+	};
+
+	// The graph make_height_sampler compiles for these settings, one preset per noise_type
+	[[nodiscard]]
+	noise_graph make_noise_graph(const noise_settings &noise);
+}
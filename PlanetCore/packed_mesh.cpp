@@ -0,0 +1,161 @@
+#include "packed_mesh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	constexpr float snorm16_max = 32767.0f;
+	constexpr float unorm16_max = 65535.0f;
+	constexpr size_t short_index_limit = size_t{ std::numeric_limits<uint16_t>::max() } + 1;
+
+	float sign_not_zero(float value)
+	{
+		return (value >= 0.0f) ? 1.0f : -1.0f;
+	}
+
+	// Same steps as the shader, so the CPU result is what the GPU sees up to float rounding
+	XMFLOAT3 decode_direction(int16_t x, int16_t y)
+	{
+		// snorm16 decode per D3D rules, -32768 maps to -1 as well
+		float u = std::max(static_cast<float>(x) / snorm16_max, -1.0f),
+		      v = std::max(static_cast<float>(y) / snorm16_max, -1.0f);
+
+		XMFLOAT3 d{ u, v, 1.0f - std::abs(u) - std::abs(v) };
+		if (d.z < 0.0f)
+		{
+			d.x = (1.0f - std::abs(v)) * sign_not_zero(u);
+			d.y = (1.0f - std::abs(u)) * sign_not_zero(v);
+		}
+
+		float length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+		return { d.x / length, d.y / length, d.z / length };
+	}
+
+	// Rounding each coordinate on its own is not always closest on the sphere,
+	// so the four neighbouring grid points are tried and the best one kept
+	void encode_direction(const XMFLOAT3 &position, int16_t &x, int16_t &y)
+	{
+		float sum = std::abs(position.x) + std::abs(position.y) + std::abs(position.z);
+		if (sum == 0.0f)
+		{
+			x = 0;
+			y = 0;
+			return;
+		}
+
+		float u = position.x / sum,
+		      v = position.y / sum;
+		if (position.z < 0.0f)
+		{
+			float fold_u = (1.0f - std::abs(v)) * sign_not_zero(u),
+			      fold_v = (1.0f - std::abs(u)) * sign_not_zero(v);
+			u = fold_u;
+			v = fold_v;
+		}
+
+		float length = std::sqrt(position.x * position.x + position.y * position.y + position.z * position.z);
+		XMFLOAT3 target{ position.x / length, position.y / length, position.z / length };
+
+		float base_u = std::floor(std::clamp(u, -1.0f, 1.0f) * snorm16_max),
+		      base_v = std::floor(std::clamp(v, -1.0f, 1.0f) * snorm16_max);
+
+		// Compared by distance, not dot product; at these angles a float dot product can't tell candidates apart
+		float best_distance = std::numeric_limits<float>::max();
+		for (float du : { 0.0f, 1.0f })
+		{
+			for (float dv : { 0.0f, 1.0f })
+			{
+				auto cx = static_cast<int16_t>(std::clamp(base_u + du, -snorm16_max, snorm16_max)),
+				     cy = static_cast<int16_t>(std::clamp(base_v + dv, -snorm16_max, snorm16_max));
+
+				auto d = decode_direction(cx, cy);
+				float dx = d.x - target.x,
+				      dy = d.y - target.y,
+				      dz = d.z - target.z;
+				float distance = dx * dx + dy * dy + dz * dz;
+				if (distance < best_distance)
+				{
+					best_distance = distance;
+					x = cx;
+					y = cy;
+				}
+			}
+		}
+	}
+}
+
+height_range planet_generator::make_height_range(float min_length, float max_length)
+{
+	assert(max_length > min_length);
+	return { min_length, max_length - min_length };
+}
+
+packed_vertex planet_generator::pack_vertex(const vertex &vertex_obj, const height_range &heights)
+{
+	auto &p = vertex_obj.position;
+
+	packed_vertex packed{};
+	encode_direction(p, packed.direction[0], packed.direction[1]);
+
+	float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+	float h = std::clamp((length - heights.base) / heights.scale, 0.0f, 1.0f);
+	packed.height = static_cast<uint16_t>(std::lround(h * unorm16_max));
+
+	return packed;
+}
+
+packed_mesh planet_generator::pack_mesh(const mesh &mesh_obj, const height_range &heights)
+{
+	packed_mesh packed{};
+	packed.heights = heights;
+
+	packed.verticies.resize(mesh_obj.verticies.size());
+	std::transform(mesh_obj.verticies.begin(), mesh_obj.verticies.end(),
+	               packed.verticies.begin(),
+	               [&](const vertex &v) { return pack_vertex(v, heights); });
+
+	if (mesh_obj.verticies.size() <= short_index_limit)
+	{
+		packed.short_indicies.assign(mesh_obj.indicies.begin(), mesh_obj.indicies.end());
+	}
+	else
+	{
+		packed.indicies = mesh_obj.indicies;
+	}
+
+	return packed;
+}
+
+XMFLOAT3 planet_generator::unpack_position(const packed_vertex &vertex_obj, const height_range &heights)
+{
+	auto d = decode_direction(vertex_obj.direction[0], vertex_obj.direction[1]);
+	float length = heights.base + (static_cast<float>(vertex_obj.height) / unorm16_max) * heights.scale;
+	return { d.x * length, d.y * length, d.z * length };
+}
+
+mesh planet_generator::unpack_mesh(const packed_mesh &mesh_obj)
+{
+	mesh unpacked{};
+
+	unpacked.verticies.resize(mesh_obj.verticies.size());
+	std::transform(mesh_obj.verticies.begin(), mesh_obj.verticies.end(),
+	               unpacked.verticies.begin(),
+	               [&](const packed_vertex &v) { return vertex{ unpack_position(v, mesh_obj.heights) }; });
+
+	if (not mesh_obj.short_indicies.empty())
+	{
+		unpacked.indicies.assign(mesh_obj.short_indicies.begin(), mesh_obj.short_indicies.end());
+	}
+	else
+	{
+		unpacked.indicies = mesh_obj.indicies;
+	}
+
+	return unpacked;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "mesh.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+namespace planet_generator
+{
+	// 8 byte vertex: direction from the planet center in octahedral mapping as two snorm16,
+	// and distance from the center as unorm16 within a height_range. Last 16 bits are unused,
+	// D3D has no 3 component 16 bit format.
+	struct packed_vertex
+	{
+		int16_t direction[2];
+		uint16_t height;
+		uint16_t reserved;
+	};
+
+	// Decoded distance from center is base + height / 65535 * scale
+	struct height_range
+	{
+		float base;
+		float scale;
+	};
+
+	// Largest angle, in radians, between a direction and its packed and decoded form
+	constexpr float packed_direction_tolerance = 5e-5f;
+
+	struct packed_mesh
+	{
+		height_range heights;
+		std::vector<packed_vertex> verticies;
+		std::vector<uint16_t> short_indicies;  // used when there are at most 65536 verticies
+		std::vector<uint32_t> indicies;        // used otherwise, only one of the two is ever filled
+	};
+
+	// Covers distances from the center in [min_length, max_length]
+	[[nodiscard]]
+	height_range make_height_range(float min_length, float max_length);
+
+	// Positions outside the height range are clamped into it
+	[[nodiscard]]
+	packed_vertex pack_vertex(const vertex &vertex_obj, const height_range &heights);
+
+	[[nodiscard]]
+	packed_mesh pack_mesh(const mesh &mesh_obj, const height_range &heights);
+
+	// CPU reference decoders; these match what the packed_position vertex shader does
+	[[nodiscard]]
+	DirectX::XMFLOAT3 unpack_position(const packed_vertex &vertex_obj, const height_range &heights);
+
+	[[nodiscard]]
+	mesh unpack_mesh(const packed_mesh &mesh_obj);
+}
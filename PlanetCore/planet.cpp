@@ -0,0 +1,536 @@
+#include "planet.h"
+#include "cube_sphere.h"
+#include "planet_kernel.h"
+#include "noise_graph.h"
+#include "thread_pool.h"
+#include "mesh.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <DirectXMath.h>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	mesh make_cube(float side_length)
+	{
+		float l = side_length / 2.0f;
+		float w = l;
+		float h = l;
+
+		return{
+			// Vertex List
+			{
+				// Front
+				{ { -l, -w, +h } }, //,{ 0.0f, 0.0f } },
+				{ { +l, -w, +h } }, //,{ 1.0f, 0.0f } },
+				{ { +l, +w, +h } }, //,{ 1.0f, 1.0f } },
+				{ { -l, +w, +h } }, //,{ 0.0f, 1.0f } },
+
+				// Bottom
+				{ { -l, -w, -h } }, //,{ 0.0f, 0.0f } },
+				{ { +l, -w, -h } }, //,{ 1.0f, 0.0f } },
+				{ { +l, -w, +h } }, //,{ 1.0f, 1.0f } },
+				{ { -l, -w, +h } }, //,{ 0.0f, 1.0f } },
+
+				// Right
+				{ { +l, -w, -h } }, //,{ 0.0f, 0.0f } },
+				{ { +l, +w, -h } }, //,{ 1.0f, 0.0f } },
+				{ { +l, +w, +h } }, //,{ 1.0f, 1.0f } },
+				{ { +l, -w, +h } }, //,{ 0.0f, 1.0f } },
+
+				// Left
+				{ { -l, -w, -h } }, //,{ 0.0f, 0.0f } },
+				{ { -l, -w, +h } }, //,{ 1.0f, 0.0f } },
+				{ { -l, +w, +h } }, //,{ 1.0f, 1.0f } },
+				{ { -l, +w, -h } }, //,{ 0.0f, 1.0f } },
+
+				// Back
+				{ { -l, -w, -h } }, //,{ 0.0f, 0.0f } },
+				{ { -l, +w, -h } }, //,{ 1.0f, 0.0f } },
+				{ { +l, +w, -h } }, //,{ 1.0f, 1.0f } },
+				{ { +l, -w, -h } }, //,{ 0.0f, 1.0f } },
+
+				// Top
+				{ { -l, +w, -h } }, //,{ 0.0f, 0.0f } },
+				{ { -l, +w, +h } }, //,{ 1.0f, 0.0f } },
+				{ { +l, +w, +h } }, //,{ 1.0f, 1.0f } },
+				{ { +l, +w, -h } }, //,{ 0.0f, 1.0f } },
+			},
+
+
+			// Index List
+			{
+				// Front
+				0, 1, 2, 0, 2, 3,
+				// Bottom
+				4, 5, 6, 4, 6, 7,
+				// Right
+				8, 9, 10, 8, 10, 11,
+				// Left
+				12, 13, 14, 12, 14, 15,
+				// Back
+				16, 17, 18, 16, 18, 19,
+				// Top
+				20, 21, 22, 20, 22, 23,
+			},
+			// No normals or meshlets
+			{},
+			{}
+		};
+	}
+
+	void subdivide_mesh(mesh &mesh_obj, uint8_t subdivisions)
+	{
+		if (subdivisions < 1)
+			return;
+
+		if (subdivisions > 1)
+			subdivide_mesh(mesh_obj, subdivisions - 1);
+
+		mesh new_mesh{};
+
+		size_t num_triangles = mesh_obj.indicies.size() / 3u;
+		for (size_t i{ 0 }; i < num_triangles; i++)
+		{
+			vertex v0 = mesh_obj.verticies[mesh_obj.indicies[i * 3]],
+				v1 = mesh_obj.verticies[mesh_obj.indicies[i * 3 + 1]],
+				v2 = mesh_obj.verticies[mesh_obj.indicies[i * 3 + 2]];
+
+			vertex m0, m1, m2;
+			m0 = {
+				{
+					0.5f * (v0.position.x + v1.position.x),
+					0.5f * (v0.position.y + v1.position.y),
+					0.5f * (v0.position.z + v1.position.z)
+				}/*,
+				{
+					0.5f * (v0.texCoord.x + v1.texCoord.x),
+					0.5f * (v0.texCoord.y + v1.texCoord.y)
+				}*/
+			};
+
+			m1 = {
+				{
+					0.5f * (v1.position.x + v2.position.x),
+					0.5f * (v1.position.y + v2.position.y),
+					0.5f * (v1.position.z + v2.position.z)
+				}/*,
+				{
+					0.5f * (v1.texCoord.x + v2.texCoord.x),
+					0.5f * (v1.texCoord.y + v2.texCoord.y)
+				}*/
+			};
+
+			m2 = {
+				{
+					0.5f * (v0.position.x + v2.position.x),
+					0.5f * (v0.position.y + v2.position.y),
+					0.5f * (v0.position.z + v2.position.z)
+				}/*,
+				{
+					0.5f * (v0.texCoord.x + v2.texCoord.x),
+					0.5f * (v0.texCoord.y + v2.texCoord.y)
+				}*/
+			};
+
+			new_mesh.verticies.insert(new_mesh.verticies.end(), {
+				v0, v1, v2, m0, m1, m2
+			});
+
+			uint32_t n = static_cast<uint32_t>(i) * 6u;
+			new_mesh.indicies.insert(new_mesh.indicies.end(), {
+				n + 0, n + 3, n + 5,
+				n + 3, n + 4, n + 5,
+				n + 5, n + 4, n + 2,
+				n + 3, n + 1, n + 4
+			});
+		}
+
+		std::swap(mesh_obj.verticies, new_mesh.verticies);
+		std::swap(mesh_obj.indicies, new_mesh.indicies);
+	}
+
+	vertex midpoint(const vertex &v0, const vertex &v1)
+	{
+		return {
+			{
+				0.5f * (v0.position.x + v1.position.x),
+				0.5f * (v0.position.y + v1.position.y),
+				0.5f * (v0.position.z + v1.position.z)
+			}
+		};
+	}
+
+	// Merge vertices with bitwise identical positions, so faces that meet at a seam
+	// share their corner vertices instead of each having a copy.
+	void weld_vertices(mesh &mesh_obj)
+	{
+		struct position_hash
+		{
+			size_t operator()(const DirectX::XMFLOAT3 &p) const
+			{
+				uint32_t bits[3]{};
+				std::memcpy(bits, &p, sizeof(bits));
+				return std::hash<uint64_t>{}((uint64_t{ bits[0] } << 32) ^ (uint64_t{ bits[1] } << 16) ^ bits[2]);
+			}
+		};
+
+		struct position_equal
+		{
+			bool operator()(const DirectX::XMFLOAT3 &a, const DirectX::XMFLOAT3 &b) const
+			{
+				return std::memcmp(&a, &b, sizeof(a)) == 0;
+			}
+		};
+
+		std::unordered_map<DirectX::XMFLOAT3, uint32_t, position_hash, position_equal> unique_positions;
+		unique_positions.reserve(mesh_obj.verticies.size());
+
+		std::vector<vertex> welded{};
+		std::vector<uint32_t> remap(mesh_obj.verticies.size());
+		for (size_t i{ 0 }; i < mesh_obj.verticies.size(); i++)
+		{
+			auto [it, inserted] = unique_positions.try_emplace(mesh_obj.verticies[i].position,
+			                                                   static_cast<uint32_t>(welded.size()));
+			if (inserted)
+				welded.push_back(mesh_obj.verticies[i]);
+
+			remap[i] = it->second;
+		}
+
+		for (auto &index : mesh_obj.indicies)
+			index = remap[index];
+
+		std::swap(mesh_obj.verticies, welded);
+	}
+
+	// Same split as subdivide_mesh, but each edge midpoint is created only once and
+	// shared by both triangles on that edge. Mesh must already be welded.
+	void subdivide_mesh_shared(mesh &mesh_obj, uint8_t subdivisions)
+	{
+		auto edge_key = [](uint32_t a, uint32_t b) -> uint64_t
+		{
+			if (a > b)
+				std::swap(a, b);
+			return (uint64_t{ a } << 32) | b;
+		};
+
+		std::unordered_map<uint64_t, uint32_t> edge_midpoints;
+
+		for (uint8_t level{ 0 }; level < subdivisions; level++)
+		{
+			size_t num_triangles = mesh_obj.indicies.size() / 3u;
+			size_t num_edges = (num_triangles * 3u) / 2u; // closed surface, each edge has two triangles
+
+			edge_midpoints.clear();
+			edge_midpoints.reserve(num_edges);
+			mesh_obj.verticies.reserve(mesh_obj.verticies.size() + num_edges);
+
+			auto get_midpoint = [&](uint32_t a, uint32_t b) -> uint32_t
+			{
+				auto [it, inserted] = edge_midpoints.try_emplace(edge_key(a, b),
+				                                                 static_cast<uint32_t>(mesh_obj.verticies.size()));
+				if (inserted)
+					mesh_obj.verticies.push_back(midpoint(mesh_obj.verticies[a], mesh_obj.verticies[b]));
+
+				return it->second;
+			};
+
+			std::vector<uint32_t> new_indicies{};
+			new_indicies.reserve(num_triangles * 12u);
+
+			for (size_t i{ 0 }; i < num_triangles; i++)
+			{
+				uint32_t v0 = mesh_obj.indicies[i * 3],
+				         v1 = mesh_obj.indicies[i * 3 + 1],
+				         v2 = mesh_obj.indicies[i * 3 + 2];
+
+				uint32_t m0 = get_midpoint(v0, v1),
+				         m1 = get_midpoint(v1, v2),
+				         m2 = get_midpoint(v0, v2);
+
+				new_indicies.insert(new_indicies.end(), {
+					v0, m0, m2,
+					m0, m1, m2,
+					m2, m1, v2,
+					m0, v1, m1
+				});
+			}
+
+			std::swap(mesh_obj.indicies, new_indicies);
+		}
+	}
+
+	// Work split used by the threaded paths. Splitting is the same with or without
+	// a pool, and each vertex is computed the same way either way.
+	constexpr uint32_t grid_tile_rows = 16;
+	constexpr size_t noise_tile_verticies = 4096;
+
+	// Writes vertex rows [first_row, last_row) of a face, and the quads that start on those rows.
+	// The rows are laid out on the cube, then projected and displaced while still in cache.
+	// Normals are written too if the mesh has room for them.
+	void make_grid_rows(mesh &mesh_obj, uint32_t face_index, uint32_t resolution, float radius, uint32_t first_row, uint32_t last_row, const height_sampler *sampler)
+	{
+		const auto &face = cube_faces[face_index];
+		float half_length = radius / std::sqrt(3.0f);
+		uint32_t row_length = resolution + 1;
+		size_t face_verticies = size_t{ row_length } * row_length;
+		size_t face_indicies = size_t{ resolution } * resolution * 6u;
+		uint32_t base = static_cast<uint32_t>(face_index * face_verticies);
+
+		auto *v_first = mesh_obj.verticies.data() + base + size_t{ first_row } * row_length;
+		auto *v_out = v_first;
+		for (uint32_t y{ first_row }; y < last_row; y++)
+		{
+			float v = grid_coordinate(y, resolution);
+			for (uint32_t x{ 0 }; x < row_length; x++)
+			{
+				float u = grid_coordinate(x, resolution);
+				(v_out++)->position = face_point(face, u, v, half_length);
+			}
+		}
+		auto *n_first = mesh_obj.normals.empty() ? nullptr : mesh_obj.normals.data() + (v_first - mesh_obj.verticies.data());
+		ensphere_verticies(v_first, v_out, radius, sampler, n_first);
+
+		auto *i_out = mesh_obj.indicies.data() + face_index * face_indicies + size_t{ first_row } * resolution * 6u;
+		for (uint32_t y{ first_row }; y < std::min(last_row, resolution); y++)
+		{
+			for (uint32_t x{ 0 }; x < resolution; x++)
+			{
+				uint32_t i00 = base + y * row_length + x,
+				         i10 = i00 + 1,
+				         i01 = i00 + row_length,
+				         i11 = i01 + 1;
+
+				*i_out++ = i00; *i_out++ = i10; *i_out++ = i11;
+				*i_out++ = i00; *i_out++ = i11; *i_out++ = i01;
+			}
+		}
+	}
+
+	void ensphere(mesh &mesh_obj, float radius)
+	{
+		auto *verticies = mesh_obj.verticies.data();
+		ensphere_verticies(verticies, verticies + mesh_obj.verticies.size(), radius, nullptr);
+	}
+
+	mesh make_grid_sphere(float radius, uint32_t resolution, const height_sampler *sampler, thread_pool *pool, bool with_normals)
+	{
+		assert(resolution > 0);
+
+		uint32_t row_length = resolution + 1;
+		size_t face_verticies = size_t{ row_length } * row_length;
+		size_t face_indicies = size_t{ resolution } * resolution * 6u;
+
+		mesh obj{};
+		obj.verticies.resize(face_verticies * cube_faces.size());
+		obj.indicies.resize(face_indicies * cube_faces.size());
+		if (with_normals)
+		{
+			obj.normals.resize(obj.verticies.size());
+		}
+
+		// Each tile is a band of rows on one face, and writes only its own part of the storage
+		size_t tiles_per_face = (row_length + grid_tile_rows - 1) / grid_tile_rows;
+		auto make_tile = [&](size_t tile)
+		{
+			uint32_t face = static_cast<uint32_t>(tile / tiles_per_face);
+			uint32_t first_row = static_cast<uint32_t>((tile % tiles_per_face) * grid_tile_rows);
+			uint32_t last_row = std::min(first_row + grid_tile_rows, row_length);
+
+			make_grid_rows(obj, face, resolution, radius, first_row, last_row, sampler);
+		};
+
+		size_t num_tiles = tiles_per_face * cube_faces.size();
+		if (pool)
+		{
+			pool->parallel_for(num_tiles, make_tile);
+		}
+		else
+		{
+			for (size_t tile{ 0 }; tile < num_tiles; tile++)
+				make_tile(tile);
+		}
+
+		return obj;
+	}
+}
+
+mesh planet_generator::generate_sphere(float size, uint8_t subdivisions, subdivision_mode mode)
+{
+	float cube_length = (2.0f * size) / std::sqrt(3.0f);
+
+	auto obj = make_cube(cube_length);
+	switch (mode)
+	{
+	case subdivision_mode::split_triangles:
+		subdivide_mesh(obj, subdivisions);
+		break;
+	case subdivision_mode::shared_vertices:
+		weld_vertices(obj);
+		subdivide_mesh_shared(obj, subdivisions);
+		break;
+	}
+	ensphere(obj, size);
+
+	return obj;
+}
+
+mesh planet_generator::generate_patch(float radius, const patch_id &patch, uint32_t resolution, float skirt_depth, noise_type type)
+{
+	auto sampler = make_height_sampler(noise_settings{ type });
+	return generate_patch(radius, patch, resolution, skirt_depth, *sampler);
+}
+
+mesh planet_generator::generate_patch(float radius, const patch_id &patch, uint32_t resolution, float skirt_depth, const height_sampler &heights)
+{
+	assert(resolution > 0 and patch.face < cube_faces.size());
+
+	const auto &face = cube_faces[patch.face];
+	float half_length = radius / std::sqrt(3.0f);
+	uint32_t row_length = resolution + 1;
+	uint32_t skirt_length = 4 * resolution;
+	uint32_t skirt_base = row_length * row_length;
+
+	// Patch verticies are addressed on the grid of the whole face at this depth,
+	// so shared edges between patches, at any depth, produce the same positions.
+	uint64_t face_resolution = uint64_t{ resolution } << patch.depth;
+	uint64_t x_offset = uint64_t{ patch.x } * resolution,
+	         y_offset = uint64_t{ patch.y } * resolution;
+
+	mesh obj{};
+	obj.verticies.resize(size_t{ skirt_base } + skirt_length);
+	obj.indicies.resize((size_t{ resolution } * resolution + skirt_length) * 6u);
+	obj.normals.resize(obj.verticies.size());
+
+	auto *v_out = obj.verticies.data();
+	for (uint32_t y{ 0 }; y < row_length; y++)
+	{
+		float v = grid_coordinate(y_offset + y, face_resolution);
+		for (uint32_t x{ 0 }; x < row_length; x++)
+		{
+			float u = grid_coordinate(x_offset + x, face_resolution);
+			(v_out++)->position = face_point(face, u, v, half_length);
+		}
+	}
+
+	ensphere_verticies(obj.verticies.data(), v_out, radius, &heights, obj.normals.data());
+
+	auto *i_out = obj.indicies.data();
+	for (uint32_t y{ 0 }; y < resolution; y++)
+	{
+		for (uint32_t x{ 0 }; x < resolution; x++)
+		{
+			uint32_t i00 = y * row_length + x,
+			         i10 = i00 + 1,
+			         i01 = i00 + row_length,
+			         i11 = i01 + 1;
+
+			*i_out++ = i00; *i_out++ = i10; *i_out++ = i11;
+			*i_out++ = i00; *i_out++ = i11; *i_out++ = i01;
+		}
+	}
+
+	// Skirt hangs down from the patch border, anti-clockwise when seen from outside,
+	// and hides cracks against neighbours at a different depth.
+	auto border_index = [&](uint32_t k) -> uint32_t
+	{
+		uint32_t side = k / resolution,
+		         step = k % resolution;
+		switch (side)
+		{
+		case 0: return step;                                               // bottom, +u
+		case 1: return step * row_length + resolution;                     // right, +v
+		case 2: return resolution * row_length + (resolution - step);      // top, -u
+		default: return (resolution - step) * row_length;                  // left, -v
+		}
+	};
+
+	float skirt_scale = 1.0f - skirt_depth / radius;
+	for (uint32_t k{ 0 }; k < skirt_length; k++)
+	{
+		const auto &p = obj.verticies[border_index(k)].position;
+		(v_out++)->position = { p.x * skirt_scale, p.y * skirt_scale, p.z * skirt_scale };
+		obj.normals[skirt_base + k] = obj.normals[border_index(k)];  // lit like the edge it hangs from
+
+		uint32_t a = border_index(k),
+		         b = border_index((k + 1) % skirt_length),
+		         s_a = skirt_base + k,
+		         s_b = skirt_base + (k + 1) % skirt_length;
+
+		*i_out++ = a; *i_out++ = s_a; *i_out++ = b;
+		*i_out++ = b; *i_out++ = s_a; *i_out++ = s_b;
+	}
+
+	return obj;
+}
+
+XMFLOAT3 planet_generator::patch_point(float radius, const patch_id &patch, float s, float t)
+{
+	assert(patch.face < cube_faces.size());
+
+	float patch_size = 2.0f / static_cast<float>(uint64_t{ 1 } << patch.depth);
+	float u = -1.0f + patch_size * (patch.x + s),
+	      v = -1.0f + patch_size * (patch.y + t);
+
+	auto p = face_point(cube_faces[patch.face], u, v, 1.0f);
+	XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&p));
+
+	XMFLOAT3 point{};
+	XMStoreFloat3(&point, n * radius);
+	return point;
+}
+
+mesh planet_generator::generate_grid_sphere(float size, uint32_t resolution, thread_pool *pool)
+{
+	return make_grid_sphere(size, resolution, nullptr, pool, false);
+}
+
+mesh planet_generator::generate_planet(float radius, uint32_t resolution, noise_type type, thread_pool *pool, bool with_normals)
+{
+	auto sampler = make_height_sampler(noise_settings{ type });
+	return make_grid_sphere(radius, resolution, sampler.get(), pool, with_normals);
+}
+
+mesh planet_generator::generate_planet(float radius, uint32_t resolution, const height_sampler &heights, thread_pool *pool, bool with_normals)
+{
+	return make_grid_sphere(radius, resolution, &heights, pool, with_normals);
+}
+
+std::unique_ptr<height_sampler> planet_generator::make_height_sampler(const noise_settings &noise)
+{
+	return make_noise_graph(noise).compile();
+}
+
+void planet_generator::layer_noise(noise_type type, mesh &mesh_obj, thread_pool *pool)
+{
+	auto sampler = make_height_sampler(noise_settings{ type });
+
+	auto *verticies = mesh_obj.verticies.data();
+	size_t vertex_count = mesh_obj.verticies.size();
+	size_t num_tiles = (vertex_count + noise_tile_verticies - 1) / noise_tile_verticies;
+	auto displace_tile = [&](size_t tile)
+	{
+		size_t first = tile * noise_tile_verticies;
+		size_t last = std::min(first + noise_tile_verticies, vertex_count);
+
+		displace_verticies(verticies + first, verticies + last, *sampler);
+	};
+
+	if (pool)
+	{
+		pool->parallel_for(num_tiles, displace_tile);
+	}
+	else
+	{
+		for (size_t tile{ 0 }; tile < num_tiles; tile++)
+			displace_tile(tile);
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <DirectXMath.h>
+
+namespace planet_generator
+{
+	struct mesh;
+	class thread_pool;
+	class height_sampler;
+
+	enum class subdivision_mode
+	{
+		split_triangles,    // every triangle gets its own 6 vertices, nothing is shared
+		shared_vertices     // edge midpoints and cube seams are shared between triangles
+	};
+
+	mesh generate_sphere(float size, uint8_t subdivisions, subdivision_mode mode = subdivision_mode::shared_vertices);
+
+	// Builds each cube face directly as a resolution x resolution quad grid, in one pass.
+	// Any resolution works; vertex count is 6 * (resolution + 1)^2.
+	// With a pool, faces are split into row tiles and built in parallel; output is identical either way.
+	mesh generate_grid_sphere(float size, uint32_t resolution, thread_pool *pool = nullptr);
+
+	// Presets for the noise graph a planet's height comes from, see make_noise_graph
+	enum class noise_type
+	{
+		simplex,        // one layer of simplex noise, with everything below 0 flattened to sea level
+		continents      // large continents, warped mountains inland and fine hills over both
+	};
+
+	// Noise is a function of direction only, so the same settings give the same terrain at any radius
+	struct noise_settings
+	{
+		noise_type type = noise_type::simplex;
+		int32_t seed = 1337;
+		float frequency = 100.0f;
+		float amplitude = 0.25f;
+	};
+
+	// Compiled make_noise_graph(noise)
+	[[nodiscard]]
+	std::unique_ptr<height_sampler> make_height_sampler(const noise_settings &noise);
+
+	void layer_noise(noise_type type, mesh &mesh_obj, thread_pool *pool = nullptr);
+
+	// generate_grid_sphere and layer_noise fused into one pass over the verticies.
+	// with_normals also fills mesh::normals, from the height gradient in that same pass.
+	mesh generate_planet(float radius, uint32_t resolution, noise_type type, thread_pool *pool = nullptr, bool with_normals = false);
+	mesh generate_planet(float radius, uint32_t resolution, const height_sampler &heights, thread_pool *pool = nullptr, bool with_normals = false);
+
+	// Square piece of a cube face, at quadtree depth; the face is split into 2^depth x 2^depth patches.
+	struct patch_id
+	{
+		uint8_t face;
+		uint8_t depth;
+		uint32_t x;
+		uint32_t y;
+	};
+
+	// Builds one patch as a resolution x resolution grid with noise, plus a skirt skirt_depth deep along its border.
+	// Always has normals.
+	mesh generate_patch(float radius, const patch_id &patch, uint32_t resolution, float skirt_depth, noise_type type);
+	mesh generate_patch(float radius, const patch_id &patch, uint32_t resolution, float skirt_depth, const height_sampler &heights);
+
+	// Point on the undisplaced sphere, for patch local coordinates s, t in [0, 1]
+	[[nodiscard]]
+	DirectX::XMFLOAT3 patch_point(float radius, const patch_id &patch, float s, float t);
+
+}
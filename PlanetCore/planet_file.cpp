@@ -0,0 +1,289 @@
+#include "planet_file.h"
+#include "planet_kernel.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace planet_generator;
+
+namespace
+{
+	constexpr char file_magic[4] = { 'P', 'L', 'N', 'T' };
+	// Also part of the hash, so files made by an older generator are never picked up.
+	// 2: heights come from simplex_noise instead of FastNoise.
+	constexpr uint32_t file_version = 2;
+
+	struct file_header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t hash;
+
+		float radius;
+		uint32_t resolution;
+		uint32_t noise_type;
+		int32_t noise_seed;
+		float noise_frequency;
+		float noise_amplitude;
+
+		uint64_t vertex_count;
+		uint64_t vertex_offset;
+		uint64_t index_count;
+		uint64_t index_offset;
+	};
+	static_assert(sizeof(file_header) == 72, "planet file header must not have padding");
+	static_assert(sizeof(vertex) == 3 * sizeof(float), "vertex is written to file as is");
+
+	size_t align_up(size_t value)
+	{
+		return (value + planet_file_alignment - 1) & ~(planet_file_alignment - 1);
+	}
+
+	// Each field is hashed on its own, so struct padding never reaches the hash
+	class fnv1a
+	{
+	public:
+		template <typename T>
+		void add(const T &value)
+		{
+			auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+			for (size_t i{ 0 }; i < sizeof(T); i++)
+			{
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+		}
+
+		uint64_t value() const
+		{
+			return hash;
+		}
+
+	private:
+		uint64_t hash = 14695981039346656037ull;
+	};
+
+	bool same_parameters(const planet_parameters &a, const planet_parameters &b)
+	{
+		return a.radius == b.radius
+		   and a.resolution == b.resolution
+		   and a.noise.type == b.noise.type
+		   and a.noise.seed == b.noise.seed
+		   and a.noise.frequency == b.noise.frequency
+		   and a.noise.amplitude == b.noise.amplitude;
+	}
+
+	// True if count items of item_size at offset fit in file_size
+	bool fits(uint64_t offset, uint64_t count, uint64_t item_size, uint64_t file_size)
+	{
+		if (offset % planet_file_alignment != 0 or offset > file_size)
+			return false;
+		return count <= (file_size - offset) / item_size;
+	}
+}
+
+uint64_t planet_generator::planet_hash(const planet_parameters &parameters)
+{
+	fnv1a hash{};
+	hash.add(file_version);
+	hash.add(parameters.radius);
+	hash.add(parameters.resolution);
+	hash.add(static_cast<uint32_t>(parameters.noise.type));
+	hash.add(parameters.noise.seed);
+	hash.add(parameters.noise.frequency);
+	hash.add(parameters.noise.amplitude);
+	return hash.value();
+}
+
+std::string planet_generator::planet_file_name(const planet_parameters &parameters)
+{
+	char name[40]{};
+	std::snprintf(name, sizeof(name), "planet_%016llx.planet", static_cast<unsigned long long>(planet_hash(parameters)));
+	return name;
+}
+
+bool planet_generator::write_planet_file(const std::string &file_path, const planet_parameters &parameters, const mesh &mesh_obj)
+{
+	file_header header{};
+	std::memcpy(header.magic, file_magic, sizeof(file_magic));
+	header.version = file_version;
+	header.hash = planet_hash(parameters);
+	header.radius = parameters.radius;
+	header.resolution = parameters.resolution;
+	header.noise_type = static_cast<uint32_t>(parameters.noise.type);
+	header.noise_seed = parameters.noise.seed;
+	header.noise_frequency = parameters.noise.frequency;
+	header.noise_amplitude = parameters.noise.amplitude;
+	header.vertex_count = mesh_obj.verticies.size();
+	header.vertex_offset = align_up(sizeof(file_header));
+	header.index_count = mesh_obj.indicies.size();
+	header.index_offset = align_up(header.vertex_offset + header.vertex_count * sizeof(vertex));
+
+	// Written under a temporary name and renamed, so a reader never maps a half written file
+	auto temp_path = file_path + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (not file)
+			return false;
+
+		const char padding[planet_file_alignment]{};
+		auto pad_to = [&](uint64_t offset)
+		{
+			auto position = static_cast<uint64_t>(file.tellp());
+			assert(position <= offset);
+			file.write(padding, static_cast<std::streamsize>(offset - position));
+		};
+
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		pad_to(header.vertex_offset);
+		file.write(reinterpret_cast<const char *>(mesh_obj.verticies.data()),
+		           static_cast<std::streamsize>(header.vertex_count * sizeof(vertex)));
+		pad_to(header.index_offset);
+		file.write(reinterpret_cast<const char *>(mesh_obj.indicies.data()),
+		           static_cast<std::streamsize>(header.index_count * sizeof(uint32_t)));
+
+		if (not file.flush())
+			return false;
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(temp_path, file_path, error);
+	if (error)
+	{
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+	return true;
+}
+
+std::unique_ptr<mapped_planet> mapped_planet::open(const std::string &file_path, const planet_parameters &parameters)
+{
+	// Constructor is private, so no make_unique
+	auto planet = std::unique_ptr<mapped_planet>(new mapped_planet());
+
+#ifdef _WIN32
+	auto file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+	planet->file_handle = file;
+
+	LARGE_INTEGER file_size{};
+	if (not GetFileSizeEx(file, &file_size) or file_size.QuadPart < static_cast<LONGLONG>(sizeof(file_header)))
+		return nullptr;
+
+	planet->mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (not planet->mapping_handle)
+		return nullptr;
+
+	planet->mapping = MapViewOfFile(planet->mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (not planet->mapping)
+		return nullptr;
+	planet->mapping_size = static_cast<size_t>(file_size.QuadPart);
+#else
+	auto file = ::open(file_path.c_str(), O_RDONLY);
+	if (file < 0)
+		return nullptr;
+
+	struct stat file_info{};
+	auto stat_result = fstat(file, &file_info);
+	if (stat_result != 0 or file_info.st_size < static_cast<off_t>(sizeof(file_header)))
+	{
+		close(file);
+		return nullptr;
+	}
+
+	auto *mapping = mmap(nullptr, static_cast<size_t>(file_info.st_size), PROT_READ, MAP_SHARED, file, 0);
+	close(file);    // mapping keeps its own reference to the file
+	if (mapping == MAP_FAILED)
+		return nullptr;
+
+	planet->mapping = mapping;
+	planet->mapping_size = static_cast<size_t>(file_info.st_size);
+#endif
+
+	// Mapping is page aligned, so the header can be read in place
+	auto *base = static_cast<const char *>(planet->mapping);
+	auto &header = *reinterpret_cast<const file_header *>(base);
+
+	if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 or header.version != file_version)
+		return nullptr;
+
+	planet->file_parameters.radius = header.radius;
+	planet->file_parameters.resolution = header.resolution;
+	planet->file_parameters.noise.type = static_cast<noise_type>(header.noise_type);
+	planet->file_parameters.noise.seed = header.noise_seed;
+	planet->file_parameters.noise.frequency = header.noise_frequency;
+	planet->file_parameters.noise.amplitude = header.noise_amplitude;
+
+	if (header.hash != planet_hash(parameters) or not same_parameters(planet->file_parameters, parameters))
+		return nullptr;
+
+	if (not fits(header.vertex_offset, header.vertex_count, sizeof(vertex), planet->mapping_size) or
+	    not fits(header.index_offset, header.index_count, sizeof(uint32_t), planet->mapping_size))
+		return nullptr;
+
+	planet->contents.verticies = reinterpret_cast<const vertex *>(base + header.vertex_offset);
+	planet->contents.vertex_count = static_cast<size_t>(header.vertex_count);
+	planet->contents.indicies = reinterpret_cast<const uint32_t *>(base + header.index_offset);
+	planet->contents.index_count = static_cast<size_t>(header.index_count);
+
+	return planet;
+}
+
+mapped_planet::~mapped_planet()
+{
+#ifdef _WIN32
+	if (mapping)
+		UnmapViewOfFile(mapping);
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	if (file_handle)
+		CloseHandle(file_handle);
+#else
+	if (mapping)
+		munmap(mapping, mapping_size);
+#endif
+}
+
+mesh_view mapped_planet::view() const
+{
+	return contents;
+}
+
+const planet_parameters &mapped_planet::parameters() const
+{
+	return file_parameters;
+}
+
+std::unique_ptr<mapped_planet> planet_generator::load_or_generate_planet(const std::string &cache_directory, const planet_parameters &parameters, thread_pool *pool)
+{
+	auto file_path = (std::filesystem::path(cache_directory) / planet_file_name(parameters)).string();
+
+	if (auto planet = mapped_planet::open(file_path, parameters); planet)
+		return planet;
+
+	auto heights = make_height_sampler(parameters.noise);
+	auto planet_mesh = generate_planet(parameters.radius, parameters.resolution, *heights, pool);
+
+	std::error_code error{};
+	std::filesystem::create_directories(cache_directory, error);
+	if (not write_planet_file(file_path, parameters, planet_mesh))
+		return nullptr;
+
+	return mapped_planet::open(file_path, parameters);
+}
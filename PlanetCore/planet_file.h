@@ -0,0 +1,77 @@
+#pragma once
+
+#include "planet.h"
+#include "mesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace planet_generator
+{
+	class thread_pool;
+
+	// Everything that decides the contents of a generated planet; a planet file is keyed by its hash
+	struct planet_parameters
+	{
+		float radius = 1.0f;
+		uint32_t resolution = 64;
+		noise_settings noise{};
+	};
+
+	// Stable across runs and platforms, and changes with the file format version
+	[[nodiscard]]
+	uint64_t planet_hash(const planet_parameters &parameters);
+
+	// "planet_<hash as 16 hex digits>.planet"
+	[[nodiscard]]
+	std::string planet_file_name(const planet_parameters &parameters);
+
+	// File layout, all little endian:
+	//   header with format version, parameters, their hash, and array counts and offsets
+	//   verticies, at the header's vertex offset
+	//   indicies, at the header's index offset
+	// Both offsets are multiples of planet_file_alignment, so a mapped file can be used in place.
+	constexpr size_t planet_file_alignment = 64;
+
+	[[nodiscard]]
+	bool write_planet_file(const std::string &file_path, const planet_parameters &parameters, const mesh &mesh_obj);
+
+	// Read-only memory mapping of a planet file. Verticies and indicies point into the mapping,
+	// and stay valid for the lifetime of this object.
+	class mapped_planet
+	{
+	public:
+		// Returns null if the file is missing, truncated, from another format version,
+		// or was generated with different parameters.
+		[[nodiscard]]
+		static std::unique_ptr<mapped_planet> open(const std::string &file_path, const planet_parameters &parameters);
+
+		~mapped_planet();
+
+		mapped_planet(const mapped_planet &) = delete;
+		mapped_planet &operator=(const mapped_planet &) = delete;
+
+		mesh_view view() const;
+		const planet_parameters &parameters() const;
+
+	private:
+		mapped_planet() = default;
+
+	private:
+		void *mapping = nullptr;
+		size_t mapping_size = 0;
+#ifdef _WIN32
+		void *file_handle = nullptr;
+		void *mapping_handle = nullptr;
+#endif
+
+		planet_parameters file_parameters{};
+		mesh_view contents{};
+	};
+
+	// Maps the planet file for these parameters from cache_directory, generating and writing it first if it isn't there.
+	// Returns null only if the file could not be written.
+	[[nodiscard]]
+	std::unique_ptr<mapped_planet> load_or_generate_planet(const std::string &cache_directory, const planet_parameters &parameters, thread_pool *pool = nullptr);
+}
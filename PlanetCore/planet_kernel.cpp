@@ -0,0 +1,167 @@
+#include "planet_kernel.h"
+#include "mesh.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	using namespace planet_generator::simd;
+
+	static_assert(lanes <= max_kernel_block);
+
+	// Block of verticies in SoA layout
+	struct alignas(32) vertex_block
+	{
+		float x[lanes];
+		float y[lanes];
+		float z[lanes];
+	};
+
+	// Short blocks are padded by repeating the last vertex, so the tail goes
+	// through the same vector code as everything else.
+	void gather(vertex_block &block, const vertex *first, size_t count)
+	{
+		for (size_t i{ 0 }; i < lanes; i++)
+		{
+			const auto &p = first[std::min(i, count - 1)].position;
+			block.x[i] = p.x;
+			block.y[i] = p.y;
+			block.z[i] = p.z;
+		}
+	}
+
+	void scatter(const vertex_block &block, vertex *first, size_t count)
+	{
+		for (size_t i{ 0 }; i < count; i++)
+		{
+			first[i].position = { block.x[i], block.y[i], block.z[i] };
+		}
+	}
+
+	void scatter(const vertex_block &block, XMFLOAT3 *first, size_t count)
+	{
+		for (size_t i{ 0 }; i < count; i++)
+		{
+			first[i] = { block.x[i], block.y[i], block.z[i] };
+		}
+	}
+
+	// One fused pass: normalize, sample height, scale out to base + height.
+	// When keep_length is set the base is each point's own length, otherwise it is radius.
+	//
+	// Surface is p(d) = (base + h(d)) * d over unit directions d, so its normal is
+	// d - t / (base + h), with t the part of grad h that is tangent to the sphere: g - (g . d) * d.
+	template <bool keep_length>
+	void process_verticies(vertex *first, vertex *last, float radius, const height_sampler *sampler, XMFLOAT3 *normals)
+	{
+		vertex_block block{}, sample_at{}, gradient{};
+		alignas(32) float height[lanes]{};
+
+		float_v base = splat(radius);
+
+		while (first < last)
+		{
+			size_t count = std::min(lanes, static_cast<size_t>(last - first));
+			gather(block, first, count);
+
+			float_v x = load(block.x),
+			        y = load(block.y),
+			        z = load(block.z);
+
+			float_v length = sqrt(add(add(mul(x, x), mul(y, y)), mul(z, z)));
+			float_v nx = div(x, length),
+			        ny = div(y, length),
+			        nz = div(z, length);
+
+			if constexpr (keep_length)
+			{
+				base = length;
+			}
+
+			float_v h = splat(0.0f);
+			bool has_gradient = false;
+			if (sampler)
+			{
+				store(sample_at.x, nx);
+				store(sample_at.y, ny);
+				store(sample_at.z, nz);
+				if (normals)
+				{
+					has_gradient = sampler->sample_gradient(sample_at.x, sample_at.y, sample_at.z, height,
+					                                        gradient.x, gradient.y, gradient.z, count);
+				}
+				if (not has_gradient)
+				{
+					sampler->sample(sample_at.x, sample_at.y, sample_at.z, height, count);
+				}
+
+				std::fill(height + count, height + lanes, 0.0f);
+				h = load(height);
+			}
+
+			float_v scale = add(base, h);
+			store(block.x, mul(nx, scale));
+			store(block.y, mul(ny, scale));
+			store(block.z, mul(nz, scale));
+
+			scatter(block, first, count);
+
+			if (normals)
+			{
+				float_v mx = nx,
+				        my = ny,
+				        mz = nz;
+				if (has_gradient)
+				{
+					// Padding lanes hold whatever the sampler left there; they are never scattered
+					float_v gx = load(gradient.x),
+					        gy = load(gradient.y),
+					        gz = load(gradient.z);
+					float_v radial = add(add(mul(gx, nx), mul(gy, ny)), mul(gz, nz));
+
+					mx = sub(nx, div(sub(gx, mul(radial, nx)), scale));
+					my = sub(ny, div(sub(gy, mul(radial, ny)), scale));
+					mz = sub(nz, div(sub(gz, mul(radial, nz)), scale));
+
+					float_v normal_length = sqrt(add(add(mul(mx, mx), mul(my, my)), mul(mz, mz)));
+					mx = div(mx, normal_length);
+					my = div(my, normal_length);
+					mz = div(mz, normal_length);
+				}
+
+				store(block.x, mx);
+				store(block.y, my);
+				store(block.z, mz);
+				scatter(block, normals, count);
+				normals += count;
+			}
+
+			first += count;
+		}
+	}
+}
+
+bool height_sampler::sample_gradient(const float *, const float *, const float *, float *, float *, float *, float *, size_t) const
+{
+	return false;
+}
+
+void planet_generator::ensphere_verticies(vertex *first, vertex *last, float radius, const height_sampler *sampler, XMFLOAT3 *normals)
+{
+	process_verticies<false>(first, last, radius, sampler, normals);
+}
+
+void planet_generator::displace_verticies(vertex *first, vertex *last, const height_sampler &sampler, XMFLOAT3 *normals)
+{
+	process_verticies<true>(first, last, 0.0f, &sampler, normals);
+}
+
+const char *planet_generator::kernel_instruction_set()
+{
+	return simd::instruction_set;
+}
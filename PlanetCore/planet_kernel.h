@@ -0,0 +1,39 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+
+namespace planet_generator
+{
+	struct vertex;
+
+	// Supplies terrain height for a block of unit directions, given as separate x, y, z arrays.
+	// Called once per block so the cost of the virtual call is spread over the whole block.
+	class height_sampler
+	{
+	public:
+		virtual ~height_sampler() = default;
+
+		virtual void sample(const float *x, const float *y, const float *z, float *height, size_t count) const = 0;
+
+		// Height and its analytic gradient with respect to x, y, z, in one evaluation.
+		// Returns false, and writes nothing, if this sampler has no gradient.
+		virtual bool sample_gradient(const float *x, const float *y, const float *z, float *height,
+		                             float *gradient_x, float *gradient_y, float *gradient_z, size_t count) const;
+	};
+
+	// Number of verticies processed together; blocks handed to height_sampler are never larger.
+	constexpr size_t max_kernel_block = 8;
+
+	// Normalizes each position, places it at radius + height along that direction.
+	// Sampler may be null for a plain sphere.
+	// With normals, also writes the surface normal of each vertex there, from the sampler's gradient;
+	// samplers without a gradient give the sphere normal.
+	void ensphere_verticies(vertex *first, vertex *last, float radius, const height_sampler *sampler, DirectX::XMFLOAT3 *normals = nullptr);
+
+	// Moves each position along its own direction by the sampled height, keeping its current length as base.
+	void displace_verticies(vertex *first, vertex *last, const height_sampler &sampler, DirectX::XMFLOAT3 *normals = nullptr);
+
+	// Name of the instruction set the kernel was compiled for; "avx2", "sse4.1", "sse2" or "scalar".
+	const char *kernel_instruction_set();
+}
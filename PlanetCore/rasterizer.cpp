@@ -0,0 +1,758 @@
+#include "rasterizer.h"
+#include "thread_pool.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	using namespace planet_generator::simd;
+
+	// Triangles one task sets up and bins, and verticies one task transforms
+	constexpr size_t chunk_triangles = 16384;
+	constexpr size_t vertex_block = 16384;
+
+	// Binned triangles are kept until flush; past this many a draw flushes on its own, to bound memory
+	constexpr size_t max_binned_triangles = 1u << 21;
+
+	// Triangles are only clipped against x and y this far outside the viewport, in NDC units,
+	// which keeps screen coordinates small enough for exact edge setup.
+	constexpr float guard_band = 2.0f;
+
+	enum clip_bits : uint32_t
+	{
+		clip_near = 1,
+		clip_far = 2,
+		clip_left = 4,
+		clip_right = 8,
+		clip_bottom = 16,
+		clip_top = 32,
+
+		not_projected = 64      // made by clipping, screen position not worked out yet
+	};
+
+	// Most corners a triangle can have after clipping against all six planes
+	constexpr size_t max_corners = 9;
+
+	// Distance inside the plane, >= 0 when inside
+	template <typename clip_vertex_t>
+	float plane_distance(uint32_t plane, const clip_vertex_t &v)
+	{
+		switch (plane)
+		{
+		case clip_near:     return v.z;
+		case clip_far:      return v.w - v.z;
+		case clip_left:     return v.x + guard_band * v.w;
+		case clip_right:    return guard_band * v.w - v.x;
+		case clip_bottom:   return v.y + guard_band * v.w;
+		default:            return guard_band * v.w - v.y;
+		}
+	}
+
+	template <typename clip_vertex_t>
+	clip_vertex_t lerp(const clip_vertex_t &a, const clip_vertex_t &b, float t)
+	{
+		clip_vertex_t v{};
+		v.x = a.x + (b.x - a.x) * t;
+		v.y = a.y + (b.y - a.y) * t;
+		v.z = a.z + (b.z - a.z) * t;
+		v.w = a.w + (b.w - a.w) * t;
+		v.shade = a.shade + (b.shade - a.shade) * t;
+		v.outside = not_projected;
+		return v;
+	}
+
+	// Sutherland-Hodgman against the planes in code; returns the corner count, in place
+	template <typename clip_vertex_t>
+	size_t clip_polygon(clip_vertex_t *corners, size_t count, uint32_t code)
+	{
+		clip_vertex_t clipped[max_corners];
+		for (uint32_t plane{ clip_near }; plane <= clip_top and count >= 3; plane <<= 1)
+		{
+			if (not (code & plane))
+				continue;
+
+			size_t out_count{ 0 };
+			for (size_t i{ 0 }; i < count; i++)
+			{
+				const auto &current = corners[i];
+				const auto &next = corners[(i + 1) % count];
+				float d_current = plane_distance(plane, current);
+				float d_next = plane_distance(plane, next);
+
+				if (d_current >= 0.0f)
+					clipped[out_count++] = current;
+				// Always from the inside corner, so an edge two triangles share is cut at the same point
+				if ((d_current >= 0.0f) != (d_next >= 0.0f))
+				{
+					clipped[out_count++] = (d_current >= 0.0f) ? lerp(current, next, d_current / (d_current - d_next))
+					                                           : lerp(next, current, d_next / (d_next - d_current));
+				}
+			}
+
+			std::copy(clipped, clipped + out_count, corners);
+			count = out_count;
+		}
+		return count;
+	}
+
+	// Rounds to the nearest 1/256 pixel with adds alone, the same way in SIMD and scalar code;
+	// exact while |coordinate| < 2^15, which the guard band keeps it under
+	constexpr float snap_steps = 256.0f;
+	constexpr float snap_magic = 12582912.0f;  // 1.5 * 2^23
+
+	float snap(float coordinate)
+	{
+		return ((coordinate * snap_steps + snap_magic) - snap_magic) * (1.0f / snap_steps);
+	}
+
+	uint32_t pack_color(const float color[3], float shade)
+	{
+		shade = std::clamp(shade, 0.0f, 1.0f);
+		auto channel = [shade](float c)
+		{
+			return static_cast<uint32_t>(std::clamp(c * shade, 0.0f, 1.0f) * 255.0f + 0.5f);
+		};
+		return channel(color[0]) | (channel(color[1]) << 8) | (channel(color[2]) << 16) | 0xff000000u;
+	}
+
+	// Edge function A * x + B * y + C, positive inside a clockwise triangle.
+	// Computed the same way for both triangles that share the edge, with every sign flipped exactly,
+	// so their tests add up to one: pixels on the edge go to the triangle for which it is a top or left edge.
+	struct edge_function
+	{
+		float a, b, c;
+		bool inclusive;
+	};
+
+	edge_function make_edge(float px, float py, float qx, float qy)
+	{
+		edge_function e{};
+		e.a = py - qy;
+		e.b = qx - px;
+		e.c = static_cast<float>(static_cast<double>(px) * qy - static_cast<double>(py) * qx);
+		e.inclusive = e.a > 0.0f or (e.a == 0.0f and e.b > 0.0f);
+		return e;
+	}
+
+	// Value across the triangle that changes linearly in screen space: v = x_step * x + y_step * y + origin
+	struct plane_function
+	{
+		float x_step, y_step, origin;
+	};
+
+	// inverse_area is 1 / ((x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0)), shared by a triangle's planes
+	plane_function make_plane(const float x[3], const float y[3], const float v[3], double inverse_area)
+	{
+		double e1x = x[1] - x[0], e1y = y[1] - y[0];
+		double e2x = x[2] - x[0], e2y = y[2] - y[0];
+		double dv1 = v[1] - v[0], dv2 = v[2] - v[0];
+
+		double x_step = (dv1 * e2y - dv2 * e1y) * inverse_area;
+		double y_step = (dv2 * e1x - dv1 * e2x) * inverse_area;
+		return { static_cast<float>(x_step),
+		         static_cast<float>(y_step),
+		         static_cast<float>(v[0] - x_step * x[0] - y_step * y[0]) };
+	}
+}
+
+rasterizer::rasterizer(uint32_t width_, uint32_t height_, thread_pool *pool_) :
+	pool(pool_)
+{
+	resize(width_, height_);
+}
+
+rasterizer::~rasterizer() = default;
+
+void rasterizer::resize(uint32_t width_, uint32_t height_)
+{
+	assert(width_ > 0 and height_ > 0 and width_ <= INT16_MAX and height_ <= INT16_MAX);
+
+	target_width = width_;
+	target_height = height_;
+	tiles_x = (width_ + tile_size - 1) / tile_size;
+	tiles_y = (height_ + tile_size - 1) / tile_size;
+
+	color_buffer.assign(size_t{ width_ } * height_, 0);
+	depth_buffer.assign(size_t{ width_ } * height_ + lanes, 1.0f);
+
+	chunk_count = 0;
+	binned_since_flush = 0;
+	draws.clear();
+}
+
+void rasterizer::clear(const float color[4], float depth)
+{
+	float rgb[3]{ color[0], color[1], color[2] };
+	auto packed = (pack_color(rgb, 1.0f) & 0x00ffffffu) |
+	              (static_cast<uint32_t>(std::clamp(color[3], 0.0f, 1.0f) * 255.0f + 0.5f) << 24);
+
+	std::fill(color_buffer.begin(), color_buffer.end(), packed);
+	std::fill(depth_buffer.begin(), depth_buffer.end(), depth);
+
+	chunk_count = 0;
+	binned_since_flush = 0;
+	draws.clear();
+}
+
+void rasterizer::draw(FXMMATRIX object_to_clip,
+                      const vertex *verticies, size_t vertex_count,
+                      const uint32_t *indicies, size_t index_count,
+                      const XMFLOAT3 *normals,
+                      const draw_settings &settings,
+                      const index_range *ranges, size_t range_count)
+{
+	if (vertex_count == 0 or index_count == 0)
+		return;
+
+	if (ranges and range_count > 0)
+	{
+		gathered_indicies.clear();
+		for (size_t r{ 0 }; r < range_count; r++)
+		{
+			assert(size_t{ ranges[r].first_index } + ranges[r].index_count <= index_count);
+			gathered_indicies.insert(gathered_indicies.end(),
+			                         indicies + ranges[r].first_index,
+			                         indicies + ranges[r].first_index + ranges[r].index_count);
+		}
+		indicies = gathered_indicies.data();
+		index_count = gathered_indicies.size();
+	}
+
+	auto draw_index = static_cast<uint32_t>(draws.size());
+	draws.push_back({ settings.fill, settings.depth, { settings.color.x, settings.color.y, settings.color.z } });
+
+	transform_verticies(object_to_clip, verticies, vertex_count, normals, settings);
+
+	// Each chunk keeps its own bins, and tiles read chunks in order, so draw order survives binning in parallel
+	size_t triangle_count = index_count / 3;
+	size_t first_chunk = chunk_count;
+	size_t new_chunks = (triangle_count + chunk_triangles - 1) / chunk_triangles;
+	chunk_count += new_chunks;
+	while (chunks.size() < chunk_count)
+	{
+		chunks.push_back(std::make_unique<bin_chunk>());
+	}
+
+	run(new_chunks, [&](size_t c)
+	{
+		size_t first = c * chunk_triangles;
+		size_t count = std::min(chunk_triangles, triangle_count - first);
+		bin_triangles(*chunks[first_chunk + c], indicies + first * 3, count, settings.cull, draw_index);
+	});
+
+	for (size_t c{ first_chunk }; c < chunk_count; c++)
+	{
+		const auto &counts = chunks[c]->counts;
+		frame_stats.triangles += counts.triangles;
+		frame_stats.culled += counts.culled;
+		frame_stats.clipped += counts.clipped;
+		frame_stats.binned += counts.binned;
+		frame_stats.tile_entries += counts.tile_entries;
+		binned_since_flush += counts.binned;
+	}
+
+	if (binned_since_flush > max_binned_triangles)
+		flush();
+}
+
+void rasterizer::flush()
+{
+	if (chunk_count > 0)
+	{
+		run(size_t{ tiles_x } * tiles_y, [&](size_t tile)
+		{
+			fill_tile(static_cast<uint32_t>(tile));
+		});
+	}
+
+	chunk_count = 0;
+	binned_since_flush = 0;
+	draws.clear();
+}
+
+uint32_t rasterizer::width() const
+{
+	return target_width;
+}
+
+uint32_t rasterizer::height() const
+{
+	return target_height;
+}
+
+const uint32_t *rasterizer::pixels() const
+{
+	return color_buffer.data();
+}
+
+const float *rasterizer::depth() const
+{
+	return depth_buffer.data();
+}
+
+bool rasterizer::write_image(const std::string &path) const
+{
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (not file.is_open())
+		return false;
+
+	file << "P6\n" << target_width << " " << target_height << "\n255\n";
+
+	std::vector<uint8_t> row(size_t{ target_width } * 3);
+	for (uint32_t y{ 0 }; y < target_height; y++)
+	{
+		const auto *source = color_buffer.data() + size_t{ y } * target_width;
+		for (uint32_t x{ 0 }; x < target_width; x++)
+		{
+			row[x * 3 + 0] = static_cast<uint8_t>(source[x]);
+			row[x * 3 + 1] = static_cast<uint8_t>(source[x] >> 8);
+			row[x * 3 + 2] = static_cast<uint8_t>(source[x] >> 16);
+		}
+		file.write(reinterpret_cast<const char *>(row.data()), row.size());
+	}
+
+	return file.good();
+}
+
+const rasterizer::statistics &rasterizer::stats() const
+{
+	return frame_stats;
+}
+
+void rasterizer::reset_stats()
+{
+	frame_stats = {};
+}
+
+// The position.vs chain, pos * transform * view * projection, folded into one matrix and run lanes verticies at a time
+void rasterizer::transform_verticies(FXMMATRIX object_to_clip, const vertex *verticies, size_t vertex_count,
+                                     const XMFLOAT3 *normals, const draw_settings &settings)
+{
+	if (transformed.size() < vertex_count)
+		transformed.resize(vertex_count);
+
+	XMFLOAT4X4 m{};
+	XMStoreFloat4x4(&m, object_to_clip);
+
+	XMFLOAT3 light{};
+	XMStoreFloat3(&light, XMVector3Normalize(XMLoadFloat3(&settings.light_direction)));
+	float ambient = settings.ambient;
+
+	size_t blocks = (vertex_count + vertex_block - 1) / vertex_block;
+	run(blocks, [&](size_t block)
+	{
+		float_v row[4][4];
+		for (size_t r{ 0 }; r < 4; r++)
+		{
+			for (size_t c{ 0 }; c < 4; c++)
+			{
+				row[r][c] = splat(m.m[r][c]);
+			}
+		}
+		auto light_x = splat(light.x), light_y = splat(light.y), light_z = splat(light.z);
+		auto zero = splat(0.0f), one = splat(1.0f), half = splat(0.5f);
+		auto ambient_v = splat(ambient), diffuse_v = splat(1.0f - ambient);
+		auto guard = splat(guard_band), guard_negative = splat(-guard_band);
+		auto width_v = splat(static_cast<float>(target_width)), height_v = splat(static_cast<float>(target_height));
+		auto steps = splat(snap_steps), inverse_steps = splat(1.0f / snap_steps), magic = splat(snap_magic);
+
+		size_t first = block * vertex_block;
+		size_t last = std::min(first + vertex_block, vertex_count);
+		for (size_t i{ first }; i < last; i += lanes)
+		{
+			size_t count = std::min(lanes, last - i);
+
+			alignas(32) float in_x[lanes]{}, in_y[lanes]{}, in_z[lanes]{};
+			alignas(32) float out[8][lanes];
+			for (size_t l{ 0 }; l < count; l++)
+			{
+				in_x[l] = verticies[i + l].position.x;
+				in_y[l] = verticies[i + l].position.y;
+				in_z[l] = verticies[i + l].position.z;
+			}
+
+			auto x = load(in_x), y = load(in_y), z = load(in_z);
+			float_v clip[4];
+			for (size_t c{ 0 }; c < 4; c++)
+			{
+				clip[c] = add(add(mul(x, row[0][c]), mul(y, row[1][c])), add(mul(z, row[2][c]), row[3][c]));
+				store(out[c], clip[c]);
+			}
+
+			if (normals)
+			{
+				for (size_t l{ 0 }; l < count; l++)
+				{
+					in_x[l] = normals[i + l].x;
+					in_y[l] = normals[i + l].y;
+					in_z[l] = normals[i + l].z;
+				}
+				auto n_dot_l = add(add(mul(load(in_x), light_x), mul(load(in_y), light_y)), mul(load(in_z), light_z));
+				store(out[4], add(ambient_v, mul(max(n_dot_l, zero), diffuse_v)));
+			}
+			else
+			{
+				std::fill(out[4], out[4] + lanes, 1.0f);
+			}
+
+			// Which planes each vertex is outside of, the same tests plane_distance makes
+			auto guard_w = mul(guard, clip[3]), guard_w_negative = mul(guard_negative, clip[3]);
+			uint32_t outside[6]{ mask_bits(less(clip[2], zero)),
+			                     mask_bits(less(clip[3], clip[2])),
+			                     mask_bits(less(clip[0], guard_w_negative)),
+			                     mask_bits(less(guard_w, clip[0])),
+			                     mask_bits(less(clip[1], guard_w_negative)),
+			                     mask_bits(less(guard_w, clip[1])) };
+
+			// Screen position, snapped; garbage where w <= 0, but such verticies are outside the near plane
+			auto inverse_w = div(one, clip[3]);
+			auto screen_x = mul(add(mul(mul(clip[0], inverse_w), half), half), width_v);
+			auto screen_y = mul(sub(half, mul(mul(clip[1], inverse_w), half)), height_v);
+			store(out[5], mul(sub(add(mul(screen_x, steps), magic), magic), inverse_steps));
+			store(out[6], mul(sub(add(mul(screen_y, steps), magic), magic), inverse_steps));
+			store(out[7], mul(clip[2], inverse_w));
+
+			for (size_t l{ 0 }; l < count; l++)
+			{
+				uint32_t code{ 0 };
+				for (uint32_t plane{ 0 }; plane < 6; plane++)
+				{
+					code |= ((outside[plane] >> l) & 1u) << plane;
+				}
+				transformed[i + l] = { out[0][l], out[1][l], out[2][l], out[3][l], out[4][l],
+				                       out[5][l], out[6][l], out[7][l], code };
+			}
+		}
+	});
+}
+
+void rasterizer::bin_triangles(bin_chunk &chunk, const uint32_t *indicies, size_t triangle_count, cull_mode cull, uint32_t draw)
+{
+	chunk.triangles.clear();
+	chunk.counts = {};
+
+	for (size_t t{ 0 }; t < triangle_count; t++)
+	{
+		clip_vertex corners[max_corners];
+		corners[0] = transformed[indicies[t * 3 + 0]];
+		corners[1] = transformed[indicies[t * 3 + 1]];
+		corners[2] = transformed[indicies[t * 3 + 2]];
+		chunk.counts.triangles++;
+
+		auto code_a = corners[0].outside, code_b = corners[1].outside, code_c = corners[2].outside;
+		if (code_a & code_b & code_c)
+		{
+			chunk.counts.culled++;
+			continue;
+		}
+
+		size_t corner_count{ 3 };
+		if (code_a | code_b | code_c)
+		{
+			chunk.counts.clipped++;
+			corner_count = clip_polygon(corners, corner_count, code_a | code_b | code_c);
+		}
+
+		auto before = chunk.triangles.size();
+		if (corner_count >= 3)
+			setup_triangle(chunk, corners, corner_count, cull, draw);
+		if (chunk.triangles.size() == before)
+			chunk.counts.culled++;
+	}
+
+	// Counting sort of the triangles into the tiles each may cover
+	size_t tile_count = size_t{ tiles_x } * tiles_y;
+	chunk.tile_start.assign(tile_count + 1, 0);
+	for (const auto &triangle : chunk.triangles)
+	{
+		for (int32_t ty{ triangle.y0 / int32_t{ tile_size } }; ty <= (triangle.y1 - 1) / int32_t{ tile_size }; ty++)
+		{
+			for (int32_t tx{ triangle.x0 / int32_t{ tile_size } }; tx <= (triangle.x1 - 1) / int32_t{ tile_size }; tx++)
+			{
+				chunk.tile_start[ty * tiles_x + tx + 1]++;
+			}
+		}
+	}
+	for (size_t tile{ 0 }; tile < tile_count; tile++)
+	{
+		chunk.tile_start[tile + 1] += chunk.tile_start[tile];
+	}
+
+	chunk.tile_entries.resize(chunk.tile_start[tile_count]);
+	for (uint32_t index{ 0 }; index < chunk.triangles.size(); index++)
+	{
+		const auto &triangle = chunk.triangles[index];
+		for (int32_t ty{ triangle.y0 / int32_t{ tile_size } }; ty <= (triangle.y1 - 1) / int32_t{ tile_size }; ty++)
+		{
+			for (int32_t tx{ triangle.x0 / int32_t{ tile_size } }; tx <= (triangle.x1 - 1) / int32_t{ tile_size }; tx++)
+			{
+				chunk.tile_entries[chunk.tile_start[ty * tiles_x + tx]++] = index;
+			}
+		}
+	}
+	// Filling moved each start to the next tile's; move them back
+	for (size_t tile{ tile_count }; tile > 0; tile--)
+	{
+		chunk.tile_start[tile] = chunk.tile_start[tile - 1];
+	}
+	chunk.tile_start[0] = 0;
+
+	chunk.counts.binned = chunk.triangles.size();
+	chunk.counts.tile_entries = chunk.tile_entries.size();
+}
+
+void rasterizer::setup_triangle(bin_chunk &chunk, const clip_vertex *corners, size_t corner_count, cull_mode cull, uint32_t draw)
+{
+	float sx[max_corners], sy[max_corners], sz[max_corners];
+	for (size_t i{ 0 }; i < corner_count; i++)
+	{
+		if (corners[i].w <= 0.0f)
+			return;
+
+		float inverse_w = 1.0f / corners[i].w;
+		sx[i] = snap((corners[i].x * inverse_w * 0.5f + 0.5f) * target_width);
+		sy[i] = snap((0.5f - corners[i].y * inverse_w * 0.5f) * target_height);
+		sz[i] = corners[i].z * inverse_w;
+	}
+
+	bool wireframe = draws[draw].fill == fill_mode::wireframe;
+
+	// Clipped polygons are convex, so a fan keeps the winding of the triangle they came from
+	for (size_t i{ 1 }; i + 1 < corner_count; i++)
+	{
+		size_t a{ 0 }, b{ i }, c{ i + 1 };
+
+		// Exact for snapped coordinates; positive is clockwise on screen, with y pointing down
+		double area = (static_cast<double>(sx[b]) - sx[a]) * (static_cast<double>(sy[c]) - sy[a]) -
+		              (static_cast<double>(sy[b]) - sy[a]) * (static_cast<double>(sx[c]) - sx[a]);
+		if (area == 0.0 or
+		    (cull == cull_mode::clockwise and area > 0.0) or
+		    (cull == cull_mode::anti_clockwise and area < 0.0))
+			continue;
+
+		if (area < 0.0)
+			std::swap(b, c);
+
+		float min_x = std::min({ sx[a], sx[b], sx[c] }), max_x = std::max({ sx[a], sx[b], sx[c] });
+		float min_y = std::min({ sy[a], sy[b], sy[c] }), max_y = std::max({ sy[a], sy[b], sy[c] });
+
+		// Pixel centres inside the bounds; lines also light pixels whose centre they only pass near
+		int32_t x0, x1, y0, y1;
+		if (wireframe)
+		{
+			x0 = static_cast<int32_t>(std::floor(min_x));
+			x1 = static_cast<int32_t>(std::floor(max_x)) + 1;
+			y0 = static_cast<int32_t>(std::floor(min_y));
+			y1 = static_cast<int32_t>(std::floor(max_y)) + 1;
+		}
+		else
+		{
+			x0 = static_cast<int32_t>(std::ceil(min_x - 0.5f));
+			x1 = static_cast<int32_t>(std::floor(max_x - 0.5f)) + 1;
+			y0 = static_cast<int32_t>(std::ceil(min_y - 0.5f));
+			y1 = static_cast<int32_t>(std::floor(max_y - 0.5f)) + 1;
+		}
+		x0 = std::max(x0, 0);
+		y0 = std::max(y0, 0);
+		x1 = std::min(x1, static_cast<int32_t>(target_width));
+		y1 = std::min(y1, static_cast<int32_t>(target_height));
+		if (x0 >= x1 or y0 >= y1)
+			continue;
+
+		binned_triangle triangle{};
+		size_t order[3]{ a, b, c };
+		for (size_t v{ 0 }; v < 3; v++)
+		{
+			triangle.x[v] = sx[order[v]];
+			triangle.y[v] = sy[order[v]];
+			triangle.z[v] = sz[order[v]];
+			triangle.shade[v] = corners[order[v]].shade;
+		}
+		triangle.x0 = static_cast<int16_t>(x0);
+		triangle.y0 = static_cast<int16_t>(y0);
+		triangle.x1 = static_cast<int16_t>(x1);
+		triangle.y1 = static_cast<int16_t>(y1);
+		triangle.draw = draw;
+		chunk.triangles.push_back(triangle);
+	}
+}
+
+void rasterizer::fill_tile(uint32_t tile)
+{
+	int32_t x0 = static_cast<int32_t>((tile % tiles_x) * tile_size);
+	int32_t y0 = static_cast<int32_t>((tile / tiles_x) * tile_size);
+	int32_t x1 = std::min(x0 + static_cast<int32_t>(tile_size), static_cast<int32_t>(target_width));
+	int32_t y1 = std::min(y0 + static_cast<int32_t>(tile_size), static_cast<int32_t>(target_height));
+
+	for (size_t c{ 0 }; c < chunk_count; c++)
+	{
+		const auto &chunk = *chunks[c];
+		for (auto entry{ chunk.tile_start[tile] }; entry < chunk.tile_start[tile + 1]; entry++)
+		{
+			const auto &triangle = chunk.triangles[chunk.tile_entries[entry]];
+			if (draws[triangle.draw].fill == fill_mode::wireframe)
+				draw_edges(triangle, x0, y0, x1, y1);
+			else
+				fill_triangle(triangle, x0, y0, x1, y1);
+		}
+	}
+}
+
+void rasterizer::fill_triangle(const binned_triangle &triangle, int32_t tile_x0, int32_t tile_y0, int32_t tile_x1, int32_t tile_y1)
+{
+	int32_t x0 = std::max<int32_t>(tile_x0, triangle.x0), x1 = std::min<int32_t>(tile_x1, triangle.x1);
+	int32_t y0 = std::max<int32_t>(tile_y0, triangle.y0), y1 = std::min<int32_t>(tile_y1, triangle.y1);
+	if (x0 >= x1 or y0 >= y1)
+		return;
+
+	const auto &record = draws[triangle.draw];
+	bool depth_test = record.depth != depth_mode::none;
+	bool depth_write = record.depth == depth_mode::read_write;
+
+	edge_function edges[3]{ make_edge(triangle.x[0], triangle.y[0], triangle.x[1], triangle.y[1]),
+	                        make_edge(triangle.x[1], triangle.y[1], triangle.x[2], triangle.y[2]),
+	                        make_edge(triangle.x[2], triangle.y[2], triangle.x[0], triangle.y[0]) };
+	double inverse_area = 1.0 / ((static_cast<double>(triangle.x[1]) - triangle.x[0]) * (static_cast<double>(triangle.y[2]) - triangle.y[0]) -
+	                             (static_cast<double>(triangle.y[1]) - triangle.y[0]) * (static_cast<double>(triangle.x[2]) - triangle.x[0]));
+	auto depth_plane = make_plane(triangle.x, triangle.y, triangle.z, inverse_area);
+	auto shade_plane = make_plane(triangle.x, triangle.y, triangle.shade, inverse_area);
+
+	alignas(32) static const float lane_offset[8]{ 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+	static_assert(lanes <= 8, "lane_offset needs a centre per lane");
+	auto offsets = load(lane_offset);
+	auto zero = splat(0.0f);
+	float_v edge_x[3]{ splat(edges[0].a), splat(edges[1].a), splat(edges[2].a) };
+	auto depth_x = splat(depth_plane.x_step), shade_x = splat(shade_plane.x_step);
+
+	// Spans start lane aligned; tiles are, so only the first and last span of a row are partial
+	int32_t span_start = x0 & ~static_cast<int32_t>(lanes - 1);
+	for (int32_t y{ y0 }; y < y1; y++)
+	{
+		float py = static_cast<float>(y) + 0.5f;
+		float_v edge_row[3];
+		for (size_t e{ 0 }; e < 3; e++)
+		{
+			edge_row[e] = splat(edges[e].b * py + edges[e].c);
+		}
+		auto depth_row = splat(depth_plane.y_step * py + depth_plane.origin);
+		auto shade_row = splat(shade_plane.y_step * py + shade_plane.origin);
+
+		size_t row_start = size_t{ static_cast<uint32_t>(y) } * target_width;
+		for (int32_t x{ span_start }; x < x1; x += static_cast<int32_t>(lanes))
+		{
+			auto px = add(splat(static_cast<float>(x)), offsets);
+
+			uint32_t covered = (1u << lanes) - 1;
+			if (x < x0)
+				covered &= ~((1u << (x0 - x)) - 1);
+			if (x + static_cast<int32_t>(lanes) > x1)
+				covered &= (1u << (x1 - x)) - 1;
+
+			for (size_t e{ 0 }; e < 3 and covered; e++)
+			{
+				auto value = add(mul(edge_x[e], px), edge_row[e]);
+				covered &= mask_bits(edges[e].inclusive ? less_equal(zero, value) : less(zero, value));
+			}
+			if (not covered)
+				continue;
+
+			auto depth = add(mul(depth_x, px), depth_row);
+			if (depth_test)
+				covered &= mask_bits(less_equal(depth, load_unaligned(depth_buffer.data() + row_start + x)));
+			if (not covered)
+				continue;
+
+			alignas(32) float depth_out[lanes], shade_out[lanes];
+			store(depth_out, depth);
+			store(shade_out, add(mul(shade_x, px), shade_row));
+			for (uint32_t l{ 0 }; l < lanes; l++)
+			{
+				if (not (covered & (1u << l)))
+					continue;
+
+				auto index = row_start + x + l;
+				if (depth_write)
+					depth_buffer[index] = depth_out[l];
+				color_buffer[index] = pack_color(record.color, shade_out[l]);
+			}
+		}
+	}
+}
+
+void rasterizer::draw_edges(const binned_triangle &triangle, int32_t tile_x0, int32_t tile_y0, int32_t tile_x1, int32_t tile_y1)
+{
+	const auto &record = draws[triangle.draw];
+	bool depth_test = record.depth != depth_mode::none;
+	bool depth_write = record.depth == depth_mode::read_write;
+
+	auto plot = [&](int32_t x, int32_t y, float depth, float shade)
+	{
+		auto index = size_t{ static_cast<uint32_t>(y) } * target_width + static_cast<uint32_t>(x);
+		if (depth_test and not (depth <= depth_buffer[index]))
+			return;
+		if (depth_write)
+			depth_buffer[index] = depth;
+		color_buffer[index] = pack_color(record.color, shade);
+	};
+
+	// One pixel per column or row along the longer axis, whichever the edge crosses more of
+	for (size_t e{ 0 }; e < 3; e++)
+	{
+		size_t p = e, q = (e + 1) % 3;
+		float dx = triangle.x[q] - triangle.x[p];
+		float dy = triangle.y[q] - triangle.y[p];
+		float dz = triangle.z[q] - triangle.z[p];
+		float ds = triangle.shade[q] - triangle.shade[p];
+
+		if (std::abs(dx) >= std::abs(dy))
+		{
+			if (dx == 0.0f)
+				continue;
+
+			float lo = std::min(triangle.x[p], triangle.x[q]), hi = std::max(triangle.x[p], triangle.x[q]);
+			int32_t first = std::max(tile_x0, static_cast<int32_t>(std::ceil(lo - 0.5f)));
+			int32_t last = std::min(tile_x1 - 1, static_cast<int32_t>(std::floor(hi - 0.5f)));
+			for (int32_t x{ first }; x <= last; x++)
+			{
+				float t = (static_cast<float>(x) + 0.5f - triangle.x[p]) / dx;
+				auto y = static_cast<int32_t>(std::floor(triangle.y[p] + t * dy));
+				if (y >= tile_y0 and y < tile_y1)
+					plot(x, y, triangle.z[p] + t * dz, triangle.shade[p] + t * ds);
+			}
+		}
+		else
+		{
+			float lo = std::min(triangle.y[p], triangle.y[q]), hi = std::max(triangle.y[p], triangle.y[q]);
+			int32_t first = std::max(tile_y0, static_cast<int32_t>(std::ceil(lo - 0.5f)));
+			int32_t last = std::min(tile_y1 - 1, static_cast<int32_t>(std::floor(hi - 0.5f)));
+			for (int32_t y{ first }; y <= last; y++)
+			{
+				float t = (static_cast<float>(y) + 0.5f - triangle.y[p]) / dy;
+				auto x = static_cast<int32_t>(std::floor(triangle.x[p] + t * dx));
+				if (x >= tile_x0 and x < tile_x1)
+					plot(x, y, triangle.z[p] + t * dz, triangle.shade[p] + t * ds);
+			}
+		}
+	}
+}
+
+void rasterizer::run(size_t count, const std::function<void(size_t)> &task)
+{
+	if (pool)
+	{
+		pool->parallel_for(count, task);
+		return;
+	}
+
+	for (size_t i{ 0 }; i < count; i++)
+	{
+		task(i);
+	}
+}
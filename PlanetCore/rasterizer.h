@@ -0,0 +1,169 @@
+#pragma once
+
+#include "mesh.h"
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace planet_generator
+{
+	class thread_pool;
+
+	// Tiled software rasterizer, for rendering with no GPU.
+	// Each draw is transformed, clipped and set up right away and its triangles are binned into screen tiles;
+	// flush then fills the tiles in parallel, each tile drawing its triangles in the order they were drawn.
+	// Follows Direct3D conventions: clip space z in [0, w], clockwise triangles face front,
+	// pixel centers at half integers, top-left fill rule and a LESS_EQUAL depth test.
+	class rasterizer
+	{
+	public:
+		enum class fill_mode
+		{
+			solid,
+			wireframe
+		};
+
+		enum class cull_mode
+		{
+			none,
+			clockwise,
+			anti_clockwise
+		};
+
+		enum class depth_mode
+		{
+			none,
+			read_write,
+			read_only
+		};
+
+		// Vertex colour is color * (ambient + saturate(dot(normal, light_direction)) * (1 - ambient)),
+		// or just color for meshes without normals. light_direction is in the mesh's own space.
+		struct draw_settings
+		{
+			fill_mode fill = fill_mode::solid;
+			cull_mode cull = cull_mode::none;
+			depth_mode depth = depth_mode::read_write;
+			DirectX::XMFLOAT3 color{ 1.0f, 1.0f, 1.0f };
+			float ambient = 0.15f;
+			DirectX::XMFLOAT3 light_direction{ 0.0f, 0.0f, -1.0f };
+		};
+
+		struct statistics
+		{
+			uint64_t triangles;         // drawn, before culling
+			uint64_t culled;            // outside the view, facing away or covering no pixel centre
+			uint64_t clipped;           // crossed a clip plane and were cut
+			uint64_t binned;            // triangles that reached the tiles, after clipping
+			uint64_t tile_entries;      // sum over tiles of the triangles binned to each
+		};
+
+		static constexpr uint32_t tile_size = 64;
+
+	public:
+		rasterizer() = delete;
+		// Without a pool everything runs on the calling thread
+		rasterizer(uint32_t width, uint32_t height, thread_pool *pool = nullptr);
+		~rasterizer();
+
+		rasterizer(const rasterizer &) = delete;
+		rasterizer &operator=(const rasterizer &) = delete;
+
+		// Drops whatever is binned and not flushed
+		void resize(uint32_t width, uint32_t height);
+
+		// Also drops whatever is binned and not flushed; color is RGBA in [0, 1]
+		void clear(const float color[4], float depth = 1.0f);
+
+		// object_to_clip is world * view * projection, for row vectors. normals may be null.
+		// ranges, if any, pick the part of indicies drawn; otherwise all of it is.
+		void draw(DirectX::FXMMATRIX object_to_clip,
+		          const vertex *verticies, size_t vertex_count,
+		          const uint32_t *indicies, size_t index_count,
+		          const DirectX::XMFLOAT3 *normals,
+		          const draw_settings &settings,
+		          const index_range *ranges = nullptr, size_t range_count = 0);
+
+		// Fills the tiles with everything binned since the last flush
+		void flush();
+
+		uint32_t width() const;
+		uint32_t height() const;
+		// Row major from the top left, one RGBA8 pixel per uint32_t with R in the lowest byte
+		const uint32_t *pixels() const;
+		const float *depth() const;
+
+		// Binary PPM; returns false if the file could not be written
+		bool write_image(const std::string &path) const;
+
+		// Since construction or the last reset_stats
+		const statistics &stats() const;
+		void reset_stats();
+
+	private:
+		struct clip_vertex
+		{
+			float x, y, z, w;
+			float shade;
+			float screen_x, screen_y, screen_z;     // snapped; only set while outside is 0
+			uint32_t outside;                       // clip planes it is outside of
+		};
+
+		// Screen space, with verticies in clockwise order
+		struct binned_triangle
+		{
+			float x[3], y[3], z[3];
+			float shade[3];
+			int16_t x0, y0, x1, y1;     // pixels it may cover, [x0, x1) by [y0, y1)
+			uint32_t draw;              // into draws
+		};
+
+		// A run of consecutive triangles, set up and binned by one task
+		struct bin_chunk
+		{
+			std::vector<binned_triangle> triangles;
+			std::vector<uint32_t> tile_start;       // tile t's entries are [tile_start[t], tile_start[t + 1])
+			std::vector<uint32_t> tile_entries;     // into triangles
+			statistics counts;
+		};
+
+		struct draw_record
+		{
+			fill_mode fill;
+			depth_mode depth;
+			float color[3];
+		};
+
+		void transform_verticies(DirectX::FXMMATRIX object_to_clip, const vertex *verticies, size_t vertex_count,
+		                         const DirectX::XMFLOAT3 *normals, const draw_settings &settings);
+		void bin_triangles(bin_chunk &chunk, const uint32_t *indicies, size_t triangle_count, cull_mode cull, uint32_t draw);
+		void setup_triangle(bin_chunk &chunk, const clip_vertex *corners, size_t corner_count, cull_mode cull, uint32_t draw);
+		void fill_tile(uint32_t tile);
+		void fill_triangle(const binned_triangle &triangle, int32_t tile_x0, int32_t tile_y0, int32_t tile_x1, int32_t tile_y1);
+		void draw_edges(const binned_triangle &triangle, int32_t tile_x0, int32_t tile_y0, int32_t tile_x1, int32_t tile_y1);
+		void run(size_t count, const std::function<void(size_t)> &task);
+
+	private:
+		thread_pool *pool = nullptr;
+
+		uint32_t target_width = 0;
+		uint32_t target_height = 0;
+		uint32_t tiles_x = 0;
+		uint32_t tiles_y = 0;
+		std::vector<uint32_t> color_buffer;
+		std::vector<float> depth_buffer;    // padded so a SIMD load at the end of the last row stays inside
+
+		std::vector<clip_vertex> transformed;
+		std::vector<uint32_t> gathered_indicies;    // a draw's ranges, one after another
+		std::vector<std::unique_ptr<bin_chunk>> chunks;
+		size_t chunk_count = 0;             // in use since the last flush
+		size_t binned_since_flush = 0;
+		std::vector<draw_record> draws;
+
+		statistics frame_stats{};
+	};
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__) || defined(__AVX__)
+#include <smmintrin.h>
+#elif defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Thin wrappers so SIMD kernels are written once for every instruction set.
+// All operations are IEEE exact (no rsqrt/rcp approximations), so every variant gives the same result.
+// Only for use inside PlanetCore's translation units.
+// MSVC only says which instruction set it may use through /arch, so the AVX2 variant needs the ReleaseAVX2
+// configuration, and SSE4.1 is picked up from /arch:AVX; plain x64 builds get SSE2.
+namespace planet_generator::simd
+{
+#if defined(__AVX2__)
+	constexpr size_t lanes = 8;
+	constexpr const char *instruction_set = "avx2";
+
+	using float_v = __m256;
+	using mask_v = __m256;
+	inline float_v load(const float *p) { return _mm256_load_ps(p); }
+	inline float_v load_unaligned(const float *p) { return _mm256_loadu_ps(p); }
+	inline void store(float *p, float_v v) { _mm256_store_ps(p, v); }
+	inline float_v splat(float f) { return _mm256_set1_ps(f); }
+	inline float_v add(float_v a, float_v b) { return _mm256_add_ps(a, b); }
+	inline float_v sub(float_v a, float_v b) { return _mm256_sub_ps(a, b); }
+	inline float_v mul(float_v a, float_v b) { return _mm256_mul_ps(a, b); }
+	inline float_v div(float_v a, float_v b) { return _mm256_div_ps(a, b); }
+	inline float_v sqrt(float_v a) { return _mm256_sqrt_ps(a); }
+	inline float_v max(float_v a, float_v b) { return _mm256_max_ps(a, b); }
+	inline float_v truncate(float_v a) { return _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+	inline float_v select(mask_v m, float_v a, float_v b) { return _mm256_blendv_ps(b, a, m); }
+	inline mask_v less(float_v a, float_v b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline mask_v less_equal(float_v a, float_v b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	inline mask_v mask_and(mask_v a, mask_v b) { return _mm256_and_ps(a, b); }
+	inline mask_v mask_or(mask_v a, mask_v b) { return _mm256_or_ps(a, b); }
+	inline uint32_t mask_bits(mask_v m) { return static_cast<uint32_t>(_mm256_movemask_ps(m)); }
+#elif defined(__SSE4_1__) || defined(__AVX__) || defined(_M_X64) || defined(__SSE2__)
+	constexpr size_t lanes = 4;
+#if defined(__SSE4_1__) || defined(__AVX__)
+	constexpr const char *instruction_set = "sse4.1";
+#else
+	constexpr const char *instruction_set = "sse2";
+#endif
+
+	using float_v = __m128;
+	using mask_v = __m128;
+	inline float_v load(const float *p) { return _mm_load_ps(p); }
+	inline float_v load_unaligned(const float *p) { return _mm_loadu_ps(p); }
+	inline void store(float *p, float_v v) { _mm_store_ps(p, v); }
+	inline float_v splat(float f) { return _mm_set1_ps(f); }
+	inline float_v add(float_v a, float_v b) { return _mm_add_ps(a, b); }
+	inline float_v sub(float_v a, float_v b) { return _mm_sub_ps(a, b); }
+	inline float_v mul(float_v a, float_v b) { return _mm_mul_ps(a, b); }
+	inline float_v div(float_v a, float_v b) { return _mm_div_ps(a, b); }
+	inline float_v sqrt(float_v a) { return _mm_sqrt_ps(a); }
+	inline float_v max(float_v a, float_v b) { return _mm_max_ps(a, b); }
+#if defined(__SSE4_1__) || defined(__AVX__)
+	inline float_v truncate(float_v a) { return _mm_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+	inline float_v select(mask_v m, float_v a, float_v b) { return _mm_blendv_ps(b, a, m); }
+#else
+	// Through int32, which is plenty for the values it is used on
+	inline float_v truncate(float_v a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+	inline float_v select(mask_v m, float_v a, float_v b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+#endif
+	inline mask_v less(float_v a, float_v b) { return _mm_cmplt_ps(a, b); }
+	inline mask_v less_equal(float_v a, float_v b) { return _mm_cmple_ps(a, b); }
+	inline mask_v mask_and(mask_v a, mask_v b) { return _mm_and_ps(a, b); }
+	inline mask_v mask_or(mask_v a, mask_v b) { return _mm_or_ps(a, b); }
+	inline uint32_t mask_bits(mask_v m) { return static_cast<uint32_t>(_mm_movemask_ps(m)); }
+#else
+	constexpr size_t lanes = 4;
+	constexpr const char *instruction_set = "scalar";
+
+	struct float_v { float v[lanes]; };
+	struct mask_v { bool v[lanes]; };
+	inline float_v load(const float *p) { float_v r; std::copy(p, p + lanes, r.v); return r; }
+	inline float_v load_unaligned(const float *p) { return load(p); }
+	inline void store(float *p, float_v a) { std::copy(a.v, a.v + lanes, p); }
+	inline float_v splat(float f) { float_v r; std::fill(r.v, r.v + lanes, f); return r; }
+	inline float_v add(float_v a, float_v b) { for (size_t i{ 0 }; i < lanes; i++) a.v[i] += b.v[i]; return a; }
+	inline float_v sub(float_v a, float_v b) { for (size_t i{ 0 }; i < lanes; i++) a.v[i] -= b.v[i]; return a; }
+	inline float_v mul(float_v a, float_v b) { for (size_t i{ 0 }; i < lanes; i++) a.v[i] *= b.v[i]; return a; }
+	inline float_v div(float_v a, float_v b) { for (size_t i{ 0 }; i < lanes; i++) a.v[i] /= b.v[i]; return a; }
+	inline float_v sqrt(float_v a) { for (size_t i{ 0 }; i < lanes; i++) a.v[i] = std::sqrt(a.v[i]); return a; }
+	inline float_v max(float_v a, float_v b) { for (size_t i{ 0 }; i < lanes; i++) a.v[i] = std::max(a.v[i], b.v[i]); return a; }
+	inline float_v truncate(float_v a) { for (size_t i{ 0 }; i < lanes; i++) a.v[i] = std::trunc(a.v[i]); return a; }
+	inline float_v select(mask_v m, float_v a, float_v b) { for (size_t i{ 0 }; i < lanes; i++) a.v[i] = m.v[i] ? a.v[i] : b.v[i]; return a; }
+	inline mask_v less(float_v a, float_v b) { mask_v m; for (size_t i{ 0 }; i < lanes; i++) m.v[i] = a.v[i] < b.v[i]; return m; }
+	inline mask_v less_equal(float_v a, float_v b) { mask_v m; for (size_t i{ 0 }; i < lanes; i++) m.v[i] = a.v[i] <= b.v[i]; return m; }
+	inline mask_v mask_and(mask_v a, mask_v b) { for (size_t i{ 0 }; i < lanes; i++) a.v[i] = a.v[i] and b.v[i]; return a; }
+	inline mask_v mask_or(mask_v a, mask_v b) { for (size_t i{ 0 }; i < lanes; i++) a.v[i] = a.v[i] or b.v[i]; return a; }
+	inline uint32_t mask_bits(mask_v m) { uint32_t r{ 0 }; for (size_t i{ 0 }; i < lanes; i++) r |= uint32_t{ m.v[i] } << i; return r; }
+#endif
+}
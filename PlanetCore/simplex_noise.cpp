@@ -0,0 +1,336 @@
+#include "simplex_noise.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace planet_generator;
+
+namespace
+{
+	constexpr float base_frequency = 0.01f;
+	constexpr int octaves = 3;
+	constexpr float lacunarity = 2.0f;
+	constexpr float gain = 0.5f;
+	constexpr float fractal_bounding = 1.0f / (1.0f + gain + gain * gain);
+
+	// Octaves and warp axes each read the permutation at a different offset, so they are uncorrelated
+	constexpr uint8_t warp_offset = 128;
+
+	// Kernel radius squared is 0.5, where each corner's influence has fallen to zero at the far side of its simplex.
+	// FastNoise uses 0.6, which leaves small steps in the noise; harmless for height, but they show up in the gradient.
+	constexpr float kernel_radius = 0.5f;
+	// Brings a single octave to about [-1, 1] for that radius
+	constexpr float kernel_scale = 80.0f;
+
+	constexpr float skew = 1.0f / 3.0f;
+	constexpr float unskew = 1.0f / 6.0f;
+
+	constexpr float grad_x[12] = { 1, -1, 1, -1, 1, -1, 1, -1, 0, 0, 0, 0 };
+	constexpr float grad_y[12] = { 1, 1, -1, -1, 0, 0, 0, 0, 1, -1, 1, -1 };
+	constexpr float grad_z[12] = { 0, 0, 0, 0, 1, 1, -1, -1, 1, 1, -1, -1 };
+
+	int fast_floor(float f)
+	{
+		return (f >= 0.0f) ? static_cast<int>(f) : static_cast<int>(f) - 1;
+	}
+
+	using namespace planet_generator::simd;
+
+	float_v fast_floor(float_v f)
+	{
+		return sub(truncate(f), select(less(f, splat(0.0f)), splat(1.0f), splat(0.0f)));
+	}
+
+	// simplex_noise::single for a block of points, value only. Same operations in the same order,
+	// so every lane gives exactly what single does; only the permutation lookups go lane by lane.
+	float_v single_block(const uint8_t *perm, const uint8_t *perm12, uint8_t offset, float_v x, float_v y, float_v z)
+	{
+		float_v zero = splat(0.0f),
+		        one = splat(1.0f);
+
+		float_v t = mul(add(add(x, y), z), splat(skew));
+		float_v i = fast_floor(add(x, t)),
+		        j = fast_floor(add(y, t)),
+		        k = fast_floor(add(z, t));
+
+		t = mul(add(add(i, j), k), splat(unskew));
+		float_v x0 = sub(x, sub(i, t)),
+		        y0 = sub(y, sub(j, t)),
+		        z0 = sub(z, sub(k, t));
+
+		// Which of the six tetrahedra, from the three comparisons single branches on
+		mask_v x_y = less_equal(y0, x0), y_z = less_equal(z0, y0), x_z = less_equal(z0, x0),
+		       y_x = less(x0, y0), z_y = less(y0, z0), z_x = less(x0, z0);
+
+		alignas(32) float corner[3][4][lanes];     // i, j, k offset of each corner
+		store(corner[0][1], select(mask_and(x_y, x_z), one, zero));
+		store(corner[1][1], select(mask_and(y_x, y_z), one, zero));
+		store(corner[2][1], select(mask_and(z_x, z_y), one, zero));
+		store(corner[0][2], select(mask_or(x_y, x_z), one, zero));
+		store(corner[1][2], select(mask_or(y_x, y_z), one, zero));
+		store(corner[2][2], select(mask_or(z_x, z_y), one, zero));
+		for (size_t axis{ 0 }; axis < 3; axis++)
+		{
+			store(corner[axis][0], zero);
+			store(corner[axis][3], one);
+		}
+
+		alignas(32) float cell[3][lanes];
+		store(cell[0], i);
+		store(cell[1], j);
+		store(cell[2], k);
+
+		alignas(32) float gradient[3][4][lanes];
+		for (size_t lane{ 0 }; lane < lanes; lane++)
+		{
+			auto ci = static_cast<int>(cell[0][lane]),
+			     cj = static_cast<int>(cell[1][lane]),
+			     ck = static_cast<int>(cell[2][lane]);
+			for (size_t c{ 0 }; c < 4; c++)
+			{
+				auto hash = perm12[((ci + static_cast<int>(corner[0][c][lane])) & 0xff) +
+				                   perm[((cj + static_cast<int>(corner[1][c][lane])) & 0xff) +
+				                        perm[((ck + static_cast<int>(corner[2][c][lane])) & 0xff) + offset]]];
+				gradient[0][c][lane] = grad_x[hash];
+				gradient[1][c][lane] = grad_y[hash];
+				gradient[2][c][lane] = grad_z[hash];
+			}
+		}
+
+		// Corners whose falloff is below zero add nothing, as single skips them
+		float_v result = zero;
+		for (size_t c{ 0 }; c < 4; c++)
+		{
+			float_v corner_offset = splat(static_cast<float>(c) * unskew);
+			float_v rx = add(sub(x0, load(corner[0][c])), corner_offset),
+			        ry = add(sub(y0, load(corner[1][c])), corner_offset),
+			        rz = add(sub(z0, load(corner[2][c])), corner_offset);
+
+			float_v falloff = sub(sub(sub(splat(kernel_radius), mul(rx, rx)), mul(ry, ry)), mul(rz, rz));
+			float_v dot = add(add(mul(load(gradient[0][c]), rx), mul(load(gradient[1][c]), ry)), mul(load(gradient[2][c]), rz));
+
+			float_v falloff2 = mul(falloff, falloff),
+			        falloff4 = mul(falloff2, falloff2);
+			result = add(result, select(less(falloff, zero), zero, mul(falloff4, dot)));
+		}
+
+		return mul(splat(kernel_scale), result);
+	}
+}
+
+simplex_noise::simplex_noise(int32_t seed)
+{
+	std::mt19937_64 generator(static_cast<uint64_t>(seed));
+
+	for (int i{ 0 }; i < 256; i++)
+	{
+		perm[i] = static_cast<uint8_t>(i);
+	}
+
+	for (int j{ 0 }; j < 256; j++)
+	{
+		auto k = static_cast<int>(generator() % static_cast<uint64_t>(256 - j)) + j;
+		auto l = perm[j];
+		perm[j] = perm[j + 256] = perm[k];
+		perm[k] = l;
+		perm12[j] = perm12[j + 256] = perm[j] % 12;
+	}
+}
+
+float simplex_noise::value(float x, float y, float z) const
+{
+	return fractal(0, x, y, z, nullptr);
+}
+
+float simplex_noise::value(float x, float y, float z, float gradient[3]) const
+{
+	return fractal(0, x, y, z, gradient);
+}
+
+void simplex_noise::sample(const float *x, const float *y, const float *z, float *out, size_t n) const
+{
+	alignas(32) float block[3][lanes], result[lanes];
+	for (size_t first{ 0 }; first < n; first += lanes)
+	{
+		// Short blocks are padded by repeating the last point
+		size_t count = std::min(lanes, n - first);
+		for (size_t i{ 0 }; i < lanes; i++)
+		{
+			size_t from = first + std::min(i, count - 1);
+			block[0][i] = x[from];
+			block[1][i] = y[from];
+			block[2][i] = z[from];
+		}
+
+		// fractal() with every step on the whole block
+		float_v bx = mul(load(block[0]), splat(base_frequency)),
+		        by = mul(load(block[1]), splat(base_frequency)),
+		        bz = mul(load(block[2]), splat(base_frequency));
+		float_v sum = splat(0.0f);
+		float amplitude{ 1.0f };
+		for (int octave{ 0 }; octave < octaves; octave++)
+		{
+			sum = add(sum, mul(single_block(perm, perm12, perm[static_cast<uint8_t>(octave)], bx, by, bz), splat(amplitude)));
+
+			bx = mul(bx, splat(lacunarity));
+			by = mul(by, splat(lacunarity));
+			bz = mul(bz, splat(lacunarity));
+			amplitude *= gain;
+		}
+
+		store(result, mul(sum, splat(fractal_bounding)));
+		std::copy(result, result + count, out + first);
+	}
+}
+
+void simplex_noise::warp(float amplitude, float &x, float &y, float &z, float jacobian[9]) const
+{
+	float g[3][3]{};
+	float offset[3]{};
+	for (uint8_t axis{ 0 }; axis < 3; axis++)
+	{
+		offset[axis] = amplitude * fractal(static_cast<uint8_t>(warp_offset + axis * octaves), x, y, z, jacobian ? g[axis] : nullptr);
+	}
+
+	if (jacobian)
+	{
+		for (int row{ 0 }; row < 3; row++)
+		{
+			for (int col{ 0 }; col < 3; col++)
+			{
+				jacobian[row * 3 + col] = ((row == col) ? 1.0f : 0.0f) + amplitude * g[row][col];
+			}
+		}
+	}
+
+	x += offset[0];
+	y += offset[1];
+	z += offset[2];
+}
+
+float simplex_noise::fractal(uint8_t first_offset, float x, float y, float z, float *gradient) const
+{
+	x *= base_frequency;
+	y *= base_frequency;
+	z *= base_frequency;
+
+	float sum{ 0.0f };
+	float amplitude{ 1.0f };
+	float frequency{ base_frequency };
+	float octave_gradient[3]{};
+
+	if (gradient)
+	{
+		gradient[0] = gradient[1] = gradient[2] = 0.0f;
+	}
+
+	for (int octave{ 0 }; octave < octaves; octave++)
+	{
+		sum += single(perm[static_cast<uint8_t>(first_offset + octave)], x, y, z, gradient ? octave_gradient : nullptr) * amplitude;
+
+		// d/dp of noise(p * frequency) is frequency * noise'
+		if (gradient)
+		{
+			for (int axis{ 0 }; axis < 3; axis++)
+			{
+				gradient[axis] += octave_gradient[axis] * amplitude * frequency;
+			}
+		}
+
+		x *= lacunarity;
+		y *= lacunarity;
+		z *= lacunarity;
+		frequency *= lacunarity;
+		amplitude *= gain;
+	}
+
+	if (gradient)
+	{
+		for (int axis{ 0 }; axis < 3; axis++)
+		{
+			gradient[axis] *= fractal_bounding;
+		}
+	}
+
+	return sum * fractal_bounding;
+}
+
+float simplex_noise::single(uint8_t offset, float x, float y, float z, float *gradient) const
+{
+	float t = (x + y + z) * skew;
+	int i = fast_floor(x + t),
+	    j = fast_floor(y + t),
+	    k = fast_floor(z + t);
+
+	t = static_cast<float>(i + j + k) * unskew;
+	float x0 = x - (static_cast<float>(i) - t),
+	      y0 = y - (static_cast<float>(j) - t),
+	      z0 = z - (static_cast<float>(k) - t);
+
+	// Which of the six tetrahedra in the skewed cube the point is in
+	int i1, j1, k1, i2, j2, k2;
+	if (x0 >= y0)
+	{
+		if (y0 >= z0)      { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+		else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+		else               { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+	}
+	else
+	{
+		if (y0 < z0)       { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+		else if (x0 < z0)  { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+		else               { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+	}
+
+	const int corner_i[4] = { 0, i1, i2, 1 },
+	          corner_j[4] = { 0, j1, j2, 1 },
+	          corner_k[4] = { 0, k1, k2, 1 };
+
+	float result{ 0.0f };
+	if (gradient)
+	{
+		gradient[0] = gradient[1] = gradient[2] = 0.0f;
+	}
+
+	// Each corner adds t^4 * (g . r), with t = kernel_radius - r . r;
+	// its gradient is t^4 * g - 8 * t^3 * (g . r) * r
+	for (int c{ 0 }; c < 4; c++)
+	{
+		float rx = x0 - static_cast<float>(corner_i[c]) + static_cast<float>(c) * unskew,
+		      ry = y0 - static_cast<float>(corner_j[c]) + static_cast<float>(c) * unskew,
+		      rz = z0 - static_cast<float>(corner_k[c]) + static_cast<float>(c) * unskew;
+
+		float falloff = kernel_radius - rx * rx - ry * ry - rz * rz;
+		if (falloff < 0.0f)
+			continue;
+
+		auto hash = perm12[((i + corner_i[c]) & 0xff) + perm[((j + corner_j[c]) & 0xff) + perm[((k + corner_k[c]) & 0xff) + offset]]];
+		float gx = grad_x[hash],
+		      gy = grad_y[hash],
+		      gz = grad_z[hash];
+		float dot = gx * rx + gy * ry + gz * rz;
+
+		float falloff2 = falloff * falloff,
+		      falloff4 = falloff2 * falloff2;
+		result += falloff4 * dot;
+
+		if (gradient)
+		{
+			float radial = -8.0f * falloff2 * falloff * dot;
+			gradient[0] += falloff4 * gx + radial * rx;
+			gradient[1] += falloff4 * gy + radial * ry;
+			gradient[2] += falloff4 * gz + radial * rz;
+		}
+	}
+
+	if (gradient)
+	{
+		gradient[0] *= kernel_scale;
+		gradient[1] *= kernel_scale;
+		gradient[2] *= kernel_scale;
+	}
+
+	return kernel_scale * result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace planet_generator
+{
+	// 3D simplex noise, summed over octaves, with its analytic gradient.
+	// Laid out like FastNoise's SimplexFractal defaults, so existing frequency and amplitude settings
+	// keep their scale: frequency 0.01, 3 octaves, lacunarity 2 and gain 0.5, about [-1, 1].
+	class simplex_noise
+	{
+	public:
+		simplex_noise(int32_t seed);
+
+		float value(float x, float y, float z) const;
+
+		// Also writes d value / d x, y, z
+		float value(float x, float y, float z, float gradient[3]) const;
+
+		// value() of n points at once, a SIMD block at a time. Results are value()'s exactly,
+		// unless the compiler fused value()'s multiplies and adds, which moves the last bit or so.
+		void sample(const float *x, const float *y, const float *z, float *out, size_t n) const;
+
+		// Moves the point by up to amplitude along a noise vector field, for domain warping.
+		// jacobian, if given, receives d warped / d input, row major.
+		void warp(float amplitude, float &x, float &y, float &z, float jacobian[9] = nullptr) const;
+
+	private:
+		float single(uint8_t offset, float x, float y, float z, float *gradient) const;
+		float fractal(uint8_t first_offset, float x, float y, float z, float *gradient) const;
+
+	private:
+		uint8_t perm[512];
+		uint8_t perm12[512];
+	};
+}
@@ -0,0 +1,100 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+using namespace planet_generator;
+
+thread_pool::thread_pool() :
+	thread_pool(std::max(1u, std::thread::hardware_concurrency()) - 1u)
+{}
+
+thread_pool::thread_pool(uint32_t worker_count)
+{
+	workers.reserve(worker_count);
+	for (uint32_t i{ 0 }; i < worker_count; i++)
+	{
+		workers.emplace_back([&]() { worker_loop(); });
+	}
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard lock(job_mutex);
+		stop_workers = true;
+	}
+	job_start.notify_all();
+
+	for (auto &worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void thread_pool::parallel_for(size_t count, const task_t &task)
+{
+	if (count == 0)
+		return;
+
+	if (workers.empty() or count == 1)
+	{
+		for (size_t i{ 0 }; i < count; i++)
+			task(i);
+		return;
+	}
+
+	{
+		std::lock_guard lock(job_mutex);
+		job_task = &task;
+		job_count = count;
+		next_index = 0;
+		busy_workers = static_cast<uint32_t>(workers.size());
+		job_generation++;
+	}
+	job_start.notify_all();
+
+	run_tasks();
+
+	std::unique_lock lock(job_mutex);
+	job_done.wait(lock, [&]() { return busy_workers == 0; });
+	job_task = nullptr;
+}
+
+uint32_t thread_pool::size() const
+{
+	return static_cast<uint32_t>(workers.size()) + 1u;
+}
+
+void thread_pool::worker_loop()
+{
+	uint64_t seen_generation{ 0 };
+
+	while (true)
+	{
+		{
+			std::unique_lock lock(job_mutex);
+			job_start.wait(lock, [&]() { return stop_workers or job_generation != seen_generation; });
+
+			if (stop_workers)
+				return;
+
+			seen_generation = job_generation;
+		}
+
+		run_tasks();
+
+		{
+			std::lock_guard lock(job_mutex);
+			busy_workers--;
+		}
+		job_done.notify_one();
+	}
+}
+
+void thread_pool::run_tasks()
+{
+	for (size_t i = next_index++; i < job_count; i = next_index++)
+	{
+		(*job_task)(i);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace planet_generator
+{
+	// Fixed set of worker threads for data parallel loops.
+	// Calling thread also takes part in the work, so a pool of size 0 runs everything inline.
+	class thread_pool
+	{
+	public:
+		using task_t = std::function<void(size_t)>;
+
+	public:
+		thread_pool();
+		thread_pool(uint32_t worker_count);
+		~thread_pool();
+
+		thread_pool(const thread_pool &) = delete;
+		thread_pool &operator=(const thread_pool &) = delete;
+
+		// Calls task(i) for every i in [0, count), and returns once all calls are done.
+		// Order of execution across indices is not defined. Only one parallel_for may run at a time.
+		void parallel_for(size_t count, const task_t &task);
+
+		uint32_t size() const;
+
+	private:
+		void worker_loop();
+		void run_tasks();
+
+	private:
+		std::vector<std::thread> workers;
+
+		std::mutex job_mutex;
+		std::condition_variable job_start;
+		std::condition_variable job_done;
+
+		const task_t *job_task = nullptr;
+		size_t job_count{ 0 };
+		uint64_t job_generation{ 0 };
+		uint32_t busy_workers{ 0 };
+		bool stop_workers = false;
+
+		std::atomic<size_t> next_index{ 0 };
+	};
+}
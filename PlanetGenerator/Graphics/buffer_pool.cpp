@@ -0,0 +1,436 @@
+#include "buffer_pool.h"
+#include "mesh.h"
+#include "packed_mesh.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace planet_generator;
+
+namespace
+{
+	bool is_index_layout(buffer_pool::layout data_layout)
+	{
+		return data_layout == buffer_pool::layout::index16 or data_layout == buffer_pool::layout::index32;
+	}
+}
+
+range_allocator::range_allocator(uint32_t capacity_) :
+	total(capacity_)
+{
+	reset();
+}
+
+uint32_t range_allocator::allocate(uint32_t count)
+{
+	assert(count > 0);
+
+	for (auto it = free_list.begin(); it != free_list.end(); ++it)
+	{
+		if (it->size < count)
+			continue;
+
+		auto offset = it->offset;
+		it->offset += count;
+		it->size -= count;
+		if (it->size == 0)
+			free_list.erase(it);
+
+		available -= count;
+		return offset;
+	}
+	return no_space;
+}
+
+void range_allocator::free(uint32_t offset, uint32_t count)
+{
+	assert(count > 0 and offset + count <= total);
+
+	auto next = std::lower_bound(free_list.begin(), free_list.end(), offset, [](const range &r, uint32_t value)
+	{
+		return r.offset < value;
+	});
+	assert(next == free_list.end() or offset + count <= next->offset);
+
+	available += count;
+
+	bool joins_previous = next != free_list.begin() and std::prev(next)->offset + std::prev(next)->size == offset;
+	bool joins_next = next != free_list.end() and offset + count == next->offset;
+	if (joins_previous and joins_next)
+	{
+		std::prev(next)->size += count + next->size;
+		free_list.erase(next);
+	}
+	else if (joins_previous)
+	{
+		std::prev(next)->size += count;
+	}
+	else if (joins_next)
+	{
+		next->offset = offset;
+		next->size += count;
+	}
+	else
+	{
+		free_list.insert(next, { offset, count });
+	}
+}
+
+void range_allocator::reset()
+{
+	free_list.clear();
+	if (total > 0)
+		free_list.push_back({ 0, total });
+	available = total;
+}
+
+uint32_t range_allocator::capacity() const
+{
+	return total;
+}
+
+uint32_t range_allocator::free_space() const
+{
+	return available;
+}
+
+uint32_t range_allocator::largest_free() const
+{
+	uint32_t largest{ 0 };
+	for (const auto &r : free_list)
+	{
+		largest = std::max(largest, r.size);
+	}
+	return largest;
+}
+
+size_t range_allocator::free_ranges() const
+{
+	return free_list.size();
+}
+
+uint32_t memory_buffer_device::make_buffer(buffer_kind, size_t bytes)
+{
+	counts.buffers++;
+
+	auto dead = std::find(alive.begin(), alive.end(), false);
+	if (dead != alive.end())
+	{
+		auto buffer = static_cast<uint32_t>(dead - alive.begin());
+		buffers[buffer].assign(bytes, 0);
+		alive[buffer] = true;
+		return buffer;
+	}
+
+	buffers.emplace_back(bytes, uint8_t{ 0 });
+	alive.push_back(true);
+	return static_cast<uint32_t>(buffers.size() - 1);
+}
+
+void memory_buffer_device::free_buffer(uint32_t buffer)
+{
+	assert(buffer < buffers.size() and alive[buffer]);
+
+	buffers[buffer] = {};
+	alive[buffer] = false;
+	counts.buffers--;
+}
+
+void memory_buffer_device::write(uint32_t buffer, size_t offset, const void *data, size_t bytes)
+{
+	assert(buffer < buffers.size() and alive[buffer] and offset + bytes <= buffers[buffer].size());
+
+	std::memcpy(buffers[buffer].data() + offset, data, bytes);
+	counts.writes++;
+}
+
+void memory_buffer_device::copy(uint32_t target, size_t target_offset, uint32_t source, size_t source_offset, size_t bytes)
+{
+	assert(target != source);
+	assert(target < buffers.size() and alive[target] and target_offset + bytes <= buffers[target].size());
+	assert(source < buffers.size() and alive[source] and source_offset + bytes <= buffers[source].size());
+
+	std::memcpy(buffers[target].data() + target_offset, buffers[source].data() + source_offset, bytes);
+	counts.copies++;
+	counts.copied_bytes += bytes;
+}
+
+const std::vector<uint8_t> &memory_buffer_device::contents(uint32_t buffer) const
+{
+	return buffers.at(buffer);
+}
+
+const memory_buffer_device::statistics &memory_buffer_device::stats() const
+{
+	return counts;
+}
+
+buffer_pool::buffer_pool(buffer_device &device_) :
+	buffer_pool(device_, settings{})
+{}
+
+buffer_pool::buffer_pool(buffer_device &device_, const settings &pool_settings_) :
+	device(device_),
+	pool_settings(pool_settings_)
+{
+	assert(pool_settings.vertex_heap_size > 0 and pool_settings.index_heap_size > 0);
+}
+
+buffer_pool::~buffer_pool()
+{
+	for (uint32_t h{ 0 }; h < heaps.size(); h++)
+	{
+		if (heaps[h].in_use)
+			free_heap(h);
+	}
+}
+
+buffer_pool::allocation buffer_pool::allocate(layout data_layout, uint32_t count, const void *const *streams)
+{
+	assert(data_layout < layout::count and count > 0);
+
+	// First heap with room in one piece, then a fragmented one with room only in pieces, then a new one;
+	// defragmenting a heap that is nearly full anyway would copy all of it for little room
+	uint32_t heap_index{ static_cast<uint32_t>(heaps.size()) }, first{ range_allocator::no_space };
+	for (uint32_t h{ 0 }; h < heaps.size() and first == range_allocator::no_space; h++)
+	{
+		if (heaps[h].in_use and heaps[h].data_layout == data_layout)
+		{
+			first = heaps[h].space.allocate(count);
+			heap_index = h;
+		}
+	}
+	for (uint32_t h{ 0 }; h < heaps.size() and first == range_allocator::no_space; h++)
+	{
+		if (heaps[h].in_use and heaps[h].data_layout == data_layout and heaps[h].space.free_space() >= count and
+		    fragmented(heaps[h]))
+		{
+			defragment_heap(h);
+			first = heaps[h].space.allocate(count);
+			heap_index = h;
+		}
+	}
+	if (first == range_allocator::no_space)
+	{
+		auto heap_size = is_index_layout(data_layout) ? pool_settings.index_heap_size : pool_settings.vertex_heap_size;
+		heap_index = make_heap(data_layout, std::max(heap_size, count));
+		first = heaps[heap_index].space.allocate(count);
+	}
+	assert(first != range_allocator::no_space);
+
+	auto &h = heaps[heap_index];
+	for (uint32_t s{ 0 }; s < stream_count(data_layout); s++)
+	{
+		auto element = stride(data_layout, s);
+		if (streams)
+		{
+			assert(streams[s]);
+			device.write(h.buffers[s], size_t{ first } * element, streams[s], size_t{ count } * element);
+		}
+		pool_stats.used_bytes += size_t{ count } * element;
+	}
+	h.live++;
+	pool_stats.allocations++;
+
+	return allocations.insert({ heap_index, first, count });
+}
+
+bool buffer_pool::free(const allocation &allocated)
+{
+	auto *b = allocations.find(allocated);
+	if (not b)
+		return false;
+
+	auto heap_index = b->heap;
+	auto &h = heaps[heap_index];
+	h.space.free(b->first, b->count);
+	h.live--;
+	for (uint32_t s{ 0 }; s < stream_count(h.data_layout); s++)
+	{
+		pool_stats.used_bytes -= size_t{ b->count } * stride(h.data_layout, s);
+	}
+	pool_stats.allocations--;
+	allocations.remove(allocated);
+
+	// Empty heaps go, except the last of their layout, which the next allocation would only make again
+	if (h.live == 0)
+	{
+		auto same_layout = std::count_if(heaps.begin(), heaps.end(), [&](const heap &other)
+		{
+			return other.in_use and other.data_layout == h.data_layout;
+		});
+		if (same_layout > 1)
+			free_heap(heap_index);
+	}
+	return true;
+}
+
+bool buffer_pool::write(const allocation &allocated, uint32_t stream, uint32_t first, const void *data, uint32_t count)
+{
+	auto *b = allocations.find(allocated);
+	if (not b)
+		return false;
+
+	const auto &h = heaps[b->heap];
+	assert(stream < stream_count(h.data_layout));
+	if (first >= b->count)
+		return true;
+
+	count = std::min(count, b->count - first);
+	auto element = stride(h.data_layout, stream);
+	device.write(h.buffers[stream], (size_t{ b->first } + first) * element, data, size_t{ count } * element);
+	return true;
+}
+
+bool buffer_pool::find(const allocation &allocated, location &where) const
+{
+	auto *b = allocations.find(allocated);
+	if (not b)
+		return false;
+
+	where.buffers = heaps[b->heap].buffers;
+	where.first = b->first;
+	where.count = b->count;
+	return true;
+}
+
+void buffer_pool::defragment()
+{
+	for (uint32_t h{ 0 }; h < heaps.size(); h++)
+	{
+		if (heaps[h].in_use and fragmented(heaps[h]))
+			defragment_heap(h);
+	}
+}
+
+const buffer_pool::statistics &buffer_pool::stats() const
+{
+	return pool_stats;
+}
+
+uint32_t buffer_pool::stream_count(layout data_layout)
+{
+	return data_layout == layout::position_normal ? 2 : 1;
+}
+
+uint32_t buffer_pool::stride(layout data_layout, uint32_t stream)
+{
+	switch (data_layout)
+	{
+	case layout::position:          return sizeof(vertex);
+	case layout::position_normal:   return stream == 0 ? sizeof(vertex) : sizeof(DirectX::XMFLOAT3);
+	case layout::packed_position:   return sizeof(packed_vertex);
+	case layout::index16:           return sizeof(uint16_t);
+	default:                        return sizeof(uint32_t);
+	}
+}
+
+uint32_t buffer_pool::make_heap(layout data_layout, uint32_t capacity)
+{
+	auto unused = std::find_if(heaps.begin(), heaps.end(), [](const heap &h)
+	{
+		return not h.in_use;
+	});
+	auto heap_index = static_cast<uint32_t>(unused - heaps.begin());
+	if (unused == heaps.end())
+		heaps.emplace_back();
+
+	auto &h = heaps[heap_index];
+	h.data_layout = data_layout;
+	h.space = range_allocator{ capacity };
+	h.buffers.fill(UINT32_MAX);
+	h.live = 0;
+	h.in_use = true;
+
+	auto kind = is_index_layout(data_layout) ? buffer_device::buffer_kind::index : buffer_device::buffer_kind::vertex;
+	for (uint32_t s{ 0 }; s < stream_count(data_layout); s++)
+	{
+		auto bytes = size_t{ capacity } * stride(data_layout, s);
+		h.buffers[s] = device.make_buffer(kind, bytes);
+		pool_stats.capacity_bytes += bytes;
+	}
+	pool_stats.heaps++;
+
+	return heap_index;
+}
+
+void buffer_pool::free_heap(uint32_t heap_index)
+{
+	auto &h = heaps[heap_index];
+	assert(h.in_use);
+
+	for (uint32_t s{ 0 }; s < stream_count(h.data_layout); s++)
+	{
+		device.free_buffer(h.buffers[s]);
+		pool_stats.capacity_bytes -= size_t{ h.space.capacity() } * stride(h.data_layout, s);
+	}
+	h.in_use = false;
+	pool_stats.heaps--;
+}
+
+// Copies the heap's allocations, in order and packed to the front, into new buffers
+void buffer_pool::defragment_heap(uint32_t heap_index)
+{
+	auto &h = heaps[heap_index];
+
+	std::vector<block *> moving;
+	moving.reserve(h.live);
+	for (auto &b : allocations)
+	{
+		if (b.heap == heap_index)
+			moving.push_back(&b);
+	}
+	std::sort(moving.begin(), moving.end(), [](const block *a, const block *b)
+	{
+		return a->first < b->first;
+	});
+
+	auto kind = is_index_layout(h.data_layout) ? buffer_device::buffer_kind::index : buffer_device::buffer_kind::vertex;
+	for (uint32_t s{ 0 }; s < stream_count(h.data_layout); s++)
+	{
+		auto element = stride(h.data_layout, s);
+		auto packed = device.make_buffer(kind, size_t{ h.space.capacity() } * element);
+
+		// Allocations next to each other go in one copy
+		uint32_t target{ 0 };
+		for (size_t i{ 0 }; i < moving.size();)
+		{
+			uint32_t source = moving[i]->first, count{ 0 };
+			for (; i < moving.size() and moving[i]->first == source + count; i++)
+			{
+				count += moving[i]->count;
+			}
+			device.copy(packed, size_t{ target } * element, h.buffers[s], size_t{ source } * element, size_t{ count } * element);
+			pool_stats.moved_bytes += size_t{ count } * element;
+			target += count;
+		}
+
+		device.free_buffer(h.buffers[s]);
+		h.buffers[s] = packed;
+	}
+
+	uint32_t target{ 0 };
+	for (auto *b : moving)
+	{
+		b->first = target;
+		target += b->count;
+	}
+
+	// All of it in use, up to target; allocations free their own parts of that later
+	h.space.reset();
+	if (target > 0)
+	{
+		[[maybe_unused]] auto front = h.space.allocate(target);
+		assert(front == 0);
+	}
+	pool_stats.defragmentations++;
+}
+
+// A quarter of the heap free, and most of that in pieces too small for what an allocation usually needs.
+// Holes that sizes alike keep reusing are fine; first fit fills them without any copying.
+bool buffer_pool::fragmented(const heap &h) const
+{
+	auto free_space = h.space.free_space();
+	return h.space.free_ranges() > 1 and free_space >= h.space.capacity() / 4 and h.space.largest_free() < free_space / 2;
+}
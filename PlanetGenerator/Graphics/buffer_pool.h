@@ -0,0 +1,205 @@
+#pragma once
+
+#include "slot_map.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace planet_generator
+{
+	// Hands out ranges of [0, capacity), first fit from a free list kept sorted by offset.
+	// Freed ranges merge with free neighbours, so free space is only split where ranges are still in use.
+	class range_allocator
+	{
+	public:
+		static constexpr uint32_t no_space = UINT32_MAX;
+
+		struct range
+		{
+			uint32_t offset;
+			uint32_t size;
+		};
+
+	public:
+		range_allocator() = default;
+		explicit range_allocator(uint32_t capacity);
+
+		// Offset of count free units, or no_space when no free range is that big
+		[[nodiscard]]
+		uint32_t allocate(uint32_t count);
+		// Range has to be one allocate gave out, and not freed since
+		void free(uint32_t offset, uint32_t count);
+		// Everything is free again
+		void reset();
+
+		uint32_t capacity() const;
+		uint32_t free_space() const;
+		uint32_t largest_free() const;
+		size_t free_ranges() const;
+
+	private:
+		std::vector<range> free_list;
+		uint32_t total = 0;
+		uint32_t available = 0;
+	};
+
+	// GPU buffers the pool allocates from, behind ids so the pool runs without a device
+	class buffer_device
+	{
+	public:
+		enum class buffer_kind
+		{
+			vertex,
+			index
+		};
+
+	public:
+		virtual ~buffer_device() = default;
+
+		[[nodiscard]]
+		virtual uint32_t make_buffer(buffer_kind kind, size_t bytes) = 0;
+		virtual void free_buffer(uint32_t buffer) = 0;
+		virtual void write(uint32_t buffer, size_t offset, const void *data, size_t bytes) = 0;
+		// Between two different buffers
+		virtual void copy(uint32_t target, size_t target_offset, uint32_t source, size_t source_offset, size_t bytes) = 0;
+	};
+
+	// Buffers in system memory, to check what the pool does without a GPU
+	class memory_buffer_device final : public buffer_device
+	{
+	public:
+		struct statistics
+		{
+			uint32_t buffers;       // alive now
+			uint32_t writes;
+			uint32_t copies;
+			uint64_t copied_bytes;
+		};
+
+	public:
+		uint32_t make_buffer(buffer_kind kind, size_t bytes) override;
+		void free_buffer(uint32_t buffer) override;
+		void write(uint32_t buffer, size_t offset, const void *data, size_t bytes) override;
+		void copy(uint32_t target, size_t target_offset, uint32_t source, size_t source_offset, size_t bytes) override;
+
+		const std::vector<uint8_t> &contents(uint32_t buffer) const;
+		const statistics &stats() const;
+
+	private:
+		std::vector<std::vector<uint8_t>> buffers;
+		std::vector<bool> alive;
+		statistics counts{};
+	};
+
+	// Vertex and index data of many meshes, sub-allocated from a few large buffers, heaps, per layout.
+	// A mesh is drawn from its heap with its first vertex as base vertex and its first index as start index,
+	// so meshes in one heap share their buffer bindings.
+	// Heaps are made as they are needed, and freed again once empty unless they are the last of their layout.
+	// When a heap has enough free space for an allocation, only not in one piece, it is defragmented:
+	// what it holds is copied packed into a new buffer, and every allocation in it moves.
+	class buffer_pool
+	{
+	public:
+		enum class layout
+		{
+			position,           // vertex
+			position_normal,    // vertex, with XMFLOAT3 normals in a second buffer at the same offsets
+			packed_position,    // packed_vertex
+			index16,
+			index32,
+
+			count
+		};
+
+		static constexpr size_t max_streams = 2;
+
+		struct settings
+		{
+			uint32_t vertex_heap_size = 1u << 20;   // verticies
+			uint32_t index_heap_size = 6u << 20;    // indicies
+		};
+
+		// Part of a heap an allocation holds, in elements
+		struct block
+		{
+			uint32_t heap;
+			uint32_t first;
+			uint32_t count;
+		};
+
+		using allocation = slot_map<block>::key;
+
+		// Where an allocation's data is now; only good until the pool next changes
+		struct location
+		{
+			std::array<uint32_t, max_streams> buffers;     // device buffers, one per stream
+			uint32_t first;                                 // in elements, from the start of the buffers
+			uint32_t count;
+		};
+
+		struct statistics
+		{
+			uint32_t heaps;
+			uint32_t allocations;
+			uint64_t capacity_bytes;
+			uint64_t used_bytes;
+			uint32_t defragmentations;
+			uint64_t moved_bytes;
+		};
+
+	public:
+		buffer_pool() = delete;
+		explicit buffer_pool(buffer_device &device);
+		buffer_pool(buffer_device &device, const settings &pool_settings);
+		~buffer_pool();
+
+		buffer_pool(const buffer_pool &) = delete;
+		buffer_pool &operator=(const buffer_pool &) = delete;
+
+		// streams holds one pointer per stream of the layout, count elements each, or is null to leave the
+		// data to write
+		[[nodiscard]]
+		allocation allocate(layout data_layout, uint32_t count, const void *const *streams);
+		// False if the allocation is stale
+		bool free(const allocation &allocated);
+		// Elements [first, first + count) of one stream, counted from the start of the allocation;
+		// those past its end are dropped. False if the allocation is stale.
+		bool write(const allocation &allocated, uint32_t stream, uint32_t first, const void *data, uint32_t count);
+
+		// False if the allocation is stale
+		bool find(const allocation &allocated, location &where) const;
+
+		// Defragments heaps whose free space is in many pieces, e.g. between frames
+		void defragment();
+
+		const statistics &stats() const;
+
+		static uint32_t stream_count(layout data_layout);
+		static uint32_t stride(layout data_layout, uint32_t stream);
+
+	private:
+		struct heap
+		{
+			layout data_layout;
+			range_allocator space;
+			std::array<uint32_t, max_streams> buffers;
+			uint32_t live = 0;          // allocations in it
+			bool in_use = false;
+		};
+
+		uint32_t make_heap(layout data_layout, uint32_t capacity);
+		void free_heap(uint32_t heap_index);
+		void defragment_heap(uint32_t heap_index);
+		bool fragmented(const heap &h) const;
+
+	private:
+		buffer_device &device;
+		settings pool_settings;
+
+		std::vector<heap> heaps;            // freed ones are kept, not in use, for the next heap made
+		slot_map<block> allocations;
+
+		statistics pool_stats{};
+	};
+}
@@ -1,5 +1,8 @@
 #include "constant_buffer.h"
-#include "mesh_buffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 
 using namespace planet_generator;
 
@@ -38,6 +41,11 @@ void constant_buffer::update(direct3d::context_t context, const transforms & dat
 	context->Unmap(buffer.get(), NULL);
 }
 
+shader_slot constant_buffer::bound_slot() const
+{
+	return slot;
+}
+
 void constant_buffer::make_buffer(direct3d::device_t device, const transforms & data)
 {
 	D3D11_BUFFER_DESC bd{};
@@ -54,3 +62,160 @@ void constant_buffer::make_buffer(direct3d::device_t device, const transforms &
 	                                  buffer.put());
 	assert(hr == S_OK);
 }
+
+bool constant_ring::supported(direct3d::device_t device)
+{
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options{};
+	auto hr = device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS,
+	                                      &options,
+	                                      sizeof(options));
+	return hr == S_OK and options.ConstantBufferOffsetting and options.MapNoOverwriteOnDynamicConstantBuffer;
+}
+
+constant_ring::constant_ring(direct3d::device_t device_, direct3d::context_t context_, uint32_t range_count_) :
+	device(device_),
+	context(context_.as<ID3D11DeviceContext1>()),
+	range_count(std::max(range_count_, 1u))
+{
+	static_assert(sizeof(transforms) <= range_bytes);
+	make_buffer();
+}
+
+void constant_ring::make_buffer()
+{
+	buffer = nullptr;
+
+	D3D11_BUFFER_DESC bd{};
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.ByteWidth = range_count * range_bytes;
+
+	HRESULT hr = device->CreateBuffer(&bd,
+	                                  nullptr,
+	                                  buffer.put());
+	assert(hr == S_OK);
+}
+
+constant_ring::key constant_ring::add(const transforms &data, shader_slot slot)
+{
+	auto k = blocks.insert({ data, 0, slot });
+	const auto *first = &data;
+	write(&k, &first, 1);
+	return k;
+}
+
+void constant_ring::remove(const key &k)
+{
+	blocks.remove(k);
+}
+
+void constant_ring::write(const key *keys, const transforms *const *data, size_t count)
+{
+	if (count == 0)
+		return;
+
+	// Discarding drops every range, so all live transforms go again, the changed ones with their new data
+	bool discard = head + count > range_count;
+	if (discard)
+	{
+		for (size_t k{ 0 }; k < count; k++)
+		{
+			if (auto *b = blocks.find(keys[k]))
+				b->data = *data[k];
+		}
+		head = 0;
+
+		// Every range goes, so a new buffer loses nothing; what is bound is bound again before the next draw
+		if (blocks.size() > range_count)
+		{
+			while (blocks.size() > range_count)
+			{
+				range_count *= 2;
+			}
+			make_buffer();
+			counts.grows++;
+		}
+	}
+
+	D3D11_MAPPED_SUBRESOURCE gpu_buffer;
+	HRESULT hr = context->Map(buffer.get(),
+	                          NULL,
+	                          discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE,
+	                          NULL,
+	                          &gpu_buffer);
+	assert(hr == S_OK);
+	if (FAILED(hr))
+		return;
+
+	auto *gpu_data = static_cast<uint8_t *>(gpu_buffer.pData);
+	auto place = [&](block &b)
+	{
+		b.range = head++;
+		std::memcpy(gpu_data + size_t{ b.range } * range_bytes, &b.data, sizeof(transforms));
+		counts.written_bytes += sizeof(transforms);
+	};
+
+	if (discard)
+	{
+		for (auto &b : blocks)
+		{
+			place(b);
+		}
+	}
+	else
+	{
+		for (size_t k{ 0 }; k < count; k++)
+		{
+			if (auto *b = blocks.find(keys[k]))
+			{
+				b->data = *data[k];
+				place(*b);
+			}
+		}
+	}
+
+	context->Unmap(buffer.get(), NULL);
+	counts.maps++;
+	counts.discards += discard ? 1 : 0;
+}
+
+void constant_ring::queue(const key &k, const transforms &data)
+{
+	queued_keys.push_back(k);
+	queued_data.push_back(&data);
+}
+
+void constant_ring::write_queued()
+{
+	write(queued_keys.data(), queued_data.data(), queued_keys.size());
+	queued_keys.clear();
+	queued_data.clear();
+}
+
+void constant_ring::activate(const key &k) const
+{
+	const auto *b = blocks.find(k);
+	assert(b);
+
+	ID3D11Buffer * const buffers[] = { buffer.get() };
+	const uint32_t first_constant = b->range * (range_bytes / 16);
+	const uint32_t constant_count = range_bytes / 16;
+	context->VSSetConstantBuffers1(static_cast<uint32_t>(b->slot),
+	                               1,
+	                               buffers,
+	                               &first_constant,
+	                               &constant_count);
+}
+
+shader_slot constant_ring::bound_slot(const key &k) const
+{
+	const auto *b = blocks.find(k);
+	assert(b);
+	return b->slot;
+}
+
+const constant_ring::statistics &constant_ring::stats() const
+{
+	return counts;
+}
@@ -1,34 +1,22 @@
 #pragma once
 
 #include "direct3d.h"
+#include "render_backend.h"
+#include "slot_map.h"
 #include <winrt/base.h>
 #include <d3d11_1.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 
 namespace planet_generator
 {
-	struct transforms;
-
-	enum class shader_stage
-	{
-		vertex,
-		pixel
-	};
-
-	enum class shader_slot
-	{
-		projection = 0,
-		view = 1,
-		transform = 2
-	};
-
 	class constant_buffer
 	{
 	public:
 		using buffer_t = winrt::com_ptr<ID3D11Buffer>;
 
-		
-
 	public:
 		constant_buffer() = delete;
 		constant_buffer(direct3d::device_t device, const transforms &data, shader_slot slot);
@@ -37,6 +25,8 @@ namespace planet_generator
 		void activate(direct3d::context_t context);
 		void update(direct3d::context_t context, const transforms &data);
 
+		shader_slot bound_slot() const;
+
 	private:
 		void make_buffer(direct3d::device_t device, const transforms &data);
 
@@ -45,5 +35,78 @@ namespace planet_generator
 		buffer_t buffer;
 		shader_stage p_stage = shader_stage::vertex;
 	};
-}
 
+	// Every transform in one dynamic buffer, a range of it each, bound with VSSetConstantBuffers1.
+	// Changed transforms are written to new ranges at the head, all under one Map with NO_OVERWRITE, so ranges
+	// the GPU may still read are left alone. When the head reaches the end the buffer is discarded instead,
+	// and every live transform is written again from the start; if they no longer fit, the buffer is made again
+	// at twice the size first.
+	// Needs Direct3D 11.1 with constant buffer offsets and NO_OVERWRITE maps of constant buffers, see supported.
+	class constant_ring
+	{
+	private:
+		struct block
+		{
+			transforms data;
+			uint32_t range;         // in range_bytes
+			shader_slot slot;
+		};
+
+	public:
+		using buffer_t = winrt::com_ptr<ID3D11Buffer>;
+		using key = slot_map<block>::key;
+
+		// Constant buffer offsets go in steps of 16 constants
+		static constexpr uint32_t range_bytes = 256;
+
+		struct statistics
+		{
+			uint32_t maps;
+			uint32_t discards;
+			uint32_t grows;         // times the buffer was made again, larger
+			uint64_t written_bytes;
+		};
+
+	public:
+		static bool supported(direct3d::device_t device);
+
+	public:
+		constant_ring() = delete;
+		constant_ring(direct3d::device_t device, direct3d::context_t context_, uint32_t range_count_ = 4096);
+
+		constant_ring(const constant_ring &) = delete;
+		constant_ring &operator=(const constant_ring &) = delete;
+
+		[[nodiscard]]
+		key add(const transforms &data, shader_slot slot);
+		void remove(const key &k);
+
+		// One map for all of them; a key given twice ends up with its last data
+		void write(const key *keys, const transforms *const *data, size_t count);
+		// Collects writes, to make with one write_queued; data has to stay put until then
+		void queue(const key &k, const transforms &data);
+		void write_queued();
+		void activate(const key &k) const;
+		shader_slot bound_slot(const key &k) const;
+
+		// Since construction
+		const statistics &stats() const;
+
+	private:
+		void make_buffer();
+
+	private:
+		direct3d::device_t device;
+		buffer_t buffer;
+		winrt::com_ptr<ID3D11DeviceContext1> context;
+
+		slot_map<block> blocks;
+		uint32_t range_count;
+		uint32_t head = 0;
+
+		std::vector<key> queued_keys;
+		std::vector<const transforms *> queued_data;
+
+		statistics counts{};
+	};
+}
@@ -0,0 +1,297 @@
+#include "d3d11_backend.h"
+
+#include "direct3d.h"
+#include "render_target.h"
+#include "pipeline_state.h"
+#include "mesh_buffer.h"
+#include "constant_buffer.h"
+#include "instance_buffer.h"
+#include "material.h"
+
+using namespace planet_generator;
+
+namespace
+{
+	constexpr std::array<float, 4> clear_color{ 0.35f, 0.25f, 0.35f, 1.0f };
+
+	// Each object keeps the context it binds to
+	class d3d11_mesh final : public backend_mesh
+	{
+	public:
+		template <typename mesh_type>
+		d3d11_mesh(direct3d &d3d, buffer_pool &pool, d3d11_buffer_device &buffers, const mesh_type &mesh_data) :
+			buffer(pool, buffers, mesh_data),
+			context(d3d.get<direct3d::context_t>())
+		{}
+
+		void activate() override
+		{
+			buffer.activate(context);
+		}
+
+		void draw() override
+		{
+			buffer.draw(context);
+		}
+
+		void draw(const index_range *ranges, size_t range_count) override
+		{
+			buffer.draw(context, ranges, range_count);
+		}
+
+		void draw_instanced(uint32_t instance_count) override
+		{
+			buffer.draw_instanced(context, instance_count);
+		}
+
+		uint32_t element_size(mesh_stream stream) const override
+		{
+			return buffer.element_size(stream);
+		}
+
+		void begin_contents(uint32_t vertex_count, uint32_t index_count) override
+		{
+			buffer.begin_contents(vertex_count, index_count);
+		}
+
+		void write(mesh_stream stream, uint32_t first, const void *data, uint32_t count) override
+		{
+			buffer.write(stream, first, data, count);
+		}
+
+		void finish_contents() override
+		{
+			buffer.finish_contents();
+		}
+
+	private:
+		mesh_buffer buffer;
+		direct3d::context_t context;
+	};
+
+	class d3d11_material final : public backend_material
+	{
+	public:
+		d3d11_material(direct3d &d3d, const material_description &description) :
+			shaders(d3d.get<direct3d::device_t>(), description),
+			context(d3d.get<direct3d::context_t>())
+		{}
+
+		void activate() override
+		{
+			shaders.activate(context);
+		}
+
+	private:
+		material shaders;
+		direct3d::context_t context;
+	};
+
+	class d3d11_pipeline final : public backend_pipeline
+	{
+	public:
+		d3d11_pipeline(direct3d &d3d, const pipeline_description &description) :
+			state(d3d.get<direct3d::device_t>(), description),
+			context(d3d.get<direct3d::context_t>())
+		{}
+
+		void activate() override
+		{
+			state.activate(context);
+		}
+
+	private:
+		pipeline_state state;
+		direct3d::context_t context;
+	};
+
+	class d3d11_constants final : public backend_constants
+	{
+	public:
+		d3d11_constants(direct3d &d3d, const transforms &data, shader_slot slot) :
+			buffer(d3d.get<direct3d::device_t>(), data, slot),
+			context(d3d.get<direct3d::context_t>())
+		{}
+
+		void activate() override
+		{
+			buffer.activate(context);
+		}
+
+		void update(const transforms &data) override
+		{
+			buffer.update(context, data);
+		}
+
+		shader_slot bound_slot() const override
+		{
+			return buffer.bound_slot();
+		}
+
+	private:
+		constant_buffer buffer;
+		direct3d::context_t context;
+	};
+
+	class d3d11_instances final : public backend_instances
+	{
+	public:
+		d3d11_instances(direct3d &d3d, uint32_t capacity) :
+			buffer(d3d.get<direct3d::device_t>(), capacity),
+			context(d3d.get<direct3d::context_t>())
+		{}
+
+		void activate() override
+		{
+			buffer.activate(context);
+		}
+
+		void update(const instance_data *data, uint32_t count) override
+		{
+			buffer.update(context, data, count);
+		}
+
+		uint32_t count() const override
+		{
+			return buffer.count();
+		}
+
+	private:
+		instance_buffer buffer;
+		direct3d::context_t context;
+	};
+
+	// A range of the backend's constant_ring, written with the rest of the frame's changes
+	class d3d11_ring_constants final : public backend_constants
+	{
+	public:
+		d3d11_ring_constants(constant_ring &ring_, const transforms &data, shader_slot slot) :
+			ring(ring_),
+			ring_key(ring_.add(data, slot))
+		{}
+
+		~d3d11_ring_constants()
+		{
+			ring.remove(ring_key);
+		}
+
+		void activate() override
+		{
+			ring.activate(ring_key);
+		}
+
+		void update(const transforms &data) override
+		{
+			const auto *first = &data;
+			ring.write(&ring_key, &first, 1);
+		}
+
+		shader_slot bound_slot() const override
+		{
+			return ring.bound_slot(ring_key);
+		}
+
+		const constant_ring::key &key() const
+		{
+			return ring_key;
+		}
+
+	private:
+		constant_ring &ring;
+		constant_ring::key ring_key;
+	};
+}
+
+d3d11_backend::d3d11_backend(HWND hWnd)
+{
+	d3d = std::make_unique<direct3d>(hWnd);
+	geometry_buffers = std::make_unique<d3d11_buffer_device>(d3d->get<direct3d::device_t>(),
+	                                                         d3d->get<direct3d::context_t>());
+	geometry = std::make_unique<buffer_pool>(*geometry_buffers);
+	if (constant_ring::supported(d3d->get<direct3d::device_t>()))
+		constants = std::make_unique<constant_ring>(d3d->get<direct3d::device_t>(),
+		                                            d3d->get<direct3d::context_t>());
+
+	draw_target = std::make_unique<render_target>(d3d->get<direct3d::device_t>(),
+	                                              d3d->get<direct3d::swap_chain_t>());
+	draw_target->activate(d3d->get<direct3d::context_t>());
+}
+
+d3d11_backend::~d3d11_backend() = default;
+
+std::unique_ptr<backend_mesh> d3d11_backend::make_mesh(const mesh &mesh_data)
+{
+	return std::make_unique<d3d11_mesh>(*d3d, *geometry, *geometry_buffers, mesh_data);
+}
+
+std::unique_ptr<backend_mesh> d3d11_backend::make_mesh(const mesh_view &mesh_data)
+{
+	return std::make_unique<d3d11_mesh>(*d3d, *geometry, *geometry_buffers, mesh_data);
+}
+
+std::unique_ptr<backend_mesh> d3d11_backend::make_mesh(const packed_mesh &mesh_data)
+{
+	return std::make_unique<d3d11_mesh>(*d3d, *geometry, *geometry_buffers, mesh_data);
+}
+
+std::unique_ptr<backend_material> d3d11_backend::make_material(const material_description &description)
+{
+	return std::make_unique<d3d11_material>(*d3d, description);
+}
+
+std::unique_ptr<backend_pipeline> d3d11_backend::make_pipeline(const pipeline_description &description)
+{
+	return std::make_unique<d3d11_pipeline>(*d3d, description);
+}
+
+std::unique_ptr<backend_constants> d3d11_backend::make_constants(const transforms &data, shader_slot slot)
+{
+	if (constants)
+		return std::make_unique<d3d11_ring_constants>(*constants, data, slot);
+	return std::make_unique<d3d11_constants>(*d3d, data, slot);
+}
+
+std::unique_ptr<backend_instances> d3d11_backend::make_instances(uint32_t capacity)
+{
+	return std::make_unique<d3d11_instances>(*d3d, capacity);
+}
+
+void d3d11_backend::update_constants(const constants_write *writes, size_t count)
+{
+	if (not constants)
+	{
+		render_backend::update_constants(writes, count);
+		return;
+	}
+
+	// Every constants object is a ring range when there is a ring
+	for (size_t w{ 0 }; w < count; w++)
+	{
+		constants->queue(static_cast<d3d11_ring_constants *>(writes[w].target)->key(), *writes[w].data);
+	}
+	constants->write_queued();
+}
+
+void d3d11_backend::begin_frame()
+{
+	geometry_buffers->forget_bindings();
+	geometry->defragment();
+
+	draw_target->clear(d3d->get<direct3d::context_t>(), clear_color);
+}
+
+void d3d11_backend::end_frame()
+{
+	d3d->present();
+}
+
+void d3d11_backend::resize()
+{
+	draw_target.reset(nullptr);
+
+	d3d->resize();
+
+	draw_target = std::make_unique<render_target>(d3d->get<direct3d::device_t>(),
+	                                              d3d->get<direct3d::swap_chain_t>());
+	draw_target->activate(d3d->get<direct3d::context_t>());
+}
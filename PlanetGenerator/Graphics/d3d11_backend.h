@@ -0,0 +1,44 @@
+#pragma once
+
+#include "render_backend.h"
+#include <Windows.h>
+#include <memory>
+
+namespace planet_generator
+{
+	class direct3d;
+	class render_target;
+	class d3d11_buffer_device;
+	class buffer_pool;
+	class constant_ring;
+
+	// Direct3D 11 device and swap chain for a window. Meshes share a few large buffers, see buffer_pool,
+	// and so do transforms, see constant_ring, where the device can bind parts of a constant buffer.
+	class d3d11_backend final : public render_backend
+	{
+	public:
+		d3d11_backend() = delete;
+		d3d11_backend(HWND hWnd);
+		~d3d11_backend();
+
+		std::unique_ptr<backend_mesh> make_mesh(const mesh &mesh_data) override;
+		std::unique_ptr<backend_mesh> make_mesh(const mesh_view &mesh_data) override;
+		std::unique_ptr<backend_mesh> make_mesh(const packed_mesh &mesh_data) override;
+		std::unique_ptr<backend_material> make_material(const material_description &description) override;
+		std::unique_ptr<backend_pipeline> make_pipeline(const pipeline_description &description) override;
+		std::unique_ptr<backend_constants> make_constants(const transforms &data, shader_slot slot) override;
+		std::unique_ptr<backend_instances> make_instances(uint32_t capacity) override;
+		void update_constants(const constants_write *writes, size_t count) override;
+
+		void begin_frame() override;
+		void end_frame() override;
+		void resize() override;
+
+	private:
+		std::unique_ptr<direct3d> d3d = nullptr;
+		std::unique_ptr<render_target> draw_target = nullptr;
+		std::unique_ptr<d3d11_buffer_device> geometry_buffers = nullptr;
+		std::unique_ptr<buffer_pool> geometry = nullptr;         // after its device, so it goes first
+		std::unique_ptr<constant_ring> constants = nullptr;     // null without 11.1 constant buffer offsets
+	};
+}
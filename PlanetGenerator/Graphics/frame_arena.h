@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace planet_generator
+{
+	// Bump allocator over one block reserved up front, for data that lives for a single frame.
+	// Everything is released at once by reset, so only trivially destructible types go in it.
+	class frame_arena
+	{
+	public:
+		frame_arena() = delete;
+		explicit frame_arena(size_t capacity_) :
+			memory(std::make_unique<std::byte[]>(capacity_)),
+			capacity(capacity_)
+		{}
+
+		// Uninitialized room for count objects, or nullptr when the arena is full
+		template <typename T>
+		T *allocate(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T> and alignof(T) <= alignof(std::max_align_t));
+
+			size_t start = (offset + alignof(T) - 1) & ~(alignof(T) - 1);
+			if (start > capacity or count > (capacity - start) / sizeof(T))
+				return nullptr;
+
+			offset = start + count * sizeof(T);
+			return reinterpret_cast<T *>(memory.get() + start);
+		}
+
+		void reset()
+		{
+			offset = 0;
+		}
+
+		size_t used() const
+		{
+			return offset;
+		}
+
+		size_t size() const
+		{
+			return capacity;
+		}
+
+	private:
+		std::unique_ptr<std::byte[]> memory;
+		size_t capacity;
+		size_t offset = 0;
+	};
+}
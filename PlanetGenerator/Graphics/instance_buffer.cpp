@@ -0,0 +1,60 @@
+#include "instance_buffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace planet_generator;
+
+instance_buffer::instance_buffer(direct3d::device_t device, uint32_t capacity_) :
+	capacity(std::max(capacity_, 1u))
+{
+	D3D11_BUFFER_DESC bd{};
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.ByteWidth = capacity * static_cast<uint32_t>(sizeof(instance_data));
+
+	HRESULT hr = device->CreateBuffer(&bd,
+	                                  nullptr,
+	                                  buffer.put());
+	assert(hr == S_OK);
+}
+
+instance_buffer::~instance_buffer() = default;
+
+void instance_buffer::activate(direct3d::context_t context)
+{
+	ID3D11Buffer * const buffers[] = { buffer.get() };
+	const uint32_t strides[] = { sizeof(instance_data) };
+	const uint32_t offsets[] = { 0 };
+	context->IASetVertexBuffers(input_slot,
+	                            1,
+	                            buffers,
+	                            strides,
+	                            offsets);
+}
+
+void instance_buffer::update(direct3d::context_t context, const instance_data *data, uint32_t count)
+{
+	instance_count = std::min(count, capacity);
+	if (instance_count == 0)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE gpu_buffer;
+	HRESULT hr = context->Map(buffer.get(),
+	                          NULL,
+	                          D3D11_MAP_WRITE_DISCARD,
+	                          NULL,
+	                          &gpu_buffer);
+	assert(hr == S_OK);
+
+	std::memcpy(gpu_buffer.pData, data, size_t{ instance_count } * sizeof(instance_data));
+
+	context->Unmap(buffer.get(), NULL);
+}
+
+uint32_t instance_buffer::count() const
+{
+	return instance_count;
+}
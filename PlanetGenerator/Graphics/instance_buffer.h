@@ -0,0 +1,39 @@
+#pragma once
+
+#include "direct3d.h"
+#include "instancing.h"
+#include <winrt/base.h>
+#include <cstdint>
+
+
+namespace planet_generator
+{
+	// Per instance data of instanced draws, in a dynamic vertex buffer bound to input slot 2.
+	// Every update writes it whole, under a Map with DISCARD.
+	class instance_buffer
+	{
+	public:
+		using buffer_t = winrt::com_ptr<ID3D11Buffer>;
+
+		static constexpr uint32_t input_slot = 2;   // after verticies and normals, see mesh_buffer
+
+	public:
+		instance_buffer() = delete;
+		instance_buffer(direct3d::device_t device, uint32_t capacity_);
+		~instance_buffer();
+
+		instance_buffer(const instance_buffer &) = delete;
+		instance_buffer &operator=(const instance_buffer &) = delete;
+
+		void activate(direct3d::context_t context);
+		// Instances past capacity are dropped
+		void update(direct3d::context_t context, const instance_data *data, uint32_t count);
+
+		uint32_t count() const;
+
+	private:
+		buffer_t buffer;
+		uint32_t capacity;
+		uint32_t instance_count{ 0 };
+	};
+}
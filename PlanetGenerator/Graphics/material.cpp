@@ -1,5 +1,6 @@
 #include "material.h"
 #include <cassert>
+#include <iterator>
 
 using namespace planet_generator;
 
@@ -7,8 +8,19 @@ namespace
 {
 	using element_desc = std::vector<D3D11_INPUT_ELEMENT_DESC>;
 	constexpr D3D11_INPUT_ELEMENT_DESC position = { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
-	constexpr D3D11_INPUT_ELEMENT_DESC normal   = { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	// Normals are their own stream, see mesh_buffer
+	constexpr D3D11_INPUT_ELEMENT_DESC normal   = { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0,                            D3D11_INPUT_PER_VERTEX_DATA, 0 };
 	constexpr D3D11_INPUT_ELEMENT_DESC texcoord = { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	constexpr D3D11_INPUT_ELEMENT_DESC packed_direction = { "POSITION", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	constexpr D3D11_INPUT_ELEMENT_DESC packed_height    = { "POSITION", 1, DXGI_FORMAT_R16G16_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+	// instance_data, one per instance, see instance_buffer
+	constexpr D3D11_INPUT_ELEMENT_DESC instance_rows[] = {
+		{ "INSTANCE_TRANSFORM", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 2, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "INSTANCE_TRANSFORM", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 2, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "INSTANCE_TRANSFORM", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 2, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "INSTANCE_TRANSFORM", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 2, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "INSTANCE_PARAMS",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 2, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+	};
 }
 
 material::material(direct3d::device_t device, const description &mat_desc)
@@ -28,7 +40,7 @@ void material::activate(direct3d::context_t context)
 	context->PSSetShader(pixel_shader.get(), nullptr, 0);
 }
 
-void material::make_input_layout(direct3d::device_t device, const std::vector<material::input_layout_mode> input_layout_list, const std::vector<byte>& vso)
+void material::make_input_layout(direct3d::device_t device, const std::vector<input_layout_mode> &input_layout_list, const std::vector<uint8_t>& vso)
 {
 	element_desc elements;
 	for (auto layout_type : input_layout_list)
@@ -44,6 +56,13 @@ void material::make_input_layout(direct3d::device_t device, const std::vector<ma
 		case input_layout_mode::texcoord:
 			elements.push_back(texcoord);
 			break;
+		case input_layout_mode::packed_position:
+			elements.push_back(packed_direction);
+			elements.push_back(packed_height);
+			break;
+		case input_layout_mode::instance:
+			elements.insert(elements.end(), std::begin(instance_rows), std::end(instance_rows));
+			break;
 		default:
 			assert(false); // Unimplemented Enum value
 			break;
@@ -58,7 +77,7 @@ void material::make_input_layout(direct3d::device_t device, const std::vector<ma
 	assert(hr == S_OK);
 }
 
-void material::make_vertex_shader(direct3d::device_t device, const std::vector<byte>& vso)
+void material::make_vertex_shader(direct3d::device_t device, const std::vector<uint8_t>& vso)
 {
 	auto hr = device->CreateVertexShader(vso.data(),
 	                                     vso.size(),
@@ -67,7 +86,7 @@ void material::make_vertex_shader(direct3d::device_t device, const std::vector<b
 	assert(hr == S_OK);
 }
 
-void material::make_pixel_shader(direct3d::device_t device, const std::vector<byte>& pso)
+void material::make_pixel_shader(direct3d::device_t device, const std::vector<uint8_t>& pso)
 {
 	auto hr = device->CreatePixelShader(pso.data(),
 	                                    pso.size(),
@@ -1,40 +1,208 @@
 #include "mesh_buffer.h"
 
+#include <cassert>
+
 using namespace planet_generator;
 
-mesh_buffer::mesh_buffer(direct3d::device_t device, const std::vector<vertex>& vertices, const std::vector<uint32_t>& indicies)
+d3d11_buffer_device::d3d11_buffer_device(direct3d::device_t device_, direct3d::context_t context_) :
+	device(device_),
+	context(context_)
+{}
+
+uint32_t d3d11_buffer_device::make_buffer(buffer_kind kind, size_t bytes)
+{
+	D3D11_BUFFER_DESC bd{};
+	bd.Usage = D3D11_USAGE_DEFAULT;
+	bd.BindFlags = (kind == buffer_kind::index) ? D3D11_BIND_INDEX_BUFFER : D3D11_BIND_VERTEX_BUFFER;
+	bd.CPUAccessFlags = NULL;
+	bd.ByteWidth = static_cast<uint32_t>(bytes);
+
+	buffer_t buffer;
+	auto hr = device->CreateBuffer(&bd,
+	                               nullptr,
+	                               buffer.put());
+	assert(hr == S_OK);
+
+	if (not free_ids.empty())
+	{
+		auto id = free_ids.back();
+		free_ids.pop_back();
+		buffers[id] = std::move(buffer);
+		return id;
+	}
+
+	buffers.push_back(std::move(buffer));
+	return static_cast<uint32_t>(buffers.size() - 1);
+}
+
+void d3d11_buffer_device::free_buffer(uint32_t buffer)
+{
+	assert(buffer < buffers.size() and buffers[buffer]);
+
+	buffers[buffer] = nullptr;
+	free_ids.push_back(buffer);
+}
+
+void d3d11_buffer_device::write(uint32_t buffer, size_t offset, const void *data, size_t bytes)
 {
-	make_buffer(device, vertices);
-	make_buffer(device, indicies);
+	D3D11_BOX box{};
+	box.left = static_cast<uint32_t>(offset);
+	box.right = static_cast<uint32_t>(offset + bytes);
+	box.bottom = 1;
+	box.back = 1;
+
+	context->UpdateSubresource(buffers[buffer].get(),
+	                           0,
+	                           &box,
+	                           data,
+	                           0,
+	                           0);
 }
 
-mesh_buffer::mesh_buffer(direct3d::device_t device, const mesh & mesh)
+void d3d11_buffer_device::copy(uint32_t target, size_t target_offset, uint32_t source, size_t source_offset, size_t bytes)
 {
-	make_buffer(device, mesh.verticies);
-	make_buffer(device, mesh.indicies);
+	D3D11_BOX box{};
+	box.left = static_cast<uint32_t>(source_offset);
+	box.right = static_cast<uint32_t>(source_offset + bytes);
+	box.bottom = 1;
+	box.back = 1;
+
+	context->CopySubresourceRegion(buffers[target].get(),
+	                               0,
+	                               static_cast<uint32_t>(target_offset),
+	                               0,
+	                               0,
+	                               buffers[source].get(),
+	                               0,
+	                               &box);
 }
 
-mesh_buffer::~mesh_buffer() = default;
+void d3d11_buffer_device::bind(const buffer_pool::location &verticies, buffer_pool::layout vertex_layout,
+                               const buffer_pool::location &indicies, buffer_pool::layout index_layout)
+{
+	auto stream_count = buffer_pool::stream_count(vertex_layout);
+
+	std::array<ID3D11Buffer *, buffer_pool::max_streams> vertex_buffers{};
+	std::array<uint32_t, buffer_pool::max_streams> strides{}, offsets{};
+	for (uint32_t s{ 0 }; s < stream_count; s++)
+	{
+		vertex_buffers[s] = buffers[verticies.buffers[s]].get();
+		strides[s] = buffer_pool::stride(vertex_layout, s);
+	}
+
+	// Strides differ between layouts, but so do their heaps, so the buffers alone tell what is bound
+	if (vertex_buffers != bound_verticies)
+	{
+		context->IASetVertexBuffers(0,
+		                            stream_count,
+		                            vertex_buffers.data(),
+		                            strides.data(),
+		                            offsets.data());
+		bound_verticies = vertex_buffers;
+	}
 
-void mesh_buffer::activate(direct3d::context_t context)
+	auto *index_buffer = buffers[indicies.buffers[0]].get();
+	auto index_format = (index_layout == buffer_pool::layout::index16) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	if (index_buffer != bound_indicies or index_format != bound_format)
+	{
+		context->IASetIndexBuffer(index_buffer,
+		                          index_format,
+		                          0);
+		bound_indicies = index_buffer;
+		bound_format = index_format;
+	}
+}
+
+void d3d11_buffer_device::forget_bindings()
 {
-	ID3D11Buffer * const vert_buffers[] = { vertex_buffer.get() };
-	context->IASetVertexBuffers(0,
-	                            1,
-	                            vert_buffers,
-	                            &vertex_size,
-	                            &vertex_offset);
+	bound_verticies = {};
+	bound_indicies = nullptr;
+	bound_format = DXGI_FORMAT_UNKNOWN;
+}
 
-	context->IASetIndexBuffer(index_buffer.get(),
-	                          DXGI_FORMAT_R32_UINT,
-	                          index_offset);
+mesh_buffer::mesh_buffer(buffer_pool &pool_, d3d11_buffer_device &buffers_, const std::vector<vertex>& vertices, const std::vector<uint32_t>& indicies) :
+	pool(pool_),
+	buffers(buffers_)
+{
+	allocate(buffer_pool::layout::position, vertices.data(), nullptr, vertices.size(),
+	         buffer_pool::layout::index32, indicies.data(), indicies.size());
+}
+
+mesh_buffer::mesh_buffer(buffer_pool &pool_, d3d11_buffer_device &buffers_, const mesh & mesh) :
+	pool(pool_),
+	buffers(buffers_)
+{
+	if (not mesh.normals.empty())
+		allocate(buffer_pool::layout::position_normal, mesh.verticies.data(), mesh.normals.data(), mesh.verticies.size(),
+		         buffer_pool::layout::index32, mesh.indicies.data(), mesh.indicies.size());
+	else
+		allocate(buffer_pool::layout::position, mesh.verticies.data(), nullptr, mesh.verticies.size(),
+		         buffer_pool::layout::index32, mesh.indicies.data(), mesh.indicies.size());
+}
+
+mesh_buffer::mesh_buffer(buffer_pool &pool_, d3d11_buffer_device &buffers_, const mesh_view & mesh) :
+	pool(pool_),
+	buffers(buffers_)
+{
+	allocate(buffer_pool::layout::position, mesh.verticies, nullptr, mesh.vertex_count,
+	         buffer_pool::layout::index32, mesh.indicies, mesh.index_count);
+}
+
+mesh_buffer::mesh_buffer(buffer_pool &pool_, d3d11_buffer_device &buffers_, const packed_mesh & mesh) :
+	pool(pool_),
+	buffers(buffers_)
+{
+	if (not mesh.short_indicies.empty())
+		allocate(buffer_pool::layout::packed_position, mesh.verticies.data(), nullptr, mesh.verticies.size(),
+		         buffer_pool::layout::index16, mesh.short_indicies.data(), mesh.short_indicies.size());
+	else
+		allocate(buffer_pool::layout::packed_position, mesh.verticies.data(), nullptr, mesh.verticies.size(),
+		         buffer_pool::layout::index32, mesh.indicies.data(), mesh.indicies.size());
+}
+
+mesh_buffer::~mesh_buffer()
+{
+	pool.free(vertex_block);
+	pool.free(index_block);
+	pool.free(next_vertex_block);
+	pool.free(next_index_block);
+}
+
+void mesh_buffer::activate(direct3d::context_t)
+{
+	buffer_pool::location verticies{}, indicies{};
+	[[maybe_unused]] bool found = pool.find(vertex_block, verticies) and pool.find(index_block, indicies);
+	assert(found);
+
+	buffers.bind(verticies, vertex_layout, indicies, index_layout);
+	base_vertex = verticies.first;
+	first_index = indicies.first;
 }
 
 void mesh_buffer::draw(direct3d::context_t context)
 {
 	context->DrawIndexed(index_count,
-	                     0,
-	                     0);
+	                     first_index,
+	                     static_cast<int32_t>(base_vertex));
+}
+
+void mesh_buffer::draw(direct3d::context_t context, const index_range *ranges, size_t range_count)
+{
+	for (size_t r{ 0 }; r < range_count; r++)
+	{
+		context->DrawIndexed(ranges[r].index_count,
+		                     first_index + ranges[r].first_index,
+		                     static_cast<int32_t>(base_vertex));
+	}
+}
+
+void mesh_buffer::draw_instanced(direct3d::context_t context, uint32_t instance_count)
+{
+	context->DrawIndexedInstanced(index_count,
+	                              instance_count,
+	                              first_index,
+	                              static_cast<int32_t>(base_vertex),
+	                              0);
 }
 
 void mesh_buffer::activate_and_draw(direct3d::context_t context)
@@ -43,40 +211,67 @@ void mesh_buffer::activate_and_draw(direct3d::context_t context)
 	draw(context);
 }
 
-void mesh_buffer::make_buffer(direct3d::device_t device, const std::vector<vertex>& vertices)
+uint32_t mesh_buffer::element_size(mesh_stream stream) const
 {
-	vertex_size = sizeof(vertices.back());
+	switch (stream)
+	{
+	case mesh_stream::verticies:
+		return buffer_pool::stride(vertex_layout, 0);
+	case mesh_stream::normals:
+		return buffer_pool::stream_count(vertex_layout) > 1 ? buffer_pool::stride(vertex_layout, 1) : 0;
+	default:
+		return buffer_pool::stride(index_layout, 0);
+	}
+}
 
-	D3D11_BUFFER_DESC bd{};
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	bd.CPUAccessFlags = NULL;
-	bd.ByteWidth = vertex_size * static_cast<uint32_t>(vertices.size());
+void mesh_buffer::begin_contents(uint32_t vertex_count, uint32_t index_count_)
+{
+	assert(vertex_count > 0 and index_count_ > 0);
 
-	D3D11_SUBRESOURCE_DATA vertex_data{};
-	vertex_data.pSysMem = reinterpret_cast<const void *>(vertices.data());
+	// Begun again before finishing, the half written contents are dropped
+	pool.free(next_vertex_block);
+	pool.free(next_index_block);
 
-	auto hr = device->CreateBuffer(&bd,
-	                               &vertex_data,
-	                               vertex_buffer.put());
-	assert(hr == S_OK);
+	next_vertex_block = pool.allocate(vertex_layout, vertex_count, nullptr);
+	next_index_block = pool.allocate(index_layout, index_count_, nullptr);
+	next_index_count = index_count_;
+	filling = true;
 }
 
-void mesh_buffer::make_buffer(direct3d::device_t device, const std::vector<uint32_t>& indicies)
+void mesh_buffer::write(mesh_stream stream, uint32_t first, const void *data, uint32_t count)
 {
-	index_count = static_cast<uint32_t>(indicies.size());
+	if (stream == mesh_stream::indicies)
+		pool.write(filling ? next_index_block : index_block, 0, first, data, count);
+	else
+		pool.write(filling ? next_vertex_block : vertex_block, stream == mesh_stream::normals ? 1 : 0, first, data, count);
+}
 
-	D3D11_BUFFER_DESC bd{};
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	bd.CPUAccessFlags = NULL;
-	bd.ByteWidth = sizeof(uint32_t) * index_count;
+void mesh_buffer::finish_contents()
+{
+	if (not filling)
+		return;
 
-	D3D11_SUBRESOURCE_DATA index_data{};
-	index_data.pSysMem = reinterpret_cast<const void *>(indicies.data());
+	pool.free(vertex_block);
+	pool.free(index_block);
+	vertex_block = next_vertex_block;
+	index_block = next_index_block;
+	index_count = next_index_count;
 
-	auto hr = device->CreateBuffer(&bd,
-	                               &index_data,
-	                               index_buffer.put());
-	assert(hr == S_OK);
+	next_vertex_block = {};
+	next_index_block = {};
+	filling = false;
+}
+
+void mesh_buffer::allocate(buffer_pool::layout vertex_layout_, const void *vertices, const void *normals, size_t vertex_count,
+                           buffer_pool::layout index_layout_, const void *indicies, size_t index_count_)
+{
+	assert(vertex_count > 0 and index_count_ > 0);
+
+	vertex_layout = vertex_layout_;
+	index_layout = index_layout_;
+	index_count = static_cast<uint32_t>(index_count_);
+
+	const void *vertex_streams[]{ vertices, normals };
+	vertex_block = pool.allocate(vertex_layout, static_cast<uint32_t>(vertex_count), vertex_streams);
+	index_block = pool.allocate(index_layout, index_count, &indicies);
 }
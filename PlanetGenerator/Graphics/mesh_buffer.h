@@ -1,58 +1,110 @@
 #pragma once
 
 #include "direct3d.h"
+#include "buffer_pool.h"
+#include "mesh.h"
+#include "meshlet.h"
+#include "packed_mesh.h"
+#include "render_backend.h"
 #include <winrt/base.h>
 #include <DirectXMath.h>
+#include <array>
 #include <cstdint>
 #include <vector>
 
 
 namespace planet_generator
 {
-	struct vertex
+	// Direct3D buffers for buffer_pool's heaps. Remembers what geometry is bound, so meshes that share
+	// their heaps do not bind them again.
+	class d3d11_buffer_device final : public buffer_device
 	{
-		DirectX::XMFLOAT3 position;
-	};
+	public:
+		using buffer_t = winrt::com_ptr<ID3D11Buffer>;
 
-	struct mesh
-	{
-		std::vector<vertex> verticies;
-		std::vector<uint32_t> indicies;
-	};
+	public:
+		d3d11_buffer_device() = delete;
+		d3d11_buffer_device(direct3d::device_t device_, direct3d::context_t context_);
 
-	struct transforms
-	{
-		DirectX::XMMATRIX data;
+		uint32_t make_buffer(buffer_kind kind, size_t bytes) override;
+		void free_buffer(uint32_t buffer) override;
+		void write(uint32_t buffer, size_t offset, const void *data, size_t bytes) override;
+		void copy(uint32_t target, size_t target_offset, uint32_t source, size_t source_offset, size_t bytes) override;
+
+		// Vertex streams to input slots 0 and up; skipped if they are bound already
+		void bind(const buffer_pool::location &verticies, buffer_pool::layout vertex_layout,
+		          const buffer_pool::location &indicies, buffer_pool::layout index_layout);
+		// Whatever else bound geometry since, e.g. a new frame
+		void forget_bindings();
+
+	private:
+		direct3d::device_t device;
+		direct3d::context_t context;
+
+		std::vector<buffer_t> buffers;
+		std::vector<uint32_t> free_ids;
+
+		std::array<ID3D11Buffer *, buffer_pool::max_streams> bound_verticies{};
+		ID3D11Buffer *bound_indicies = nullptr;
+		DXGI_FORMAT bound_format{ DXGI_FORMAT_UNKNOWN };
 	};
 
+	// A mesh's verticies and indicies, in a buffer_pool's heaps. Draws address them with base vertex
+	// and start index, so they stay right however often the pool moves them.
 	class mesh_buffer
 	{
-	public:
-		using buffer_t = winrt::com_ptr<ID3D11Buffer>;
-
 	public:
 		mesh_buffer() = delete;
-		mesh_buffer(direct3d::device_t device, const std::vector<vertex> &vertices, const std::vector<uint32_t> &indicies);
-		mesh_buffer(direct3d::device_t device, const mesh &mesh);
+		mesh_buffer(buffer_pool &pool_, d3d11_buffer_device &buffers_, const std::vector<vertex> &vertices, const std::vector<uint32_t> &indicies);
+		// Normals, if the mesh has them, go in a second stream bound to input slot 1
+		mesh_buffer(buffer_pool &pool_, d3d11_buffer_device &buffers_, const mesh &mesh);
+		// Data is copied straight from the view into the GPU buffers, e.g. from a mapped planet file
+		mesh_buffer(buffer_pool &pool_, d3d11_buffer_device &buffers_, const mesh_view &mesh);
+		// 8 byte verticies, and 16 bit indicies when the mesh has them
+		mesh_buffer(buffer_pool &pool_, d3d11_buffer_device &buffers_, const packed_mesh &mesh);
 		~mesh_buffer();
 
+		mesh_buffer(const mesh_buffer &) = delete;
+		mesh_buffer &operator=(const mesh_buffer &) = delete;
+
 		void activate(direct3d::context_t context);
+		// Mesh has to be active
 		void draw(direct3d::context_t context);
+		void draw(direct3d::context_t context, const index_range *ranges, size_t range_count);
+		// Instances have to be bound too, see instance_buffer
+		void draw_instanced(direct3d::context_t context, uint32_t instance_count);
 
 		void activate_and_draw(direct3d::context_t context);
 
+		// As backend_mesh has them. New contents get blocks of their own, in the same layouts, and the old
+		// blocks are freed once they are written.
+		uint32_t element_size(mesh_stream stream) const;
+		void begin_contents(uint32_t vertex_count, uint32_t index_count);
+		void write(mesh_stream stream, uint32_t first, const void *data, uint32_t count);
+		void finish_contents();
+
 	private:
-		void make_buffer(direct3d::device_t device, const std::vector<vertex> &vertices);
-		void make_buffer(direct3d::device_t device, const std::vector<uint32_t> &indicies);
+		void allocate(buffer_pool::layout vertex_layout_, const void *vertices, const void *normals, size_t vertex_count,
+		              buffer_pool::layout index_layout_, const void *indicies, size_t index_count);
 
 	private:
-		buffer_t vertex_buffer;
-		buffer_t index_buffer;
+		buffer_pool &pool;
+		d3d11_buffer_device &buffers;
+
+		buffer_pool::layout vertex_layout{ buffer_pool::layout::position };
+		buffer_pool::layout index_layout{ buffer_pool::layout::index32 };
+		buffer_pool::allocation vertex_block{};
+		buffer_pool::allocation index_block{};
 
+		// Contents being written, until finish_contents
+		buffer_pool::allocation next_vertex_block{};
+		buffer_pool::allocation next_index_block{};
+		uint32_t next_index_count{ 0 };
+		bool filling{ false };
+
+		// Where the blocks were when the mesh was last activated
 		uint32_t index_count{ 0 },
-		         index_offset{ 0 },
-		         vertex_size{ 0 },
-		         vertex_offset{ 0 };
+		         first_index{ 0 },
+		         base_vertex{ 0 };
 	};
 }
-
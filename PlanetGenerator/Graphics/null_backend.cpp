@@ -0,0 +1,253 @@
+#include "null_backend.h"
+
+#include "mesh.h"
+#include "packed_mesh.h"
+
+#include <algorithm>
+
+using namespace planet_generator;
+
+// Takes the element sizes of the data it was made from, so writes to it size up the same
+class null_backend::null_mesh final : public backend_mesh
+{
+public:
+	null_mesh(null_backend &owner_, uint32_t id_, const std::array<uint32_t, 3> &sizes_) :
+		owner(owner_),
+		id(id_),
+		sizes(sizes_)
+	{}
+
+	void activate() override
+	{
+		owner.count(command_type::bind_mesh, id);
+	}
+
+	void draw() override
+	{
+		owner.count(command_type::draw, id);
+	}
+
+	void draw(const index_range *, size_t range_count) override
+	{
+		owner.count(command_type::draw_ranges, id, static_cast<uint32_t>(range_count));
+	}
+
+	void draw_instanced(uint32_t instance_count) override
+	{
+		owner.count(command_type::draw_instanced, id, instance_count);
+	}
+
+	uint32_t element_size(mesh_stream stream) const override
+	{
+		return sizes[static_cast<size_t>(stream)];
+	}
+
+	void begin_contents(uint32_t, uint32_t) override
+	{}
+
+	void write(mesh_stream, uint32_t, const void *, uint32_t count) override
+	{
+		owner.count(command_type::write_mesh, id, count);
+	}
+
+	void finish_contents() override
+	{}
+
+private:
+	null_backend &owner;
+	uint32_t id;
+	std::array<uint32_t, 3> sizes;      // verticies, normals, indicies
+};
+
+class null_backend::null_material final : public backend_material
+{
+public:
+	null_material(null_backend &owner_, uint32_t id_) :
+		owner(owner_),
+		id(id_)
+	{}
+
+	void activate() override
+	{
+		owner.count(command_type::bind_material, id);
+	}
+
+private:
+	null_backend &owner;
+	uint32_t id;
+};
+
+class null_backend::null_pipeline final : public backend_pipeline
+{
+public:
+	null_pipeline(null_backend &owner_, uint32_t id_) :
+		owner(owner_),
+		id(id_)
+	{}
+
+	void activate() override
+	{
+		owner.count(command_type::bind_pipeline, id);
+	}
+
+private:
+	null_backend &owner;
+	uint32_t id;
+};
+
+class null_backend::null_constants final : public backend_constants
+{
+public:
+	null_constants(null_backend &owner_, uint32_t id_, shader_slot slot_) :
+		owner(owner_),
+		id(id_),
+		slot(slot_)
+	{}
+
+	void activate() override
+	{
+		owner.count(command_type::bind_constants, id, static_cast<uint32_t>(slot));
+	}
+
+	void update(const transforms &) override
+	{
+		owner.count(command_type::update_constants, id);
+	}
+
+	shader_slot bound_slot() const override
+	{
+		return slot;
+	}
+
+private:
+	null_backend &owner;
+	uint32_t id;
+	shader_slot slot;
+};
+
+class null_backend::null_instances final : public backend_instances
+{
+public:
+	null_instances(null_backend &owner_, uint32_t id_, uint32_t capacity_) :
+		owner(owner_),
+		id(id_),
+		capacity(capacity_)
+	{}
+
+	void activate() override
+	{
+		owner.count(command_type::bind_instances, id);
+	}
+
+	void update(const instance_data *, uint32_t count_) override
+	{
+		instance_count = std::min(count_, capacity);
+		owner.count(command_type::update_instances, id, instance_count);
+	}
+
+	uint32_t count() const override
+	{
+		return instance_count;
+	}
+
+private:
+	null_backend &owner;
+	uint32_t id;
+	uint32_t capacity;
+	uint32_t instance_count = 0;
+};
+
+std::unique_ptr<backend_mesh> null_backend::make_mesh(const mesh &mesh_data)
+{
+	auto id = made[0]++;
+	count(command_type::make_mesh, id);
+	uint32_t normal_size = mesh_data.normals.empty() ? 0 : sizeof(DirectX::XMFLOAT3);
+	return std::make_unique<null_mesh>(*this, id, std::array<uint32_t, 3>{ sizeof(vertex), normal_size, sizeof(uint32_t) });
+}
+
+std::unique_ptr<backend_mesh> null_backend::make_mesh(const mesh_view &)
+{
+	auto id = made[0]++;
+	count(command_type::make_mesh, id);
+	return std::make_unique<null_mesh>(*this, id, std::array<uint32_t, 3>{ sizeof(vertex), 0, sizeof(uint32_t) });
+}
+
+std::unique_ptr<backend_mesh> null_backend::make_mesh(const packed_mesh &mesh_data)
+{
+	auto id = made[0]++;
+	count(command_type::make_mesh, id);
+	uint32_t index_size = mesh_data.short_indicies.empty() ? sizeof(uint32_t) : sizeof(uint16_t);
+	return std::make_unique<null_mesh>(*this, id, std::array<uint32_t, 3>{ sizeof(packed_vertex), 0, index_size });
+}
+
+std::unique_ptr<backend_material> null_backend::make_material(const material_description &)
+{
+	auto id = made[1]++;
+	count(command_type::make_material, id);
+	return std::make_unique<null_material>(*this, id);
+}
+
+std::unique_ptr<backend_pipeline> null_backend::make_pipeline(const pipeline_description &)
+{
+	auto id = made[2]++;
+	count(command_type::make_pipeline, id);
+	return std::make_unique<null_pipeline>(*this, id);
+}
+
+std::unique_ptr<backend_constants> null_backend::make_constants(const transforms &, shader_slot slot)
+{
+	auto id = made[3]++;
+	count(command_type::make_constants, id, static_cast<uint32_t>(slot));
+	return std::make_unique<null_constants>(*this, id, slot);
+}
+
+std::unique_ptr<backend_instances> null_backend::make_instances(uint32_t capacity)
+{
+	auto id = made[4]++;
+	count(command_type::make_instances, id, capacity);
+	return std::make_unique<null_instances>(*this, id, capacity);
+}
+
+void null_backend::begin_frame()
+{
+	count(command_type::begin_frame, 0);
+}
+
+void null_backend::end_frame()
+{
+	count(command_type::end_frame, 0);
+}
+
+void null_backend::resize()
+{
+	count(command_type::resize, 0);
+}
+
+uint64_t null_backend::calls(command_type type) const
+{
+	return call_counts[static_cast<size_t>(type)];
+}
+
+void null_backend::reset_calls()
+{
+	call_counts.fill(0);
+}
+
+void null_backend::on_command(command_type, uint32_t, uint32_t)
+{}
+
+void null_backend::count(command_type type, uint32_t object, uint32_t value)
+{
+	++call_counts[static_cast<size_t>(type)];
+	on_command(type, object, value);
+}
+
+void recording_backend::clear()
+{
+	commands.clear();
+}
+
+void recording_backend::on_command(command_type type, uint32_t object, uint32_t value)
+{
+	commands.push_back({ type, object, value });
+}
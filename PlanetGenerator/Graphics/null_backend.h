@@ -0,0 +1,98 @@
+#pragma once
+
+#include "render_backend.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace planet_generator
+{
+	// Backend without a device: objects do nothing but count what is asked of them.
+	// Measures what renderer itself costs per draw, and runs where there is no GPU.
+	class null_backend : public render_backend
+	{
+	public:
+		enum class command_type
+		{
+			make_mesh,
+			make_material,
+			make_pipeline,
+			make_constants,
+			make_instances,
+			bind_mesh,
+			bind_material,
+			bind_pipeline,
+			bind_constants,
+			bind_instances,
+			update_constants,
+			update_instances,
+			write_mesh,
+			draw,
+			draw_ranges,
+			draw_instanced,
+			begin_frame,
+			end_frame,
+			resize,
+
+			count
+		};
+
+	public:
+		std::unique_ptr<backend_mesh> make_mesh(const mesh &mesh_data) override;
+		std::unique_ptr<backend_mesh> make_mesh(const mesh_view &mesh_data) override;
+		std::unique_ptr<backend_mesh> make_mesh(const packed_mesh &mesh_data) override;
+		std::unique_ptr<backend_material> make_material(const material_description &description) override;
+		std::unique_ptr<backend_pipeline> make_pipeline(const pipeline_description &description) override;
+		std::unique_ptr<backend_constants> make_constants(const transforms &data, shader_slot slot) override;
+		std::unique_ptr<backend_instances> make_instances(uint32_t capacity) override;
+
+		void begin_frame() override;
+		void end_frame() override;
+		void resize() override;
+
+		// Since construction or the last reset_calls
+		uint64_t calls(command_type type) const;
+		void reset_calls();
+
+	protected:
+		// Every call comes through here; object is the index it was made with, in its own kind.
+		// value is the range count of draw_ranges, the slot of make_constants, the element count of
+		// write_mesh, the capacity of make_instances and the instance count of update_instances and
+		// draw_instanced; 0 otherwise.
+		virtual void on_command(command_type type, uint32_t object, uint32_t value);
+
+	private:
+		class null_mesh;
+		class null_material;
+		class null_pipeline;
+		class null_constants;
+		class null_instances;
+
+		void count(command_type type, uint32_t object, uint32_t value = 0);
+
+	private:
+		std::array<uint64_t, static_cast<size_t>(command_type::count)> call_counts{};
+		std::array<uint32_t, 5> made{};     // meshes, materials, pipelines, constants, instance sets
+	};
+
+	// Also keeps every call, in order, to check the stream a frame turns into
+	class recording_backend final : public null_backend
+	{
+	public:
+		struct command
+		{
+			command_type type;
+			uint32_t object;
+			uint32_t value;
+		};
+
+	public:
+		void clear();
+
+		std::vector<command> commands;
+
+	protected:
+		void on_command(command_type type, uint32_t object, uint32_t value) override;
+	};
+}
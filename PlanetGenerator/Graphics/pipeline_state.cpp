@@ -6,6 +6,22 @@ using namespace planet_generator;
 namespace
 {
 	constexpr uint32_t max_anisotropy = 16U;
+
+	D3D11_PRIMITIVE_TOPOLOGY to_d3d_topology(primitive_topology topology)
+	{
+		switch (topology)
+		{
+		case primitive_topology::TriangleList:
+			return D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		case primitive_topology::TriangleStrip:
+			return D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+		case primitive_topology::LineList:
+			return D3D11_PRIMITIVE_TOPOLOGY_LINELIST;
+		case primitive_topology::PointList:
+			return D3D11_PRIMITIVE_TOPOLOGY_POINTLIST;
+		}
+		return D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	}
 }
 
 pipeline_state::pipeline_state(direct3d::device_t device, const description & state_desc)
@@ -15,7 +31,7 @@ pipeline_state::pipeline_state(direct3d::device_t device, const description & st
 	make_rasterizer_state(device, state_desc.rasterizer);
 	make_sampler_state(device, state_desc.sampler);
 
-	primitive_topology = state_desc.primitive_topology;
+	topology = to_d3d_topology(state_desc.topology);
 }
 
 pipeline_state::~pipeline_state() = default;
@@ -35,7 +51,7 @@ void pipeline_state::activate(direct3d::context_t context)
 	                       samplers);
 
 
-	context->IASetPrimitiveTopology(primitive_topology);
+	context->IASetPrimitiveTopology(topology);
 }
 
 void pipeline_state::make_blend_state(direct3d::device_t device, blend_mode blend)
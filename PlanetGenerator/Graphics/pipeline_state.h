@@ -1,13 +1,12 @@
 #pragma once
 
 #include "direct3d.h"
+#include "render_backend.h"
 #include <winrt/base.h>
 #include <vector>
 
 namespace planet_generator
 {
-	struct pipeline_description;
-
 	class pipeline_state
 	{
 	public:
@@ -16,40 +15,6 @@ namespace planet_generator
 		using rasterizer_state_t = winrt::com_ptr<ID3D11RasterizerState>;
 		using sampler_state_t = winrt::com_ptr<ID3D11SamplerState>;
 
-	public:
-		enum class blend_mode
-		{
-			Opaque,
-			Alpha,
-			Additive,
-			NonPremultipled
-		};
-
-		enum class depth_stencil_mode
-		{
-			None,
-			ReadWrite,
-			ReadOnly
-		};
-
-		enum class rasterizer_mode
-		{
-			CullNone,
-			CullClockwise,
-			CullAntiClockwise,
-			Wireframe
-		};
-
-		enum class sampler_mode
-		{
-			PointWrap,
-			PointClamp,
-			LinearWrap,
-			LinearClamp,
-			AnisotropicWrap,
-			AnisotropicClamp
-		};
-
 		using description = pipeline_description;
 
 	public:
@@ -71,17 +36,6 @@ namespace planet_generator
 		rasterizer_state_t rasterizer_state;
 		sampler_state_t sampler_state;
 
-		D3D11_PRIMITIVE_TOPOLOGY primitive_topology;
-	};
-
-	struct pipeline_description
-	{
-		pipeline_state::blend_mode blend;
-		pipeline_state::depth_stencil_mode depth_stencil;
-		pipeline_state::rasterizer_mode rasterizer;
-		pipeline_state::sampler_mode sampler;
-
-		D3D11_PRIMITIVE_TOPOLOGY primitive_topology;
+		D3D11_PRIMITIVE_TOPOLOGY topology;
 	};
 }
-
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "instancing.h"
+#include "meshlet.h"
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace planet_generator
+{
+	struct vertex;
+	struct mesh;
+	struct mesh_view;
+	struct packed_mesh;
+
+	struct transforms
+	{
+		DirectX::XMMATRIX data;
+	};
+
+	enum class shader_stage
+	{
+		vertex,
+		pixel
+	};
+
+	enum class shader_slot
+	{
+		projection = 0,
+		view = 1,
+		transform = 2,
+		vertex_decode = 3,  // height_range of packed verticies, in the first row
+		world_view_projection = 4   // transform * view * projection, for the _wvp vertex shaders
+	};
+
+	enum class blend_mode
+	{
+		Opaque,
+		Alpha,
+		Additive,
+		NonPremultipled
+	};
+
+	enum class depth_stencil_mode
+	{
+		None,
+		ReadWrite,
+		ReadOnly
+	};
+
+	enum class rasterizer_mode
+	{
+		CullNone,
+		CullClockwise,
+		CullAntiClockwise,
+		Wireframe
+	};
+
+	enum class sampler_mode
+	{
+		PointWrap,
+		PointClamp,
+		LinearWrap,
+		LinearClamp,
+		AnisotropicWrap,
+		AnisotropicClamp
+	};
+
+	enum class primitive_topology
+	{
+		TriangleList,
+		TriangleStrip,
+		LineList,
+		PointList
+	};
+
+	enum class input_layout_mode
+	{
+		position,
+		normal,
+		texcoord,
+		packed_position,    // packed_vertex; octahedral direction and height, decoded in the vertex shader
+		instance            // instance_data, one per instance, from the bound backend_instances
+	};
+
+	// Parts of a mesh's data that can be written after it is made
+	enum class mesh_stream
+	{
+		verticies,
+		normals,
+		indicies
+	};
+
+	struct pipeline_description
+	{
+		blend_mode blend;
+		depth_stencil_mode depth_stencil;
+		rasterizer_mode rasterizer;
+		sampler_mode sampler;
+
+		primitive_topology topology;
+	};
+
+	struct material_description
+	{
+		const std::vector<input_layout_mode> &input_layout;
+		const std::vector<uint8_t> &vertex_shader_file;
+		const std::vector<uint8_t> &pixel_shader_file;
+	};
+
+	// Objects a backend makes. Each binds itself to the backend's device when activated.
+	class backend_mesh
+	{
+	public:
+		virtual ~backend_mesh() = default;
+
+		virtual void activate() = 0;
+		// Whole mesh, or only the given index ranges of it; the mesh has to be active
+		virtual void draw() = 0;
+		virtual void draw(const index_range *ranges, size_t range_count) = 0;
+		// Whole mesh, once per instance of the active backend_instances
+		virtual void draw_instanced(uint32_t instance_count) = 0;
+
+		// Bytes per element of the stream as the mesh keeps it; 0 for a stream the mesh does not have
+		virtual uint32_t element_size(mesh_stream stream) const = 0;
+		// New contents of these sizes, filled in by write; draws keep using the old ones until finish_contents
+		virtual void begin_contents(uint32_t vertex_count, uint32_t index_count) = 0;
+		// Elements [first, first + count) of the stream, in the contents being filled in if any are begun.
+		// Writes past the end are dropped.
+		virtual void write(mesh_stream stream, uint32_t first, const void *data, uint32_t count) = 0;
+		virtual void finish_contents() = 0;
+	};
+
+	class backend_material
+	{
+	public:
+		virtual ~backend_material() = default;
+
+		virtual void activate() = 0;
+	};
+
+	class backend_pipeline
+	{
+	public:
+		virtual ~backend_pipeline() = default;
+
+		virtual void activate() = 0;
+	};
+
+	class backend_constants
+	{
+	public:
+		virtual ~backend_constants() = default;
+
+		virtual void activate() = 0;
+		virtual void update(const transforms &data) = 0;
+		virtual shader_slot bound_slot() const = 0;
+	};
+
+	// Per instance data for instanced draws, written whole whenever it changes
+	class backend_instances
+	{
+	public:
+		virtual ~backend_instances() = default;
+
+		virtual void activate() = 0;
+		// Instances past the capacity it was made with are dropped
+		virtual void update(const instance_data *data, uint32_t count) = 0;
+		virtual uint32_t count() const = 0;
+	};
+
+	struct constants_write
+	{
+		backend_constants *target;
+		const transforms *data;
+	};
+
+	// What renderer draws with: a device, and the target frames go to.
+	// d3d11_backend on Windows; null_backend and recording_backend run anywhere, with no device at all.
+	class render_backend
+	{
+	public:
+		virtual ~render_backend() = default;
+
+		[[nodiscard]]
+		virtual std::unique_ptr<backend_mesh> make_mesh(const mesh &mesh_data) = 0;
+		[[nodiscard]]
+		virtual std::unique_ptr<backend_mesh> make_mesh(const mesh_view &mesh_data) = 0;
+		[[nodiscard]]
+		virtual std::unique_ptr<backend_mesh> make_mesh(const packed_mesh &mesh_data) = 0;
+		[[nodiscard]]
+		virtual std::unique_ptr<backend_material> make_material(const material_description &description) = 0;
+		[[nodiscard]]
+		virtual std::unique_ptr<backend_pipeline> make_pipeline(const pipeline_description &description) = 0;
+		[[nodiscard]]
+		virtual std::unique_ptr<backend_constants> make_constants(const transforms &data, shader_slot slot) = 0;
+		[[nodiscard]]
+		virtual std::unique_ptr<backend_instances> make_instances(uint32_t capacity) = 0;
+
+		// All the constants that changed for a frame, each once, before any of its draws.
+		// Backends that can write them together override this; by default each is updated on its own.
+		virtual void update_constants(const constants_write *writes, size_t count)
+		{
+			for (size_t w{ 0 }; w < count; w++)
+			{
+				writes[w].target->update(*writes[w].data);
+			}
+		}
+
+		// Clears the target
+		virtual void begin_frame() = 0;
+		// Shows the frame
+		virtual void end_frame() = 0;
+		// Target has to match the window's new size
+		virtual void resize() = 0;
+	};
+}
@@ -0,0 +1,467 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace planet_generator;
+
+namespace
+{
+	// Bits of each key field, most significant first
+	constexpr uint32_t pipeline_bits = 8;
+	constexpr uint32_t material_bits = 10;
+	constexpr uint32_t constant_set_bits = 12;
+	constexpr uint32_t depth_bits = 18;
+	constexpr uint32_t mesh_bits = 16;
+	static_assert(pipeline_bits + material_bits + constant_set_bits + depth_bits + mesh_bits == 64);
+
+	constexpr uint32_t radix_bits = 8;
+	constexpr uint32_t radix_passes = 64 / radix_bits;
+	constexpr size_t radix_buckets = size_t{ 1 } << radix_bits;
+
+	// Below this a plain insertion sort beats clearing the histograms
+	constexpr size_t min_radix_count = 64;
+
+	constexpr uint64_t field(uint32_t value, uint32_t bits)
+	{
+		return value & ((uint64_t{ 1 } << bits) - 1);
+	}
+
+	// Top bits of a non negative float, which sort the same as the float itself
+	uint32_t depth_field(float depth)
+	{
+		depth = std::max(depth, 0.0f);
+		uint32_t bits{};
+		std::memcpy(&bits, &depth, sizeof(bits));
+		return bits >> (31 - depth_bits);       // sign bit is always clear
+	}
+
+	// Where state is in states, or count if it is not there; there are only a handful per frame
+	size_t find_state(const draw_state *states, size_t count, const draw_state &state)
+	{
+		return static_cast<size_t>(std::find_if(states, states + count, [&state](const draw_state &s)
+		{
+			return s.pipeline == state.pipeline and s.material == state.material and s.constants == state.constants;
+		}) - states);
+	}
+
+	// States with the same constant buffers share a set, numbered by the first of them
+	size_t find_constant_set(const draw_state *states, size_t count, const draw_state &state)
+	{
+		return static_cast<size_t>(std::find_if(states, states + count, [&state](const draw_state &s)
+		{
+			return s.constants == state.constants;
+		}) - states);
+	}
+}
+
+void recording_sink::bind_pipeline(object_id id)
+{
+	commands.push_back({ command_type::bind_pipeline, id.slot, id.generation, 0 });
+}
+
+void recording_sink::bind_material(object_id id)
+{
+	commands.push_back({ command_type::bind_material, id.slot, id.generation, 0 });
+}
+
+void recording_sink::bind_constants(uint32_t slot, object_id id)
+{
+	commands.push_back({ command_type::bind_constants, id.slot, id.generation, slot });
+}
+
+void recording_sink::bind_mesh(object_id id)
+{
+	commands.push_back({ command_type::bind_mesh, id.slot, id.generation, 0 });
+}
+
+void recording_sink::bind_instances(object_id id)
+{
+	commands.push_back({ command_type::bind_instances, id.slot, id.generation, 0 });
+}
+
+void recording_sink::draw()
+{
+	commands.push_back({ command_type::draw, 0, 0, 0 });
+}
+
+void recording_sink::draw(const index_range *, size_t range_count)
+{
+	commands.push_back({ command_type::draw_ranges, static_cast<uint32_t>(range_count), 0, 0 });
+}
+
+void recording_sink::draw_instanced()
+{
+	commands.push_back({ command_type::draw_instanced, 0, 0, 0 });
+}
+
+size_t recording_sink::count(command_type type) const
+{
+	return static_cast<size_t>(std::count_if(commands.begin(), commands.end(),
+	                                          [type](const command &c) { return c.type == type; }));
+}
+
+void recording_sink::clear()
+{
+	commands.clear();
+}
+
+uint64_t planet_generator::make_sort_key(uint32_t pipeline, uint32_t material, uint32_t constant_set, float depth, uint32_t mesh_id)
+{
+	uint64_t key = field(pipeline, pipeline_bits);
+	key = (key << material_bits) | field(material, material_bits);
+	key = (key << constant_set_bits) | field(constant_set, constant_set_bits);
+	key = (key << depth_bits) | field(depth_field(depth), depth_bits);
+	key = (key << mesh_bits) | field(mesh_id, mesh_bits);
+	return key;
+}
+
+void planet_generator::radix_sort(sort_entry *entries, size_t count, sort_entry *scratch)
+{
+	if (count < min_radix_count)
+	{
+		for (size_t i{ 1 }; i < count; i++)
+		{
+			auto entry = entries[i];
+			size_t j = i;
+			for (; j > 0 and entries[j - 1].key > entry.key; j--)
+			{
+				entries[j] = entries[j - 1];
+			}
+			entries[j] = entry;
+		}
+		return;
+	}
+
+	// Every pass's histogram in one read of the keys
+	uint32_t histograms[radix_passes][radix_buckets]{};
+	for (size_t i{ 0 }; i < count; i++)
+	{
+		for (uint32_t pass{ 0 }; pass < radix_passes; pass++)
+		{
+			histograms[pass][(entries[i].key >> (pass * radix_bits)) & (radix_buckets - 1)]++;
+		}
+	}
+
+	auto *source = entries;
+	auto *target = scratch;
+	for (uint32_t pass{ 0 }; pass < radix_passes; pass++)
+	{
+		auto &histogram = histograms[pass];
+		uint32_t shift = pass * radix_bits;
+
+		// Nothing to do when every key has the same byte here, which is most of them
+		if (histogram[(source[0].key >> shift) & (radix_buckets - 1)] == count)
+			continue;
+
+		uint32_t offset{ 0 };
+		for (auto &bucket : histogram)
+		{
+			auto bucket_count = bucket;
+			bucket = offset;
+			offset += bucket_count;
+		}
+
+		for (size_t i{ 0 }; i < count; i++)
+		{
+			target[histogram[(source[i].key >> shift) & (radix_buckets - 1)]++] = source[i];
+		}
+		std::swap(source, target);
+	}
+
+	if (source != entries)
+	{
+		std::copy(source, source + count, entries);
+	}
+}
+
+void state_tracker::reset()
+{
+	bound = {};
+	bound_mesh = {};
+	bound_instances = {};
+}
+
+void state_tracker::draw(const draw_state &state, object_id mesh_id, const index_range *ranges, uint32_t range_count,
+                         command_sink &sink, submit_statistics &stats, object_id instances_id)
+{
+	auto bind = [&stats](object_id &bound_id, object_id id, uint32_t &bind_count)
+	{
+		if (id.slot == no_object)
+			return false;
+		if (bound_id == id)
+		{
+			stats.skipped_binds++;
+			return false;
+		}
+		bound_id = id;
+		bind_count++;
+		return true;
+	};
+
+	if (bind(bound.pipeline, state.pipeline, stats.pipeline_binds))
+		sink.bind_pipeline(state.pipeline);
+	if (bind(bound.material, state.material, stats.material_binds))
+		sink.bind_material(state.material);
+	for (uint32_t slot{ 0 }; slot < constant_slot_count; slot++)
+	{
+		if (bind(bound.constants[slot], state.constants[slot], stats.constant_binds))
+			sink.bind_constants(slot, state.constants[slot]);
+	}
+	if (bind(bound_mesh, mesh_id, stats.mesh_binds))
+		sink.bind_mesh(mesh_id);
+
+	stats.draws++;
+	if (instances_id.slot != no_object)
+	{
+		if (bind(bound_instances, instances_id, stats.instance_binds))
+			sink.bind_instances(instances_id);
+		stats.instanced_draws++;
+		sink.draw_instanced();
+	}
+	else if (range_count == 0)
+		sink.draw();
+	else
+		sink.draw(ranges, range_count);
+}
+
+void render_list::set_pipeline(object_id id)
+{
+	current.pipeline = id;
+}
+
+void render_list::set_material(object_id id)
+{
+	current.material = id;
+}
+
+void render_list::set_constants(uint32_t slot, object_id id)
+{
+	assert(slot < constant_slot_count);
+	current.constants[slot] = id;
+}
+
+void render_list::add_draw(object_id mesh_id, float depth)
+{
+	add_draw(mesh_id, nullptr, 0, depth);
+}
+
+void render_list::add_draw(object_id mesh_id, const index_range *ranges_, size_t range_count, float depth)
+{
+	add(mesh_id, ranges_, range_count, {}, depth);
+}
+
+void render_list::add_instanced_draw(object_id mesh_id, object_id instances_id, float depth)
+{
+	add(mesh_id, nullptr, 0, instances_id, depth);
+}
+
+void render_list::add(object_id mesh_id, const index_range *ranges_, size_t range_count, object_id instances_id, float depth)
+{
+	auto state = find_state(states.data(), states.size(), current);
+	if (state == states.size())
+		states.push_back(current);
+	auto constant_set = find_constant_set(states.data(), states.size(), current);
+
+	auto index = static_cast<uint32_t>(draws.size());
+	draws.push_back({ mesh_id, static_cast<uint32_t>(state), static_cast<uint32_t>(ranges.size()), static_cast<uint32_t>(range_count), instances_id });
+	ranges.insert(ranges.end(), ranges_, ranges_ + range_count);
+	keys.push_back({ make_sort_key(current.pipeline.slot, current.material.slot, static_cast<uint32_t>(constant_set), depth, mesh_id.slot), index });
+	sorted = false;
+}
+
+void render_list::clear()
+{
+	current = {};
+	states.clear();
+	draws.clear();
+	ranges.clear();
+	keys.clear();
+	sorted = true;
+}
+
+void render_list::execute(state_tracker &tracker, command_sink &sink, submit_statistics &stats)
+{
+	if (not sorted)
+	{
+		std::vector<sort_entry> scratch(keys.size());
+		radix_sort(keys.data(), keys.size(), scratch.data());
+		sorted = true;
+	}
+
+	for (auto &entry : keys)
+	{
+		const auto &d = draws[entry.index];
+		tracker.draw(states[d.state], d.mesh_id, ranges.data() + d.first_range, d.range_count, sink, stats, d.instances_id);
+	}
+}
+
+const draw_state &render_list::end_state() const
+{
+	return current;
+}
+
+render_queue::render_queue() :
+	render_queue(settings{})
+{}
+
+render_queue::render_queue(const settings &queue_settings_) :
+	queue_settings(queue_settings_),
+	arena(queue_settings_.max_draws * (sizeof(draw) + 2 * sizeof(sort_entry)) +     // keys, and scratch to sort them
+	      queue_settings_.max_ranges * sizeof(index_range) +
+	      queue_settings_.max_states * sizeof(draw_state) +
+	      queue_settings_.max_lists * sizeof(render_list *) +
+	      5 * alignof(std::max_align_t))
+{
+	begin_frame();
+}
+
+void render_queue::set_pipeline(object_id id)
+{
+	if (current.pipeline != id)
+		current_index = no_object;
+	current.pipeline = id;
+}
+
+void render_queue::set_material(object_id id)
+{
+	if (current.material != id)
+		current_index = no_object;
+	current.material = id;
+}
+
+void render_queue::set_constants(uint32_t slot, object_id id)
+{
+	assert(slot < constant_slot_count);
+	if (current.constants[slot] != id)
+		current_index = no_object;
+	current.constants[slot] = id;
+}
+
+void render_queue::add_draw(object_id mesh_id, float depth)
+{
+	add_draw(mesh_id, nullptr, 0, depth);
+}
+
+void render_queue::add_draw(object_id mesh_id, const index_range *ranges, size_t range_count, float depth)
+{
+	add(mesh_id, ranges, range_count, {}, depth);
+}
+
+void render_queue::add_instanced_draw(object_id mesh_id, object_id instances_id, float depth)
+{
+	add(mesh_id, nullptr, 0, instances_id, depth);
+}
+
+void render_queue::add(object_id mesh_id, const index_range *ranges, size_t range_count, object_id instances_id, float depth)
+{
+	auto state = current_state_index();
+	index_range *copied = nullptr;
+	if (draw_count < queue_settings.max_draws and state != no_object and range_count > 0 and
+	    range_total + range_count <= queue_settings.max_ranges)
+	{
+		copied = arena.allocate<index_range>(range_count);
+	}
+	if (draw_count == queue_settings.max_draws or state == no_object or (range_count > 0 and not copied) or
+	    range_total + range_count > queue_settings.max_ranges)
+	{
+		dropped_draws++;
+		return;
+	}
+
+	std::copy(ranges, ranges + range_count, copied);
+	range_total += static_cast<uint32_t>(range_count);
+	draws[draw_count] = { mesh_id, state, copied, static_cast<uint32_t>(range_count), instances_id };
+	keys[draw_count] = { make_sort_key(current.pipeline.slot, current.material.slot, current_constant_set, depth, mesh_id.slot), draw_count };
+	draw_count++;
+}
+
+void render_queue::add_list(render_list &list)
+{
+	if (list_count == queue_settings.max_lists)
+	{
+		dropped_draws++;
+		return;
+	}
+	lists[list_count++] = &list;
+
+	// Whatever the list sets stays set for the draws after it
+	const auto &list_state = list.end_state();
+	auto inherit = [this](object_id &id, object_id list_id)
+	{
+		if (list_id.slot != no_object and list_id != id)
+		{
+			id = list_id;
+			current_index = no_object;
+		}
+	};
+	inherit(current.pipeline, list_state.pipeline);
+	inherit(current.material, list_state.material);
+	for (size_t slot{ 0 }; slot < constant_slot_count; slot++)
+	{
+		inherit(current.constants[slot], list_state.constants[slot]);
+	}
+}
+
+void render_queue::submit(command_sink &sink)
+{
+	frame_stats = {};
+	frame_stats.dropped_draws = dropped_draws;
+
+	tracker.reset();
+	for (uint32_t l{ 0 }; l < list_count; l++)
+	{
+		lists[l]->execute(tracker, sink, frame_stats);
+	}
+
+	radix_sort(keys, draw_count, scratch);
+
+	for (uint32_t k{ 0 }; k < draw_count; k++)
+	{
+		const auto &d = draws[keys[k].index];
+		tracker.draw(states[d.state], d.mesh_id, d.ranges, d.range_count, sink, frame_stats, d.instances_id);
+	}
+
+	begin_frame();
+}
+
+const render_queue::statistics &render_queue::stats() const
+{
+	return frame_stats;
+}
+
+void render_queue::begin_frame()
+{
+	arena.reset();
+	states = arena.allocate<draw_state>(queue_settings.max_states);
+	draws = arena.allocate<draw>(queue_settings.max_draws);
+	keys = arena.allocate<sort_entry>(queue_settings.max_draws);
+	scratch = arena.allocate<sort_entry>(queue_settings.max_draws);
+	lists = arena.allocate<render_list *>(queue_settings.max_lists);
+	assert(states and draws and keys and scratch and lists);
+
+	state_count = 0;
+	draw_count = 0;
+	range_total = 0;
+	list_count = 0;
+	dropped_draws = 0;
+	current_index = no_object;
+}
+
+uint32_t render_queue::current_state_index()
+{
+	if (current_index != no_object)
+		return current_index;
+
+	auto found = find_state(states, state_count, current);
+	if (found == state_count)
+	{
+		if (state_count == queue_settings.max_states)
+			return no_object;
+		states[state_count++] = current;
+	}
+	current_index = static_cast<uint32_t>(found);
+	current_constant_set = static_cast<uint32_t>(find_constant_set(states, state_count, current));
+	return current_index;
+}
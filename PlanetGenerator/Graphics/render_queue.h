@@ -0,0 +1,272 @@
+#pragma once
+
+#include "frame_arena.h"
+#include "meshlet.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace planet_generator
+{
+	// Constant buffer slots a draw can have bound, one per shader_slot
+	constexpr size_t constant_slot_count = 5;
+
+	// Slot of a renderer object, 0 based; no_object where nothing is bound
+	constexpr uint32_t no_object = std::numeric_limits<uint32_t>::max();
+
+	// Renderer object a command is for: its slot, and the generation the slot had when the command was recorded,
+	// so a command for an object since removed can be told from one for whatever took its slot, see slot_map
+	struct object_id
+	{
+		uint32_t slot = no_object;
+		uint32_t generation = 0;
+	};
+
+	inline bool operator==(const object_id &a, const object_id &b)
+	{
+		return a.slot == b.slot and a.generation == b.generation;
+	}
+
+	inline bool operator!=(const object_id &a, const object_id &b)
+	{
+		return not (a == b);
+	}
+
+	// Everything a draw needs bound, besides its mesh
+	struct draw_state
+	{
+		object_id pipeline{};
+		object_id material{};
+		std::array<object_id, constant_slot_count> constants{};
+	};
+
+	// Where a sorted frame goes, bind by bind and draw by draw. Binds arrive only when they change something.
+	class command_sink
+	{
+	public:
+		virtual ~command_sink() = default;
+
+		virtual void bind_pipeline(object_id id) = 0;
+		virtual void bind_material(object_id id) = 0;
+		virtual void bind_constants(uint32_t slot, object_id id) = 0;
+		virtual void bind_mesh(object_id id) = 0;
+		virtual void bind_instances(object_id id) = 0;
+		// Draw the whole of the bound mesh, or only some index ranges of it
+		virtual void draw() = 0;
+		virtual void draw(const index_range *ranges, size_t range_count) = 0;
+		// Whole of the bound mesh, once per instance in the bound instance set
+		virtual void draw_instanced() = 0;
+	};
+
+	// Keeps every command it is given, to check what a frame submits without a device
+	class recording_sink : public command_sink
+	{
+	public:
+		enum class command_type
+		{
+			bind_pipeline,
+			bind_material,
+			bind_constants,
+			bind_mesh,
+			bind_instances,
+			draw,
+			draw_ranges,
+			draw_instanced
+		};
+
+		struct command
+		{
+			command_type type;
+			uint32_t id;            // slot of the object bound; range count for draw_ranges
+			uint32_t generation;    // of the object bound
+			uint32_t slot;          // bind_constants only
+		};
+
+	public:
+		void bind_pipeline(object_id id) override;
+		void bind_material(object_id id) override;
+		void bind_constants(uint32_t slot, object_id id) override;
+		void bind_mesh(object_id id) override;
+		void bind_instances(object_id id) override;
+		void draw() override;
+		void draw(const index_range *ranges, size_t range_count) override;
+		void draw_instanced() override;
+
+		size_t count(command_type type) const;
+		void clear();
+
+		std::vector<command> commands;
+	};
+
+	// Draw key, most significant first: pipeline, material, set of constant buffers, depth, mesh.
+	// Sorting by it groups draws by their most expensive state, then goes front to back.
+	// Ids wider than their field wrap around, which only costs some grouping, never correctness.
+	[[nodiscard]]
+	uint64_t make_sort_key(uint32_t pipeline, uint32_t material, uint32_t constant_set, float depth, uint32_t mesh_id);
+
+	struct sort_entry
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	// Stable LSD radix sort on the key, a byte at a time; bytes every key shares are skipped.
+	// scratch needs room for count entries.
+	void radix_sort(sort_entry *entries, size_t count, sort_entry *scratch);
+
+	struct submit_statistics
+	{
+		uint32_t draws;
+		uint32_t instanced_draws;   // of draws
+		uint32_t pipeline_binds;
+		uint32_t material_binds;
+		uint32_t constant_binds;
+		uint32_t mesh_binds;
+		uint32_t instance_binds;
+		uint32_t skipped_binds;     // binds a draw needed, but that were already bound
+		uint32_t dropped_draws;     // did not fit in the frame's command buffer
+	};
+
+	// Remembers what the sink has bound, so binds that would change nothing are skipped
+	class state_tracker
+	{
+	public:
+		// Nothing is known to be bound
+		void reset();
+		// Binds whatever of state and mesh is not bound yet, then draws; ranges may be null for the whole mesh.
+		// With an instance set the whole mesh is drawn instanced, and ranges are ignored.
+		void draw(const draw_state &state, object_id mesh_id, const index_range *ranges, uint32_t range_count,
+		          command_sink &sink, submit_statistics &stats, object_id instances_id = {});
+
+	private:
+		draw_state bound{};
+		object_id bound_mesh{};
+		object_id bound_instances{};
+	};
+
+	// Draws recorded once and replayed every frame it is queued, until it is cleared or added to.
+	// Recorded like render_queue: state applies to the draws added after it. The draws are sorted by
+	// their keys the first time the list runs after a change, and not again until the next change.
+	class render_list
+	{
+	public:
+		void set_pipeline(object_id id);
+		void set_material(object_id id);
+		void set_constants(uint32_t slot, object_id id);
+
+		void add_draw(object_id mesh_id, float depth = 0.0f);
+		// Ranges are copied; with none the whole mesh is drawn
+		void add_draw(object_id mesh_id, const index_range *ranges, size_t range_count, float depth = 0.0f);
+		// Whole mesh, once for each instance in the set
+		void add_instanced_draw(object_id mesh_id, object_id instances_id, float depth = 0.0f);
+
+		void clear();
+
+		void execute(state_tracker &tracker, command_sink &sink, submit_statistics &stats);
+
+		// State the list leaves set, no_object in whatever it never set
+		const draw_state &end_state() const;
+
+	private:
+		struct draw
+		{
+			object_id mesh_id;
+			uint32_t state;             // into states
+			uint32_t first_range;
+			uint32_t range_count;       // 0 draws the whole mesh
+			object_id instances_id;     // no_object for a draw that is not instanced
+		};
+
+		void add(object_id mesh_id, const index_range *ranges, size_t range_count, object_id instances_id, float depth);
+
+	private:
+		draw_state current{};
+		std::vector<draw_state> states;
+		std::vector<draw> draws;
+		std::vector<index_range> ranges;
+		std::vector<sort_entry> keys;
+		bool sorted = true;
+	};
+
+	// Draws for one frame, in submission order, in a command buffer of fixed size.
+	// State set through set_pipeline, set_material and set_constants applies to draws added after it,
+	// as if each were bound right away; so does the state a render_list leaves set.
+	// submit runs the queued lists in order, then sorts the other draws and binds only what changes.
+	// All of a frame's commands go in one frame_arena, so a frame allocates nothing from the heap;
+	// draws past its capacity are dropped, and counted.
+	class render_queue
+	{
+	public:
+		using statistics = submit_statistics;
+
+		struct settings
+		{
+			uint32_t max_draws = 16384;
+			uint32_t max_ranges = 256 * 1024;   // index ranges, over all of a frame's draws
+			uint32_t max_states = 256;
+			uint32_t max_lists = 64;
+		};
+
+	public:
+		render_queue();
+		explicit render_queue(const settings &queue_settings);
+
+		void set_pipeline(object_id id);
+		void set_material(object_id id);
+		void set_constants(uint32_t slot, object_id id);
+
+		// depth orders draws with the same state, nearest first
+		void add_draw(object_id mesh_id, float depth = 0.0f);
+		// Ranges are copied; with none the whole mesh is drawn
+		void add_draw(object_id mesh_id, const index_range *ranges, size_t range_count, float depth = 0.0f);
+		// Whole mesh, once for each instance in the set; the set is read when the frame is submitted
+		void add_instanced_draw(object_id mesh_id, object_id instances_id, float depth = 0.0f);
+
+		// List has to live until submit, and is sorted then if it changed
+		void add_list(render_list &list);
+
+		// Sends the queued lists and draws to sink and empties the queue; state set so far is kept
+		void submit(command_sink &sink);
+
+		const statistics &stats() const;
+
+	private:
+		struct draw
+		{
+			object_id mesh_id;
+			uint32_t state;             // into states
+			const index_range *ranges;  // in the arena
+			uint32_t range_count;       // 0 draws the whole mesh
+			object_id instances_id;     // no_object for a draw that is not instanced
+		};
+
+		void begin_frame();
+		void add(object_id mesh_id, const index_range *ranges, size_t range_count, object_id instances_id, float depth);
+		uint32_t current_state_index();
+
+	private:
+		settings queue_settings;
+		frame_arena arena;
+		state_tracker tracker;
+
+		draw_state current{};
+		uint32_t current_index = no_object;     // in states, no_object when current has changed since
+		uint32_t current_constant_set = 0;
+
+		// This frame's commands, all in the arena
+		draw_state *states = nullptr;
+		draw *draws = nullptr;
+		sort_entry *keys = nullptr;
+		sort_entry *scratch = nullptr;          // to sort keys
+		render_list **lists = nullptr;
+		uint32_t state_count = 0;
+		uint32_t draw_count = 0;
+		uint32_t range_total = 0;               // index ranges copied this frame, at most max_ranges
+		uint32_t list_count = 0;
+		uint32_t dropped_draws = 0;
+
+		statistics frame_stats{};
+	};
+}
@@ -1,120 +1,479 @@
 #include "renderer.h"
 
-#include "direct3d.h"
-#include "render_target.h"
-#include "pipeline_state.h"
-#include "mesh_buffer.h"
-#include "constant_buffer.h"
-#include "material.h"
+#include "mesh.h"
+
+#include <cassert>
+#include <cstring>
+#include <utility>
 
 using namespace planet_generator;
 
 namespace
 {
-	constexpr std::array<float, 4> clear_color{ 0.35f, 0.25f, 0.35f, 1.0f };
+	static_assert(static_cast<size_t>(shader_slot::world_view_projection) < constant_slot_count);
+
+	template <typename key_type>
+	renderer::handle make_handle(renderer::object_type type, const key_type &key)
+	{
+		return { type, key.slot, key.generation };
+	}
+
+	// Object the handle is to, or nullptr if it is stale or of another type
+	template <typename T>
+	T *find_object(slot_map<T> &objects, const renderer::handle &handle_, renderer::object_type type)
+	{
+		if (handle_.type != type)
+			return nullptr;
+
+		return objects.find({ handle_.id, handle_.generation });
+	}
+
+	object_id make_id(const renderer::handle &handle_)
+	{
+		return { handle_.id, handle_.generation };
+	}
 }
 
-renderer::renderer(HWND hWnd)
+// Sends the sorted frame to the backend's objects
+class renderer::backend_sink final : public command_sink
 {
-	d3d = std::make_unique<direct3d>(hWnd);
-	auto device = d3d->get<direct3d::device_t>();
+public:
+	backend_sink(renderer &owner_) :
+		owner(owner_)
+	{}
+
+	// One freed since it was queued binds nothing, even if its slot has gone to a new object, and draws with a
+	// freed mesh or instance set are skipped; both are counted as stale
+
+	void bind_pipeline(object_id id) override
+	{
+		if (auto *pipeline = resolve(owner.pipeline_states, id))
+			(*pipeline)->activate();
+	}
+
+	void bind_material(object_id id) override
+	{
+		if (auto *material = resolve(owner.material_list, id))
+			(*material)->activate();
+	}
+
+	void bind_constants(uint32_t, object_id id) override
+	{
+		if (auto *constants = resolve(owner.constant_buffers, id))
+			constants->buffer->activate();
+	}
+
+	void bind_mesh(object_id id) override
+	{
+		auto *mesh = resolve(owner.meshes, id);
+		bound_mesh = mesh ? mesh->get() : nullptr;
+		if (bound_mesh)
+			bound_mesh->activate();
+	}
+
+	void bind_instances(object_id id) override
+	{
+		auto *instances = resolve(owner.instance_sets, id);
+		bound_instances = instances ? instances->get() : nullptr;
+		if (bound_instances)
+			bound_instances->activate();
+	}
+
+	void draw() override
+	{
+		if (bound_mesh)
+			bound_mesh->draw();
+		else
+			stale++;
+	}
+
+	void draw(const index_range *ranges, size_t range_count) override
+	{
+		if (bound_mesh)
+			bound_mesh->draw(ranges, range_count);
+		else
+			stale++;
+	}
+
+	void draw_instanced() override
+	{
+		if (not bound_mesh or not bound_instances)
+			stale++;
+		else if (bound_instances->count() > 0)
+			bound_mesh->draw_instanced(bound_instances->count());
+	}
+
+	uint32_t stale_commands() const
+	{
+		return stale;
+	}
+
+private:
+	renderer &owner;
+	backend_mesh *bound_mesh = nullptr;
+	backend_instances *bound_instances = nullptr;
+	uint32_t stale = 0;
+
+	template <typename T>
+	T *resolve(slot_map<T> &objects, object_id id)
+	{
+		auto *object = objects.find({ id.slot, id.generation });
+		if (not object)
+			stale++;
+		return object;
+	}
+};
 
-	draw_target = std::make_unique<render_target>(device,
-	                                              d3d->get<direct3d::swap_chain_t>());
-	draw_target->activate(d3d->get<direct3d::context_t>());
+renderer::renderer(std::unique_ptr<render_backend> backend_,
+                   const render_queue::settings &queue_settings,
+                   const upload_queue::settings &upload_settings) :
+	backend(std::move(backend_)),
+	draw_queue(queue_settings),
+	uploads(upload_settings)
+{
+	assert(backend);
 }
 
 renderer::~renderer() = default;
 
 renderer::handle renderer::add_mesh(const mesh & mesh_data)
 {
-	meshes.push_back(std::make_unique<mesh_buffer>(d3d->get<direct3d::device_t>(), 
-	                                               mesh_data));
+	return make_handle(object_type::mesh, meshes.insert(backend->make_mesh(mesh_data)));
+}
 
-	return { object_type::mesh, static_cast<uint32_t>(meshes.size()) };
+renderer::handle renderer::add_mesh(const mesh_view & mesh_data)
+{
+	return make_handle(object_type::mesh, meshes.insert(backend->make_mesh(mesh_data)));
 }
 
-renderer::handle renderer::add_material(const material_description & description)
+renderer::handle renderer::add_mesh(const packed_mesh & mesh_data)
 {
-	material_list.push_back(std::make_unique<material>(d3d->get<direct3d::device_t>(),
-	                                                   description));
+	return make_handle(object_type::mesh, meshes.insert(backend->make_mesh(mesh_data)));
+}
 
-	return { object_type::material, static_cast<uint32_t>(material_list.size()) };
+renderer::handle renderer::add_material(const material_description & description)
+{
+	return make_handle(object_type::material, material_list.insert(backend->make_material(description)));
 }
 
 renderer::handle renderer::add_pipeline_state(const pipeline_description &description)
 {
-	pipeline_states.push_back(std::make_unique<pipeline_state>(d3d->get<direct3d::device_t>(),
-	                                                           description));
-
-	return { object_type::pipeline, static_cast<uint32_t>(pipeline_states.size()) };;
+	return make_handle(object_type::pipeline, pipeline_states.insert(backend->make_pipeline(description)));
 }
 
 renderer::handle renderer::add_transform(const transforms &transform, shader_slot slot)
 {
-	constant_buffers.push_back(std::make_unique<constant_buffer>(d3d->get<direct3d::device_t>(),
-	                                                             transform,
-	                                                             slot));
-
-	return { object_type::transform, static_cast<uint32_t>(constant_buffers.size()) };
+	return make_handle(object_type::transform, constant_buffers.insert({ backend->make_constants(transform, slot), transform, false }));
 }
 
 void renderer::update_transform(const renderer::handle &id, const transforms & transform)
 {
-	if (id.type != object_type::transform) 
+	auto *constants = find_object(constant_buffers, id, object_type::transform);
+	if (not constants)
 		return;
 
-	auto r_id = id.id - 1;
-	constant_buffers.at(r_id)->update(d3d->get<direct3d::context_t>(), transform);
+	constant_counts.updates++;
+	if (std::memcmp(&constants->data, &transform, sizeof(transforms)) == 0)
+	{
+		constant_counts.unchanged++;
+		return;
+	}
+
+	constants->data = transform;
+	if (not constants->dirty)
+	{
+		constants->dirty = true;
+		dirty_constants.push_back(id.id);
+	}
 }
 
-void renderer::add_to_draw_queue(handle handle_)
+bool renderer::update_mesh(const handle &mesh_handle, const mesh &mesh_data)
 {
-	draw_queue.push(handle_);
+	auto *target = find_object(meshes, mesh_handle, object_type::mesh);
+	if (not target or mesh_data.verticies.empty() or mesh_data.indicies.empty())
+		return false;
+
+	auto &m = **target;
+	uint32_t normal_size = mesh_data.normals.empty() ? 0 : sizeof(DirectX::XMFLOAT3);
+	if (m.element_size(mesh_stream::verticies) != sizeof(vertex) or
+	    m.element_size(mesh_stream::normals) != normal_size or
+	    m.element_size(mesh_stream::indicies) != sizeof(uint32_t))
+		return false;
+	assert(mesh_data.normals.empty() or mesh_data.normals.size() == mesh_data.verticies.size());
+
+	uploads.add_contents(m,
+	                     mesh_data.verticies.data(), mesh_data.normals.data(), static_cast<uint32_t>(mesh_data.verticies.size()),
+	                     mesh_data.indicies.data(), static_cast<uint32_t>(mesh_data.indicies.size()));
+	return true;
 }
 
-void renderer::draw_frame()
+bool renderer::update_mesh_range(const handle &mesh_handle, uint32_t first_vertex, const vertex *verticies, const DirectX::XMFLOAT3 *normals, uint32_t count)
 {
-	auto context = d3d->get<direct3d::context_t>();
-	draw_target->clear(context, clear_color);
+	auto *target = find_object(meshes, mesh_handle, object_type::mesh);
+	if (not target)
+		return false;
 
-	while (not draw_queue.empty())
-	{
-		auto [obj_type, id] = draw_queue.front();
-		draw_queue.pop();
+	auto &m = **target;
+	if (m.element_size(mesh_stream::verticies) != sizeof(vertex) or
+	    (normals and m.element_size(mesh_stream::normals) != sizeof(DirectX::XMFLOAT3)))
+		return false;
 
-		activate(context, obj_type, --id);
-	}
+	uploads.add_range(m, mesh_stream::verticies, first_vertex, verticies, count);
+	if (normals)
+		uploads.add_range(m, mesh_stream::normals, first_vertex, normals, count);
+	return true;
+}
 
-	d3d->present();
+bool renderer::update_mesh_range(const handle &mesh_handle, uint32_t first_index, const uint32_t *indicies, uint32_t count)
+{
+	auto *target = find_object(meshes, mesh_handle, object_type::mesh);
+	if (not target or (*target)->element_size(mesh_stream::indicies) != sizeof(uint32_t))
+		return false;
+
+	uploads.add_range(**target, mesh_stream::indicies, first_index, indicies, count);
+	return true;
 }
 
-void renderer::resize_frame()
+renderer::handle renderer::add_instances(uint32_t capacity)
 {
-	draw_target.reset(nullptr);
+	return make_handle(object_type::instances, instance_sets.insert(backend->make_instances(capacity)));
+}
 
-	d3d->resize();
+bool renderer::update_instances(const handle &instances_handle, const instance_data *data, uint32_t count)
+{
+	auto *target = find_object(instance_sets, instances_handle, object_type::instances);
+	if (not target)
+		return false;
 
-	draw_target = std::make_unique<render_target>(d3d->get<direct3d::device_t>(),
-	                                              d3d->get<direct3d::swap_chain_t>());
-	draw_target->activate(d3d->get<direct3d::context_t>());
+	(*target)->update(data, count);
+	return true;
 }
 
-void planet_generator::renderer::activate(winrt::com_ptr<ID3D11DeviceContext>& context, object_type obj_type, const uint32_t &id)
+renderer::handle renderer::add_render_list()
 {
-	switch (obj_type)
+	return make_handle(object_type::render_list, render_lists.insert(std::make_unique<render_list>()));
+}
+
+void renderer::add_to_render_list(const handle &list, handle handle_, float depth)
+{
+	auto *target = find_object(render_lists, list, object_type::render_list);
+	if (not target or not is_valid(handle_))
+		return;
+
+	auto id = make_id(handle_);
+	switch (handle_.type)
 	{
+	case object_type::pipeline:
+		(*target)->set_pipeline(id);
+		break;
 	case object_type::material:
-		material_list.at(id)->activate(context);
+		(*target)->set_material(id);
+		break;
+	case object_type::transform:
+		(*target)->set_constants(static_cast<uint32_t>(find_object(constant_buffers, handle_, object_type::transform)->buffer->bound_slot()), id);
 		break;
 	case object_type::mesh:
-		meshes.at(id)->activate_and_draw(context);
+		(*target)->add_draw(id, depth);
 		break;
+	case object_type::render_list:
+	case object_type::instances:
+		break;
+	}
+}
+
+void renderer::add_to_render_list(const handle &list, handle mesh_handle, const index_range *ranges, size_t range_count, float depth)
+{
+	auto *target = find_object(render_lists, list, object_type::render_list);
+	if (not target or not find_object(meshes, mesh_handle, object_type::mesh))
+		return;
+
+	(*target)->add_draw(make_id(mesh_handle), ranges, range_count, depth);
+}
+
+void renderer::add_to_render_list(const handle &list, handle mesh_handle, handle instances_handle, float depth)
+{
+	auto *target = find_object(render_lists, list, object_type::render_list);
+	if (not target or not find_object(meshes, mesh_handle, object_type::mesh) or
+	    not find_object(instance_sets, instances_handle, object_type::instances))
+		return;
+
+	(*target)->add_instanced_draw(make_id(mesh_handle), make_id(instances_handle), depth);
+}
+
+void renderer::clear_render_list(const handle &list)
+{
+	if (auto *target = find_object(render_lists, list, object_type::render_list))
+		(*target)->clear();
+}
+
+bool renderer::remove(const handle &handle_)
+{
+	switch (handle_.type)
+	{
+	case object_type::transform:
+		return constant_buffers.remove({ handle_.id, handle_.generation });
+	case object_type::pipeline:
+		return pipeline_states.remove({ handle_.id, handle_.generation });
+	case object_type::material:
+		return material_list.remove({ handle_.id, handle_.generation });
+	case object_type::mesh:
+		if (auto *target = find_object(meshes, handle_, object_type::mesh))
+		{
+			uploads.cancel(**target);
+			return meshes.remove({ handle_.id, handle_.generation });
+		}
+		return false;
+	case object_type::render_list:
+		if (auto *list = find_object(render_lists, handle_, object_type::render_list))
+		{
+			removed_lists.push_back(std::move(*list));
+			return render_lists.remove({ handle_.id, handle_.generation });
+		}
+		return false;
+	case object_type::instances:
+		return instance_sets.remove({ handle_.id, handle_.generation });
+	}
+	return false;
+}
+
+bool renderer::is_valid(const handle &handle_) const
+{
+	switch (handle_.type)
+	{
+	case object_type::transform:
+		return constant_buffers.contains({ handle_.id, handle_.generation });
 	case object_type::pipeline:
-		pipeline_states.at(id)->activate(context);
+		return pipeline_states.contains({ handle_.id, handle_.generation });
+	case object_type::material:
+		return material_list.contains({ handle_.id, handle_.generation });
+	case object_type::mesh:
+		return meshes.contains({ handle_.id, handle_.generation });
+	case object_type::render_list:
+		return render_lists.contains({ handle_.id, handle_.generation });
+	case object_type::instances:
+		return instance_sets.contains({ handle_.id, handle_.generation });
+	}
+	return false;
+}
+
+size_t renderer::object_count(object_type type) const
+{
+	switch (type)
+	{
+	case object_type::transform:
+		return constant_buffers.size();
+	case object_type::pipeline:
+		return pipeline_states.size();
+	case object_type::material:
+		return material_list.size();
+	case object_type::mesh:
+		return meshes.size();
+	case object_type::render_list:
+		return render_lists.size();
+	case object_type::instances:
+		return instance_sets.size();
+	}
+	return 0;
+}
+
+void renderer::add_to_draw_queue(handle handle_, float depth)
+{
+	if (not is_valid(handle_))
+		return;
+
+	auto id = make_id(handle_);
+	switch (handle_.type)
+	{
+	case object_type::pipeline:
+		draw_queue.set_pipeline(id);
+		break;
+	case object_type::material:
+		draw_queue.set_material(id);
 		break;
 	case object_type::transform:
-		constant_buffers.at(id)->activate(context);
+		draw_queue.set_constants(static_cast<uint32_t>(find_object(constant_buffers, handle_, object_type::transform)->buffer->bound_slot()), id);
+		break;
+	case object_type::mesh:
+		draw_queue.add_draw(id, depth);
 		break;
+	case object_type::render_list:
+		draw_queue.add_list(**find_object(render_lists, handle_, object_type::render_list));
+		break;
+	case object_type::instances:
+		break;
+	}
+}
+
+void renderer::add_to_draw_queue(handle mesh_handle, const index_range *ranges, size_t range_count, float depth)
+{
+	if (not find_object(meshes, mesh_handle, object_type::mesh))
+		return;
+
+	draw_queue.add_draw(make_id(mesh_handle), ranges, range_count, depth);
+}
+
+void renderer::add_to_draw_queue(handle mesh_handle, handle instances_handle, float depth)
+{
+	if (not find_object(meshes, mesh_handle, object_type::mesh) or
+	    not find_object(instance_sets, instances_handle, object_type::instances))
+		return;
+
+	draw_queue.add_instanced_draw(make_id(mesh_handle), make_id(instances_handle), depth);
+}
+
+void renderer::draw_frame()
+{
+	backend->begin_frame();
+
+	// A slot freed since it was updated is skipped, and one listed twice is only dirty the first time
+	constant_writes.clear();
+	for (auto slot : dirty_constants)
+	{
+		auto *constants = constant_buffers.find_slot(slot);
+		if (not constants or not constants->dirty)
+			continue;
+
+		constants->dirty = false;
+		constant_writes.push_back({ constants->buffer.get(), &constants->data });
 	}
+	dirty_constants.clear();
+	if (not constant_writes.empty())
+		backend->update_constants(constant_writes.data(), constant_writes.size());
+	constant_counts.written = static_cast<uint32_t>(constant_writes.size());
+	last_constant_counts = constant_counts;
+	constant_counts = {};
+
+	uploads.upload();
+
+	backend_sink sink{ *this };
+	draw_queue.submit(sink);
+	last_stale_commands = sink.stale_commands();
+	removed_lists.clear();
+
+	backend->end_frame();
+}
+
+void renderer::resize_frame()
+{
+	backend->resize();
+}
+
+const render_queue::statistics &renderer::frame_stats() const
+{
+	return draw_queue.stats();
+}
+
+const upload_queue::statistics &renderer::upload_stats() const
+{
+	return uploads.stats();
+}
+
+const renderer::constant_statistics &renderer::constant_stats() const
+{
+	return last_constant_counts;
+}
+
+uint32_t renderer::stale_commands() const
+{
+	return last_stale_commands;
 }
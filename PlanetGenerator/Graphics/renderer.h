@@ -1,28 +1,18 @@
 #pragma once
 
-#include <Windows.h>
-#include <winrt/base.h>
-#include <d3d11_1.h>
+#include "render_queue.h"
+#include "render_backend.h"
+#include "slot_map.h"
+#include "upload_queue.h"
 #include <memory>
 #include <vector>
 #include <tuple>
-#include <queue>
 
 namespace planet_generator
 {
-	class direct3d;
-	class render_target;
-	class pipeline_state;
-	struct pipeline_description;
-	class material;
-	struct material_description;
-	class mesh_buffer;
-	struct mesh;
-	class constant_buffer;
-	struct transforms;
-	enum class shader_stage;
-	enum class shader_slot;
-
+	// Keeps the objects a frame is drawn with and queues their draws; the backend does the drawing.
+	// Objects live in slot maps, so any of them can be removed again and its slot reused; handles to a removed
+	// object go stale and are ignored wherever they are passed, as are handles of the wrong type.
 	class renderer
 	{
 	public:
@@ -31,54 +21,139 @@ namespace planet_generator
 			transform,
 			pipeline,
 			material,
-			mesh
+			mesh,
+			render_list,
+			instances
 		};
 
 		struct handle
 		{
 			object_type type;
-			uint32_t id;
+			uint32_t id;            // slot, see slot_map
+			uint32_t generation;    // 0 in a handle that was never given out
+		};
+
+		// Of the transform updates made for the last frame
+		struct constant_statistics
+		{
+			uint32_t updates;       // update_transform calls
+			uint32_t unchanged;     // of them, with the data the transform had already
+			uint32_t written;       // transforms sent to the backend, however often each was updated
 		};
 
 	private:
-		using mesh_buffer_ptr = std::unique_ptr<mesh_buffer>;
-		using material_ptr = std::unique_ptr<material>;
-		using pipeline_state_ptr = std::unique_ptr<pipeline_state>;
-		using constant_buffer_ptr = std::unique_ptr<constant_buffer>;
+		using mesh_buffer_ptr = std::unique_ptr<backend_mesh>;
+		using material_ptr = std::unique_ptr<backend_material>;
+		using pipeline_state_ptr = std::unique_ptr<backend_pipeline>;
+		using constant_buffer_ptr = std::unique_ptr<backend_constants>;
+		using render_list_ptr = std::unique_ptr<render_list>;
+		using instances_ptr = std::unique_ptr<backend_instances>;
+
+		struct constant_entry
+		{
+			constant_buffer_ptr buffer;
+			transforms data;        // as last updated
+			bool dirty;             // updated since the backend was last sent it
+		};
 		
 	public:
 		renderer() = delete;
-		renderer(HWND hWnd);
+		explicit renderer(std::unique_ptr<render_backend> backend_,
+		                  const render_queue::settings &queue_settings = {},
+		                  const upload_queue::settings &upload_settings = {});
 		~renderer();
 		
 		[[nodiscard]]
 		handle add_mesh(const mesh &mesh_data);
 		[[nodiscard]]
+		handle add_mesh(const mesh_view &mesh_data);
+		[[nodiscard]]
+		handle add_mesh(const packed_mesh &mesh_data);
+		[[nodiscard]]
 		handle add_material(const material_description &description);
 		[[nodiscard]]
 		handle add_pipeline_state(const pipeline_description &description);
 		[[nodiscard]]
 		handle add_transform(const transforms &transform, shader_slot slot);
+		// Only kept until the frame is drawn, and then sent to the backend with every other changed transform;
+		// the same data again changes nothing
 		void update_transform(const handle &id, const transforms &transform);
 
-		void add_to_draw_queue(handle handle_);
+		// Mesh data is copied when these are called and written out over the next frames, within the upload
+		// budget, see upload_queue. New contents show whole, once written; ranges show as they are written.
+		// Both return false, and change nothing, for a stale handle or data the mesh does not keep the same way:
+		// packed meshes, and normals on a mesh made without them or missing on one made with them.
+		bool update_mesh(const handle &mesh_handle, const mesh &mesh_data);
+		// normals can be null to leave them as they are
+		bool update_mesh_range(const handle &mesh_handle, uint32_t first_vertex, const vertex *verticies, const DirectX::XMFLOAT3 *normals, uint32_t count);
+		bool update_mesh_range(const handle &mesh_handle, uint32_t first_index, const uint32_t *indicies, uint32_t count);
+
+		// Instance set for instanced draws of one mesh, e.g. all the moons drawn from one sphere, see instance_builder.
+		// Empty until updated; an update replaces every instance, is written to the backend right away,
+		// and drops whatever is past capacity. Returns false for a stale handle.
+		[[nodiscard]]
+		handle add_instances(uint32_t capacity);
+		bool update_instances(const handle &instances_handle, const instance_data *data, uint32_t count);
+
+		// Retained list of binds and draws, built once with add_to_render_list and then queued each frame
+		// with add_to_draw_queue, which replays it. It stays as built until cleared.
+		[[nodiscard]]
+		handle add_render_list();
+		void add_to_render_list(const handle &list, handle handle_, float depth = 0.0f);
+		void add_to_render_list(const handle &list, handle mesh_handle, const index_range *ranges, size_t range_count, float depth = 0.0f);
+		void add_to_render_list(const handle &list, handle mesh_handle, handle instances_handle, float depth = 0.0f);
+		void clear_render_list(const handle &list);
+
+		// Frees the object right away; returns false if the handle was already stale.
+		// Draws queued with it this frame and render lists that still use it skip it from then on,
+		// even once its slot has gone to a new object; see stale_commands.
+		bool remove(const handle &handle_);
+		bool is_valid(const handle &handle_) const;
+		// Objects of the type alive now
+		size_t object_count(object_type type) const;
+
+		// Pipelines, materials and transforms apply to the meshes queued after them, as if bound right away,
+		// and so do the ones a render list sets. Render lists are drawn first, in the order they were queued;
+		// meshes are then drawn sorted by state and depth, nearest first, see render_queue.
+		void add_to_draw_queue(handle handle_, float depth = 0.0f);
+		// Draws only the given index ranges of a mesh, e.g. its visible meshlets. Ranges are copied.
+		void add_to_draw_queue(handle mesh_handle, const index_range *ranges, size_t range_count, float depth = 0.0f);
+		// Draws the whole mesh once for each instance the set has when the frame is drawn, in one draw call
+		void add_to_draw_queue(handle mesh_handle, handle instances_handle, float depth = 0.0f);
 
 		void draw_frame();
 		void resize_frame();
 
+		// Binds and draws the last frame made
+		const render_queue::statistics &frame_stats() const;
+		// Of the uploads the last frame made
+		const upload_queue::statistics &upload_stats() const;
+		const constant_statistics &constant_stats() const;
+		// Binds and draws the last frame skipped, because the object they were for had been removed
+		uint32_t stale_commands() const;
+
 	private:
-		void activate(winrt::com_ptr<ID3D11DeviceContext> &context, object_type obj_type, const uint32_t &id);
+		class backend_sink;
 
 	private:
-		std::unique_ptr<direct3d> d3d = nullptr;
-		std::unique_ptr<render_target> draw_target = nullptr;
+		std::unique_ptr<render_backend> backend = nullptr;
+
+		slot_map<mesh_buffer_ptr> meshes;
+		slot_map<pipeline_state_ptr> pipeline_states;
+		slot_map<material_ptr> material_list;
+		slot_map<constant_entry> constant_buffers;
+		slot_map<render_list_ptr> render_lists;
+		slot_map<instances_ptr> instance_sets;
+		std::vector<render_list_ptr> removed_lists;     // may still be queued, so kept until the frame is drawn
 
-		std::vector<mesh_buffer_ptr> meshes;
-		std::vector<pipeline_state_ptr> pipeline_states;
-		std::vector<material_ptr> material_list;
-		std::vector<constant_buffer_ptr> constant_buffers;
+		render_queue draw_queue;
+		upload_queue uploads;
 
-		std::queue<handle> draw_queue;
+		std::vector<uint32_t> dirty_constants;          // slots
+		std::vector<constants_write> constant_writes;
+		constant_statistics constant_counts{};          // for the frame being made
+		constant_statistics last_constant_counts{};
+		uint32_t last_stale_commands = 0;
 	};
 
 	
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace planet_generator
+{
+	// Values kept packed in one array, found through slots that never move.
+	// A key is a slot and the generation it was handed out at; removing a value bumps its slot's generation,
+	// so keys to it stop matching and the slot goes on a free list for the next insert.
+	// Insert, remove and find are O(1); removal moves the last value into the hole, so order is not kept.
+	// Memory only grows with the most values held at once, however many come and go.
+	template <typename T>
+	class slot_map
+	{
+	public:
+		struct key
+		{
+			uint32_t slot;
+			uint32_t generation;    // odd while the slot holds a value, so a zero key never matches
+		};
+
+		static constexpr uint32_t no_slot = std::numeric_limits<uint32_t>::max();
+
+	public:
+		[[nodiscard]]
+		key insert(T value)
+		{
+			uint32_t slot_index;
+			if (free_head != no_slot)
+			{
+				slot_index = free_head;
+				free_head = slots[slot_index].position;
+			}
+			else
+			{
+				assert(slots.size() < no_slot);
+				slot_index = static_cast<uint32_t>(slots.size());
+				slots.push_back({});
+			}
+
+			auto &s = slots[slot_index];
+			s.position = static_cast<uint32_t>(values.size());
+			s.generation++;
+
+			values.push_back(std::move(value));
+			value_slots.push_back(slot_index);
+			return { slot_index, s.generation };
+		}
+
+		// False if the key is stale, or was never handed out
+		bool remove(const key &k)
+		{
+			if (not contains(k))
+				return false;
+
+			auto &s = slots[k.slot];
+			uint32_t last = static_cast<uint32_t>(values.size() - 1);
+			if (s.position != last)
+			{
+				values[s.position] = std::move(values[last]);
+				value_slots[s.position] = value_slots[last];
+				slots[value_slots[s.position]].position = s.position;
+			}
+			values.pop_back();
+			value_slots.pop_back();
+
+			s.generation++;
+			s.position = free_head;
+			free_head = k.slot;
+			return true;
+		}
+
+		bool contains(const key &k) const
+		{
+			return k.slot < slots.size() and slots[k.slot].generation == k.generation and (k.generation & 1u);
+		}
+
+		// nullptr if the key is stale
+		T *find(const key &k)
+		{
+			return contains(k) ? &values[slots[k.slot].position] : nullptr;
+		}
+
+		const T *find(const key &k) const
+		{
+			return contains(k) ? &values[slots[k.slot].position] : nullptr;
+		}
+
+		// Whatever the slot holds now, whichever generation; nullptr if it is free
+		T *find_slot(uint32_t slot)
+		{
+			if (slot >= slots.size() or not (slots[slot].generation & 1u))
+				return nullptr;
+			return &values[slots[slot].position];
+		}
+
+		void clear()
+		{
+			for (uint32_t slot_index{ 0 }; slot_index < slots.size(); slot_index++)
+			{
+				auto &s = slots[slot_index];
+				if (s.generation & 1u)
+				{
+					s.generation++;
+					s.position = free_head;
+					free_head = slot_index;
+				}
+			}
+			values.clear();
+			value_slots.clear();
+		}
+
+		size_t size() const
+		{
+			return values.size();
+		}
+
+		bool empty() const
+		{
+			return values.empty();
+		}
+
+		// Slots made so far, free or not; the most values ever held at once
+		size_t slot_count() const
+		{
+			return slots.size();
+		}
+
+		// Packed values, in no particular order
+		T *begin()
+		{
+			return values.data();
+		}
+
+		T *end()
+		{
+			return values.data() + values.size();
+		}
+
+		const T *begin() const
+		{
+			return values.data();
+		}
+
+		const T *end() const
+		{
+			return values.data() + values.size();
+		}
+
+	private:
+		struct slot
+		{
+			uint32_t position = 0;      // into values while used, the next free slot while free
+			uint32_t generation = 0;
+		};
+
+	private:
+		std::vector<T> values;
+		std::vector<uint32_t> value_slots;  // slot of each value
+		std::vector<slot> slots;
+		uint32_t free_head = no_slot;
+	};
+}
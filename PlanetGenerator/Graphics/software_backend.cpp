@@ -0,0 +1,420 @@
+#include "software_backend.h"
+
+#include "mesh.h"
+#include "packed_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	// Same as lit.ps and green.ps
+	const XMFLOAT3 base_color{ 0.0f, 1.0f, 0.0f };
+	const XMFLOAT3 light_direction{ -0.5f, 0.5f, -1.0f };
+	constexpr float ambient = 0.15f;
+
+	// Same as lit_instanced.ps
+	XMFLOAT3 instance_color(float seed)
+	{
+		constexpr float two_pi = 6.28318531f;
+		return { 0.5f + 0.5f * std::cos(two_pi * seed),
+		         0.5f + 0.5f * std::cos(two_pi * (seed + 0.33f)),
+		         0.5f + 0.5f * std::cos(two_pi * (seed + 0.67f)) };
+	}
+
+	static_assert(static_cast<size_t>(shader_slot::world_view_projection) < 5);
+
+	template <typename T>
+	void write_elements(std::vector<T> &elements, uint32_t first, const void *data, uint32_t count)
+	{
+		if (first >= elements.size())
+			return;
+
+		count = std::min<uint32_t>(count, static_cast<uint32_t>(elements.size() - first));
+		std::memcpy(elements.data() + first, data, size_t{ count } * sizeof(T));
+	}
+}
+
+// Keeps its own copy of the data, as a GPU buffer would
+class software_backend::software_mesh final : public backend_mesh
+{
+public:
+	software_mesh(software_backend &owner_, mesh mesh_data) :
+		owner(owner_),
+		data(std::move(mesh_data))
+	{}
+
+	void activate() override
+	{
+		owner.bound_mesh = this;
+	}
+
+	void draw() override
+	{
+		owner.draw(*this, nullptr, 0);
+	}
+
+	void draw(const index_range *ranges, size_t range_count) override
+	{
+		owner.draw(*this, ranges, range_count);
+	}
+
+	void draw_instanced(uint32_t instance_count) override
+	{
+		owner.draw_instanced(*this, instance_count);
+	}
+
+	// Packed meshes are unpacked when made, so every mesh keeps whole verticies
+	uint32_t element_size(mesh_stream stream) const override
+	{
+		switch (stream)
+		{
+		case mesh_stream::verticies:
+			return sizeof(vertex);
+		case mesh_stream::normals:
+			return data.normals.empty() ? 0 : sizeof(XMFLOAT3);
+		default:
+			return sizeof(uint32_t);
+		}
+	}
+
+	void begin_contents(uint32_t vertex_count, uint32_t index_count) override
+	{
+		next.verticies.resize(vertex_count);
+		next.normals.resize(data.normals.empty() ? 0 : vertex_count);
+		next.indicies.resize(index_count);
+		filling = true;
+	}
+
+	void write(mesh_stream stream, uint32_t first, const void *source, uint32_t count) override
+	{
+		auto &target = filling ? next : data;
+		switch (stream)
+		{
+		case mesh_stream::verticies:
+			write_elements(target.verticies, first, source, count);
+			break;
+		case mesh_stream::normals:
+			write_elements(target.normals, first, source, count);
+			break;
+		default:
+			write_elements(target.indicies, first, source, count);
+			break;
+		}
+	}
+
+	void finish_contents() override
+	{
+		std::swap(data, next);
+		next = {};
+		filling = false;
+	}
+
+	const mesh &contents() const
+	{
+		return data;
+	}
+
+private:
+	software_backend &owner;
+	mesh data;
+	mesh next;              // contents being filled in
+	bool filling = false;
+};
+
+class software_backend::software_material final : public backend_material
+{
+public:
+	software_material(software_backend &owner_, const material_description &description) :
+		owner(owner_),
+		lit(std::find(description.input_layout.begin(), description.input_layout.end(), input_layout_mode::normal) != description.input_layout.end())
+	{}
+
+	void activate() override
+	{
+		owner.bound_material = this;
+	}
+
+	bool has_lighting() const
+	{
+		return lit;
+	}
+
+private:
+	software_backend &owner;
+	bool lit;
+};
+
+class software_backend::software_pipeline final : public backend_pipeline
+{
+public:
+	software_pipeline(software_backend &owner_, const pipeline_description &description) :
+		owner(owner_)
+	{
+		// Matches the rasterizer and depth stencil states pipeline_state makes
+		switch (description.rasterizer)
+		{
+		case rasterizer_mode::CullNone:
+			raster.cull = rasterizer::cull_mode::none;
+			break;
+		case rasterizer_mode::CullClockwise:
+			raster.cull = rasterizer::cull_mode::clockwise;
+			break;
+		case rasterizer_mode::CullAntiClockwise:
+			raster.cull = rasterizer::cull_mode::anti_clockwise;
+			break;
+		case rasterizer_mode::Wireframe:
+			raster.fill = rasterizer::fill_mode::wireframe;
+			raster.cull = rasterizer::cull_mode::anti_clockwise;
+			break;
+		}
+
+		switch (description.depth_stencil)
+		{
+		case depth_stencil_mode::None:
+			raster.depth = rasterizer::depth_mode::none;
+			break;
+		case depth_stencil_mode::ReadWrite:
+			raster.depth = rasterizer::depth_mode::read_write;
+			break;
+		case depth_stencil_mode::ReadOnly:
+			raster.depth = rasterizer::depth_mode::read_only;
+			break;
+		}
+	}
+
+	void activate() override
+	{
+		owner.bound_pipeline = this;
+	}
+
+	const rasterizer::draw_settings &settings() const
+	{
+		return raster;
+	}
+
+private:
+	software_backend &owner;
+	rasterizer::draw_settings raster{};
+};
+
+class software_backend::software_constants final : public backend_constants
+{
+public:
+	software_constants(software_backend &owner_, const transforms &data, shader_slot slot_) :
+		owner(owner_),
+		slot(slot_)
+	{
+		update(data);
+	}
+
+	void activate() override
+	{
+		owner.bound_constants[static_cast<size_t>(slot)] = this;
+	}
+
+	// Constant buffers hold matrices transposed, for the shaders; undo that
+	void update(const transforms &data) override
+	{
+		XMStoreFloat4x4(&matrix, XMMatrixTranspose(data.data));
+	}
+
+	shader_slot bound_slot() const override
+	{
+		return slot;
+	}
+
+	XMMATRIX value() const
+	{
+		return XMLoadFloat4x4(&matrix);
+	}
+
+private:
+	software_backend &owner;
+	shader_slot slot;
+	XMFLOAT4X4 matrix{};
+};
+
+class software_backend::software_instances final : public backend_instances
+{
+public:
+	software_instances(software_backend &owner_, uint32_t capacity_) :
+		owner(owner_),
+		capacity(capacity_)
+	{}
+
+	void activate() override
+	{
+		owner.bound_instances = this;
+	}
+
+	void update(const instance_data *data, uint32_t count_) override
+	{
+		instances.assign(data, data + std::min(count_, capacity));
+	}
+
+	uint32_t count() const override
+	{
+		return static_cast<uint32_t>(instances.size());
+	}
+
+	const std::vector<instance_data> &contents() const
+	{
+		return instances;
+	}
+
+private:
+	software_backend &owner;
+	uint32_t capacity;
+	std::vector<instance_data> instances;
+};
+
+software_backend::software_backend() :
+	software_backend(settings{})
+{}
+
+software_backend::software_backend(const settings &backend_settings_) :
+	backend_settings(backend_settings_),
+	raster(backend_settings_.width, backend_settings_.height, backend_settings_.pool)
+{}
+
+software_backend::~software_backend() = default;
+
+std::unique_ptr<backend_mesh> software_backend::make_mesh(const mesh &mesh_data)
+{
+	return std::make_unique<software_mesh>(*this, mesh_data);
+}
+
+std::unique_ptr<backend_mesh> software_backend::make_mesh(const mesh_view &mesh_data)
+{
+	mesh copy{};
+	copy.verticies.assign(mesh_data.verticies, mesh_data.verticies + mesh_data.vertex_count);
+	copy.indicies.assign(mesh_data.indicies, mesh_data.indicies + mesh_data.index_count);
+	return std::make_unique<software_mesh>(*this, std::move(copy));
+}
+
+// Decoded once here, rather than by every draw as packed_position.vs does
+std::unique_ptr<backend_mesh> software_backend::make_mesh(const packed_mesh &mesh_data)
+{
+	return std::make_unique<software_mesh>(*this, unpack_mesh(mesh_data));
+}
+
+std::unique_ptr<backend_material> software_backend::make_material(const material_description &description)
+{
+	return std::make_unique<software_material>(*this, description);
+}
+
+std::unique_ptr<backend_pipeline> software_backend::make_pipeline(const pipeline_description &description)
+{
+	return std::make_unique<software_pipeline>(*this, description);
+}
+
+std::unique_ptr<backend_constants> software_backend::make_constants(const transforms &data, shader_slot slot)
+{
+	return std::make_unique<software_constants>(*this, data, slot);
+}
+
+std::unique_ptr<backend_instances> software_backend::make_instances(uint32_t capacity)
+{
+	return std::make_unique<software_instances>(*this, capacity);
+}
+
+void software_backend::begin_frame()
+{
+	raster.clear(backend_settings.clear_color.data());
+}
+
+void software_backend::end_frame()
+{
+	raster.flush();
+}
+
+void software_backend::resize()
+{}
+
+void software_backend::resize(uint32_t width, uint32_t height)
+{
+	backend_settings.width = width;
+	backend_settings.height = height;
+	raster.resize(width, height);
+}
+
+const rasterizer &software_backend::target() const
+{
+	return raster;
+}
+
+bool software_backend::write_image(const std::string &path) const
+{
+	return raster.write_image(path);
+}
+
+// Identity for a slot with nothing bound
+XMMATRIX software_backend::bound_matrix(shader_slot slot) const
+{
+	const auto *constants = bound_constants[static_cast<size_t>(slot)];
+	return constants ? constants->value() : XMMatrixIdentity();
+}
+
+void software_backend::draw(const software_mesh &mesh_data, const index_range *ranges, size_t range_count)
+{
+	// A bound world_view_projection stands in for the three, as the _wvp shaders have it
+	auto transform = bound_matrix(shader_slot::transform);
+	auto object_to_clip = bound_constants[static_cast<size_t>(shader_slot::world_view_projection)]
+	                    ? bound_matrix(shader_slot::world_view_projection)
+	                    : transform * bound_matrix(shader_slot::view) * bound_matrix(shader_slot::projection);
+
+	draw(mesh_data, transform, object_to_clip, base_color, ranges, range_count);
+}
+
+// Each instance is scaled by its radius, then placed by its transform
+void software_backend::draw_instanced(const software_mesh &mesh_data, uint32_t instance_count)
+{
+	if (not bound_instances)
+		return;
+
+	auto view_projection = bound_matrix(shader_slot::view) * bound_matrix(shader_slot::projection);
+
+	const auto &instances = bound_instances->contents();
+	instance_count = std::min(instance_count, static_cast<uint32_t>(instances.size()));
+	for (uint32_t i{ 0 }; i < instance_count; i++)
+	{
+		const auto &instance = instances[i];
+		auto transform = XMLoadFloat4x4(&instance.transform);
+		auto object_to_clip = XMMatrixScaling(instance.radius, instance.radius, instance.radius) * transform * view_projection;
+		draw(mesh_data, transform, object_to_clip, instance_color(instance.seed), nullptr, 0);
+	}
+}
+
+void software_backend::draw(const software_mesh &mesh_data, FXMMATRIX transform, CXMMATRIX object_to_clip,
+                            const XMFLOAT3 &color, const index_range *ranges, size_t range_count)
+{
+	auto settings = bound_pipeline ? bound_pipeline->settings() : rasterizer::draw_settings{};
+	settings.color = color;
+	settings.ambient = ambient;
+
+	// lit.ps lights normals turned by transform; turn the light the other way instead, into the mesh's space
+	const auto &contents = mesh_data.contents();
+	bool lit = bound_material and bound_material->has_lighting() and not contents.normals.empty();
+	if (lit)
+	{
+		XMFLOAT4X4 t{};
+		XMStoreFloat4x4(&t, transform);
+		auto &l = light_direction;
+		settings.light_direction = XMFLOAT3{ t.m[0][0] * l.x + t.m[0][1] * l.y + t.m[0][2] * l.z,
+		                                     t.m[1][0] * l.x + t.m[1][1] * l.y + t.m[1][2] * l.z,
+		                                     t.m[2][0] * l.x + t.m[2][1] * l.y + t.m[2][2] * l.z };
+	}
+
+	raster.draw(object_to_clip,
+	            contents.verticies.data(), contents.verticies.size(),
+	            contents.indicies.data(), contents.indicies.size(),
+	            lit ? contents.normals.data() : nullptr,
+	            settings,
+	            ranges, range_count);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "render_backend.h"
+#include "rasterizer.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace planet_generator
+{
+	class thread_pool;
+
+	// Draws with the CPU into an image, for machines with no GPU.
+	// Shades the way the shaders do: position.vs and green.ps for materials with only positions,
+	// position_normal.vs and lit.ps for materials with normals, though lighting is per vertex here.
+	// Instanced draws shade as position_normal_instanced.vs and lit_instanced.ps do, one instance after another.
+	// Draws are binned as they come and the image is filled in by end_frame.
+	class software_backend final : public render_backend
+	{
+	public:
+		struct settings
+		{
+			uint32_t width = 1920;
+			uint32_t height = 1080;
+			thread_pool *pool = nullptr;        // runs on the calling thread alone without one
+			std::array<float, 4> clear_color{ 0.35f, 0.25f, 0.35f, 1.0f };
+		};
+
+	public:
+		software_backend();
+		explicit software_backend(const settings &backend_settings);
+		~software_backend();
+
+		std::unique_ptr<backend_mesh> make_mesh(const mesh &mesh_data) override;
+		std::unique_ptr<backend_mesh> make_mesh(const mesh_view &mesh_data) override;
+		std::unique_ptr<backend_mesh> make_mesh(const packed_mesh &mesh_data) override;
+		std::unique_ptr<backend_material> make_material(const material_description &description) override;
+		std::unique_ptr<backend_pipeline> make_pipeline(const pipeline_description &description) override;
+		std::unique_ptr<backend_constants> make_constants(const transforms &data, shader_slot slot) override;
+		std::unique_ptr<backend_instances> make_instances(uint32_t capacity) override;
+
+		void begin_frame() override;
+		void end_frame() override;
+		// There is no window to follow; size changes only through resize(width, height)
+		void resize() override;
+		void resize(uint32_t width, uint32_t height);
+
+		// Last frame finished
+		const rasterizer &target() const;
+		bool write_image(const std::string &path) const;
+
+	private:
+		class software_mesh;
+		class software_material;
+		class software_pipeline;
+		class software_constants;
+		class software_instances;
+
+		DirectX::XMMATRIX bound_matrix(shader_slot slot) const;
+		void draw(const software_mesh &mesh_data, const index_range *ranges, size_t range_count);
+		void draw_instanced(const software_mesh &mesh_data, uint32_t instance_count);
+		// transform turns the mesh's normals, for lighting
+		void draw(const software_mesh &mesh_data, DirectX::FXMMATRIX transform, DirectX::CXMMATRIX object_to_clip,
+		          const DirectX::XMFLOAT3 &color, const index_range *ranges, size_t range_count);
+
+	private:
+		settings backend_settings;
+		rasterizer raster;
+
+		// Bound like a device context would have them
+		const software_mesh *bound_mesh = nullptr;
+		const software_material *bound_material = nullptr;
+		const software_pipeline *bound_pipeline = nullptr;
+		std::array<const software_constants *, 5> bound_constants{};
+		const software_instances *bound_instances = nullptr;
+	};
+}
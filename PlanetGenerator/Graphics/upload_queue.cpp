@@ -0,0 +1,260 @@
+#include "upload_queue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+using namespace planet_generator;
+
+namespace
+{
+	constexpr size_t no_room = std::numeric_limits<size_t>::max();
+	constexpr size_t stream_count = 3;
+
+	static_assert(static_cast<size_t>(mesh_stream::verticies) == 0 and
+	              static_cast<size_t>(mesh_stream::normals) == 1 and
+	              static_cast<size_t>(mesh_stream::indicies) == 2);
+}
+
+upload_queue::upload_queue() :
+	upload_queue(settings{})
+{}
+
+upload_queue::upload_queue(const settings &queue_settings_) :
+	queue_settings(queue_settings_),
+	ring(queue_settings_.ring_bytes)
+{
+	assert(queue_settings.ring_bytes > 0 and queue_settings.frame_budget > 0);
+}
+
+void upload_queue::add_contents(backend_mesh &target,
+                                const void *verticies, const void *normals, uint32_t vertex_count,
+                                const void *indicies, uint32_t index_count)
+{
+	request r{};
+	r.target = &target;
+	r.contents = true;
+	r.counts[0] = vertex_count;
+	r.counts[1] = target.element_size(mesh_stream::normals) ? vertex_count : 0;
+	r.counts[2] = index_count;
+
+	const void *streams[stream_count]{ verticies, normals, indicies };
+	add(std::move(r), streams);
+}
+
+void upload_queue::add_range(backend_mesh &target, mesh_stream stream, uint32_t first, const void *data, uint32_t count)
+{
+	if (count == 0 or target.element_size(stream) == 0)
+		return;
+
+	request r{};
+	r.target = &target;
+	r.first = first;
+	r.counts[static_cast<size_t>(stream)] = count;
+
+	const void *streams[stream_count]{};
+	streams[static_cast<size_t>(stream)] = data;
+	add(std::move(r), streams);
+}
+
+void upload_queue::cancel(const backend_mesh &target)
+{
+	for (auto it = requests.begin(); it != requests.end();)
+	{
+		if (it->target != &target)
+		{
+			++it;
+			continue;
+		}
+
+		pending -= it->bytes - it->sent;
+		it = requests.erase(it);
+	}
+}
+
+void upload_queue::upload()
+{
+	for (auto &r : requests)
+	{
+		r.uploads++;
+	}
+	drain(queue_settings.frame_budget, current.uploaded_bytes);
+
+	auto now = clock::now();
+	double seconds = std::chrono::duration<double>(now - last_upload).count();
+	last_upload = now;
+
+	frame_stats = current;
+	frame_stats.mean_latency_ms = current.completed ? current.mean_latency_ms / current.completed : 0.0;
+	frame_stats.throughput = seconds > 0.0 ? (current.uploaded_bytes + current.forced_bytes) / seconds : 0.0;
+	frame_stats.pending_bytes = pending;
+	frame_stats.pending_requests = static_cast<uint32_t>(requests.size());
+	current = {};
+}
+
+void upload_queue::flush()
+{
+	drain(no_room, current.forced_bytes);
+}
+
+const upload_queue::statistics &upload_queue::stats() const
+{
+	return frame_stats;
+}
+
+void upload_queue::add(request &&r, const void *const streams[])
+{
+	r.added = clock::now();
+	r.bytes = 0;
+	for (size_t s{ 0 }; s < stream_count; s++)
+	{
+		r.sizes[s] = r.counts[s] ? r.target->element_size(static_cast<mesh_stream>(s)) : 0;
+		assert(r.counts[s] == 0 or (r.sizes[s] > 0 and streams[s]));
+		r.bytes += size_t{ r.counts[s] } * r.sizes[s];
+	}
+
+	// More than the ring holds: whatever is waiting goes first, then this straight from the caller's memory
+	if (r.bytes > ring.size())
+	{
+		drain(no_room, current.forced_bytes);
+
+		const uint8_t *data[stream_count]{};
+		for (size_t s{ 0 }; s < stream_count; s++)
+		{
+			data[s] = static_cast<const uint8_t *>(streams[s]);
+		}
+		current.forced_bytes += send(r, no_room, data);
+		finish(r);
+		return;
+	}
+
+	// Oldest requests go early until there is room
+	auto offset = ring_allocate(r.bytes);
+	while (offset == no_room)
+	{
+		assert(not requests.empty());
+		drain_front(current.forced_bytes);
+		offset = ring_allocate(r.bytes);
+	}
+
+	r.offset = offset;
+	for (size_t s{ 0 }; s < stream_count; s++)
+	{
+		auto stream_bytes = size_t{ r.counts[s] } * r.sizes[s];
+		if (stream_bytes)
+			std::memcpy(ring.data() + offset, streams[s], stream_bytes);
+		offset += stream_bytes;
+	}
+
+	pending += r.bytes;
+	requests.push_back(std::move(r));
+}
+
+// Requests sit in the ring in the order they were added, from the front's offset up to the back's end,
+// wrapping around to 0 at most once
+size_t upload_queue::ring_allocate(size_t bytes) const
+{
+	if (requests.empty())
+		return bytes <= ring.size() ? 0 : no_room;
+
+	size_t tail = requests.front().offset;
+	size_t head = requests.back().offset + requests.back().bytes;
+	bool wrapped = requests.back().offset < tail;
+
+	if (wrapped)
+		return head + bytes <= tail ? head : no_room;
+	if (head + bytes <= ring.size())
+		return head;
+	return bytes <= tail ? 0 : no_room;
+}
+
+size_t upload_queue::send(request &r, size_t budget, const uint8_t *const data[])
+{
+	if (r.contents and not r.begun)
+	{
+		r.target->begin_contents(r.counts[0], r.counts[2]);
+		r.begun = true;
+	}
+
+	size_t written{ 0 }, stream_start{ 0 };
+	for (size_t s{ 0 }; s < stream_count; s++)
+	{
+		auto stream_bytes = size_t{ r.counts[s] } * r.sizes[s];
+		if (r.sent < stream_start + stream_bytes)
+		{
+			auto done = static_cast<uint32_t>((r.sent - stream_start) / r.sizes[s]);
+			auto left = r.counts[s] - done;
+			auto count = static_cast<uint32_t>(std::min<size_t>(left, (budget - written) / r.sizes[s]));
+			// Always at least one element, however small the budget
+			if (count == 0 and written == 0)
+				count = 1;
+			if (count == 0)
+				break;
+
+			r.target->write(static_cast<mesh_stream>(s),
+			                (r.contents ? 0 : r.first) + done,
+			                data[s] + size_t{ done } * r.sizes[s],
+			                count);
+			written += size_t{ count } * r.sizes[s];
+			r.sent += size_t{ count } * r.sizes[s];
+			if (count < left)
+				break;
+		}
+		stream_start += stream_bytes;
+	}
+	return written;
+}
+
+void upload_queue::finish(const request &r)
+{
+	if (r.contents)
+		r.target->finish_contents();
+
+	double latency_ms = std::chrono::duration<double, std::milli>(clock::now() - r.added).count();
+	current.completed++;
+	current.mean_latency_ms += latency_ms;     // a sum until upload divides it
+	current.max_latency_ms = std::max(current.max_latency_ms, latency_ms);
+	current.max_latency_frames = std::max(current.max_latency_frames, r.uploads);
+}
+
+void upload_queue::drain(size_t budget, uint64_t &counter)
+{
+	while (not requests.empty() and budget > 0)
+	{
+		auto &front = requests.front();
+		auto written = send(front, budget, ring_streams(front).streams);
+		budget -= std::min(written, budget);
+		counter += written;
+		pending -= written;
+
+		if (front.sent < front.bytes)
+			break;
+
+		finish(front);
+		requests.pop_front();
+	}
+}
+
+void upload_queue::drain_front(uint64_t &counter)
+{
+	auto &front = requests.front();
+	auto written = send(front, no_room, ring_streams(front).streams);
+	counter += written;
+	pending -= written;
+
+	finish(front);
+	requests.pop_front();
+}
+
+upload_queue::stream_pointers upload_queue::ring_streams(const request &r) const
+{
+	stream_pointers data{};
+	auto offset = r.offset;
+	for (size_t s{ 0 }; s < stream_count; s++)
+	{
+		data.streams[s] = ring.data() + offset;
+		offset += size_t{ r.counts[s] } * r.sizes[s];
+	}
+	return data;
+}
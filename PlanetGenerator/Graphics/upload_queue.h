@@ -0,0 +1,110 @@
+#pragma once
+
+#include "render_backend.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace planet_generator
+{
+	// Mesh data waiting to go to the backend, copied into a staging ring when it is added.
+	// upload sends at most frame_budget bytes a frame, oldest first, cutting requests between elements,
+	// so a large update spreads over several frames rather than stalling one. New contents for a mesh only
+	// show once all of them are written; range writes show as they go.
+	// When the ring has no room for a new request, the oldest ones are sent right away to make room,
+	// past the budget; those bytes are counted as forced.
+	class upload_queue
+	{
+	public:
+		struct settings
+		{
+			size_t ring_bytes = 64ull * 1024 * 1024;
+			size_t frame_budget = 4ull * 1024 * 1024;  // bytes sent per upload
+		};
+
+		// Of the last upload, except the pending counts, which are for what is left after it
+		struct statistics
+		{
+			uint64_t uploaded_bytes;        // within the budget
+			uint64_t forced_bytes;          // past the budget since the upload before, to make room in the ring or by flush
+			uint64_t pending_bytes;
+			uint32_t pending_requests;
+			uint32_t completed;             // requests finished
+			uint32_t max_latency_frames;    // uploads a finished request waited, the one it finished in included
+			double mean_latency_ms;         // from being added to being finished
+			double max_latency_ms;
+			double throughput;              // uploaded and forced bytes per second since the upload before
+		};
+
+	public:
+		upload_queue();
+		explicit upload_queue(const settings &queue_settings);
+
+		upload_queue(const upload_queue &) = delete;
+		upload_queue &operator=(const upload_queue &) = delete;
+
+		// Replaces all of target's data; normals are only read if target has them.
+		// target has to live until the request is finished, or be cancelled first.
+		void add_contents(backend_mesh &target,
+		                  const void *verticies, const void *normals, uint32_t vertex_count,
+		                  const void *indicies, uint32_t index_count);
+		// Elements [first, first + count) of one stream
+		void add_range(backend_mesh &target, mesh_stream stream, uint32_t first, const void *data, uint32_t count);
+		// Drops whatever is still waiting for target, e.g. before it is destroyed
+		void cancel(const backend_mesh &target);
+
+		// Sends this frame's budget
+		void upload();
+		// Sends everything now, whatever the budget
+		void flush();
+
+		const statistics &stats() const;
+
+	private:
+		using clock = std::chrono::steady_clock;
+
+		// Streams, one after another in the ring: verticies, normals, indicies
+		struct request
+		{
+			backend_mesh *target;
+			bool contents;                  // begins and finishes new contents around its writes
+			bool begun;
+			uint32_t first;                 // element written first, for a range
+			uint32_t counts[3];             // elements per stream
+			uint32_t sizes[3];              // bytes per element, per stream
+			size_t offset;                  // in ring
+			size_t bytes;
+			size_t sent;                    // bytes of it written so far
+			uint32_t uploads;               // upload calls it has been waiting through
+			clock::time_point added;
+		};
+
+		struct stream_pointers
+		{
+			const uint8_t *streams[3];
+		};
+
+		void add(request &&r, const void *const streams[]);
+		size_t ring_allocate(size_t bytes) const;
+		// Writes up to budget bytes of r, at least one element, returns how many were written
+		size_t send(request &r, size_t budget, const uint8_t *const data[]);
+		void finish(const request &r);
+		// Oldest first, until budget is spent; counter gets what was written
+		void drain(size_t budget, uint64_t &counter);
+		// All of the oldest request
+		void drain_front(uint64_t &counter);
+		stream_pointers ring_streams(const request &r) const;
+
+	private:
+		settings queue_settings;
+		std::vector<uint8_t> ring;
+		std::deque<request> requests;
+		uint64_t pending = 0;
+
+		clock::time_point last_upload = clock::now();
+		statistics current{};           // gathered until the next upload
+		statistics frame_stats{};
+	};
+}
@@ -2,14 +2,14 @@
 
 #include "window/window.h"
 #include "input.h"
-#include "graphics/mesh_buffer.h"
-#include "graphics/pipeline_state.h"
-#include "graphics/constant_buffer.h"
-#include "graphics/material.h"
+#include "graphics/d3d11_backend.h"
 #include "camera.h"
 
 #include "planet.h"
+#include "height_cache.h"
+#include "terrain_lod.h"
 
+#include <algorithm>
 #include <vector>
 #include <fstream>
 #include <DirectXMath.h>
@@ -20,8 +20,26 @@ using namespace planet_generator;
 // TODO: Move this whole block
 namespace
 {
+	// Terrain patches as 8 byte packed verticies with 16 bit indicies, instead of 12 byte positions and 32 bit indicies
+	constexpr bool compact_verticies = false;
+	// One world_view_projection matrix made on the CPU each frame, and the _wvp vertex shaders, instead of
+	// every vertex going through transform, view and projection in turn
+	constexpr bool combined_transforms = true;
+	// Noise graph preset the terrain is made from, simplex or continents
+	constexpr noise_type terrain_noise = noise_type::simplex;
+	// Levels of cached noise heights, up to 256 quads per face edge; patches finer than that evaluate noise
+	constexpr uint32_t cached_heights_base = 64;
+	constexpr uint8_t cached_heights_levels = 3;
+
+	const wchar_t *vertex_shader_file()
+	{
+		if (compact_verticies)
+			return combined_transforms ? L"packed_position_wvp.vs.cso" : L"packed_position.vs.cso";
+		return combined_transforms ? L"position_normal_wvp.vs.cso" : L"position_normal.vs.cso";
+	}
+
 	// TODO: Move somewhere else later
-	using file_in_mem = std::vector<byte>;
+	using file_in_mem = std::vector<uint8_t>;
 	// TODO: Move somewhere else later
 	file_in_mem read_binary_file(const std::wstring &fileName)
 	{
@@ -41,8 +59,8 @@ namespace
 		buffer.reserve(inFile.tellg());
 		inFile.seekg(0, std::ios::beg);
 
-		std::copy(std::istream_iterator<byte>(inFile),
-		          std::istream_iterator<byte>(),
+		std::copy(std::istream_iterator<uint8_t>(inFile),
+		          std::istream_iterator<uint8_t>(),
 		          std::back_inserter(buffer));
 
 		return buffer;
@@ -68,9 +86,11 @@ application::application()
 	app_input = std::make_unique<input>(app_window->handle(),
 										std::vector{ input::input_device_type::keyboard, input::input_device_type::mouse });
 
-	gfx_renderer = std::make_unique<renderer>(app_window->handle());
+	gfx_renderer = std::make_unique<renderer>(std::make_unique<d3d11_backend>(app_window->handle()));
 
 	camera_view = std::make_unique<camera>();
+
+	terrain_heights = std::make_unique<height_cache>(cached_heights_base, cached_heights_levels);
 }
 
 application::~application() = default;
@@ -131,6 +151,29 @@ void application::update_input()
 	else if (app_input->test_keypress(key::K))
 		camera_view->rotate(0.f, -move_by, 0.f);
 		
+	// R and F change the planet's radius, + and - its patch resolution. The terrain is rebuilt from the
+	// cached heights, once per key press.
+	bool radius_up = app_input->test_keypress(key::R),
+	     radius_down = app_input->test_keypress(key::F),
+	     resolution_up = app_input->test_keypress(key::Add) or app_input->test_keypress(key::OemPlus),
+	     resolution_down = app_input->test_keypress(key::Subtract) or app_input->test_keypress(key::OemMinus);
+	bool terrain_keys = radius_up or radius_down or resolution_up or resolution_down;
+	if (terrain_keys and not terrain_keys_held)
+	{
+		if (radius_up)
+			terrain_radius = std::min(terrain_radius * 1.1f, 1.5f);
+		else if (radius_down)
+			terrain_radius = std::max(terrain_radius / 1.1f, 0.5f);
+
+		if (resolution_up)
+			patch_resolution = std::min(patch_resolution * 2, 64u);
+		else if (resolution_down)
+			patch_resolution = std::max(patch_resolution / 2, 8u);
+
+		build_terrain();
+	}
+	terrain_keys_held = terrain_keys;
+
 	if (app_input->test_keypress(key::U))
 		camera_view->rotate(0.f, 0.f, move_by);
 	else if (app_input->test_keypress(key::O))
@@ -152,31 +195,34 @@ void application::setup()
 	/* Pipeline State setup */ {
 		pipeline_id = gfx_renderer->add_pipeline_state(
 			pipeline_description{
-				pipeline_state::blend_mode::Opaque,
-				pipeline_state::depth_stencil_mode::ReadWrite,
-				pipeline_state::rasterizer_mode::Wireframe,
-				pipeline_state::sampler_mode::AnisotropicClamp,
+				blend_mode::Opaque,
+				depth_stencil_mode::ReadWrite,
+				compact_verticies ? rasterizer_mode::Wireframe   // packed patches have no normals to light with
+				                  : rasterizer_mode::CullNone,
+				sampler_mode::AnisotropicClamp,
 
-				D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST,
+				primitive_topology::TriangleList,
 				});
 	}
 
 	/* Material setup */ {
-		auto vso = read_binary_file(L"position.vs.cso"),
-		     pso = read_binary_file(L"green.ps.cso");
+		auto vso = read_binary_file(vertex_shader_file()),
+		     pso = read_binary_file(compact_verticies ? L"green.ps.cso" : L"lit.ps.cso");
 
+		auto layout = compact_verticies ? std::vector{ input_layout_mode::packed_position }
+		                                : std::vector{ input_layout_mode::position, input_layout_mode::normal };
 		material_id = gfx_renderer->add_material(
 			material_description{
-				{ material::input_layout_mode::position },
+				layout,
 				vso,
 				pso
 			});
 	}
 
-	/* Mesh setup */ {
-		auto planet = generate_sphere(1.0f, 6);
-		layer_noise(noise_type::simplex, planet);
-		mesh_id = gfx_renderer->add_mesh(planet);
+	/* Planet terrain setup; build_terrain fills in the decode transform */ {
+		decode_id = gfx_renderer->add_transform(transforms{ DirectX::XMMatrixIdentity() },
+		                                        shader_slot::vertex_decode);
+		build_terrain();
 	}
 
 	/* Mesh transform setup */ {
@@ -193,6 +239,8 @@ void application::setup()
 		auto width = static_cast<uint16_t>(rect.right - rect.left);
 		auto height = static_cast<uint16_t>(rect.bottom - rect.top);
 		auto tdata = projection(width, height, 60.0f, 0.1f, 1000.0f);
+		DirectX::XMStoreFloat4x4(&projection_matrix, tdata);
+		viewport_height = height;
 		projection_id = gfx_renderer->add_transform(transforms{ DirectX::XMMatrixTranspose(tdata) },
 		                                            shader_slot::projection);
 	}
@@ -205,6 +253,21 @@ void application::setup()
 		view_id = gfx_renderer->add_transform(transforms{ DirectX::XMMatrixTranspose(tdata) },
 		                                      shader_slot::view);
 	}
+
+	/* Combined Matrix setup, filled in by update */ {
+		wvp_id = gfx_renderer->add_transform(transforms{ DirectX::XMMatrixIdentity() },
+		                                     shader_slot::world_view_projection);
+	}
+
+	/* Scene state, the same every frame; transforms are updated in place */ {
+		scene_list_id = gfx_renderer->add_render_list();
+		auto ids = combined_transforms ? std::vector{ wvp_id, pipeline_id, transform_id, decode_id, material_id }
+		                               : std::vector{ view_id, projection_id, pipeline_id, transform_id, decode_id, material_id };
+		for (auto &id : ids)
+		{
+			gfx_renderer->add_to_render_list(scene_list_id, id);
+		}
+	}
 }
 
 void application::update()
@@ -212,7 +275,9 @@ void application::update()
 	/* Update Input */
 	update_input();
 
-	/* Update the Camera location */ {
+	/* Update the Camera location; the renderer drops the update when the camera has not moved */
+	if (not combined_transforms)
+	{
 		auto tdata = camera_view->view();
 		gfx_renderer->update_transform(view_id, transforms{ DirectX::XMMatrixTranspose(tdata) });
 	}
@@ -224,13 +289,41 @@ void application::update()
 		gfx_renderer->update_transform(transform_id, transforms{ DirectX::XMMatrixTranspose(tdata) });
 		r += 0.01f;
 		if (r > 360.0f) r = 0.0f;
+
+		/* Pick terrain patches for where the camera is, relative to the planet */
+		auto planet_space = DirectX::XMMatrixInverse(nullptr, tdata);
+		auto camera_position = DirectX::XMVector3TransformCoord(camera_view->location(), planet_space);
+		auto projection_data = DirectX::XMLoadFloat4x4(&projection_matrix);
+		auto planet_to_clip = tdata * camera_view->view() * projection_data;
+		if (combined_transforms)
+			gfx_renderer->update_transform(wvp_id, transforms{ DirectX::XMMatrixTranspose(planet_to_clip) });
+		planet_terrain->update(camera_position,
+		                       planet_to_clip,
+		                       projection_data,
+		                       viewport_height);
 	}
 
 	/* Fill the Draw Queue */
-	gfx_renderer->add_to_draw_queue(view_id);
-	gfx_renderer->add_to_draw_queue(projection_id);
-	gfx_renderer->add_to_draw_queue(pipeline_id);
-	gfx_renderer->add_to_draw_queue(transform_id);
-	gfx_renderer->add_to_draw_queue(material_id);
-	gfx_renderer->add_to_draw_queue(mesh_id);
+	gfx_renderer->add_to_draw_queue(scene_list_id);
+	planet_terrain->add_to_draw_queue(*gfx_renderer);
+}
+
+void application::build_terrain()
+{
+	// Old terrain frees its meshes and stops its workers first
+	planet_terrain = nullptr;
+
+	terrain_lod::settings terrain_settings{ terrain_radius, terrain_noise };
+	terrain_settings.patch_resolution = patch_resolution;
+	terrain_settings.compact_verticies = compact_verticies;
+	terrain_settings.cached_heights = terrain_heights.get();
+	planet_terrain = std::make_unique<terrain_lod>(*gfx_renderer, terrain_settings);
+
+	// Packed verticies are decoded with the terrain's height range, which changes with the radius
+	auto &heights = planet_terrain->vertex_heights();
+	auto tdata = DirectX::XMMatrixSet(heights.base, heights.scale, 0.0f, 0.0f,
+	                                  0.0f, 0.0f, 0.0f, 0.0f,
+	                                  0.0f, 0.0f, 0.0f, 0.0f,
+	                                  0.0f, 0.0f, 0.0f, 0.0f);
+	gfx_renderer->update_transform(decode_id, transforms{ tdata });
 }
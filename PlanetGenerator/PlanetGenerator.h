@@ -3,6 +3,7 @@
 #include "graphics/renderer.h"
 #include <cstdint>
 #include <memory>
+#include <DirectXMath.h>
 
 namespace planet_generator
 {
@@ -10,6 +11,8 @@ namespace planet_generator
 	class input;
 	class renderer;
 	class camera;
+	class terrain_lod;
+	class height_cache;
 
 	class application
 	{
@@ -25,6 +28,7 @@ namespace planet_generator
 
 		void setup();
 		void update();
+		void build_terrain();
 
 	private:
 		bool exit_application = false;
@@ -32,12 +36,23 @@ namespace planet_generator
 		std::unique_ptr<input> app_input = nullptr;
 		std::unique_ptr<renderer> gfx_renderer = nullptr;
 		std::unique_ptr<camera> camera_view = nullptr;
+		std::unique_ptr<height_cache> terrain_heights = nullptr;     // outlives the terrain, which reads it from its workers
+		std::unique_ptr<terrain_lod> planet_terrain = nullptr;
 
 		renderer::handle material_id{};
-		renderer::handle mesh_id{};
 		renderer::handle pipeline_id{};
 		renderer::handle transform_id{};
 		renderer::handle projection_id{};
 		renderer::handle view_id{};
+		renderer::handle decode_id{};
+		renderer::handle wvp_id{};
+		renderer::handle scene_list_id{};
+
+		DirectX::XMFLOAT4X4 projection_matrix{};
+		float viewport_height{ 0.0f };
+
+		float terrain_radius{ 1.0f };
+		uint32_t patch_resolution{ 32 };
+		bool terrain_keys_held = false;
 	};
 }
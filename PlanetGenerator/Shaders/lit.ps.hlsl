@@ -0,0 +1,9 @@
+static const float3 light_direction = normalize(float3(-0.5f, 0.5f, -1.0f));
+static const float3 base_color = float3(0.0f, 1.0f, 0.0f);
+static const float ambient = 0.15f;
+
+float4 main( float4 pos : SV_POSITION, float3 normal : NORMAL ) : SV_TARGET
+{
+	float diffuse = saturate(dot(normalize(normal), light_direction));
+	return float4(base_color * (ambient + diffuse * (1.0f - ambient)), 1.0f);
+}
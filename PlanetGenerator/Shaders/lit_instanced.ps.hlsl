@@ -0,0 +1,10 @@
+static const float3 light_direction = normalize(float3(-0.5f, 0.5f, -1.0f));
+static const float ambient = 0.15f;
+static const float two_pi = 6.28318531f;
+
+float4 main( float4 pos : SV_POSITION, float3 normal : NORMAL, float seed : SEED ) : SV_TARGET
+{
+	float3 color = 0.5f + 0.5f * cos(two_pi * (seed + float3(0.0f, 0.33f, 0.67f)));
+	float diffuse = saturate(dot(normalize(normal), light_direction));
+	return float4(color * (ambient + diffuse * (1.0f - ambient)), 1.0f);
+}
\ No newline at end of file
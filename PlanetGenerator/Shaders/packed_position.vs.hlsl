@@ -0,0 +1,44 @@
+cbuffer viewBuffer : register(b0)
+{
+    float4x4 projection;
+}
+
+cbuffer frameBuffer : register(b1)
+{
+    float4x4 view;
+}
+
+cbuffer transformBuffer : register(b2)
+{
+    float4x4 transform;
+}
+
+// x is height_range base, y is height_range scale
+cbuffer decodeBuffer : register(b3)
+{
+    float4 height_range;
+}
+
+// Same decode as unpack_position in packed_mesh.cpp
+float3 octahedral_decode(float2 e)
+{
+	float3 d = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	if (d.z < 0.0f)
+	{
+		d.xy = (1.0f - abs(d.yx)) * ((d.xy >= 0.0f) ? 1.0f : -1.0f);
+	}
+	return normalize(d);
+}
+
+float4 main( float2 direction : POSITION0, float2 height : POSITION1 ) : SV_POSITION
+{
+	float4 pos;
+	pos.xyz = octahedral_decode(direction) * (height_range.x + height.x * height_range.y);
+	pos.w = 1.0f;
+
+	pos = mul(pos, transform);
+    pos = mul(pos, view);
+    pos = mul(pos, projection);
+	
+	return pos;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+cbuffer viewBuffer : register(b0)
+{
+    float4x4 projection;
+}
+
+cbuffer frameBuffer : register(b1)
+{
+    float4x4 view;
+}
+
+cbuffer transformBuffer : register(b2)
+{
+    float4x4 transform;
+}
+
+struct vs_out
+{
+	float4 pos : SV_POSITION;
+	float3 normal : NORMAL;
+};
+
+// Normals come from the second vertex stream; transform has no scale, so it rotates them as is
+vs_out main( float4 pos : POSITION, float3 normal : NORMAL )
+{
+	vs_out output;
+
+	pos.w = 1.0f;
+
+	pos = mul(pos, transform);
+    pos = mul(pos, view);
+    output.pos = mul(pos, projection);
+	output.normal = mul(float4(normal, 0.0f), transform).xyz;
+	
+	return output;
+}
@@ -0,0 +1,43 @@
+cbuffer viewBuffer : register(b0)
+{
+    float4x4 projection;
+}
+
+cbuffer frameBuffer : register(b1)
+{
+    float4x4 view;
+}
+
+struct instance
+{
+	float4 row0 : INSTANCE_TRANSFORM0;
+	float4 row1 : INSTANCE_TRANSFORM1;
+	float4 row2 : INSTANCE_TRANSFORM2;
+	float4 row3 : INSTANCE_TRANSFORM3;
+	float4 params : INSTANCE_PARAMS;    // radius, seed
+};
+
+struct vs_out
+{
+	float4 pos : SV_POSITION;
+	float3 normal : NORMAL;
+	float seed : SEED;
+};
+
+// Per instance data comes from the third stream, see instance_buffer; the mesh is scaled by radius,
+// then placed by the instance's transform, which only rotates and moves it
+vs_out main( float4 pos : POSITION, float3 normal : NORMAL, instance i )
+{
+	vs_out output;
+
+	float4x4 transform = float4x4(i.row0, i.row1, i.row2, i.row3);
+
+	pos = float4(pos.xyz * i.params.x, 1.0f);
+	pos = mul(pos, transform);
+	pos = mul(pos, view);
+	output.pos = mul(pos, projection);
+	output.normal = mul(float4(normal, 0.0f), transform).xyz;
+	output.seed = i.params.y;
+
+	return output;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+// position_normal.vs with transform, view and projection combined on the CPU; transform still turns the normals
+cbuffer transformBuffer : register(b2)
+{
+    float4x4 transform;
+}
+
+cbuffer wvpBuffer : register(b4)
+{
+    float4x4 world_view_projection;
+}
+
+struct vs_out
+{
+	float4 pos : SV_POSITION;
+	float3 normal : NORMAL;
+};
+
+vs_out main( float4 pos : POSITION, float3 normal : NORMAL )
+{
+	vs_out output;
+
+	pos.w = 1.0f;
+
+	output.pos = mul(pos, world_view_projection);
+	output.normal = mul(float4(normal, 0.0f), transform).xyz;
+	
+	return output;
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+// position.vs with transform, view and projection combined on the CPU
+cbuffer wvpBuffer : register(b4)
+{
+    float4x4 world_view_projection;
+}
+
+
+float4 main( float4 pos : POSITION ) : SV_POSITION
+{
+	pos.w = 1.0f;
+
+	return mul(pos, world_view_projection);
+}
\ No newline at end of file
@@ -82,6 +82,11 @@ const XMMATRIX camera::view() const
 	return XMMatrixMultiply(translation, rotation);
 }
 
+const XMVECTOR camera::location() const
+{
+	return position;
+}
+
 XMMATRIX planet_generator::projection(float width, float height, float field_of_view, float near_plane, float far_plane)
 {
 	float aspect_ratio = width / height;
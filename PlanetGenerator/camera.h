@@ -23,6 +23,9 @@ namespace planet_generator
 		[[nodiscard]]
 		const DirectX::XMMATRIX view() const;
 
+		[[nodiscard]]
+		const DirectX::XMVECTOR location() const;
+
 	private:
 		DirectX::XMVECTOR position{};
 		DirectX::XMVECTOR orientation{};
@@ -0,0 +1,388 @@
+#include "terrain_lod.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	constexpr uint8_t cube_face_count = 6;
+	constexpr float min_distance = 1e-6f;
+
+	// Patch bounds ignore skirts, which are always hidden behind the patch's own surface
+	constexpr float min_patch_height = 0.0f;
+
+	// Smallest vertex spacing for packed verticies, in multiples of their direction error
+	constexpr float packed_spacing_margin = 8.0f;
+
+	float vertex_spacing(float radius, uint32_t patch_resolution, uint8_t depth)
+	{
+		return radius * XM_PIDIV2 / static_cast<float>(uint64_t{ patch_resolution } << depth);
+	}
+}
+
+terrain_lod::terrain_lod(renderer &gfx_renderer_, const settings &lod_settings_) :
+	gfx_renderer(gfx_renderer_),
+	lod_settings(lod_settings_)
+{
+	assert(lod_settings.patch_resolution > 0);
+
+	// Lowest point is the deepest skirt, on the root patches, under a patch with no displacement
+	float deepest_skirt = vertex_spacing(lod_settings.radius, lod_settings.patch_resolution, 0) + lod_settings.max_height;
+	heights = make_height_range(lod_settings.radius - deepest_skirt,
+	                            lod_settings.radius + lod_settings.max_height);
+
+	if (lod_settings.compact_verticies)
+	{
+		float min_spacing = packed_spacing_margin * packed_direction_tolerance * lod_settings.radius;
+		while (lod_settings.max_depth > 0 and
+		       vertex_spacing(lod_settings.radius, lod_settings.patch_resolution, lod_settings.max_depth) < min_spacing)
+		{
+			lod_settings.max_depth--;
+		}
+	}
+
+	streamer = std::make_unique<chunk_streamer>(chunk_streamer::settings{ lod_settings.radius,
+	                                                                      lod_settings.noise,
+	                                                                      lod_settings.patch_resolution,
+	                                                                      lod_settings.cache_budget,
+	                                                                      lod_settings.worker_count,
+	                                                                      lod_settings.cached_heights });
+
+	for (uint8_t face{ 0 }; face < cube_face_count; face++)
+	{
+		make_node(face, patch_id{ face, 0, 0, 0 });
+	}
+}
+
+terrain_lod::~terrain_lod()
+{
+	for (auto node_index : resident)
+	{
+		gfx_renderer.remove(nodes[node_index].mesh_id);
+	}
+}
+
+void terrain_lod::update(FXMVECTOR camera_position, CXMMATRIX planet_to_clip, CXMMATRIX projection, float viewport_height)
+{
+	frame_stats = {};
+	frame_index++;
+	selected.clear();
+	visible_ranges.clear();
+	streamer->begin_frame();
+
+	auto view = make_cull_view(planet_to_clip, camera_position);
+
+	// Terrain never goes below the bare sphere, so that is what hides patches past the horizon
+	culler.reset_stats();
+	culler.cull(view, lod_settings.radius);
+
+	// Distance at which one world unit covers one pixel: h / (2 * tan(fov / 2))
+	float error_scale = 0.5f * viewport_height * XMVectorGetY(projection.r[1]);
+
+	for (uint32_t root{ 0 }; root < cube_face_count; root++)
+	{
+		select(root, camera_position, error_scale, view);
+	}
+
+	free_unused_meshes();
+	frame_stats.live_nodes = static_cast<uint32_t>(nodes.size() - 4 * free_blocks.size());
+	streamer->end_frame();
+}
+
+void terrain_lod::add_to_draw_queue(renderer &gfx_renderer_) const
+{
+	for (auto &item : selected)
+	{
+		gfx_renderer_.add_to_draw_queue(item.mesh_id, visible_ranges.data() + item.first_range, item.range_count, item.depth);
+	}
+}
+
+const height_range &terrain_lod::vertex_heights() const
+{
+	return heights;
+}
+
+const terrain_lod::statistics &terrain_lod::stats() const
+{
+	return frame_stats;
+}
+
+const chunk_streamer::statistics &terrain_lod::streaming_stats() const
+{
+	return streamer->stats();
+}
+
+const patch_culler::statistics &terrain_lod::culling_stats() const
+{
+	return culler.stats();
+}
+
+void terrain_lod::make_node(uint32_t node_index, const patch_id &patch)
+{
+	node n{};
+	n.patch = patch;
+
+	// Bound covers the patch from the bare sphere up to the highest displacement
+	auto bounds = make_patch_bounds(lod_settings.radius, patch, min_patch_height, lod_settings.max_height);
+	n.center = bounds.center;
+	n.bound_radius = bounds.radius;
+
+	// Spacing between grid verticies, which is how far the patch can be off from the next depth
+	n.geometric_error = vertex_spacing(lod_settings.radius, lod_settings.patch_resolution, patch.depth);
+
+	if (node_index == nodes.size())
+	{
+		[[maybe_unused]] auto bounds_index = culler.add(bounds);
+		assert(bounds_index == node_index);
+		nodes.push_back(std::move(n));
+	}
+	else
+	{
+		culler.replace(node_index, bounds);
+		nodes[node_index] = std::move(n);
+	}
+}
+
+// Children are four siblings in a row, in a collapsed block if there is one
+uint32_t terrain_lod::make_children(const patch_id &parent)
+{
+	auto first_child = static_cast<uint32_t>(nodes.size());
+	if (not free_blocks.empty())
+	{
+		first_child = free_blocks.back();
+		free_blocks.pop_back();
+	}
+
+	uint8_t depth = parent.depth + 1;
+	make_node(first_child,     patch_id{ parent.face, depth, parent.x * 2,     parent.y * 2 });
+	make_node(first_child + 1, patch_id{ parent.face, depth, parent.x * 2 + 1, parent.y * 2 });
+	make_node(first_child + 2, patch_id{ parent.face, depth, parent.x * 2,     parent.y * 2 + 1 });
+	make_node(first_child + 3, patch_id{ parent.face, depth, parent.x * 2 + 1, parent.y * 2 + 1 });
+	return first_child;
+}
+
+// Gives up the subtree under the node once nothing in it holds a mesh
+void terrain_lod::collapse(uint32_t node_index)
+{
+	if (nodes[node_index].first_child != 0 and not has_mesh_below(node_index))
+	{
+		release_children(node_index);
+	}
+}
+
+void terrain_lod::release_children(uint32_t node_index)
+{
+	uint32_t first_child = nodes[node_index].first_child;
+	for (uint32_t child = first_child; child < first_child + 4; child++)
+	{
+		if (nodes[child].first_child != 0)
+		{
+			release_children(child);
+		}
+
+		assert(not nodes[child].has_mesh);
+		culler.remove(child);
+	}
+
+	nodes[node_index].first_child = 0;
+	free_blocks.push_back(first_child);
+	frame_stats.collapsed_nodes += 4;
+}
+
+bool terrain_lod::has_mesh_below(uint32_t node_index) const
+{
+	uint32_t first_child = nodes[node_index].first_child;
+	if (first_child == 0)
+		return false;
+
+	for (uint32_t child = first_child; child < first_child + 4; child++)
+	{
+		if (nodes[child].has_mesh or has_mesh_below(child))
+			return true;
+	}
+	return false;
+}
+
+// Whether every visible part of the patch can still be drawn from meshes further down
+bool terrain_lod::children_resident(uint32_t node_index) const
+{
+	uint32_t first_child = nodes[node_index].first_child;
+	if (first_child == 0)
+		return false;
+
+	for (uint32_t child = first_child; child < first_child + 4; child++)
+	{
+		if (culler.visible(child) and not nodes[child].has_mesh and not children_resident(child))
+			return false;
+	}
+	return true;
+}
+
+float terrain_lod::distance_to(uint32_t node_index, FXMVECTOR camera_position) const
+{
+	auto center = XMLoadFloat3(&nodes[node_index].center);
+	return XMVectorGetX(XMVector3Length(camera_position - center)) - nodes[node_index].bound_radius;
+}
+
+void terrain_lod::select(uint32_t node_index, FXMVECTOR camera_position, float error_scale, const cull_view &view)
+{
+	frame_stats.visited_nodes++;
+
+	if (not culler.visible(node_index))
+	{
+		collapse(node_index);
+		return;
+	}
+
+	float distance = distance_to(node_index, camera_position);
+	float screen_error = nodes[node_index].geometric_error * error_scale / std::max(distance, min_distance);
+
+	auto patch = nodes[node_index].patch;
+	bool split = screen_error > lod_settings.max_screen_error and patch.depth < lod_settings.max_depth;
+	if (split)
+	{
+		if (nodes[node_index].first_child == 0)
+		{
+			// nodes may reallocate here, so no references are held across this
+			uint32_t first_child = make_children(patch);
+			nodes[node_index].first_child = first_child;
+			culler.cull(view, lod_settings.radius, first_child, first_child + 4);
+		}
+
+		// Only switch to the children once all visible ones are there, until then this patch stands in
+		uint32_t first_child = nodes[node_index].first_child;
+		bool children_ready = true;
+		for (uint32_t child{ 0 }; child < 4; child++)
+		{
+			if (culler.visible(first_child + child))
+			{
+				children_ready = make_ready(first_child + child, screen_error) and children_ready;
+			}
+		}
+
+		if (children_ready)
+		{
+			for (uint32_t child{ 0 }; child < 4; child++)
+			{
+				select(first_child + child, camera_position, error_scale, view);
+			}
+			return;
+		}
+	}
+	else
+	{
+		collapse(node_index);
+	}
+
+	if (not make_ready(node_index, screen_error))
+	{
+		// Zooming out, the children keep standing in until this patch is streamed in again
+		if (children_resident(node_index))
+		{
+			select_children(node_index, camera_position, view);
+		}
+		return;
+	}
+
+	draw(node_index, distance, view);
+}
+
+// Draws the resident patches under the node, going deeper only where one is missing
+void terrain_lod::select_children(uint32_t node_index, FXMVECTOR camera_position, const cull_view &view)
+{
+	uint32_t first_child = nodes[node_index].first_child;
+	for (uint32_t child = first_child; child < first_child + 4; child++)
+	{
+		if (not culler.visible(child))
+			continue;
+
+		if (nodes[child].has_mesh)
+		{
+			nodes[child].last_used = frame_index;
+			draw(child, distance_to(child, camera_position), view);
+		}
+		else
+		{
+			select_children(child, camera_position, view);
+		}
+	}
+}
+
+void terrain_lod::draw(uint32_t node_index, float distance, const cull_view &view)
+{
+	auto resolution = uint64_t{ lod_settings.patch_resolution };
+	frame_stats.selected_patches++;
+	frame_stats.selected_verticies += (resolution + 1) * (resolution + 1) + 4 * resolution;
+
+	const auto &meshlets = nodes[node_index].meshlets;
+	auto first_range = static_cast<uint32_t>(visible_ranges.size());
+	auto visible = static_cast<uint32_t>(cull_meshlets(meshlets.data(), meshlets.size(), view, visible_ranges));
+	frame_stats.visible_meshlets += visible;
+	frame_stats.culled_meshlets += static_cast<uint32_t>(meshlets.size()) - visible;
+
+	auto range_count = static_cast<uint32_t>(visible_ranges.size()) - first_range;
+	for (uint32_t r = first_range; r < visible_ranges.size(); r++)
+	{
+		frame_stats.submitted_triangles += visible_ranges[r].index_count / 3;
+	}
+	if (range_count > 0)
+	{
+		selected.push_back({ nodes[node_index].mesh_id, first_range, range_count, std::max(distance, 0.0f) });
+	}
+}
+
+bool terrain_lod::make_ready(uint32_t node_index, float priority)
+{
+	auto &n = nodes[node_index];
+	if (n.has_mesh)
+	{
+		n.last_used = frame_index;
+		return true;
+	}
+
+	if (auto *patch_mesh = streamer->find(n.patch))
+	{
+		n.mesh_id = lod_settings.compact_verticies ? gfx_renderer.add_mesh(pack_mesh(*patch_mesh, heights))
+		                                           : gfx_renderer.add_mesh(*patch_mesh);
+		n.meshlets = patch_mesh->meshlets;
+		n.has_mesh = true;
+		n.last_used = frame_index;
+		resident.push_back(node_index);
+		frame_stats.uploaded_patches++;
+		return true;
+	}
+
+	// Skirt has to reach below the lowest neighbouring patch, at any depth
+	float skirt_depth = n.geometric_error + lod_settings.max_height;
+	streamer->request(n.patch, skirt_depth, priority);
+	return false;
+}
+
+// Meshes of patches not needed lately go back to the renderer; the patch is streamed in again if it is needed
+void terrain_lod::free_unused_meshes()
+{
+	for (size_t i{ 0 }; i < resident.size();)
+	{
+		auto &n = nodes[resident[i]];
+		if (frame_index - n.last_used <= lod_settings.mesh_keep_frames)
+		{
+			i++;
+			continue;
+		}
+
+		gfx_renderer.remove(n.mesh_id);
+		n.mesh_id = {};
+		n.has_mesh = false;
+		n.meshlets = {};
+		frame_stats.freed_patches++;
+
+		resident[i] = resident.back();
+		resident.pop_back();
+	}
+
+	frame_stats.resident_patches = static_cast<uint32_t>(resident.size());
+}
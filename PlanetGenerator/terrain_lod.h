@@ -0,0 +1,136 @@
+#pragma once
+
+#include "planet.h"
+#include "chunk_streamer.h"
+#include "culling.h"
+#include "meshlet.h"
+#include "packed_mesh.h"
+#include "graphics/renderer.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace planet_generator
+{
+	// Chunked LOD terrain, one quadtree per cube face.
+	// Each frame the trees are walked from the camera, and a patch is split into four
+	// while its geometric error, projected on to the screen, is larger than max_screen_error.
+	// Patches are generated in the background; a parent is drawn until all its children are ready,
+	// and children that are still resident are drawn until their parent is ready again.
+	// Patches outside the frustum or below the planet's horizon are skipped with everything under them,
+	// so they are neither split, requested nor drawn. All known patches are tested in one batch per frame.
+	// Selected patches are then culled meshlet by meshlet, against the frustum and by their normal cones,
+	// and only the visible index ranges are drawn.
+	// A patch's mesh is freed from the renderer once it has gone unused for mesh_keep_frames frames,
+	// so the meshes held stay bounded by what the camera has needed lately. Subtrees left without any
+	// mesh are collapsed, and their nodes are reused for the next split, so the tree stays bounded too.
+	class terrain_lod
+	{
+	public:
+		struct settings
+		{
+			float radius;
+			noise_type noise;
+			uint32_t patch_resolution = 32;
+			uint8_t max_depth = 12;
+			float max_screen_error = 2.0f;  // in pixels
+			float max_height = 0.25f;       // largest displacement noise can produce
+			size_t cache_budget = 256ull * 1024 * 1024;
+			uint32_t worker_count = 0;
+			// Upload patches as packed_mesh, 8 byte verticies and 16 bit indicies. Needs the packed_position
+			// material and vertex_heights() bound to shader_slot::vertex_decode. Packed directions are only
+			// so precise, so max_depth is lowered to keep vertex spacing well above that.
+			bool compact_verticies = false;
+			uint32_t mesh_keep_frames = 120;    // frames an unused patch keeps its mesh, in case it is needed again
+			// Noise heights for the shallower patches, kept by the owner across terrain rebuilds,
+			// so a new radius or patch resolution only resamples them. Must outlive the terrain.
+			height_cache *cached_heights = nullptr;
+		};
+
+		struct statistics
+		{
+			uint32_t visited_nodes;
+			uint32_t selected_patches;
+			uint32_t uploaded_patches;
+			uint32_t freed_patches;
+			uint32_t resident_patches;      // with a mesh in the renderer, after freeing
+			uint32_t collapsed_nodes;
+			uint32_t live_nodes;            // in the trees, after collapsing
+			uint64_t selected_verticies;
+			uint32_t visible_meshlets;
+			uint32_t culled_meshlets;
+			uint64_t submitted_triangles;
+		};
+
+	public:
+		terrain_lod() = delete;
+		terrain_lod(renderer &gfx_renderer, const settings &lod_settings);
+		// Frees its meshes, so the renderer has to outlive it
+		~terrain_lod();
+
+		// camera_position is in planet space, projection is what the view is rendered with,
+		// planet_to_clip is the planet's world * view * projection
+		void update(DirectX::FXMVECTOR camera_position, DirectX::CXMMATRIX planet_to_clip, DirectX::CXMMATRIX projection, float viewport_height);
+		void add_to_draw_queue(renderer &gfx_renderer) const;
+
+		// Decode range for packed verticies, covers every patch including skirts
+		const height_range &vertex_heights() const;
+
+		const statistics &stats() const;
+		const chunk_streamer::statistics &streaming_stats() const;
+		const patch_culler::statistics &culling_stats() const;
+
+	private:
+		struct node
+		{
+			patch_id patch;             // bounds are in the culler, under the node's index
+			DirectX::XMFLOAT3 center;
+			float bound_radius;
+			float geometric_error;
+
+			uint32_t first_child = 0;   // 0 when not split yet, root nodes are never children
+			bool has_mesh = false;
+			renderer::handle mesh_id{};
+			uint32_t last_used = 0;     // frame it was last drawn or stood ready for its parent
+			std::vector<meshlet> meshlets;
+		};
+
+		// Visible part of a selected patch
+		struct draw_item
+		{
+			renderer::handle mesh_id;
+			uint32_t first_range;
+			uint32_t range_count;
+			float depth;                // distance from the camera to the patch's bound
+		};
+
+		void make_node(uint32_t node_index, const patch_id &patch);
+		uint32_t make_children(const patch_id &parent);
+		void collapse(uint32_t node_index);
+		void release_children(uint32_t node_index);
+		bool has_mesh_below(uint32_t node_index) const;
+		bool children_resident(uint32_t node_index) const;
+		float distance_to(uint32_t node_index, DirectX::FXMVECTOR camera_position) const;
+		void select(uint32_t node_index, DirectX::FXMVECTOR camera_position, float error_scale, const cull_view &view);
+		void select_children(uint32_t node_index, DirectX::FXMVECTOR camera_position, const cull_view &view);
+		void draw(uint32_t node_index, float distance, const cull_view &view);
+		bool make_ready(uint32_t node_index, float priority);
+		void free_unused_meshes();
+
+	private:
+		renderer &gfx_renderer;
+		settings lod_settings;
+		height_range heights{};
+		std::unique_ptr<chunk_streamer> streamer = nullptr;
+
+		std::vector<node> nodes;
+		std::vector<uint32_t> free_blocks;  // first of four collapsed siblings, to be reused
+		std::vector<uint32_t> resident;     // nodes with a mesh
+		uint32_t frame_index = 0;
+		patch_culler culler;
+		std::vector<draw_item> selected;
+		std::vector<index_range> visible_ranges;
+		statistics frame_stats{};
+	};
+}
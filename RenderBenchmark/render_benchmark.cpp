@@ -0,0 +1,323 @@
+// Renderer CPU overhead benchmark
+// Queues and submits frames of draws through renderer to a backend that does no GPU work, and reports
+// what renderer itself costs: time per draw, the binds a frame sends and the binds it skips.
+// With --churn, instead streams terrain sized meshes in and out of a buffer_pool on system memory buffers,
+// n per frame, and reports what the pool holds and how much it had to move.
+//
+//   render_benchmark [--draws n[,n...]] [--frames n] [--meshes n] [--states n] [--ranges n] [--record] [--churn n]
+
+#include "Graphics/renderer.h"
+#include "Graphics/null_backend.h"
+#include "Graphics/buffer_pool.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace planet_generator;
+
+namespace
+{
+	struct options
+	{
+		std::vector<uint32_t> draw_counts{ 10000, 100000, 1000000 };
+		uint32_t frames = 20;
+		uint32_t meshes = 1024;
+		uint32_t states = 64;       // pipeline, material and transform combinations draws are spread over
+		uint32_t ranges = 0;        // index ranges per draw, 0 draws whole meshes
+		bool record = false;        // log the command stream too, as recording_backend does
+		uint32_t churn = 0;         // meshes replaced per frame in the buffer_pool run, 0 to skip it
+	};
+
+	struct result
+	{
+		double queue_seconds;       // best frame
+		double submit_seconds;
+		render_queue::statistics stats;
+		uint64_t backend_calls;
+		size_t recorded;
+	};
+
+	// Deterministic, and cheap next to what is measured
+	struct xorshift
+	{
+		uint32_t state = 0x9e3779b9u;
+
+		uint32_t next()
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+	};
+
+	result measure(const options &opt, uint32_t draw_count)
+	{
+		render_queue::settings queue_settings{};
+		queue_settings.max_draws = draw_count;
+		queue_settings.max_ranges = std::max(1u, draw_count * opt.ranges);
+		queue_settings.max_states = opt.states;
+
+		auto backend = opt.record ? std::make_unique<recording_backend>() : std::make_unique<null_backend>();
+		auto &calls = *backend;
+		auto *recorder = opt.record ? static_cast<recording_backend *>(backend.get()) : nullptr;
+		renderer gfx{ std::move(backend), queue_settings };
+
+		// A few pipelines and materials, a transform per state
+		const uint32_t pipeline_count = std::min(opt.states, 4u);
+		const uint32_t material_count = std::min(opt.states, 16u);
+		std::vector<renderer::handle> pipelines, materials, transforms_, meshes;
+		for (uint32_t i{ 0 }; i < pipeline_count; i++)
+		{
+			pipelines.push_back(gfx.add_pipeline_state(pipeline_description{ blend_mode::Opaque,
+			                                                                 depth_stencil_mode::ReadWrite,
+			                                                                 rasterizer_mode::CullNone,
+			                                                                 sampler_mode::LinearClamp,
+			                                                                 primitive_topology::TriangleList }));
+		}
+		std::vector<input_layout_mode> layout{ input_layout_mode::position };
+		std::vector<uint8_t> no_shader;
+		for (uint32_t i{ 0 }; i < material_count; i++)
+		{
+			materials.push_back(gfx.add_material(material_description{ layout, no_shader, no_shader }));
+		}
+		for (uint32_t i{ 0 }; i < opt.states; i++)
+		{
+			transforms_.push_back(gfx.add_transform(transforms{ DirectX::XMMatrixIdentity() }, shader_slot::transform));
+		}
+		mesh empty_mesh{};
+		for (uint32_t i{ 0 }; i < opt.meshes; i++)
+		{
+			meshes.push_back(gfx.add_mesh(empty_mesh));
+		}
+
+		std::vector<index_range> ranges(opt.ranges);
+		for (uint32_t i{ 0 }; i < opt.ranges; i++)
+		{
+			ranges[i] = { i * 192u, 192u };
+		}
+
+		result best{};
+		best.queue_seconds = 1e30;
+		best.submit_seconds = 1e30;
+
+		// Frame 0 warms up
+		for (uint32_t frame{ 0 }; frame <= opt.frames; frame++)
+		{
+			xorshift random{};
+			calls.reset_calls();
+			if (recorder)
+				recorder->clear();
+
+			auto start = std::chrono::steady_clock::now();
+			gfx.update_transform(transforms_[frame % opt.states], transforms{ DirectX::XMMatrixIdentity() });
+			for (uint32_t d{ 0 }; d < draw_count; d++)
+			{
+				auto state = random.next() % opt.states;
+				auto mesh_id = random.next() % opt.meshes;
+				auto depth = static_cast<float>(random.next() & 0xffff) / 256.0f;
+
+				gfx.add_to_draw_queue(pipelines[state % pipeline_count]);
+				gfx.add_to_draw_queue(materials[state % material_count]);
+				gfx.add_to_draw_queue(transforms_[state]);
+				if (opt.ranges)
+					gfx.add_to_draw_queue(meshes[mesh_id], ranges.data(), ranges.size(), depth);
+				else
+					gfx.add_to_draw_queue(meshes[mesh_id], depth);
+			}
+			auto queued = std::chrono::steady_clock::now();
+			gfx.draw_frame();
+			auto stop = std::chrono::steady_clock::now();
+
+			if (frame == 0)
+				continue;
+
+			double queue_seconds = std::chrono::duration<double>(queued - start).count();
+			double submit_seconds = std::chrono::duration<double>(stop - queued).count();
+			if (queue_seconds + submit_seconds < best.queue_seconds + best.submit_seconds)
+			{
+				best.queue_seconds = queue_seconds;
+				best.submit_seconds = submit_seconds;
+				best.stats = gfx.frame_stats();
+
+				best.backend_calls = 0;
+				for (size_t type{ 0 }; type < static_cast<size_t>(null_backend::command_type::count); type++)
+				{
+					best.backend_calls += calls.calls(static_cast<null_backend::command_type>(type));
+				}
+				best.recorded = recorder ? recorder->commands.size() : 0;
+			}
+		}
+
+		return best;
+	}
+
+	// opt.meshes patches live at once, opt.churn of them replaced each frame, with sizes varying the way
+	// terrain patches with and without skirts do. Contents are checked at the end.
+	void measure_pool(const options &opt)
+	{
+		memory_buffer_device device{};
+		buffer_pool pool{ device };
+
+		struct patch
+		{
+			buffer_pool::allocation verticies;
+			buffer_pool::allocation indicies;
+			uint32_t seed;
+		};
+
+		xorshift random{};
+		auto make_patch = [&]()
+		{
+			// 33 x 33 grid and up to 128 skirt verticies, two triangles per quad
+			uint32_t seed = random.next();
+			uint32_t vertex_count = 33 * 33 + seed % 129;
+			uint32_t index_count = 32 * 32 * 6 + (seed % 129) * 6;
+			std::vector<vertex> verticies(vertex_count, vertex{ { static_cast<float>(seed), 0.0f, 0.0f } });
+			std::vector<uint32_t> indicies(index_count, seed);
+
+			const void *vertex_streams[]{ verticies.data() };
+			const void *index_streams[]{ indicies.data() };
+			return patch{ pool.allocate(buffer_pool::layout::position, vertex_count, vertex_streams),
+			              pool.allocate(buffer_pool::layout::index32, index_count, index_streams),
+			              seed };
+		};
+
+		std::vector<patch> patches;
+		for (uint32_t i{ 0 }; i < opt.meshes; i++)
+		{
+			patches.push_back(make_patch());
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t frame{ 0 }; frame < opt.frames; frame++)
+		{
+			for (uint32_t c{ 0 }; c < opt.churn; c++)
+			{
+				auto &replaced = patches[random.next() % patches.size()];
+				pool.free(replaced.verticies);
+				pool.free(replaced.indicies);
+				replaced = make_patch();
+			}
+			pool.defragment();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		uint32_t wrong{ 0 };
+		for (const auto &p : patches)
+		{
+			buffer_pool::location where{};
+			if (not pool.find(p.indicies, where) or
+			    *reinterpret_cast<const uint32_t *>(device.contents(where.buffers[0]).data() + size_t{ where.first } * 4) != p.seed)
+				wrong++;
+		}
+
+		const auto &stats = pool.stats();
+		std::printf("buffer pool: %u patches, %u replaced per frame, %u frames, %.3f ms per frame\n",
+		            opt.meshes, opt.churn, opt.frames, seconds * 1e3 / opt.frames);
+		std::printf("%u heaps, %.1f of %.1f MB used, %u defragmentations moving %.1f MB, %u device buffers, %u wrong\n",
+		            stats.heaps,
+		            stats.used_bytes / 1048576.0,
+		            stats.capacity_bytes / 1048576.0,
+		            stats.defragmentations,
+		            stats.moved_bytes / 1048576.0,
+		            device.stats().buffers,
+		            wrong);
+	}
+
+	std::vector<uint32_t> parse_list(std::string_view text)
+	{
+		std::vector<uint32_t> values;
+		while (not text.empty())
+		{
+			auto comma = text.find(',');
+			values.push_back(std::stoul(std::string(text.substr(0, comma))));
+			text = (comma == text.npos) ? std::string_view{} : text.substr(comma + 1);
+		}
+		return values;
+	}
+
+	options parse_options(int argc, char *argv[])
+	{
+		options opt{};
+		for (int i{ 1 }; i < argc; i++)
+		{
+			std::string_view arg = argv[i];
+			auto next = [&]() -> std::string
+			{
+				if (i + 1 >= argc)
+				{
+					std::fprintf(stderr, "missing value for %s\n", argv[i]);
+					std::exit(1);
+				}
+				return argv[++i];
+			};
+
+			if (arg == "--draws")       opt.draw_counts = parse_list(next());
+			else if (arg == "--frames") opt.frames = std::max(1ul, std::stoul(next()));
+			else if (arg == "--meshes") opt.meshes = std::max(1ul, std::stoul(next()));
+			else if (arg == "--states") opt.states = std::max(1ul, std::stoul(next()));
+			else if (arg == "--ranges") opt.ranges = std::stoul(next());
+			else if (arg == "--record") opt.record = true;
+			else if (arg == "--churn")  opt.churn = std::stoul(next());
+			else
+			{
+				std::fprintf(stderr, "unknown option %s\n", argv[i]);
+				std::exit(1);
+			}
+		}
+		return opt;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	auto opt = parse_options(argc, argv);
+
+	if (opt.churn > 0)
+	{
+		measure_pool(opt);
+		return 0;
+	}
+
+	std::printf("backend: %s, frames: %u, meshes: %u, states: %u, ranges per draw: %u\n",
+	            opt.record ? "recording" : "null",
+	            opt.frames,
+	            opt.meshes,
+	            opt.states,
+	            opt.ranges);
+	std::printf("%10s %10s %10s %12s %12s %10s %10s %10s %10s %12s %10s %12s\n",
+	            "draws", "queue ms", "submit ms", "ns/draw", "pipelines", "materials", "constants",
+	            "meshes", "skipped", "backend calls", "dropped", "recorded");
+
+	for (auto draw_count : opt.draw_counts)
+	{
+		if (draw_count == 0)
+			continue;
+
+		auto res = measure(opt, draw_count);
+		std::printf("%10u %10.3f %10.3f %12.2f %12u %10u %10u %10u %10u %12llu %10u %12zu\n",
+		            draw_count,
+		            res.queue_seconds * 1e3,
+		            res.submit_seconds * 1e3,
+		            (res.queue_seconds + res.submit_seconds) * 1e9 / draw_count,
+		            res.stats.pipeline_binds,
+		            res.stats.material_binds,
+		            res.stats.constant_binds,
+		            res.stats.mesh_binds,
+		            res.stats.skipped_binds,
+		            static_cast<unsigned long long>(res.backend_calls),
+		            res.stats.dropped_draws,
+		            res.recorded);
+		std::fflush(stdout);
+	}
+
+	return 0;
+}
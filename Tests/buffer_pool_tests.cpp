@@ -0,0 +1,218 @@
+#include "tests.h"
+#include "Graphics/buffer_pool.h"
+
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+using namespace planet_generator;
+
+namespace
+{
+	using layout = buffer_pool::layout;
+
+	// Indicies first, first + 1, ..., so each allocation's data tells where it came from
+	std::vector<uint32_t> make_indicies(uint32_t first, uint32_t count)
+	{
+		std::vector<uint32_t> indicies(count);
+		std::iota(indicies.begin(), indicies.end(), first);
+		return indicies;
+	}
+
+	buffer_pool::allocation allocate(buffer_pool &pool, const std::vector<uint32_t> &indicies)
+	{
+		const void *streams[]{ indicies.data() };
+		return pool.allocate(layout::index32, static_cast<uint32_t>(indicies.size()), streams);
+	}
+
+	// Allocation is where find says, and holds what it was given
+	bool holds(const buffer_pool &pool, const memory_buffer_device &device, const buffer_pool::allocation &allocated,
+	           const std::vector<uint32_t> &indicies)
+	{
+		buffer_pool::location where{};
+		if (not pool.find(allocated, where) or where.count != indicies.size())
+			return false;
+
+		auto &contents = device.contents(where.buffers[0]);
+		auto offset = size_t{ where.first } * sizeof(uint32_t);
+		auto bytes = indicies.size() * sizeof(uint32_t);
+		return offset + bytes <= contents.size() and std::memcmp(contents.data() + offset, indicies.data(), bytes) == 0;
+	}
+
+	uint32_t first_of(const buffer_pool &pool, const buffer_pool::allocation &allocated)
+	{
+		buffer_pool::location where{};
+		return pool.find(allocated, where) ? where.first : UINT32_MAX;
+	}
+
+	// Freed ranges merge with their free neighbours on either side
+	void ranges_merge()
+	{
+		range_allocator space{ 16 };
+		uint32_t offsets[4]{};
+		for (auto &offset : offsets)
+		{
+			offset = space.allocate(4);
+		}
+		CHECK(offsets[0] == 0 and offsets[1] == 4 and offsets[2] == 8 and offsets[3] == 12);
+		CHECK(space.allocate(1) == range_allocator::no_space);
+
+		space.free(4, 4);
+		space.free(12, 4);
+		CHECK(space.free_ranges() == 2 and space.free_space() == 8 and space.largest_free() == 4);
+
+		space.free(8, 4);
+		CHECK(space.free_ranges() == 1 and space.largest_free() == 12);
+
+		space.free(0, 4);
+		CHECK(space.free_ranges() == 1 and space.free_space() == 16);
+		CHECK(space.allocate(16) == 0);
+	}
+
+	// Data goes where find says, and freed space is used again, merged
+	void allocate_and_free()
+	{
+		memory_buffer_device device{};
+		buffer_pool pool{ device, buffer_pool::settings{ 16, 16 } };
+
+		auto a_data = make_indicies(100, 4), b_data = make_indicies(200, 4), c_data = make_indicies(300, 4);
+		auto a = allocate(pool, a_data), b = allocate(pool, b_data), c = allocate(pool, c_data);
+		CHECK(holds(pool, device, a, a_data) and holds(pool, device, b, b_data) and holds(pool, device, c, c_data));
+		CHECK(pool.stats().heaps == 1 and pool.stats().allocations == 3);
+		CHECK(pool.stats().used_bytes == 12 * sizeof(uint32_t));
+
+		// Ranges past the end of the allocation are cut off
+		auto update = make_indicies(900, 8);
+		CHECK(pool.write(c, 0, 2, update.data(), 8));
+		CHECK(holds(pool, device, c, { 300, 301, 900, 901 }));
+
+		CHECK(pool.free(b));
+		CHECK(pool.free(a));
+		CHECK(pool.stats().allocations == 1 and pool.stats().used_bytes == 4 * sizeof(uint32_t));
+
+		// Fits only in what a and b left, together
+		auto d_data = make_indicies(400, 8);
+		auto d = allocate(pool, d_data);
+		CHECK(first_of(pool, d) == 0);
+		CHECK(holds(pool, device, d, d_data));
+		CHECK(pool.stats().heaps == 1);
+	}
+
+	// A new heap is made when none has room, and freed once empty unless it is the last of its layout
+	void heaps_grow()
+	{
+		memory_buffer_device device{};
+		buffer_pool pool{ device, buffer_pool::settings{ 16, 16 } };
+
+		auto a = allocate(pool, make_indicies(0, 12));
+		auto b_data = make_indicies(50, 8);
+		auto b = allocate(pool, b_data);
+		CHECK(pool.stats().heaps == 2);
+		CHECK(pool.stats().capacity_bytes == 2 * 16 * sizeof(uint32_t));
+
+		buffer_pool::location a_where{}, b_where{};
+		CHECK(pool.find(a, a_where) and pool.find(b, b_where));
+		CHECK(a_where.buffers[0] != b_where.buffers[0]);
+		CHECK(holds(pool, device, b, b_data));
+
+		// Bigger than a heap, so it gets one of its own size
+		auto big_data = make_indicies(1000, 40);
+		auto big = allocate(pool, big_data);
+		CHECK(pool.stats().heaps == 3);
+		CHECK(holds(pool, device, big, big_data));
+
+		CHECK(pool.free(big));
+		CHECK(pool.free(b));
+		CHECK(pool.stats().heaps == 1);
+		CHECK(pool.free(a));
+		CHECK(pool.stats().heaps == 1 and pool.stats().allocations == 0);
+		CHECK(device.stats().buffers == 1);
+
+		// Other layouts have heaps of their own
+		const std::vector<uint16_t> short_indicies{ 0, 1, 2 };
+		const void *streams[]{ short_indicies.data() };
+		auto s = pool.allocate(layout::index16, 3, streams);
+		buffer_pool::location s_where{};
+		CHECK(pool.find(s, s_where) and pool.stats().heaps == 2);
+	}
+
+	// A heap with enough room only in pieces is packed, and find has the allocations where they moved
+	void defragment_moves()
+	{
+		memory_buffer_device device{};
+		buffer_pool pool{ device, buffer_pool::settings{ 32, 32 } };
+
+		std::vector<buffer_pool::allocation> allocated;
+		std::vector<std::vector<uint32_t>> data;
+		for (uint32_t i{ 0 }; i < 8; i++)
+		{
+			data.push_back(make_indicies(i * 10, 4));
+			allocated.push_back(allocate(pool, data.back()));
+		}
+		for (uint32_t i{ 0 }; i < 8; i += 2)
+		{
+			CHECK(pool.free(allocated[i]));
+		}
+
+		// 16 free, in pieces of 4
+		auto big_data = make_indicies(500, 8);
+		auto big = allocate(pool, big_data);
+		CHECK(pool.stats().defragmentations == 1);
+		CHECK(pool.stats().heaps == 1);
+		CHECK(pool.stats().moved_bytes == 16 * sizeof(uint32_t));
+
+		// Kept in order, packed to the front
+		for (uint32_t i{ 1 }; i < 8; i += 2)
+		{
+			CHECK(first_of(pool, allocated[i]) == (i / 2) * 4);
+			CHECK(holds(pool, device, allocated[i], data[i]));
+		}
+		CHECK(first_of(pool, big) == 16);
+		CHECK(holds(pool, device, big, big_data));
+
+		// Between frames too; 20 free, in three pieces
+		CHECK(pool.free(allocated[1]));
+		CHECK(pool.free(allocated[3]));
+		CHECK(pool.free(allocated[7]));
+		pool.defragment();
+		CHECK(pool.stats().defragmentations == 2);
+		CHECK(first_of(pool, allocated[5]) == 0 and first_of(pool, big) == 4);
+		CHECK(holds(pool, device, allocated[5], data[5]) and holds(pool, device, big, big_data));
+
+		// Nothing to gain from a heap in one piece
+		pool.defragment();
+		CHECK(pool.stats().defragmentations == 2);
+	}
+
+	// Keys of freed allocations stay stale, also once their slot is used again
+	void stale_keys()
+	{
+		memory_buffer_device device{};
+		buffer_pool pool{ device, buffer_pool::settings{ 16, 16 } };
+
+		auto a = allocate(pool, make_indicies(0, 4));
+		CHECK(pool.free(a));
+		CHECK(not pool.free(a));
+
+		auto b_data = make_indicies(10, 4);
+		auto b = allocate(pool, b_data);
+		CHECK(b.slot == a.slot and b.generation != a.generation);
+
+		buffer_pool::location where{};
+		CHECK(not pool.find(a, where));
+		auto update = make_indicies(99, 4);
+		CHECK(not pool.write(a, 0, 0, update.data(), 4));
+		CHECK(not pool.free(a));
+		CHECK(holds(pool, device, b, b_data));
+		CHECK(pool.stats().allocations == 1);
+	}
+}
+
+void planet_generator::buffer_pool_tests()
+{
+	ranges_merge();
+	allocate_and_free();
+	heaps_grow();
+	defragment_moves();
+	stale_keys();
+}
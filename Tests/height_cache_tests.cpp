@@ -0,0 +1,190 @@
+#include "tests.h"
+#include "height_cache.h"
+#include "cube_sphere.h"
+#include "mesh.h"
+#include "planet_kernel.h"
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace planet_generator;
+
+namespace
+{
+	// Noise heights, counting every direction they are evaluated for
+	class counting_sampler : public height_sampler
+	{
+	public:
+		counting_sampler(const noise_settings &settings) :
+			source(make_height_sampler(settings))
+		{}
+
+		void sample(const float *x, const float *y, const float *z, float *height, size_t count) const override
+		{
+			evaluated += count;
+			source->sample(x, y, z, height, count);
+		}
+
+		bool sample_gradient(const float *x, const float *y, const float *z, float *height,
+		                     float *gradient_x, float *gradient_y, float *gradient_z, size_t count) const override
+		{
+			evaluated += count;
+			return source->sample_gradient(x, y, z, height, gradient_x, gradient_y, gradient_z, count);
+		}
+
+		mutable std::atomic<size_t> evaluated{ 0 };
+
+	private:
+		std::unique_ptr<height_sampler> source;
+	};
+
+	DirectX::XMFLOAT3 direction(uint32_t face, float u, float v)
+	{
+		auto p = face_point(cube_faces[face], u, v, 1.0f);
+		float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+		return { p.x / length, p.y / length, p.z / length };
+	}
+
+	float height_at(const height_sampler &sampler, const DirectX::XMFLOAT3 &d)
+	{
+		float height{};
+		sampler.sample(&d.x, &d.y, &d.z, &height, 1);
+		return height;
+	}
+
+	// Once a level is built, other resolutions and radii are resamples, with no noise evaluated
+	void levels_are_reused()
+	{
+		noise_settings settings{};
+		counting_sampler noise{ settings };
+		height_cache cache{ 16, 3 };
+
+		auto finest = cache.make_sampler(settings, noise, 64);
+		size_t built = noise.evaluated;
+		CHECK(built >= 6 * 65 * 65);
+
+		for (uint32_t resolution : { 64u, 32u, 20u, 16u, 8u })
+		{
+			auto sampler = cache.make_sampler(settings, noise, resolution);
+			for (float radius : { 1.0f, 3.0f })
+			{
+				auto planet = generate_planet(radius, resolution, *sampler, nullptr, true);
+				CHECK(planet.verticies.size() == 6 * size_t{ resolution + 1 } * (resolution + 1));
+			}
+		}
+		CHECK(noise.evaluated == built);
+		CHECK(cache.memory_used() > 0);
+
+		// Other settings are another entry, built from scratch
+		noise_settings other{ noise_type::simplex, 7 };
+		counting_sampler other_noise{ other };
+		auto coarse = cache.make_sampler(other, other_noise, 16);
+		CHECK(other_noise.evaluated >= 6 * 17 * 17 and other_noise.evaluated < built);
+		CHECK(noise.evaluated == built);
+
+		cache.clear();
+		CHECK(cache.memory_used() == 0);
+		auto rebuilt = cache.make_sampler(settings, noise, 64);
+		CHECK(noise.evaluated == 2 * built);
+
+		// Samplers keep their level alive through clear
+		CHECK(height_at(*finest, direction(0, 0.1f, 0.2f)) == height_at(*rebuilt, direction(0, 0.1f, 0.2f)));
+	}
+
+	// At grid points the cache gives back what the source gave; in between it interpolates
+	void bilinear_matches_direct_sampling()
+	{
+		noise_settings settings{};
+		auto direct = make_height_sampler(settings);
+		height_cache cache{ 32, 1 };
+		auto cached = cache.make_sampler(settings, 32);
+
+		constexpr uint32_t resolution = 32;
+		size_t above_zero{ 0 };
+		for (uint32_t face{ 0 }; face < cube_faces.size(); face++)
+		{
+			for (uint32_t y{ 0 }; y <= resolution; y++)
+			{
+				for (uint32_t x{ 0 }; x <= resolution; x++)
+				{
+					auto d = direction(face, grid_coordinate(x, resolution), grid_coordinate(y, resolution));
+
+					float expected{}, gradient[3]{};
+					float height{}, cached_gradient[3]{};
+					CHECK(direct->sample_gradient(&d.x, &d.y, &d.z, &expected, &gradient[0], &gradient[1], &gradient[2], 1));
+					CHECK(cached->sample_gradient(&d.x, &d.y, &d.z, &height, &cached_gradient[0], &cached_gradient[1], &cached_gradient[2], 1));
+
+					CHECK(std::abs(height - expected) <= 1e-6f);
+					CHECK(height_at(*cached, d) == height);
+					for (int axis{ 0 }; axis < 3; axis++)
+					{
+						CHECK(std::abs(cached_gradient[axis] - gradient[axis]) <= 1e-4f * (1.0f + std::abs(gradient[axis])));
+					}
+
+					if (expected > 0.0f)
+						above_zero++;
+				}
+			}
+		}
+		CHECK(above_zero > 0);
+
+		// Middle of a cell is the average of its corners
+		for (uint32_t face{ 0 }; face < cube_faces.size(); face++)
+		{
+			for (uint32_t y{ 0 }; y < resolution; y += 5)
+			{
+				for (uint32_t x{ 0 }; x < resolution; x += 3)
+				{
+					float u0 = grid_coordinate(x, resolution), u1 = grid_coordinate(x + 1, resolution),
+					      v0 = grid_coordinate(y, resolution), v1 = grid_coordinate(y + 1, resolution);
+
+					float corners = height_at(*cached, direction(face, u0, v0)) + height_at(*cached, direction(face, u1, v0))
+					              + height_at(*cached, direction(face, u0, v1)) + height_at(*cached, direction(face, u1, v1));
+					float middle = height_at(*cached, direction(face, 0.5f * (u0 + u1), 0.5f * (v0 + v1)));
+					CHECK(std::abs(middle - 0.25f * corners) <= 1e-6f);
+				}
+			}
+		}
+	}
+
+	// Threads asking for the same level at once share one build
+	void concurrent_requests_build_once()
+	{
+		noise_settings settings{};
+		counting_sampler noise{ settings };
+
+		height_cache reference{ 64, 1 };
+		auto one = reference.make_sampler(settings, noise, 64);
+		size_t one_build = noise.evaluated.exchange(0);
+
+		height_cache cache{ 64, 1 };
+		std::vector<std::thread> threads;
+		std::vector<float> heights(8);
+		auto d = direction(2, 0.3f, -0.4f);
+		for (size_t i{ 0 }; i < heights.size(); i++)
+		{
+			threads.emplace_back([&, i]()
+			{
+				auto sampler = cache.make_sampler(settings, noise, 64);
+				heights[i] = height_at(*sampler, d);
+			});
+		}
+		for (auto &t : threads)
+			t.join();
+
+		CHECK(noise.evaluated == one_build);
+		for (auto h : heights)
+		{
+			CHECK(h == height_at(*one, d));
+		}
+	}
+}
+
+void planet_generator::height_cache_tests()
+{
+	levels_are_reused();
+	bilinear_matches_direct_sampling();
+	concurrent_requests_build_once();
+}
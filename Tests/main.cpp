@@ -0,0 +1,47 @@
+// Unit tests
+// Runs every test and reports the checks that failed; exits with 1 if there were any.
+//
+//   tests
+
+#include "tests.h"
+
+#include <cstdio>
+
+using namespace planet_generator;
+
+namespace
+{
+	int failed_checks = 0;
+
+	struct test
+	{
+		const char *name;
+		void (*run)();
+	};
+
+	const test all_tests[] = {
+		{ "buffer_pool", buffer_pool_tests },
+		{ "height_cache", height_cache_tests },
+		{ "noise_graph", noise_graph_tests },
+		{ "packed_mesh", packed_mesh_tests },
+		{ "render_queue", render_queue_tests },
+	};
+}
+
+void planet_generator::check_failed(const char *file, int line, const char *condition)
+{
+	std::printf("%s(%d): check failed: %s\n", file, line, condition);
+	failed_checks++;
+}
+
+int main()
+{
+	for (auto &t : all_tests)
+	{
+		int failed_before = failed_checks;
+		t.run();
+		std::printf("%-16s %s\n", t.name, (failed_checks == failed_before) ? "passed" : "FAILED");
+	}
+
+	return (failed_checks == 0) ? 0 : 1;
+}
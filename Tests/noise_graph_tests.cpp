@@ -0,0 +1,195 @@
+#include "tests.h"
+#include "noise_graph.h"
+#include "simplex_noise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace planet_generator;
+
+namespace
+{
+	// Random directions, more than one kernel block's worth so programs run over several blocks
+	struct directions
+	{
+		std::vector<float> x, y, z;
+	};
+
+	directions random_directions(size_t count)
+	{
+		std::mt19937 rng{ 42 };
+		std::normal_distribution<float> normal{};
+
+		directions d{};
+		for (size_t i{ 0 }; i < count; i++)
+		{
+			float x = normal(rng), y = normal(rng), z = normal(rng);
+			float length = std::sqrt(x * x + y * y + z * z);
+			d.x.push_back(x / length);
+			d.y.push_back(y / length);
+			d.z.push_back(z / length);
+		}
+		return d;
+	}
+
+	void dead_nodes_are_dropped()
+	{
+		noise_graph graph{};
+		auto layer = graph.noise(noise_settings{});
+		graph.constant(2.0f);
+		graph.noise(noise_settings{ noise_type::simplex, 7 });
+		auto result = graph.scale_bias(layer, 2.0f, 1.0f);
+		graph.add(result, graph.constant(1.0f));
+
+		graph.set_output(result);
+		auto program = graph.compile();
+		CHECK(program != nullptr);
+		CHECK(program->instruction_count() == 2);
+		CHECK(program->register_count() == 1);
+	}
+
+	void registers_are_reused()
+	{
+		// Each step reads its input for the last time, so the whole chain runs in one register
+		noise_graph chain{};
+		auto value = chain.noise(noise_settings{});
+		for (int i{ 0 }; i < 100; i++)
+		{
+			value = chain.scale_bias(value, 0.5f, 0.1f);
+		}
+		auto chain_program = chain.compile();
+		CHECK(chain_program != nullptr);
+		CHECK(chain_program->instruction_count() == 101);
+		CHECK(chain_program->register_count() == 1);
+
+		// Two values alive at once need two registers, however many there are in total
+		noise_graph sum{};
+		auto total = sum.noise(noise_settings{});
+		for (int i{ 0 }; i < 10; i++)
+		{
+			total = sum.add(total, sum.noise(noise_settings{ noise_type::simplex, i }));
+		}
+		auto sum_program = sum.compile();
+		CHECK(sum_program != nullptr);
+		CHECK(sum_program->register_count() == 2);
+
+		// All of them alive at once; one more than fits is refused
+		for (size_t count : { noise_program::max_registers, noise_program::max_registers + 1 })
+		{
+			noise_graph wide{};
+			std::vector<noise_graph::node_id> values;
+			for (size_t i{ 0 }; i < count; i++)
+			{
+				values.push_back(wide.constant(static_cast<float>(i)));
+			}
+			auto wide_total = values.back();
+			for (size_t i{ 0 }; i + 1 < count; i++)
+			{
+				wide_total = wide.add(wide_total, values[i]);
+			}
+
+			auto wide_program = wide.compile();
+			if (count > noise_program::max_registers)
+			{
+				CHECK(wide_program == nullptr);
+			}
+			else
+			{
+				CHECK(wide_program != nullptr and wide_program->register_count() == count);
+			}
+		}
+	}
+
+	// The simplex preset gives what a single layer with negative heights flattened always gave, bit for bit
+	void default_graph_matches_simplex()
+	{
+		noise_settings settings{};
+		auto program = make_noise_graph(settings).compile();
+		CHECK(program != nullptr);
+
+		size_t count = 1000;
+		auto d = random_directions(count);
+		std::vector<float> height(count), gx(count), gy(count), gz(count);
+		program->sample(d.x.data(), d.y.data(), d.z.data(), height.data(), count);
+
+		simplex_noise noise{ settings.seed };
+		std::vector<float> sx(count), sy(count), sz(count), expected(count);
+		for (size_t i{ 0 }; i < count; i++)
+		{
+			sx[i] = d.x[i] * settings.frequency;
+			sy[i] = d.y[i] * settings.frequency;
+			sz[i] = d.z[i] * settings.frequency;
+		}
+		noise.sample(sx.data(), sy.data(), sz.data(), expected.data(), count);
+
+		size_t above_zero{ 0 };
+		for (size_t i{ 0 }; i < count; i++)
+		{
+			CHECK(height[i] == std::max(0.0f, expected[i]) * settings.amplitude);
+			if (height[i] > 0.0f)
+				above_zero++;
+		}
+		CHECK(above_zero > 0 and above_zero < count);
+
+		CHECK(program->sample_gradient(d.x.data(), d.y.data(), d.z.data(), height.data(), gx.data(), gy.data(), gz.data(), count));
+		for (size_t i{ 0 }; i < count; i++)
+		{
+			float gradient[3]{};
+			float value = noise.value(sx[i], sy[i], sz[i], gradient);
+			float slope = (value > 0.0f) ? settings.amplitude * settings.frequency : 0.0f;
+
+			CHECK(height[i] == std::max(0.0f, value) * settings.amplitude);
+			CHECK(gx[i] == gradient[0] * slope);
+			CHECK(gy[i] == gradient[1] * slope);
+			CHECK(gz[i] == gradient[2] * slope);
+		}
+	}
+
+	// Warp, blend, multiply and scale_bias, with a mask that never saturates, so the result is smooth everywhere
+	void gradient_matches_finite_difference()
+	{
+		noise_graph graph{};
+		auto warped = graph.noise(noise_settings{ noise_type::simplex, 1, 100.0f, 0.5f }, 10.0f);
+		auto plain = graph.noise(noise_settings{ noise_type::simplex, 2, 50.0f, 0.5f });
+		auto mask = graph.scale_bias(graph.noise(noise_settings{ noise_type::simplex, 3, 25.0f, 1.0f }), 0.2f, 0.5f);
+		graph.add(graph.blend(warped, plain, mask), graph.multiply(warped, plain));
+		auto program = graph.compile();
+		CHECK(program != nullptr);
+
+		size_t count = 64;
+		auto d = random_directions(count);
+		std::vector<float> height(count), gx(count), gy(count), gz(count);
+		CHECK(program->sample_gradient(d.x.data(), d.y.data(), d.z.data(), height.data(), gx.data(), gy.data(), gz.data(), count));
+
+		constexpr float step = 1e-3f;
+		for (size_t i{ 0 }; i < count; i++)
+		{
+			const float gradient[3] = { gx[i], gy[i], gz[i] };
+			for (int axis{ 0 }; axis < 3; axis++)
+			{
+				float p[2][3] = { { d.x[i], d.y[i], d.z[i] }, { d.x[i], d.y[i], d.z[i] } };
+				p[0][axis] -= step;
+				p[1][axis] += step;
+
+				float h[2]{};
+				for (int side{ 0 }; side < 2; side++)
+				{
+					program->sample(&p[side][0], &p[side][1], &p[side][2], &h[side], 1);
+				}
+
+				float difference = (h[1] - h[0]) / (2.0f * step);
+				CHECK(std::abs(difference - gradient[axis]) <= 0.01f + 0.01f * std::abs(gradient[axis]));
+			}
+		}
+	}
+}
+
+void planet_generator::noise_graph_tests()
+{
+	dead_nodes_are_dropped();
+	registers_are_reused();
+	default_graph_matches_simplex();
+	gradient_matches_finite_difference();
+}
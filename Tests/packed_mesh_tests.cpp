@@ -0,0 +1,112 @@
+#include "tests.h"
+#include "packed_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	constexpr float unorm16_max = 65535.0f;
+
+	float length(const XMFLOAT3 &v)
+	{
+		return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+	}
+
+	// atan2 of the cross and dot products, which stays accurate for tiny angles unlike acos
+	float angle_between(const XMFLOAT3 &a, const XMFLOAT3 &b)
+	{
+		XMFLOAT3 cross{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		return std::atan2(length(cross), a.x * b.x + a.y * b.y + a.z * b.z);
+	}
+
+	// Direction comes back within the tolerance, and the distance from the center within half a height step
+	void check_round_trip(const XMFLOAT3 &position, const height_range &heights)
+	{
+		auto decoded = unpack_position(pack_vertex(vertex{ position }, heights), heights);
+		CHECK(angle_between(position, decoded) <= packed_direction_tolerance);
+
+		// Float rounding of the decoded length is allowed for on top
+		float expected = std::clamp(length(position), heights.base, heights.base + heights.scale);
+		float bound = 0.5f * heights.scale / unorm16_max + 4.0f * std::numeric_limits<float>::epsilon() * (heights.base + heights.scale);
+		CHECK(std::abs(length(decoded) - expected) <= bound);
+	}
+
+	XMFLOAT3 scaled(const XMFLOAT3 &direction, float distance)
+	{
+		float s = distance / length(direction);
+		return { direction.x * s, direction.y * s, direction.z * s };
+	}
+}
+
+void planet_generator::packed_mesh_tests()
+{
+	auto heights = make_height_range(0.9f, 1.1f);
+
+	// Poles of every axis; -z is the corner of the fold, where all four corners of the map meet
+	const XMFLOAT3 poles[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	for (auto &pole : poles)
+	{
+		check_round_trip(pole, heights);
+	}
+
+	// Close to the -z pole, on each side of the fold's corner
+	for (float x : { -1e-4f, 1e-4f })
+	{
+		for (float y : { -1e-4f, 1e-4f })
+		{
+			check_round_trip(scaled({ x, y, -1.0f }, 1.0f), heights);
+		}
+	}
+
+	// Around the equator, where z changes sign and the fold starts, and just below it
+	for (uint32_t i{ 0 }; i < 360; i++)
+	{
+		float angle = XMConvertToRadians(static_cast<float>(i));
+		for (float z : { 0.0f, -1e-6f, -1e-3f, 1e-3f })
+		{
+			check_round_trip(scaled({ std::cos(angle), std::sin(angle), z }, 1.0f), heights);
+		}
+	}
+
+	// Spread over the whole sphere and the whole height range
+	std::mt19937 rng{ 13 };
+	std::normal_distribution<float> axis{};
+	std::uniform_real_distribution<float> distance{ 0.9f, 1.1f };
+	for (uint32_t i{ 0 }; i < 100000; i++)
+	{
+		XMFLOAT3 direction{ axis(rng), axis(rng), axis(rng) };
+		if (length(direction) < 1e-3f)
+			continue;
+
+		check_round_trip(scaled(direction, distance(rng)), heights);
+	}
+
+	// Ends of the height range are exact, and points outside it are clamped to them
+	CHECK(pack_vertex(vertex{ { 0.0f, 0.9f, 0.0f } }, heights).height == 0);
+	CHECK(pack_vertex(vertex{ { 0.0f, 1.1f, 0.0f } }, heights).height == 65535);
+	CHECK(pack_vertex(vertex{ { 0.0f, 0.5f, 0.0f } }, heights).height == 0);
+	CHECK(pack_vertex(vertex{ { 0.0f, 2.0f, 0.0f } }, heights).height == 65535);
+	check_round_trip({ 0.0f, 0.0f, -0.5f }, heights);
+	check_round_trip({ 3.0f, 0.0f, 0.0f }, heights);
+
+	// A whole mesh comes back with the same indicies, in 16 bits while they fit
+	mesh triangle{};
+	triangle.verticies = { vertex{ { 1, 0, 0 } }, vertex{ { 0, 1, 0 } }, vertex{ { 0, 0, -1 } } };
+	triangle.indicies = { 0, 1, 2 };
+	auto packed = pack_mesh(triangle, heights);
+	CHECK(packed.short_indicies.size() == 3 and packed.indicies.empty());
+
+	auto unpacked = unpack_mesh(packed);
+	CHECK(unpacked.indicies == triangle.indicies);
+	CHECK(unpacked.verticies.size() == 3);
+	for (size_t i{ 0 }; i < unpacked.verticies.size(); i++)
+	{
+		CHECK(angle_between(unpacked.verticies[i].position, triangle.verticies[i].position) <= packed_direction_tolerance);
+	}
+}
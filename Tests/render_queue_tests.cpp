@@ -0,0 +1,217 @@
+#include "tests.h"
+#include "Graphics/null_backend.h"
+#include "Graphics/renderer.h"
+#include "mesh.h"
+
+#include <vector>
+
+using namespace DirectX;
+using namespace planet_generator;
+
+namespace
+{
+	using command_type = null_backend::command_type;
+
+	struct expected_command
+	{
+		command_type type;
+		uint32_t object;
+	};
+
+	// Renderer drawing into a recording_backend, with a few of each object to draw with
+	struct test_scene
+	{
+		recording_backend *recorder = nullptr;
+		std::unique_ptr<renderer> gfx;
+		std::vector<renderer::handle> pipelines, materials, transforms_, meshes;
+
+		test_scene()
+		{
+			auto backend = std::make_unique<recording_backend>();
+			recorder = backend.get();
+			gfx = std::make_unique<renderer>(std::move(backend));
+
+			std::vector<input_layout_mode> layout{ input_layout_mode::position };
+			std::vector<uint8_t> no_shader;
+			mesh triangle{};
+			triangle.verticies = { vertex{ { 0, 0, 0 } }, vertex{ { 1, 0, 0 } }, vertex{ { 0, 1, 0 } } };
+			triangle.indicies = { 0, 1, 2 };
+			for (uint32_t i{ 0 }; i < 3; i++)
+			{
+				pipelines.push_back(gfx->add_pipeline_state(pipeline_description{ blend_mode::Opaque,
+				                                                                  depth_stencil_mode::ReadWrite,
+				                                                                  rasterizer_mode::CullNone,
+				                                                                  sampler_mode::LinearClamp,
+				                                                                  primitive_topology::TriangleList }));
+				materials.push_back(gfx->add_material(material_description{ layout, no_shader, no_shader }));
+				transforms_.push_back(gfx->add_transform(transforms{ XMMatrixIdentity() }, shader_slot::transform));
+				meshes.push_back(gfx->add_mesh(triangle));
+			}
+		}
+
+		// Draws a frame and returns its binds and draws, in order
+		std::vector<recording_backend::command> draw_frame()
+		{
+			recorder->clear();
+			gfx->draw_frame();
+
+			std::vector<recording_backend::command> binds_and_draws;
+			for (auto &c : recorder->commands)
+			{
+				switch (c.type)
+				{
+				case command_type::bind_mesh:
+				case command_type::bind_material:
+				case command_type::bind_pipeline:
+				case command_type::bind_constants:
+				case command_type::bind_instances:
+				case command_type::draw:
+				case command_type::draw_ranges:
+				case command_type::draw_instanced:
+					binds_and_draws.push_back(c);
+					break;
+				default:
+					break;
+				}
+			}
+			return binds_and_draws;
+		}
+	};
+
+	bool matches(const std::vector<recording_backend::command> &commands, const std::vector<expected_command> &expected)
+	{
+		if (commands.size() != expected.size())
+			return false;
+
+		for (size_t i{ 0 }; i < commands.size(); i++)
+		{
+			if (commands[i].type != expected[i].type or commands[i].object != expected[i].object)
+				return false;
+		}
+		return true;
+	}
+
+	// State shared by draws is bound once, and a mesh drawn twice in a row is bound once
+	void state_is_bound_once()
+	{
+		test_scene scene{};
+		auto &gfx = *scene.gfx;
+		gfx.add_to_draw_queue(scene.pipelines[0]);
+		gfx.add_to_draw_queue(scene.materials[0]);
+		gfx.add_to_draw_queue(scene.transforms_[0]);
+		gfx.add_to_draw_queue(scene.meshes[0], 1.0f);
+		gfx.add_to_draw_queue(scene.meshes[0], 1.0f);
+		gfx.add_to_draw_queue(scene.meshes[1], 2.0f);
+
+		CHECK(matches(scene.draw_frame(), { { command_type::bind_pipeline, 0 },
+		                                    { command_type::bind_material, 0 },
+		                                    { command_type::bind_constants, 0 },
+		                                    { command_type::bind_mesh, 0 },
+		                                    { command_type::draw, 0 },
+		                                    { command_type::draw, 0 },
+		                                    { command_type::bind_mesh, 1 },
+		                                    { command_type::draw, 1 } }));
+
+		auto &stats = gfx.frame_stats();
+		CHECK(stats.draws == 3);
+		CHECK(stats.pipeline_binds == 1 and stats.material_binds == 1 and stats.constant_binds == 1);
+		CHECK(stats.mesh_binds == 2);
+		// Pipeline, material, transform and mesh for the second draw, all but the mesh for the third
+		CHECK(stats.skipped_binds == 4 + 3);
+
+		// State set so far is kept for the next frame, but binds start over
+		gfx.add_to_draw_queue(scene.meshes[2]);
+		CHECK(matches(scene.draw_frame(), { { command_type::bind_pipeline, 0 },
+		                                    { command_type::bind_material, 0 },
+		                                    { command_type::bind_constants, 0 },
+		                                    { command_type::bind_mesh, 2 },
+		                                    { command_type::draw, 2 } }));
+	}
+
+	// Draws are grouped by pipeline, then material, and go front to back within a group
+	void draws_are_sorted()
+	{
+		test_scene scene{};
+		auto &gfx = *scene.gfx;
+		gfx.add_to_draw_queue(scene.pipelines[1]);
+		gfx.add_to_draw_queue(scene.materials[0]);
+		gfx.add_to_draw_queue(scene.meshes[0], 5.0f);
+		gfx.add_to_draw_queue(scene.pipelines[0]);
+		gfx.add_to_draw_queue(scene.meshes[1], 3.0f);
+		gfx.add_to_draw_queue(scene.materials[1]);
+		gfx.add_to_draw_queue(scene.meshes[2], 4.0f);
+		gfx.add_to_draw_queue(scene.materials[0]);
+		gfx.add_to_draw_queue(scene.meshes[2], 1.0f);
+
+		CHECK(matches(scene.draw_frame(), { { command_type::bind_pipeline, 0 },
+		                                    { command_type::bind_material, 0 },
+		                                    { command_type::bind_mesh, 2 },
+		                                    { command_type::draw, 2 },
+		                                    { command_type::bind_mesh, 1 },
+		                                    { command_type::draw, 1 },
+		                                    { command_type::bind_material, 1 },
+		                                    { command_type::bind_mesh, 2 },
+		                                    { command_type::draw, 2 },
+		                                    { command_type::bind_pipeline, 1 },
+		                                    { command_type::bind_material, 0 },
+		                                    { command_type::bind_mesh, 0 },
+		                                    { command_type::draw, 0 } }));
+	}
+
+	// A render list replays the same commands every frame it is queued, ahead of the sorted draws,
+	// and those draws carry on from the state it left bound
+	void lists_replay()
+	{
+		test_scene scene{};
+		auto &gfx = *scene.gfx;
+		auto list = gfx.add_render_list();
+		gfx.add_to_render_list(list, scene.pipelines[2]);
+		gfx.add_to_render_list(list, scene.materials[2]);
+		gfx.add_to_render_list(list, scene.transforms_[2]);
+		gfx.add_to_render_list(list, scene.meshes[1], 2.0f);
+		gfx.add_to_render_list(list, scene.meshes[0], 1.0f);
+
+		const std::vector<expected_command> list_commands{ { command_type::bind_pipeline, 2 },
+		                                                   { command_type::bind_material, 2 },
+		                                                   { command_type::bind_constants, 2 },
+		                                                   { command_type::bind_mesh, 0 },
+		                                                   { command_type::draw, 0 },
+		                                                   { command_type::bind_mesh, 1 },
+		                                                   { command_type::draw, 1 } };
+		for (uint32_t frame{ 0 }; frame < 3; frame++)
+		{
+			gfx.add_to_draw_queue(list);
+			CHECK(matches(scene.draw_frame(), list_commands));
+		}
+
+		gfx.add_to_draw_queue(scene.meshes[2]);
+		gfx.add_to_draw_queue(list);
+		gfx.add_to_draw_queue(scene.meshes[1]);
+		auto expected = list_commands;
+		expected.push_back({ command_type::draw, 1 });
+		expected.push_back({ command_type::bind_mesh, 2 });
+		expected.push_back({ command_type::draw, 2 });
+		CHECK(matches(scene.draw_frame(), expected));
+
+		// A removed mesh is skipped by the list, even once its slot is taken again
+		CHECK(gfx.remove(scene.meshes[0]));
+		mesh other{};
+		auto reused = gfx.add_mesh(other);
+		CHECK(reused.id == scene.meshes[0].id);
+
+		gfx.add_to_draw_queue(list);
+		CHECK(matches(scene.draw_frame(), { { command_type::bind_pipeline, 2 },
+		                                    { command_type::bind_material, 2 },
+		                                    { command_type::bind_constants, 2 },
+		                                    { command_type::bind_mesh, 1 },
+		                                    { command_type::draw, 1 } }));
+		CHECK(gfx.stale_commands() == 2);
+	}
+}
+
+void planet_generator::render_queue_tests()
+{
+	state_is_bound_once();
+	draws_are_sorted();
+	lists_replay();
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// A failed check is reported with where it is and the run goes on
+#define CHECK(condition) \
+	((condition) ? (void)0 : planet_generator::check_failed(__FILE__, __LINE__, #condition))
+
+namespace planet_generator
+{
+	void check_failed(const char *file, int line, const char *condition);
+
+	void buffer_pool_tests();
+	void height_cache_tests();
+	void noise_graph_tests();
+	void packed_mesh_tests();
+	void render_queue_tests();
+}
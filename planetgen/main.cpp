@@ -0,0 +1,469 @@
+// planetgen
+// Headless planet generator; builds one planet mesh and writes it to disk.
+//
+//   planetgen [options] --output planet.ply
+//
+//   --radius r           sphere radius, default 1
+//   --subdivisions n     subdivision level, default 6; grid meshes use 2^n quads per face edge
+//   --mesh kind          grid (default), shared or split
+//   --noise kind         simplex (default), continents or none
+//   --seed n             noise seed
+//   --frequency f        noise frequency
+//   --amplitude a        noise amplitude
+//   --threads n          threads to use including the calling thread, 0 for all cores (default)
+//   --optimize           reorder triangles and verticies for GPU vertex cache and fetch locality
+//   --normals            also write smooth per vertex normals, from the analytic noise gradient (.obj and .ply)
+//   --lods n             grid meshes also get n - 1 coarser levels of detail, each half the resolution of the one before,
+//                        written as <output>_lod1.ply and so on. Noise is evaluated once, into a height cache,
+//                        and every level is resampled from it. .obj and .ply only
+//   --output path        .obj, .ply, .planet or .ppm, default planet.ply
+//                        .planet files are the memory mappable planet cache format, and need a noisy grid mesh
+//                        .ppm renders a picture of the planet on the CPU, with no GPU needed
+//   --size WxH           .ppm picture size, default 1920x1080
+//   --wireframe          .ppm shows triangle edges instead of the lit surface
+//   --frames n           .ppm renders n frames and reports frames per second, default 1
+//   --moons n            .ppm adds n moons orbiting the planet, all drawn in one instanced draw
+//   --quiet              only print errors
+
+#include "planet.h"
+#include "planet_kernel.h"
+#include "culling.h"
+#include "instancing.h"
+#include "mesh.h"
+#include "mesh_io.h"
+#include "mesh_optimizer.h"
+#include "planet_file.h"
+#include "height_cache.h"
+#include "thread_pool.h"
+#include "Graphics/renderer.h"
+#include "Graphics/software_backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace planet_generator;
+
+namespace
+{
+	enum class mesh_kind
+	{
+		grid,
+		shared,
+		split
+	};
+
+	struct options
+	{
+		float radius = 1.0f;
+		uint32_t subdivisions = 6;
+		mesh_kind kind = mesh_kind::grid;
+		bool with_noise = true;
+		noise_settings noise{};
+		uint32_t threads = 0;
+		bool optimize = false;
+		bool normals = false;
+		uint32_t lods = 1;
+		std::string output = "planet.ply";
+		uint32_t width = 1920;
+		uint32_t height = 1080;
+		bool wireframe = false;
+		uint32_t frames = 1;
+		uint32_t moons = 0;
+		bool quiet = false;
+	};
+
+	struct render_result
+	{
+		double milliseconds;    // per frame, averaged
+		rasterizer::statistics stats;
+		instance_builder::statistics moons;     // of the last frame
+	};
+
+	struct moon_orbit
+	{
+		float distance;         // from the planet's centre
+		float height;           // above the orbital plane
+		float angle;            // at the first frame
+		float speed;            // radians per frame
+	};
+
+	[[noreturn]]
+	void fail(const char *message, std::string_view detail = {})
+	{
+		std::fprintf(stderr, "planetgen: %s%.*s\n", message, static_cast<int>(detail.size()), detail.data());
+		std::exit(1);
+	}
+
+	bool ends_with(std::string_view text, std::string_view suffix)
+	{
+		return text.size() >= suffix.size() and text.substr(text.size() - suffix.size()) == suffix;
+	}
+
+	options parse_options(int argc, char *argv[])
+	{
+		options opt{};
+		for (int i{ 1 }; i < argc; i++)
+		{
+			std::string_view arg = argv[i];
+			auto next = [&]() -> std::string
+			{
+				if (i + 1 >= argc)
+					fail("missing value for ", arg);
+				return argv[++i];
+			};
+
+			try
+			{
+				if (arg == "--radius")             opt.radius = std::stof(next());
+				else if (arg == "--subdivisions")  opt.subdivisions = std::stoul(next());
+				else if (arg == "--seed")          opt.noise.seed = std::stoi(next());
+				else if (arg == "--frequency")     opt.noise.frequency = std::stof(next());
+				else if (arg == "--amplitude")     opt.noise.amplitude = std::stof(next());
+				else if (arg == "--threads")       opt.threads = std::stoul(next());
+				else if (arg == "--output")        opt.output = next();
+				else if (arg == "--optimize")      opt.optimize = true;
+				else if (arg == "--normals")       opt.normals = true;
+				else if (arg == "--lods")          opt.lods = std::max(1ul, std::stoul(next()));
+				else if (arg == "--wireframe")     opt.wireframe = true;
+				else if (arg == "--frames")        opt.frames = std::max(1ul, std::stoul(next()));
+				else if (arg == "--moons")         opt.moons = std::stoul(next());
+				else if (arg == "--quiet")         opt.quiet = true;
+				else if (arg == "--size")
+				{
+					auto size = next();
+					auto x = size.find('x');
+					if (x == size.npos)
+						fail("size must be WxH: ", size);
+					opt.width = std::stoul(size.substr(0, x));
+					opt.height = std::stoul(size.substr(x + 1));
+					if (opt.width == 0 or opt.height == 0 or opt.width > 16384 or opt.height > 16384)
+						fail("bad size ", size);
+				}
+				else if (arg == "--mesh")
+				{
+					auto kind = next();
+					if (kind == "grid")        opt.kind = mesh_kind::grid;
+					else if (kind == "shared") opt.kind = mesh_kind::shared;
+					else if (kind == "split")  opt.kind = mesh_kind::split;
+					else fail("unknown mesh kind ", kind);
+				}
+				else if (arg == "--noise")
+				{
+					auto kind = next();
+					if (kind == "simplex")         { opt.with_noise = true; opt.noise.type = noise_type::simplex; }
+					else if (kind == "continents") { opt.with_noise = true; opt.noise.type = noise_type::continents; }
+					else if (kind == "none")       opt.with_noise = false;
+					else fail("unknown noise kind ", kind);
+				}
+				else fail("unknown option ", arg);
+			}
+			catch (const std::logic_error &)
+			{
+				fail("bad value for ", arg);
+			}
+		}
+
+		// Subdivided meshes grow 4x per level, and the grid resolution must fit 32 bits
+		auto max_subdivisions = (opt.kind == mesh_kind::grid) ? 14u : 10u;
+		if (opt.subdivisions > max_subdivisions)
+			fail("subdivisions too large for this mesh kind");
+
+		if (not ends_with(opt.output, ".obj") and not ends_with(opt.output, ".ply") and not ends_with(opt.output, ".planet") and
+		    not ends_with(opt.output, ".ppm"))
+			fail("output must end in .obj, .ply, .planet or .ppm: ", opt.output);
+
+		// Planet files are keyed by grid generation parameters, so they can't hold other kinds of mesh
+		if (ends_with(opt.output, ".planet") and (opt.kind != mesh_kind::grid or not opt.with_noise))
+			fail("a .planet file needs --mesh grid and a --noise other than none");
+
+		if (opt.lods > 1)
+		{
+			if (opt.kind != mesh_kind::grid or not opt.with_noise)
+				fail("--lods needs --mesh grid and a --noise other than none");
+			if (not ends_with(opt.output, ".obj") and not ends_with(opt.output, ".ply"))
+				fail("--lods needs a .obj or .ply output");
+			if (opt.lods > opt.subdivisions + 1)
+				fail("--lods can't be more than --subdivisions + 1");
+		}
+
+		return opt;
+	}
+
+	// "planet.ply" -> "planet_lod2.ply"
+	std::string lod_path(const std::string &path, uint32_t lod)
+	{
+		auto dot = path.rfind('.');
+		return path.substr(0, dot) + "_lod" + std::to_string(lod) + path.substr(dot);
+	}
+
+	// A sphere's normals are just its directions
+	void add_sphere_normals(mesh &sphere)
+	{
+		sphere.normals.clear();
+		sphere.normals.reserve(sphere.verticies.size());
+		for (const auto &v : sphere.verticies)
+		{
+			DirectX::XMFLOAT3 n{};
+			DirectX::XMStoreFloat3(&n, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&v.position)));
+			sphere.normals.push_back(n);
+		}
+	}
+
+	// Spread through a thick ring around the planet, some of it behind the camera, so culling has work to do
+	std::vector<moon_orbit> make_moons(uint32_t count, float planet_radius, instance_builder &bodies)
+	{
+		constexpr float golden_angle = 2.39996323f;
+		std::vector<moon_orbit> orbits;
+		orbits.reserve(count);
+		for (uint32_t i{ 0 }; i < count; i++)
+		{
+			float t = (i + 0.5f) / count;
+			float wobble = std::fmod(i * 0.618034f, 1.0f);
+			moon_orbit orbit{ planet_radius * (1.4f + 2.2f * t),
+			                  planet_radius * 0.3f * (wobble - 0.5f),
+			                  i * golden_angle,
+			                  0.02f / (1.0f + 2.0f * t) };
+			orbits.push_back(orbit);
+			bodies.add({ {}, planet_radius * (0.02f + 0.06f * wobble), 0.0f, wobble });
+		}
+		return orbits;
+	}
+
+	double milliseconds_since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Draws the planet through renderer, with the CPU backend, from a fixed viewpoint that has all of it in view
+	render_result render_picture(const mesh &planet, const options &opt, thread_pool &pool)
+	{
+		using namespace DirectX;
+
+		software_backend::settings target{};
+		target.width = opt.width;
+		target.height = opt.height;
+		target.pool = &pool;
+		auto backend = std::make_unique<software_backend>(target);
+		auto &picture = *backend;
+		renderer gfx{ std::move(backend) };
+
+		auto pipeline_id = gfx.add_pipeline_state(
+			pipeline_description{
+				blend_mode::Opaque,
+				depth_stencil_mode::ReadWrite,
+				opt.wireframe ? rasterizer_mode::Wireframe : rasterizer_mode::CullNone,
+				sampler_mode::AnisotropicClamp,
+
+				primitive_topology::TriangleList,
+			});
+
+		// Shaders are not run, the backend shades like them by the layout alone
+		std::vector<uint8_t> no_shader;
+		auto layout = opt.wireframe ? std::vector{ input_layout_mode::position }
+		                            : std::vector{ input_layout_mode::position, input_layout_mode::normal };
+		auto material_id = gfx.add_material(material_description{ layout, no_shader, no_shader });
+		auto mesh_id = gfx.add_mesh(planet);
+
+		constexpr auto angle = XMConvertToRadians(30.0f);
+		auto world = XMMatrixRotationRollPitchYaw(angle, angle, 0.0f);
+		auto view = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -2.5f * opt.radius, 1.0f),
+		                             XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),
+		                             XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		auto projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.0f),
+		                                           static_cast<float>(opt.width) / opt.height,
+		                                           0.1f * opt.radius,
+		                                           10.0f * opt.radius);
+		auto transform_id = gfx.add_transform(transforms{ XMMatrixTranspose(world) }, shader_slot::transform);
+		auto view_id = gfx.add_transform(transforms{ XMMatrixTranspose(view) }, shader_slot::view);
+		auto projection_id = gfx.add_transform(transforms{ XMMatrixTranspose(projection) }, shader_slot::projection);
+
+		// Moons share one unit sphere; every frame they move along their orbits, and only those in view are
+		// sent to the instance set, for one instanced draw
+		instance_builder moons;
+		auto orbits = make_moons(opt.moons, opt.radius, moons);
+		std::vector<instance_data> moon_instances(orbits.size());
+		auto moon_view = make_cull_view(view * projection, XMVectorSet(0.0f, 0.0f, -2.5f * opt.radius, 1.0f));
+
+		auto moon_sphere = generate_grid_sphere(1.0f, 16);
+		if (not opt.wireframe)
+			add_sphere_normals(moon_sphere);
+		auto moon_layout = layout;
+		moon_layout.push_back(input_layout_mode::instance);
+		auto moon_material_id = gfx.add_material(material_description{ moon_layout, no_shader, no_shader });
+		auto moon_mesh_id = gfx.add_mesh(moon_sphere);
+		auto moon_instances_id = gfx.add_instances(static_cast<uint32_t>(orbits.size()));
+
+		render_result result{};
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t frame{ 0 }; frame < opt.frames; frame++)
+		{
+			for (auto &id : { projection_id, view_id, transform_id, pipeline_id, material_id, mesh_id })
+			{
+				gfx.add_to_draw_queue(id);
+			}
+
+			if (not orbits.empty())
+			{
+				for (uint32_t m{ 0 }; m < orbits.size(); m++)
+				{
+					const auto &orbit = orbits[m];
+					float angle = orbit.angle + orbit.speed * frame;
+					moons.set_position(m, { orbit.distance * std::cos(angle), orbit.height, orbit.distance * std::sin(angle) });
+					moons.set_spin(m, angle);
+				}
+				auto visible = moons.build(moon_view, moon_instances.data());
+				gfx.update_instances(moon_instances_id, moon_instances.data(), visible);
+				gfx.add_to_draw_queue(moon_material_id);
+				gfx.add_to_draw_queue(moon_mesh_id, moon_instances_id);
+			}
+			gfx.draw_frame();
+		}
+		result.milliseconds = milliseconds_since(start) / opt.frames;
+		result.moons = moons.stats();
+
+		result.stats = picture.target().stats();
+		if (not picture.write_image(opt.output))
+			fail("could not write ", opt.output);
+
+		return result;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	auto opt = parse_options(argc, argv);
+
+	auto start = std::chrono::steady_clock::now();
+
+	thread_pool pool = opt.threads ? thread_pool(opt.threads - 1) : thread_pool();
+	auto heights = opt.with_noise ? make_height_sampler(opt.noise) : nullptr;
+
+	// Lit pictures need normals, whether or not they were asked for
+	bool picture = ends_with(opt.output, ".ppm");
+	if (picture and not opt.wireframe)
+		opt.normals = true;
+
+	auto generate_start = std::chrono::steady_clock::now();
+	std::unique_ptr<height_cache> lod_heights{};
+	mesh planet{};
+	if (opt.kind == mesh_kind::grid)
+	{
+		auto resolution = 1u << opt.subdivisions;
+		if (opt.lods > 1)
+		{
+			// Every level of detail is resampled from these; only the finest evaluates noise
+			lod_heights = std::make_unique<height_cache>(resolution >> (opt.lods - 1), static_cast<uint8_t>(opt.lods));
+			heights = lod_heights->make_sampler(opt.noise, *heights, resolution, &pool);
+		}
+		planet = heights ? generate_planet(opt.radius, resolution, *heights, &pool, opt.normals)
+		                 : generate_grid_sphere(opt.radius, resolution, &pool);
+	}
+	else
+	{
+		auto mode = (opt.kind == mesh_kind::shared) ? subdivision_mode::shared_vertices : subdivision_mode::split_triangles;
+		planet = generate_sphere(opt.radius, static_cast<uint8_t>(opt.subdivisions), mode);
+		if (heights)
+		{
+			if (opt.normals)
+				planet.normals.resize(planet.verticies.size());
+			displace_verticies(planet.verticies.data(), planet.verticies.data() + planet.verticies.size(), *heights,
+			                   opt.normals ? planet.normals.data() : nullptr);
+		}
+	}
+
+	if (opt.normals and planet.normals.empty())
+		add_sphere_normals(planet);
+	auto generate_ms = milliseconds_since(generate_start);
+
+	float acmr_before{}, acmr_after{};
+	double optimize_ms{};
+	if (opt.optimize)
+	{
+		auto optimize_start = std::chrono::steady_clock::now();
+		acmr_before = average_cache_miss_ratio(planet);
+		optimize_mesh(planet);
+		acmr_after = average_cache_miss_ratio(planet);
+		optimize_ms = milliseconds_since(optimize_start);
+	}
+
+	if (picture)
+	{
+		auto result = render_picture(planet, opt, pool);
+		if (not opt.quiet)
+		{
+			auto frame_stats = result.stats;
+			std::printf("%s: %zu verticies, %zu triangles, generate %.3f ms\n",
+			            opt.output.c_str(), planet.verticies.size(), planet.indicies.size() / 3, generate_ms);
+			std::printf("render %ux%u %s, %u threads: %.3f ms per frame, %.1f frames per second\n",
+			            opt.width,
+			            opt.height,
+			            opt.wireframe ? "wireframe" : "solid",
+			            pool.size(),
+			            result.milliseconds,
+			            1000.0 / result.milliseconds);
+			std::printf("per frame: %llu triangles, %llu culled, %llu clipped, %llu binned to %llu tile entries\n",
+			            static_cast<unsigned long long>(frame_stats.triangles / opt.frames),
+			            static_cast<unsigned long long>(frame_stats.culled / opt.frames),
+			            static_cast<unsigned long long>(frame_stats.clipped / opt.frames),
+			            static_cast<unsigned long long>(frame_stats.binned / opt.frames),
+			            static_cast<unsigned long long>(frame_stats.tile_entries / opt.frames));
+			if (opt.moons)
+				std::printf("moons: %u of %u in view, drawn instanced\n", result.moons.visible, result.moons.tested);
+		}
+		return 0;
+	}
+
+	auto write_start = std::chrono::steady_clock::now();
+	bool written = false;
+	if (ends_with(opt.output, ".obj"))
+		written = write_obj(planet, opt.output);
+	else if (ends_with(opt.output, ".ply"))
+		written = write_ply(planet, opt.output);
+	else
+		written = write_planet_file(opt.output, planet_parameters{ opt.radius, 1u << opt.subdivisions, opt.noise }, planet);
+	if (not written)
+		fail("could not write ", opt.output);
+	auto write_ms = milliseconds_since(write_start);
+
+	if (not opt.quiet)
+	{
+		std::printf("%s: %zu verticies, %zu triangles\n", opt.output.c_str(), planet.verticies.size(), planet.indicies.size() / 3);
+		std::printf("generate %.3f ms (%s kernel, %u threads), write %.3f ms, total %.3f ms\n",
+		            generate_ms,
+		            kernel_instruction_set(),
+		            pool.size(),
+		            write_ms,
+		            milliseconds_since(start));
+		if (opt.optimize)
+			std::printf("optimize %.3f ms, ACMR %.3f -> %.3f\n", optimize_ms, acmr_before, acmr_after);
+	}
+
+	for (uint32_t lod{ 1 }; lod < opt.lods; lod++)
+	{
+		auto lod_start = std::chrono::steady_clock::now();
+		auto resolution = (1u << opt.subdivisions) >> lod;
+		auto lod_sampler = lod_heights->make_sampler(opt.noise, resolution, &pool);
+		auto lod_mesh = generate_planet(opt.radius, resolution, *lod_sampler, &pool, opt.normals);
+		if (opt.optimize)
+			optimize_mesh(lod_mesh);
+
+		auto path = lod_path(opt.output, lod);
+		bool lod_written = ends_with(path, ".obj") ? write_obj(lod_mesh, path) : write_ply(lod_mesh, path);
+		if (not lod_written)
+			fail("could not write ", path);
+
+		if (not opt.quiet)
+			std::printf("%s: %zu verticies, %zu triangles, resampled and written in %.3f ms\n",
+			            path.c_str(), lod_mesh.verticies.size(), lod_mesh.indicies.size() / 3, milliseconds_since(lod_start));
+	}
+
+	return 0;
+}